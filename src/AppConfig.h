@@ -0,0 +1,83 @@
+#pragma once
+#include "SettingsSchema.h"
+
+/**
+ * @file AppConfig.h
+ * @brief settings.ini と結び付くアプリケーション設定値とそのスキーマ表。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 描画に用いる設定値一式。各メンバーは kAppConfigFields で設定キーへ束縛される。
+ * @note 既定値は kAppConfigFields だけが持つ (SettingsBinding::ApplyDefaults で適用する)。ここでは 0 で初期化するのみ。
+ */
+struct AppConfig
+{
+    bool vsync{};              // VSync 有効フラグ
+    int hotReloadIntervalMs{}; // ホットリロード間隔 (ミリ秒)
+    int hotReloadDebounceMs{}; // 連続した更新をまとめる待ち時間 (ミリ秒)
+    int maxFps{};              // フレームレートの上限 (0 なら上限なし)
+    int backgroundFps{};       // 最小化中・隠れている間のフレームレート
+    bool onDemand{};           // 入力・アニメーション・再読み込みがあるときだけ描く
+    float clear[4]{};          // クリアカラー RGBA
+    float scale{};             // 三角形スケール係数
+    float speed{};             // 回転速度係数
+    float tint[3]{};           // 色調補正係数
+};
+
+/**
+ * @brief AppConfig の各メンバーと settings.ini のキーを対応付ける記述子表。
+ * @details 項目の追加はこの表への 1 行追加だけで既定値・読み込み・保存・UI・範囲検証へ反映される。
+ *          束縛先は BindField のメンバーポインターで指定し、FieldType とメンバーの型が合わなければコンパイルできない。
+ *          UI はカテゴリが切り替わる位置で見出しを作るため、同じカテゴリの項目は連続して並べる。
+ */
+inline constexpr FieldDesc kAppConfigFields[] = {
+    {"Render", "VSync", "VSync", BindField<FieldType::Bool, &AppConfig::vsync>, {1.0}, 0.0, 1.0},
+    {"Render",
+     "HotReloadIntervalMs",
+     "HotReloadIntervalMs",
+     BindField<FieldType::Int, &AppConfig::hotReloadIntervalMs>,
+     {500.0},
+     100.0,
+     2000.0,
+     nullptr,
+     RangePolicy::Reject},
+    {"Render",
+     "HotReloadDebounceMs",
+     "HotReloadDebounceMs",
+     BindField<FieldType::Int, &AppConfig::hotReloadDebounceMs>,
+     {50.0},
+     0.0,
+     1000.0},
+    {"Render", "MaxFps", "MaxFps", BindField<FieldType::Int, &AppConfig::maxFps>, {240.0}, 0.0, 1000.0},
+    {"Render",
+     "BackgroundFps",
+     "BackgroundFps",
+     BindField<FieldType::Int, &AppConfig::backgroundFps>,
+     {10.0},
+     1.0,
+     60.0},
+    {"Render", "OnDemand", "OnDemand", BindField<FieldType::Bool, &AppConfig::onDemand>, {0.0}, 0.0, 1.0},
+    {"Clear",
+     "ClearColor",
+     "Color",
+     BindField<FieldType::Color4, &AppConfig::clear>,
+     {0.05, 0.10, 0.20, 1.0},
+     0.0,
+     1.0,
+     nullptr,
+     RangePolicy::Clamp,
+     "R|G|B|A"},
+    {"Triangle", "Scale", "Scale", BindField<FieldType::Float, &AppConfig::scale>, {1.0}, 0.1, 5.0},
+    {"Triangle", "RotationSpeed", "RotationSpeed", BindField<FieldType::Float, &AppConfig::speed>, {1.0}, -10.0, 10.0},
+    {"Triangle",
+     "Tint",
+     "Tint",
+     BindField<FieldType::Color3, &AppConfig::tint>,
+     {1.0, 1.0, 1.0},
+     0.0,
+     1.0,
+     nullptr,
+     RangePolicy::Clamp,
+     "TintR|TintG|TintB"},
+};
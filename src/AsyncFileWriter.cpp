@@ -0,0 +1,324 @@
+/**
+ * @file AsyncFileWriter.cpp
+ * @brief 非同期・原子的ファイルライターの実装。
+ * @author 山内陽
+ */
+
+#include "AsyncFileWriter.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief デバウンス時間と最大遅延を指定して構築する。ワーカーは最初の要求時に起動する。
+ * @param debounce 要求が途切れてから書き出すまでの待ち時間。
+ * @param maxLatency 要求が続いていても書き出すまでの最大待ち時間。
+ */
+AsyncFileWriter::AsyncFileWriter(std::chrono::milliseconds debounce, std::chrono::milliseconds maxLatency)
+    : m_debounce(debounce), m_maxLatency(maxLatency)
+{
+}
+
+/**
+ * @brief 保留中の内容を書き出してからワーカーを停止する。
+ */
+AsyncFileWriter::~AsyncFileWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+/**
+ * @brief 書き出し要求を登録する。バッファの交換のみでディスクには触れない。
+ * @param path 書き出し先パス。
+ * @param content 書き出す内容 (保留バッファと交換される)。
+ */
+void AsyncFileWriter::Submit(const std::filesystem::path& path, std::string& content)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto now = Clock::now();
+        if (!m_hasPending)
+            m_firstSubmit = now;
+        m_lastSubmit = now;
+        if (m_pendingPath != path)
+            m_pendingPath = path;
+        m_pending.swap(content);
+        m_patchable = false;
+        m_hasPending = true;
+        if (!m_thread.joinable())
+            m_thread = std::thread(&AsyncFileWriter::Run, this);
+    }
+    m_wake.notify_all();
+}
+
+/**
+ * @brief 差分書き込みを優先した書き出し要求を登録する。
+ * @param path 書き出し先パス。
+ * @param content 差分適用後のファイル全体。
+ * @param patch 差分。
+ */
+void AsyncFileWriter::SubmitPatch(const std::filesystem::path& path, std::string& content, FilePatch& patch)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto now = Clock::now();
+        // 未処理の全体書き出し要求や別ファイル宛ての要求とは合成できない
+        const bool merge = m_hasPending && m_patchable && m_pendingPath == path;
+        if (!m_hasPending)
+            m_firstSubmit = now;
+        m_lastSubmit = now;
+        if (m_pendingPath != path)
+            m_pendingPath = path;
+        m_pending.swap(content);
+        if (merge)
+        {
+            // ディスク上はまだ最初の差分の before のままなので、同じ位置の書き換えだけを合成できる
+            m_patchable = patch.offset == m_pendingPatch.offset && patch.bytes.size() == m_pendingPatch.bytes.size();
+            m_pendingPatch.bytes.swap(patch.bytes);
+        }
+        else
+        {
+            std::swap(m_pendingPatch, patch);
+            m_patchable = !m_hasPending && FitsInSector(m_pendingPatch.offset, m_pendingPatch.bytes.size()) &&
+                          m_pendingPatch.before.size() == m_pendingPatch.bytes.size();
+        }
+        m_hasPending = true;
+        if (!m_thread.joinable())
+            m_thread = std::thread(&AsyncFileWriter::Run, this);
+    }
+    m_wake.notify_all();
+}
+
+/**
+ * @brief 保留中の内容を直ちに書き出し、完了まで待つ。
+ */
+void AsyncFileWriter::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_thread.joinable())
+        return;
+    m_flush = true;
+    m_wake.notify_all();
+    m_done.wait(lock, [this] { return !m_hasPending && !m_busy; });
+    m_flush = false;
+}
+
+/**
+ * @brief 完了した書き出し回数を取得する。
+ * @return 書き出し回数。
+ */
+uint64_t AsyncFileWriter::WriteCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_writeCount;
+}
+
+/**
+ * @brief 直近の書き出しが成功したか取得する。
+ * @return 成功した場合は true。
+ */
+bool AsyncFileWriter::LastWriteSucceeded() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastOk;
+}
+
+/**
+ * @brief 要求を待ち、デバウンス後に最新の内容を書き出すループ。停止時は保留分を書き切ってから抜ける。
+ */
+void AsyncFileWriter::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_stop || m_hasPending; });
+        if (!m_hasPending)
+            break;
+
+        // 要求が途切れるか最大遅延に達するまで待つ (待機中の Submit は m_lastSubmit を延ばす)
+        while (!m_stop && !m_flush)
+        {
+            const auto deadline = (std::min)(m_lastSubmit + m_debounce, m_firstSubmit + m_maxLatency);
+            if (Clock::now() >= deadline)
+                break;
+            m_wake.wait_until(lock, deadline);
+        }
+
+        m_writing.swap(m_pending);
+        std::swap(m_writingPatch, m_pendingPatch);
+        const bool patchable = m_patchable;
+        const std::filesystem::path path = m_pendingPath;
+        m_hasPending = false;
+        m_patchable = false;
+        m_busy = true;
+
+        lock.unlock();
+        // 差分が使えない (ファイルが外部で変わった等) 場合や途中で失敗した場合は全体を書き直す
+        bool ok = patchable && WritePatch(path, m_writingPatch, m_writing);
+        if (!ok)
+            ok = WriteAtomically(path, m_writing);
+        lock.lock();
+
+        m_busy = false;
+        m_lastOk = ok;
+        ++m_writeCount;
+        m_done.notify_all();
+    }
+}
+
+/**
+ * @brief ディスク上の内容が、差分を当てる前の内容 (差分の位置は patch.before、それ以外は content) と一致するか判定する。
+ * @param disk ディスクから読んだ内容。
+ * @param patch 差分。
+ * @param content 差分適用後のファイル全体。
+ * @return 一致する場合は true。
+ */
+static bool MatchesBeforePatch(std::string_view disk, const FilePatch& patch, std::string_view content)
+{
+    const size_t begin = static_cast<size_t>(patch.offset);
+    const size_t end = begin + patch.before.size();
+    return disk.size() == content.size() && end <= disk.size() && disk.substr(0, begin) == content.substr(0, begin) &&
+           disk.substr(begin, patch.before.size()) == patch.before && disk.substr(end) == content.substr(end);
+}
+
+/**
+ * @brief 既存ファイルの 1 セクター内の指定位置だけを 1 回の書き込みで書き換えて fsync する。
+ * @details 書き込みが 1 回で済む場合に限るため、途中でクラッシュしても書き換えの前後どちらかの内容が残る。
+ *          外部で編集されていれば (長さが同じでも) 照合で検出し、何も書かずに失敗する。
+ * @param path 対象パス。
+ * @param patch 差分。
+ * @param content 差分適用後のファイル全体。
+ * @return 成功した場合は true。
+ */
+bool AsyncFileWriter::WritePatch(const std::filesystem::path& path, const FilePatch& patch, std::string_view content)
+{
+    if (patch.bytes.size() != patch.before.size() || !FitsInSector(patch.offset, patch.bytes.size()) ||
+        patch.offset + patch.bytes.size() > content.size())
+        return false;
+
+    std::string disk(content.size(), '\0');
+#if defined(_WIN32)
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE | GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size{};
+    bool ok = GetFileSizeEx(h, &size) && static_cast<uint64_t>(size.QuadPart) == content.size();
+    for (size_t off = 0; ok && off < disk.size();)
+    {
+        const DWORD chunk = static_cast<DWORD>((std::min)(disk.size() - off, static_cast<size_t>(1u << 30)));
+        DWORD read = 0;
+        ok = ReadFile(h, disk.data() + off, chunk, &read, nullptr) && read > 0;
+        off += read;
+    }
+    ok = ok && MatchesBeforePatch(disk, patch, content);
+    if (ok)
+    {
+        OVERLAPPED ov{};
+        ov.Offset = static_cast<DWORD>(patch.offset);
+        ov.OffsetHigh = static_cast<DWORD>(patch.offset >> 32);
+        DWORD written = 0;
+        ok = WriteFile(h, patch.bytes.data(), static_cast<DWORD>(patch.bytes.size()), &written, &ov) &&
+             written == patch.bytes.size();
+    }
+    ok = ok && FlushFileBuffers(h);
+    CloseHandle(h);
+    return ok;
+#else
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st{};
+    bool ok = fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) == content.size();
+    for (size_t off = 0; ok && off < disk.size();)
+    {
+        const ssize_t n = pread(fd, disk.data() + off, disk.size() - off, static_cast<off_t>(off));
+        ok = n > 0;
+        if (ok)
+            off += static_cast<size_t>(n);
+    }
+    ok = ok && MatchesBeforePatch(disk, patch, content);
+    ok = ok && pwrite(fd, patch.bytes.data(), patch.bytes.size(), static_cast<off_t>(patch.offset)) ==
+                   static_cast<ssize_t>(patch.bytes.size());
+    ok = ok && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    return ok;
+#endif
+}
+
+/**
+ * @brief 一時ファイルへ書き込み、fsync してから rename で置き換える。
+ * @param path 書き出し先パス。
+ * @param data 書き出す内容。
+ * @return 成功した場合は true。
+ */
+bool AsyncFileWriter::WriteAtomically(const std::filesystem::path& path, std::string_view data)
+{
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+
+#if defined(_WIN32)
+    HANDLE h = CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = true;
+    for (size_t off = 0; ok && off < data.size();)
+    {
+        const DWORD chunk = static_cast<DWORD>((std::min)(data.size() - off, static_cast<size_t>(1u << 30)));
+        DWORD written = 0;
+        ok = WriteFile(h, data.data() + off, chunk, &written, nullptr) && written > 0;
+        off += written;
+    }
+    ok = ok && FlushFileBuffers(h);
+    CloseHandle(h);
+    if (ok)
+        ok = MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    if (!ok)
+        DeleteFileW(tmp.c_str());
+    return ok;
+#else
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = true;
+    for (size_t off = 0; ok && off < data.size();)
+    {
+        const ssize_t n = write(fd, data.data() + off, data.size() - off);
+        ok = n > 0;
+        if (ok)
+            off += static_cast<size_t>(n);
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (ok)
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    // rename 自体を永続化するためディレクトリも同期する
+    const std::filesystem::path dir = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+    int dfd = open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dfd >= 0)
+    {
+        fsync(dfd);
+        close(dfd);
+    }
+    return true;
+#endif
+}
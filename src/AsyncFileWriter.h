@@ -0,0 +1,148 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * @file AsyncFileWriter.h
+ * @brief ファイル書き込みをワーカースレッドへ逃がし、連続した保存要求をまとめるライターの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief ファイル内の固定位置を同じ長さのバイト列で上書きする差分。
+ */
+struct FilePatch
+{
+    uint64_t offset = 0; // 書き換え位置
+    std::string bytes;   // 書き込む内容
+    std::string before;  // 差分を作った時点でその位置にあった内容 (ディスク上の内容の照合に使う)
+};
+
+/**
+ * @brief 保存要求をデバウンスしてワーカースレッドで原子的に書き出すクラス。
+ * @details Submit は内容を受け取るバッファを交換するだけで、ディスクには触れない。ワーカーは要求が
+ *          デバウンス時間だけ途切れるか、最初の要求から最大遅延を過ぎた時点で最新の内容を一時ファイルへ書き、
+ *          fsync 後に本来のパスへ rename する。途中でクラッシュしても書きかけのファイルは残らない。
+ */
+class AsyncFileWriter
+{
+public:
+    /**
+     * @brief デバウンス時間と最大遅延を指定して構築する。
+     * @param debounce 要求が途切れてから書き出すまでの待ち時間。
+     * @param maxLatency 要求が続いていても書き出すまでの最大待ち時間。
+     */
+    explicit AsyncFileWriter(std::chrono::milliseconds debounce = std::chrono::milliseconds(250),
+                             std::chrono::milliseconds maxLatency = std::chrono::milliseconds(1000));
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    /**
+     * @brief 保留中の内容を書き出してからワーカーを停止する。
+     */
+    ~AsyncFileWriter();
+
+    /**
+     * @brief 書き出し要求を登録する。未処理の要求があれば新しい内容で置き換える。
+     * @param path 書き出し先パス。
+     * @param content 書き出す内容。呼び出し後は以前の保留バッファ (中身は不定) と交換され、容量を再利用できる。
+     */
+    void Submit(const std::filesystem::path& path, std::string& content);
+
+    /**
+     * @brief 差分書き込みを優先した書き出し要求を登録する。
+     * @details 差分は同じ長さの置き換え 1 つで、1 セクター (kSectorSize) 内に収まっていること。1 回の書き込みで
+     *          済むため、途中でクラッシュしても書きかけの状態は残らない。ディスク上の内容が差分の位置では
+     *          patch.before と、それ以外では content と一致する場合だけその位置を書き換えて fsync し、そうでなければ
+     *          content 全体を原子的に書き出す。未処理の差分要求と同じ位置の差分なら後勝ちで合成し、別の位置なら
+     *          全体の書き出しに切り替える。
+     * @param path 書き出し先パス。
+     * @param content 差分適用後のファイル全体 (差分が使えない場合の書き出し内容)。Submit と同様に交換される。
+     * @param patch 差分 (呼び出し後の中身は不定)。
+     */
+    void SubmitPatch(const std::filesystem::path& path, std::string& content, FilePatch& patch);
+
+    /**
+     * @brief 差分がセクター内に収まっているか判定する。
+     * @param offset 書き換え位置。
+     * @param length 書き換え長。
+     * @return 1 セクター内に収まる場合は true。
+     */
+    static bool FitsInSector(uint64_t offset, size_t length)
+    {
+        return length > 0 && offset / kSectorSize == (offset + length - 1) / kSectorSize;
+    }
+
+    static constexpr uint64_t kSectorSize = 512; // 1 回の書き込みが分断されない単位とみなすサイズ
+
+    /**
+     * @brief デバウンスを待たずに保留中の内容を書き出し、完了まで待つ。
+     */
+    void Flush();
+
+    /**
+     * @brief 完了した書き出し回数を取得する。
+     * @return 書き出し回数。
+     */
+    uint64_t WriteCount() const;
+
+    /**
+     * @brief 直近の書き出しが成功したか取得する。
+     * @return 成功した場合は true。
+     */
+    bool LastWriteSucceeded() const;
+
+    /**
+     * @brief 一時ファイルへ書き込み、fsync してから rename で置き換える。
+     * @param path 書き出し先パス。
+     * @param data 書き出す内容。
+     * @return 成功した場合は true。
+     */
+    static bool WriteAtomically(const std::filesystem::path& path, std::string_view data);
+
+    /**
+     * @brief 既存ファイルの 1 セクター内の指定位置だけを 1 回の書き込みで書き換えて fsync する。
+     * @details 書き換える前にファイル全体を読み、差分の位置が patch.before、それ以外が content と一致することを
+     *          確かめる。外部で編集されていれば (長さが同じでも) 何も書かずに失敗する。
+     * @param path 対象パス。
+     * @param patch 差分。
+     * @param content 差分適用後のファイル全体。
+     * @return 成功した場合は true。
+     */
+    static bool WritePatch(const std::filesystem::path& path, const FilePatch& patch, std::string_view content);
+
+private:
+    /**
+     * @brief ワーカースレッドの本体。
+     */
+    void Run();
+
+    using Clock = std::chrono::steady_clock;
+
+    const std::chrono::milliseconds m_debounce;   // デバウンス時間
+    const std::chrono::milliseconds m_maxLatency; // 最大遅延
+    std::thread m_thread;                         // ワーカースレッド
+    mutable std::mutex m_mutex;                   // 以下の状態を保護する
+    std::condition_variable m_wake;               // 要求・停止・フラッシュでワーカーを起こす
+    std::condition_variable m_done;               // 書き出し完了の通知
+    std::filesystem::path m_pendingPath;          // 保留中の書き出し先
+    std::string m_pending;                        // 保留中の内容
+    std::string m_writing;                        // ワーカーが書き出し中の内容
+    FilePatch m_pendingPatch;                     // 保留中の差分
+    FilePatch m_writingPatch;                     // ワーカーが書き出し中の差分
+    bool m_patchable = false;                     // 保留中の要求を差分で書ける
+    bool m_hasPending = false;                    // 保留中の要求がある
+    bool m_busy = false;                          // ワーカーが書き出し中
+    bool m_flush = false;                         // デバウンスを打ち切る要求
+    bool m_stop = false;                          // 停止要求
+    bool m_lastOk = true;                         // 直近の書き出し結果
+    uint64_t m_writeCount = 0;                    // 完了した書き出し回数
+    Clock::time_point m_firstSubmit{};            // 保留中の最初の要求時刻
+    Clock::time_point m_lastSubmit{};             // 保留中の最後の要求時刻
+};
@@ -0,0 +1,113 @@
+/**
+ * @file ConfigService.cpp
+ * @brief 複数設定ファイルのホットリロードサービスの実装。
+ * @author 山内陽
+ */
+
+#include "ConfigService.h"
+
+#include <chrono>
+#include <memory>
+
+/**
+ * @brief 設定ファイルを読み込み、サービスが所有する Settings として監視を始める。
+ * @param path 設定ファイルパス。
+ * @param policy 再読み込みの方針。
+ * @return ファイル番号。
+ */
+ConfigService::FileId ConfigService::Open(const std::wstring& path, const ReloadPolicy& policy)
+{
+    File file;
+    file.owned = std::make_unique<Settings>();
+    file.owned->Load(path);
+    file.settings = file.owned.get();
+    file.layer = 0;
+    file.path = path;
+    file.policy = policy;
+    return Register(std::move(file));
+}
+
+/**
+ * @brief 外部で所有している Settings のレイヤーを監視対象に加える。
+ * @param settings 取り込み先。
+ * @param layer 対象レイヤー。
+ * @param policy 再読み込みの方針。
+ * @return ファイル番号。
+ */
+ConfigService::FileId ConfigService::Watch(Settings& settings, uint32_t layer, const ReloadPolicy& policy)
+{
+    if (layer >= settings.LayerCount())
+        return kNoFile;
+    File file;
+    file.settings = &settings;
+    file.layer = layer;
+    file.path = layer == 0 ? settings.Path() : settings.LayerPath(layer);
+    file.policy = policy;
+    if (file.path.empty())
+        return kNoFile;
+    return Register(std::move(file));
+}
+
+/**
+ * @brief 監視スレッドへファイルを登録する。最初の登録で監視スレッドを起動する。
+ * @details 差分の基準は監視スレッドだけが触れるため、ファイルごとに作って処理に持たせる。
+ * @param file 登録情報。
+ * @return ファイル番号。
+ */
+ConfigService::FileId ConfigService::Register(File file)
+{
+    Settings* settings = file.settings;
+    auto base = std::make_shared<Settings::DiffBase>();
+    const FileId id = m_watcher.Add(file.path, settings->ContentHash(file.layer), settings->Dependencies(file.layer),
+                                    settings->DependencyHash(file.layer),
+                                    [settings, base](IniDocument& doc) { settings->Diff(doc, *base); });
+    m_files.push_back(std::move(file));
+    SetPolicy(id, m_files[id].policy);
+    if (m_files.size() == 1)
+        m_watcher.Start();
+    return id;
+}
+
+/**
+ * @brief 再読み込みの方針を変更する。
+ * @details 基本レイヤーの場合は Settings::ReloadIfChanged の待ち時間にも同じデバウンス時間を使う。
+ * @param id ファイル番号。
+ * @param policy 新しい方針。
+ */
+void ConfigService::SetPolicy(FileId id, const ReloadPolicy& policy)
+{
+    File& file = m_files[id];
+    file.policy = policy;
+    m_watcher.SetPollInterval(id, policy.pollIntervalMs);
+    m_watcher.SetDebounce(id, policy.debounceMs);
+    m_watcher.SetEnabled(id, policy.enabled);
+    if (file.layer == 0)
+        file.settings->SetReloadDebounce(std::chrono::milliseconds(policy.debounceMs));
+}
+
+/**
+ * @brief 監視スレッドが用意した内容を取り込み、変化があったファイルのコールバックを呼ぶ。
+ * @details 用意された番号だけを処理するため、変化の無いファイルには触れない。取り込み中にコールバックから
+ *          SetPolicy や RequestReload を呼んでもよい。
+ * @return 取り込んだファイル数。
+ */
+size_t ConfigService::Poll()
+{
+    if (!m_watcher.TakeReady(m_ready))
+        return 0;
+
+    size_t applied = 0;
+    for (FileId id : m_ready)
+    {
+        auto doc = m_watcher.TakeSnapshot(id);
+        if (!doc)
+            continue;
+        File& file = m_files[id];
+        if (!file.settings->Apply(*doc, file.layer))
+            continue;
+        ++applied;
+        if (file.onReload)
+            file.onReload(id);
+    }
+    return applied;
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include "FileWatcher.h"
+#include "Settings.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @file ConfigService.h
+ * @brief 複数の設定ファイルを 1 本の監視スレッドでホットリロードするサービスの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 設定ファイルごとの再読み込みの方針。
+ */
+struct ReloadPolicy
+{
+    int pollIntervalMs = 500; // ポーリング方式で監視する場合の確認間隔 (ミリ秒)
+    int debounceMs = 50;      // 連続した変更をまとめる待ち時間 (ミリ秒)
+    bool enabled = true;      // 変更を検知して再読み込みする
+};
+
+/**
+ * @brief 描画・入力・UI レイアウト・シーンごとの調整値など、複数の設定ファイルをまとめて監視・再読み込みするクラス。
+ * @details 監視対象は Open で作ったサービス所有の Settings か、Watch で登録した外部の Settings のレイヤー。
+ *          変更の検知・読み込み・解析はすべてのファイルで共有する 1 本の FileWatcher スレッドが行い、
+ *          所有スレッドは Poll で解析済みの内容を取り込むだけ。内容が用意されたファイルの番号は監視スレッドが
+ *          一覧に積むため、Poll のコストは監視ファイル数によらず、変化が無ければアトミック変数 1 回の読み取りで終わる。
+ *          監視スレッドは直前に受け渡した内容との差分 (Settings::Diff) も作るため、取り込みで統合し直すのは
+ *          値が変わったキーだけになり、所有スレッドの費用はファイルの大きさではなく変更の大きさに比例する。
+ *          キー単位の購読コールバック (Settings::Subscribe) とファイル単位の再読み込みコールバックは、
+ *          どちらも Poll を呼んだスレッドで呼ばれる。Poll 以外のメンバーも所有スレッド専用。
+ */
+class ConfigService
+{
+public:
+    using FileId = uint32_t;
+
+    static constexpr FileId kNoFile = FileWatcher::kNoFile; // 無効なファイル番号
+
+    /**
+     * @brief ファイルの内容を取り込んだ後に呼ばれるコールバック型。
+     */
+    using ReloadCallback = std::function<void(FileId)>;
+
+    ConfigService() = default;
+    ConfigService(const ConfigService&) = delete;
+    ConfigService& operator=(const ConfigService&) = delete;
+
+    /**
+     * @brief 設定ファイルを読み込み、サービスが所有する Settings として監視を始める。
+     * @param path 設定ファイルパス。まだ存在しなくてもよい (作成された時点で取り込む)。
+     * @param policy 再読み込みの方針。
+     * @return ファイル番号。
+     */
+    FileId Open(const std::wstring& path, const ReloadPolicy& policy = {});
+
+    /**
+     * @brief 外部で所有している Settings のレイヤーを監視対象に加える。
+     * @details 取り込み済みの内容のハッシュを監視スレッドへ渡すため、登録直後に同じ内容を解析し直すことはない。
+     * @param settings 取り込み先 (サービスより長く生存すること)。
+     * @param layer 対象レイヤー (ファイルパスを持つもの)。
+     * @param policy 再読み込みの方針。
+     * @return ファイル番号。レイヤーにファイルパスが無ければ kNoFile。
+     */
+    FileId Watch(Settings& settings, uint32_t layer = 0, const ReloadPolicy& policy = {});
+
+    /**
+     * @brief 監視しているファイル数を取得する。
+     * @return ファイル数。
+     */
+    uint32_t FileCount() const
+    {
+        return static_cast<uint32_t>(m_files.size());
+    }
+
+    /**
+     * @brief ファイルの取り込み先を取得する。
+     * @param id ファイル番号。
+     * @return 取り込み先の Settings。
+     */
+    Settings& Get(FileId id)
+    {
+        return *m_files[id].settings;
+    }
+
+    /**
+     * @brief ファイルの取り込み先レイヤーを取得する。
+     * @param id ファイル番号。
+     * @return レイヤー番号。
+     */
+    uint32_t Layer(FileId id) const
+    {
+        return m_files[id].layer;
+    }
+
+    /**
+     * @brief ファイルパスを取得する。
+     * @param id ファイル番号。
+     * @return ファイルパス。
+     */
+    const std::wstring& Path(FileId id) const
+    {
+        return m_files[id].path;
+    }
+
+    /**
+     * @brief 再読み込みの方針を変更する。次の変更検知から反映される。
+     * @param id ファイル番号。
+     * @param policy 新しい方針。
+     */
+    void SetPolicy(FileId id, const ReloadPolicy& policy);
+
+    /**
+     * @brief 再読み込みの方針を取得する。
+     * @param id ファイル番号。
+     * @return 方針。
+     */
+    const ReloadPolicy& Policy(FileId id) const
+    {
+        return m_files[id].policy;
+    }
+
+    /**
+     * @brief ファイルの内容を取り込んだ後に呼ぶコールバックを設定する。
+     * @details キー単位の購読コールバックがすべて呼ばれた後に、Poll を呼んだスレッドで呼ばれる。
+     *          Settings::ChangedKeys() でそのファイルの取り込みで変化したキーを参照できる。
+     * @param id ファイル番号。
+     * @param callback コールバック (空なら解除)。
+     */
+    void SetReloadCallback(FileId id, ReloadCallback callback)
+    {
+        m_files[id].onReload = std::move(callback);
+    }
+
+    /**
+     * @brief 変更の有無にかかわらず読み込み直すよう要求する。内容が同じなら取り込みは行わない。
+     * @param id ファイル番号。
+     */
+    void RequestReload(FileId id)
+    {
+        m_watcher.RequestReload(id);
+    }
+
+    /**
+     * @brief 監視スレッドでの読み込みの統計を取得する。
+     * @param id ファイル番号。
+     * @return 統計。取り込み側の統計は Get(id).Stats() で得られる。
+     */
+    FileWatchStats WatchStats(FileId id) const
+    {
+        return m_watcher.Stats(id);
+    }
+
+    /**
+     * @brief 使用中の検知方式名を取得する。
+     * @return 検知方式名。
+     */
+    const char* Backend() const
+    {
+        return m_watcher.Backend();
+    }
+
+    /**
+     * @brief 監視スレッドが用意した内容を取り込み、変化があったファイルのコールバックを呼ぶ。毎フレーム呼ぶ。
+     * @return 取り込んだファイル数。
+     */
+    size_t Poll();
+
+private:
+    /**
+     * @brief 監視対象 1 ファイル分の登録情報。
+     */
+    struct File
+    {
+        std::unique_ptr<Settings> owned; // Open で作った Settings (Watch で登録したものは nullptr)
+        Settings* settings = nullptr;    // 取り込み先
+        uint32_t layer = 0;              // 取り込み先レイヤー
+        std::wstring path;               // ファイルパス
+        ReloadPolicy policy;             // 再読み込みの方針
+        ReloadCallback onReload;         // 取り込み後のコールバック
+    };
+
+    /**
+     * @brief 監視スレッドへファイルを登録する。
+     * @param file 登録情報。
+     * @return ファイル番号。
+     */
+    FileId Register(File file);
+
+    std::vector<File> m_files;     // 監視対象 (ファイル番号順。m_watcher の番号と一致する)
+    std::vector<uint32_t> m_ready; // Poll で取り出した番号 (容量を再利用する)
+    FileWatcher m_watcher;         // 全ファイル共有の監視スレッド (先に停止させるため最後に宣言する)
+};
@@ -0,0 +1,512 @@
+/**
+ * @file D3D11RenderDevice.cpp
+ * @brief Direct3D 11 によるレンダーデバイスの実装。
+ * @author 山内陽
+ */
+
+#include "D3D11RenderDevice.h"
+
+#include <d3dcompiler.h>
+
+using Microsoft::WRL::ComPtr;
+
+/**
+ * @brief 頂点属性をシェーダーのセマンティクス名へ変換する。
+ * @param semantic 頂点属性の意味。
+ * @return セマンティクス名。
+ */
+static const char* SemanticName(VertexSemantic semantic)
+{
+    switch (semantic)
+    {
+    case VertexSemantic::Color:
+        return "COLOR";
+    case VertexSemantic::TexCoord:
+        return "TEXCOORD";
+    default:
+        return "POSITION";
+    }
+}
+
+/**
+ * @brief 頂点属性の型を DXGI のフォーマットへ変換する。
+ * @param format 頂点属性の型。
+ * @return DXGI のフォーマット。
+ */
+static DXGI_FORMAT VertexDxgiFormat(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Float2:
+        return DXGI_FORMAT_R32G32_FLOAT;
+    case VertexFormat::Unorm8x4:
+        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    default:
+        return DXGI_FORMAT_R32G32B32_FLOAT;
+    }
+}
+
+/**
+ * @brief HLSL をファイルまたはソースからコンパイルする。失敗した場合はエラーをデバッグ出力へ書き出す。
+ * @param desc パイプラインの記述。
+ * @param entry 関数名。
+ * @param target シェーダーモデル。
+ * @param blob コンパイル結果の格納先。
+ * @return 成功した場合は true。
+ */
+static bool CompileShader(const PipelineDesc& desc, const std::string& entry, const char* target,
+                          ComPtr<ID3DBlob>& blob)
+{
+    UINT compileFlags = 0;
+#if defined(_DEBUG)
+    compileFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+    ComPtr<ID3DBlob> err;
+    HRESULT hr;
+    if (!desc.shaderFile.empty())
+        hr = D3DCompileFromFile(desc.shaderFile.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, entry.c_str(),
+                                target, compileFlags, 0, blob.GetAddressOf(), err.GetAddressOf());
+    else
+        hr = D3DCompile(desc.shaderSource.data(), desc.shaderSource.size(), desc.name.c_str(), nullptr, nullptr,
+                        entry.c_str(), target, compileFlags, 0, blob.GetAddressOf(), err.GetAddressOf());
+    if (FAILED(hr))
+    {
+        if (err)
+            OutputDebugStringA((char*)err->GetBufferPointer());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Direct3D デバイス・コンテキスト・スワップチェーンと、共有のサンプラー・深度ステンシルを生成する。
+ * @param hWnd プレゼンテーションに使用するウィンドウハンドル。
+ * @param width 希望するバックバッファ幅。
+ * @param height 希望するバックバッファ高さ。
+ * @return 生成に成功した場合は true。
+ */
+bool D3D11RenderDevice::Init(HWND hWnd, uint32_t width, uint32_t height)
+{
+    DXGI_SWAP_CHAIN_DESC sd{};
+    sd.BufferCount = 2;
+    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    sd.OutputWindow = hWnd;
+    sd.SampleDesc.Count = 1;
+    sd.Windowed = TRUE;
+    sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+    sd.BufferDesc.Width = width;
+    sd.BufferDesc.Height = height;
+
+    UINT deviceFlags = 0;
+#if defined(_DEBUG)
+    deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+    D3D_FEATURE_LEVEL req[] = {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0,
+        D3D_FEATURE_LEVEL_10_1,
+        D3D_FEATURE_LEVEL_10_0,
+    };
+    D3D_FEATURE_LEVEL got{};
+
+    HRESULT hr = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, deviceFlags, req,
+                                               _countof(req), D3D11_SDK_VERSION, &sd, m_swapChain.GetAddressOf(),
+                                               m_device.GetAddressOf(), &got, m_context.GetAddressOf());
+
+    if (FAILED(hr))
+    {
+        hr = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, deviceFlags, req, _countof(req),
+                                           D3D11_SDK_VERSION, &sd, m_swapChain.GetAddressOf(), m_device.GetAddressOf(),
+                                           &got, m_context.GetAddressOf());
+    }
+    if (FAILED(hr))
+        return false;
+    m_width = width;
+    m_height = height;
+
+    // Alt+Enter による全画面切り替えは DXGI がメッセージループのスレッドでスワップチェーンを操作するため止める
+    // (スワップチェーンは描画スレッドだけが使う)
+    ComPtr<IDXGIFactory> factory;
+    if (SUCCEEDED(m_swapChain->GetParent(__uuidof(IDXGIFactory), reinterpret_cast<void**>(factory.GetAddressOf()))))
+        factory->MakeWindowAssociation(hWnd, DXGI_MWA_NO_ALT_ENTER);
+
+    D3D11_SAMPLER_DESC samp{};
+    samp.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    samp.AddressU = samp.AddressV = samp.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samp.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+    if (FAILED(m_device->CreateSamplerState(&samp, m_sampler.GetAddressOf())))
+        return false;
+
+    D3D11_DEPTH_STENCIL_DESC ds{};
+    ds.DepthEnable = FALSE;
+    ds.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    ds.DepthFunc = D3D11_COMPARISON_ALWAYS;
+    ds.FrontFace.StencilFailOp = ds.FrontFace.StencilDepthFailOp = ds.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+    ds.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
+    ds.BackFace = ds.FrontFace;
+    if (FAILED(m_device->CreateDepthStencilState(&ds, m_depthStencil.GetAddressOf())))
+        return false;
+
+    return CreateRenderTarget();
+}
+
+/**
+ * @brief バックバッファを取得しレンダーターゲットビューを作成する。
+ * @return ビューの用意に成功した場合は true。
+ */
+bool D3D11RenderDevice::CreateRenderTarget()
+{
+    ComPtr<ID3D11Texture2D> backBuf;
+    HRESULT hr = m_swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(backBuf.GetAddressOf()));
+    if (FAILED(hr))
+        return false;
+    hr = m_device->CreateRenderTargetView(backBuf.Get(), nullptr, m_rtv.GetAddressOf());
+    return SUCCEEDED(hr);
+}
+
+/**
+ * @brief リソースの枠を確保する。空きがあれば使い回す。
+ * @return ハンドル。
+ */
+RenderDevice::Handle D3D11RenderDevice::Allocate()
+{
+    Handle handle;
+    if (!m_freeList.empty())
+    {
+        handle = m_freeList.back();
+        m_freeList.pop_back();
+    }
+    else
+    {
+        m_resources.emplace_back();
+        handle = static_cast<Handle>(m_resources.size());
+    }
+    m_resources[handle - 1].used = true;
+    return handle;
+}
+
+/**
+ * @brief ハンドルからリソースを引く。
+ * @param handle ハンドル。
+ * @return リソース。無効なら nullptr。
+ */
+D3D11RenderDevice::Resource* D3D11RenderDevice::Find(Handle handle)
+{
+    if (handle == kNoHandle || handle > m_resources.size() || !m_resources[handle - 1].used)
+        return nullptr;
+    return &m_resources[handle - 1];
+}
+
+/**
+ * @brief バッファを作成する。初期内容が無ければ CPU から書き込める動的バッファにする。
+ * @param kind 用途。
+ * @param bytes 大きさ (バイト)。
+ * @param initial 初期内容 (nullptr なら動的バッファ)。
+ * @return ハンドル。失敗した場合は kNoHandle。
+ */
+RenderDevice::Handle D3D11RenderDevice::CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial)
+{
+    D3D11_BUFFER_DESC bd{};
+    bd.ByteWidth = bytes;
+    bd.BindFlags = kind == BufferKind::Vertex  ? D3D11_BIND_VERTEX_BUFFER
+                   : kind == BufferKind::Index ? D3D11_BIND_INDEX_BUFFER
+                                               : D3D11_BIND_CONSTANT_BUFFER;
+    if (initial)
+    {
+        bd.Usage = D3D11_USAGE_DEFAULT;
+    }
+    else
+    {
+        bd.Usage = D3D11_USAGE_DYNAMIC;
+        bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    }
+    D3D11_SUBRESOURCE_DATA init{initial};
+    ComPtr<ID3D11Buffer> buffer;
+    if (FAILED(m_device->CreateBuffer(&bd, initial ? &init : nullptr, buffer.GetAddressOf())))
+        return kNoHandle;
+    const Handle handle = Allocate();
+    m_resources[handle - 1].buffer = buffer;
+    return handle;
+}
+
+/**
+ * @brief RGBA8 のテクスチャとシェーダーリソースビューを作成する。
+ * @param width 幅 (ピクセル)。
+ * @param height 高さ (ピクセル)。
+ * @param rgba 画素。
+ * @return ハンドル。失敗した場合は kNoHandle。
+ */
+RenderDevice::Handle D3D11RenderDevice::CreateTexture(uint32_t width, uint32_t height, const void* rgba)
+{
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = width;
+    td.Height = height;
+    td.MipLevels = 1;
+    td.ArraySize = 1;
+    td.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    td.SampleDesc.Count = 1;
+    td.Usage = D3D11_USAGE_DEFAULT;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    D3D11_SUBRESOURCE_DATA init{};
+    init.pSysMem = rgba;
+    init.SysMemPitch = width * 4;
+    ComPtr<ID3D11Texture2D> texture;
+    if (FAILED(m_device->CreateTexture2D(&td, &init, texture.GetAddressOf())))
+        return kNoHandle;
+
+    ComPtr<ID3D11ShaderResourceView> srv;
+    if (FAILED(m_device->CreateShaderResourceView(texture.Get(), nullptr, srv.GetAddressOf())))
+        return kNoHandle;
+    const Handle handle = Allocate();
+    m_resources[handle - 1].srv = srv;
+    return handle;
+}
+
+/**
+ * @brief シェーダーをコンパイルし、入力レイアウト・ブレンド・ラスタライザーの各ステートと合わせてパイプラインにする。
+ * @param desc 記述。
+ * @return ハンドル。失敗した場合は kNoHandle。
+ */
+RenderDevice::Handle D3D11RenderDevice::CreatePipeline(const PipelineDesc& desc)
+{
+    ComPtr<ID3DBlob> vsBlob, psBlob;
+    if (!CompileShader(desc, desc.vsEntry, "vs_5_0", vsBlob) || !CompileShader(desc, desc.psEntry, "ps_5_0", psBlob))
+        return kNoHandle;
+
+    Resource r;
+    if (FAILED(m_device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr,
+                                            r.vs.GetAddressOf())))
+        return kNoHandle;
+    if (FAILED(m_device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr,
+                                           r.ps.GetAddressOf())))
+        return kNoHandle;
+
+    std::vector<D3D11_INPUT_ELEMENT_DESC> layout;
+    for (const VertexAttribute& a : desc.layout)
+        layout.push_back({SemanticName(a.semantic), 0, VertexDxgiFormat(a.format), 0, a.offset,
+                          D3D11_INPUT_PER_VERTEX_DATA, 0});
+    if (FAILED(m_device->CreateInputLayout(layout.data(), static_cast<UINT>(layout.size()), vsBlob->GetBufferPointer(),
+                                           vsBlob->GetBufferSize(), r.inputLayout.GetAddressOf())))
+        return kNoHandle;
+
+    D3D11_BLEND_DESC bd{};
+    D3D11_RENDER_TARGET_BLEND_DESC& rt = bd.RenderTarget[0];
+    rt.BlendEnable = desc.alphaBlend ? TRUE : FALSE;
+    rt.SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    rt.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    rt.BlendOp = D3D11_BLEND_OP_ADD;
+    rt.SrcBlendAlpha = D3D11_BLEND_ONE;
+    rt.DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    rt.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    rt.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    if (FAILED(m_device->CreateBlendState(&bd, r.blend.GetAddressOf())))
+        return kNoHandle;
+
+    D3D11_RASTERIZER_DESC rd{};
+    rd.FillMode = D3D11_FILL_SOLID;
+    rd.CullMode = D3D11_CULL_NONE;
+    rd.DepthClipEnable = TRUE;
+    rd.ScissorEnable = desc.scissor ? TRUE : FALSE;
+    if (FAILED(m_device->CreateRasterizerState(&rd, r.rasterizer.GetAddressOf())))
+        return kNoHandle;
+
+    const Handle handle = Allocate();
+    r.used = true;
+    m_resources[handle - 1] = std::move(r);
+    return handle;
+}
+
+/**
+ * @brief リソースを解放し、ハンドルを再利用できるようにする。
+ * @param handle 破棄するリソース。
+ */
+void D3D11RenderDevice::Destroy(Handle handle)
+{
+    if (!Find(handle))
+        return;
+    m_resources[handle - 1] = Resource{};
+    m_freeList.push_back(handle);
+}
+
+/**
+ * @brief 動的バッファを WRITE_DISCARD でマップする。
+ * @param buffer 動的バッファ。
+ * @return 書き込み先。失敗した場合は nullptr。
+ */
+void* D3D11RenderDevice::MapBuffer(Handle buffer)
+{
+    Resource* r = Find(buffer);
+    if (!r || !r->buffer)
+        return nullptr;
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(m_context->Map(r->buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+        return nullptr;
+    return mapped.pData;
+}
+
+/**
+ * @brief 動的バッファのマップを解除する。
+ * @param buffer 動的バッファ。
+ */
+void D3D11RenderDevice::UnmapBuffer(Handle buffer)
+{
+    if (Resource* r = Find(buffer))
+        m_context->Unmap(r->buffer.Get(), 0);
+}
+
+/**
+ * @brief 大きさが変わっていればスワップチェーンのバッファを作り直す。
+ * @param width 幅 (ピクセル)。
+ * @param height 高さ (ピクセル)。
+ * @return レンダーターゲットを用意できた場合は true。
+ */
+bool D3D11RenderDevice::Resize(uint32_t width, uint32_t height)
+{
+    if (!m_swapChain || width == 0 || height == 0)
+        return false;
+    if (width == m_width && height == m_height && m_rtv)
+        return true;
+    m_width = width;
+    m_height = height;
+
+    m_context->OMSetRenderTargets(0, nullptr, nullptr);
+    m_rtv.Reset();
+    if (FAILED(m_swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0)))
+        return false;
+    return CreateRenderTarget();
+}
+
+/**
+ * @brief レンダーターゲット・ビューポート・共有ステートを設定し、バックバッファをクリアする。
+ * @param clear クリアカラー。
+ */
+void D3D11RenderDevice::BeginPass(const float clear[4])
+{
+    if (!m_rtv)
+        return;
+    m_context->OMSetRenderTargets(1, m_rtv.GetAddressOf(), nullptr);
+    m_context->ClearRenderTargetView(m_rtv.Get(), clear);
+
+    D3D11_VIEWPORT vp{};
+    vp.Width = (float)m_width;
+    vp.Height = (float)m_height;
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    m_context->RSSetViewports(1, &vp);
+    m_context->OMSetDepthStencilState(m_depthStencil.Get(), 0);
+    m_context->PSSetSamplers(0, 1, m_sampler.GetAddressOf());
+    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+/**
+ * @brief シェーダー・入力レイアウト・ブレンド・ラスタライザーを設定する。
+ * @param pipeline パイプライン。
+ */
+void D3D11RenderDevice::SetPipeline(Handle pipeline)
+{
+    Resource* r = Find(pipeline);
+    if (!r || !r->vs)
+        return;
+    const float blendFactor[4] = {0.f, 0.f, 0.f, 0.f};
+    m_context->IASetInputLayout(r->inputLayout.Get());
+    m_context->VSSetShader(r->vs.Get(), nullptr, 0);
+    m_context->PSSetShader(r->ps.Get(), nullptr, 0);
+    m_context->OMSetBlendState(r->blend.Get(), blendFactor, 0xffffffff);
+    m_context->RSSetState(r->rasterizer.Get());
+}
+
+/**
+ * @brief 頂点バッファを設定する。
+ * @param buffer 頂点バッファ。
+ * @param stride 頂点 1 つのバイト数。
+ */
+void D3D11RenderDevice::SetVertexBuffer(Handle buffer, uint32_t stride)
+{
+    Resource* r = Find(buffer);
+    if (!r)
+        return;
+    const UINT offset = 0;
+    m_context->IASetVertexBuffers(0, 1, r->buffer.GetAddressOf(), &stride, &offset);
+}
+
+/**
+ * @brief インデックスバッファを設定する。
+ * @param buffer インデックスバッファ。
+ * @param format インデックスの型。
+ */
+void D3D11RenderDevice::SetIndexBuffer(Handle buffer, IndexFormat format)
+{
+    if (Resource* r = Find(buffer))
+        m_context->IASetIndexBuffer(r->buffer.Get(),
+                                    format == IndexFormat::U16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
+}
+
+/**
+ * @brief 定数バッファを頂点・ピクセルシェーダーのスロット 0 へ設定する。
+ * @param buffer 定数バッファ。
+ */
+void D3D11RenderDevice::SetConstantBuffer(Handle buffer)
+{
+    Resource* r = Find(buffer);
+    if (!r)
+        return;
+    m_context->VSSetConstantBuffers(0, 1, r->buffer.GetAddressOf());
+    m_context->PSSetConstantBuffers(0, 1, r->buffer.GetAddressOf());
+}
+
+/**
+ * @brief テクスチャをピクセルシェーダーのスロット 0 へ設定する。
+ * @param texture テクスチャ。
+ */
+void D3D11RenderDevice::SetTexture(Handle texture)
+{
+    if (Resource* r = Find(texture))
+        m_context->PSSetShaderResources(0, 1, r->srv.GetAddressOf());
+}
+
+/**
+ * @brief シザー矩形を設定する。
+ * @param rect 矩形。
+ */
+void D3D11RenderDevice::SetScissor(const ScissorRect& rect)
+{
+    const D3D11_RECT r = {static_cast<LONG>(rect.left), static_cast<LONG>(rect.top), static_cast<LONG>(rect.right),
+                          static_cast<LONG>(rect.bottom)};
+    m_context->RSSetScissorRects(1, &r);
+}
+
+/**
+ * @brief 三角形リストを描く。
+ * @param vertexCount 頂点数。
+ * @param firstVertex 最初の頂点。
+ */
+void D3D11RenderDevice::Draw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    m_context->Draw(vertexCount, firstVertex);
+}
+
+/**
+ * @brief インデックス付きの三角形リストを描く。
+ * @param indexCount インデックス数。
+ * @param firstIndex 最初のインデックス。
+ * @param baseVertex 各インデックスへ足す値。
+ */
+void D3D11RenderDevice::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+    m_context->DrawIndexed(indexCount, firstIndex, baseVertex);
+}
+
+/**
+ * @brief バックバッファを表示する。
+ * @param vsync 垂直同期を待つ場合は true。
+ * @return 結果。ウィンドウが完全に隠れていれば PresentResult::Occluded。
+ */
+PresentResult D3D11RenderDevice::Present(bool vsync)
+{
+    const HRESULT hr = m_swapChain->Present(vsync ? 1 : 0, 0);
+    if (hr == DXGI_STATUS_OCCLUDED)
+        return PresentResult::Occluded;
+    return SUCCEEDED(hr) ? PresentResult::Ok : PresentResult::Failed;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "RenderDevice.h"
+
+#include <cstdint>
+#include <d3d11.h>
+#include <dxgi.h>
+#include <vector>
+#include <windows.h>
+#include <wrl.h>
+
+/**
+ * @file D3D11RenderDevice.h
+ * @brief Direct3D 11 によるレンダーデバイスの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief Direct3D 11 の即時コンテキストとスワップチェーンで描くレンダーデバイス。
+ * @details パイプラインは HLSL をその場でコンパイルして作る。サンプラー (線形・クランプ) と
+ *          深度ステンシル (無効) は全パイプラインで共有する。
+ */
+class D3D11RenderDevice : public RenderDevice
+{
+public:
+    /**
+     * @brief デバイスとスワップチェーンを作成する。ハードウェアで作れなければ WARP を使う。
+     * @param hWnd 表示先のウィンドウ。
+     * @param width バックバッファ幅 (ピクセル)。
+     * @param height バックバッファ高さ (ピクセル)。
+     * @return 作成に成功した場合は true。
+     */
+    bool Init(HWND hWnd, uint32_t width, uint32_t height);
+
+    const char* Name() const override
+    {
+        return "Direct3D 11";
+    }
+
+    Handle CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial) override;
+    Handle CreateTexture(uint32_t width, uint32_t height, const void* rgba) override;
+    Handle CreatePipeline(const PipelineDesc& desc) override;
+    void Destroy(Handle handle) override;
+    void* MapBuffer(Handle buffer) override;
+    void UnmapBuffer(Handle buffer) override;
+    bool Resize(uint32_t width, uint32_t height) override;
+    void BeginPass(const float clear[4]) override;
+    void SetPipeline(Handle pipeline) override;
+    void SetVertexBuffer(Handle buffer, uint32_t stride) override;
+    void SetIndexBuffer(Handle buffer, IndexFormat format) override;
+    void SetConstantBuffer(Handle buffer) override;
+    void SetTexture(Handle texture) override;
+    void SetScissor(const ScissorRect& rect) override;
+    void Draw(uint32_t vertexCount, uint32_t firstVertex) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+    PresentResult Present(bool vsync) override;
+
+private:
+    /**
+     * @brief ハンドルが指す Direct3D のオブジェクト。種類に応じて一部のメンバーだけを使う。
+     */
+    struct Resource
+    {
+        bool used = false;                                        // 使用中
+        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;              // バッファ
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;     // テクスチャのビュー
+        Microsoft::WRL::ComPtr<ID3D11VertexShader> vs;            // 頂点シェーダー
+        Microsoft::WRL::ComPtr<ID3D11PixelShader> ps;             // ピクセルシェーダー
+        Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;    // 入力レイアウト
+        Microsoft::WRL::ComPtr<ID3D11BlendState> blend;           // ブレンドステート
+        Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizer; // ラスタライザーステート
+    };
+
+    /**
+     * @brief バックバッファからレンダーターゲットビューを構築する。
+     * @return 作成に成功した場合は true。
+     */
+    bool CreateRenderTarget();
+
+    /**
+     * @brief リソースの枠を確保する。空きがあれば使い回す。
+     * @return ハンドル。
+     */
+    Handle Allocate();
+
+    /**
+     * @brief ハンドルからリソースを引く。
+     * @param handle ハンドル。
+     * @return リソース。無効なら nullptr。
+     */
+    Resource* Find(Handle handle);
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;                  // Direct3D デバイス
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;          // 即時コンテキスト
+    Microsoft::WRL::ComPtr<IDXGISwapChain> m_swapChain;             // スワップチェーン
+    Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_rtv;           // レンダーターゲットビュー
+    Microsoft::WRL::ComPtr<ID3D11SamplerState> m_sampler;           // 共有サンプラー
+    Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_depthStencil; // 深度テストを無効にするステート
+    uint32_t m_width = 0;                                           // バックバッファ幅
+    uint32_t m_height = 0;                                          // バックバッファ高さ
+    std::vector<Resource> m_resources;                              // ハンドル - 1 で引くリソース
+    std::vector<Handle> m_freeList;                                 // 破棄されたハンドル
+};
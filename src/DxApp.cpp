@@ -1,22 +1,25 @@
 /**
  * @file DxApp.cpp
- * @brief Direct3D 11 アプリケーションラッパーの実装。
+ * @brief 設定の同期・UI・描画ループをまとめたアプリケーションクラスの実装。
  * @author 山内陽
  */
 
 #include "DxApp.h"
 
 #include "imgui.h"
-#include "imgui_impl_dx11.h"
-#include "imgui_impl_win32.h"
 
-#include <cassert>
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <string>
 
-using Microsoft::WRL::ComPtr;
+#if defined(_WIN32)
+#include "imgui_impl_win32.h"
 
-extern LRESULT ImGui_ImplWin32_WndProcHandler(HWND, UINT, WPARAM, LPARAM);
+#include <windows.h>
+#endif
 
 /**
  * @brief 位置と色を保持する頂点構造体。
@@ -28,15 +31,24 @@ struct Vertex
 };
 
 /**
- * @brief シェーダーと共有する定数バッファのレイアウト。
+ * @brief 描画段が空きパケットを待つ最大時間。超えたらそのフレームは作らず、メッセージの処理へ戻る。
+ * @details DXGI は Present や ResizeBuffers の中でウィンドウへメッセージを送ることがあるため、
+ *          メッセージループのスレッドが描画スレッドを無期限に待つとデッドロックしうる。
  */
-struct CBData
+static constexpr std::chrono::milliseconds kAcquireTimeout{100};
+
+/**
+ * @brief デバッグ出力へ 1 行書き出す。Windows 以外では標準エラー出力へ書く。
+ * @param line 改行を含む文字列。
+ */
+static void DebugLog(const std::string& line)
 {
-    float Tint[4];   // 色調係数 (w は未使用)
-    float Screen[2]; // 画面サイズ
-    float Pad0[2];   // アライメント調整用パディング
-    float Mvp[16];   // モデルビュー射影行列
-};
+#if defined(_WIN32)
+    OutputDebugStringA(line.c_str());
+#else
+    std::fputs(line.c_str(), stderr);
+#endif
+}
 
 /**
  * @brief Z 軸回転と等方スケールを組み合わせた行列を生成する。
@@ -53,420 +65,458 @@ static void MakeZRotateScale(float* out16, float angle, float scale)
 }
 
 /**
- * @brief デバイス・スワップチェーン・シェーダー・UI を初期化する。
- * @param hWnd レンダラーに関連付けるウィンドウハンドル。
+ * @brief 設定・描画リソース・UI を初期化し、描画スレッドを起動する。
+ * @param window ImGui が入力を受け取るウィンドウ (Windows では HWND)。nullptr ならヘッドレス。
+ * @param device 描画に使うデバイス。
  * @param width バックバッファ幅 (ピクセル)。
  * @param height バックバッファ高さ (ピクセル)。
+ * @param overrides コマンドラインで指定された上書き設定 (INI テキスト)。
  * @return すべての初期化に成功した場合は true。
  */
-bool DxApp::Init(HWND hWnd, UINT width, UINT height)
+bool DxApp::Init(void* window, std::unique_ptr<RenderDevice> device, uint32_t width, uint32_t height,
+                 const std::string& overrides)
 {
+    m_window = window;
+    m_device = std::move(device);
     m_width = width;
     m_height = height;
 
+    m_binding.ApplyDefaults(&m_config);
+    m_binding.Resolve(m_settings);
+    m_binding.Subscribe(m_settings, &m_config);
+    m_settings.SetJournal(&m_journal);
+
+    // 優先度の低い順に 基本 (settings.ini) < ユーザー (settings.user.ini) < コマンドライン。
+    // 既定値はスキーマ表が受け持つ
+    m_userLayer = m_settings.AddLayer("User", L"settings.user.ini");
+    m_commandLineLayer = m_settings.AddLayer("CommandLine");
     m_settings.Load(L"settings.ini");
-    UpdateFromSettings(false);
+    m_settings.LoadLayer(m_userLayer);
+    m_settings.SetLayerText(m_commandLineLayer, overrides);
+    UpdateFromSettings();
+    // 基本ファイルとユーザー上書きファイルは 1 本の監視スレッドを共有する。取り込み済みの内容のハッシュは
+    // ConfigService が渡すため、起動直後の touch などで同じ内容を解析し直すことはない
+    m_baseFile = m_configService.Watch(m_settings, 0);
+    m_userFile = m_configService.Watch(m_settings, m_userLayer);
+    for (ConfigService::FileId id : {m_baseFile, m_userFile})
+    {
+        if (id != ConfigService::kNoFile)
+            m_configService.SetReloadCallback(id, [this](ConfigService::FileId file) { OnSettingsReloaded(file); });
+    }
+    ApplyReloadPolicy();
+    ApplyFramePacing();
     m_start = std::chrono::steady_clock::now();
-    m_lastCheck = m_start;
+    m_lastUiFrame = m_start;
 
-    if (!CreateDeviceAndSwapChain(hWnd, width, height))
-        return false;
-    if (!CreateRenderTarget())
-        return false;
-    if (!LoadShaders())
+    if (!m_device)
         return false;
     if (!CreateTriangleResources())
         return false;
-    if (!CreateConstantBuffer())
+    if (!InitImGui())
         return false;
 
-    InitImGui(hWnd);
-
-    D3D11_VIEWPORT vp{};
-    vp.TopLeftX = 0.0f;
-    vp.TopLeftY = 0.0f;
-    vp.Width = static_cast<float>(m_width);
-    vp.Height = static_cast<float>(m_height);
-    vp.MinDepth = 0.0f;
-    vp.MaxDepth = 1.0f;
-    m_context->RSSetViewports(1, &vp);
-
+    // ここから先、デバイスは描画スレッドだけが使う
+    m_pipeline.Start([this](FramePacket& packet) { Submit(packet); });
     return true;
 }
 
 /**
- * @brief Direct3D コンテキスト上で ImGui を動作させるよう構成する。
- * @param hWnd ホストとなるウィンドウハンドル。
+ * @brief 提出待ちのフレームを描き切ってから描画スレッドを止め、ImGui を破棄する。
  */
-void DxApp::InitImGui(HWND hWnd)
+void DxApp::Shutdown()
+{
+    m_pipeline.Stop();
+    ShutdownImGui();
+}
+
+/**
+ * @brief ImGui のコンテキストを作り、レンダーデバイスで描くレンダラーを登録する。
+ * @return レンダラーのリソースを作成できた場合は true。
+ */
+bool DxApp::InitImGui()
 {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGui::StyleColorsDark();
-    ImGui_ImplWin32_Init(hWnd);
-    ImGui_ImplDX11_Init(m_device.Get(), m_context.Get());
+#if defined(_WIN32)
+    if (m_window)
+        ImGui_ImplWin32_Init(static_cast<HWND>(m_window));
+#endif
+    if (!m_window)
+    {
+        // ヘッドレスではウィンドウの配置を imgui.ini から読み書きせず、毎回同じ配置から始める
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(static_cast<float>(m_width), static_cast<float>(m_height));
+        io.IniFilename = nullptr;
+    }
+    return m_ui.Init(*m_device);
 }
 
 /**
- * @brief Direct3D と関連付いた ImGui リソースをすべて解放する。
+ * @brief ImGui のレンダラー・プラットフォームバックエンド・コンテキストをすべて解放する。
  */
 void DxApp::ShutdownImGui()
 {
-    ImGui_ImplDX11_Shutdown();
-    ImGui_ImplWin32_Shutdown();
+    if (!ImGui::GetCurrentContext())
+        return;
+    m_ui.Shutdown();
+#if defined(_WIN32)
+    if (m_window)
+        ImGui_ImplWin32_Shutdown();
+#endif
     ImGui::DestroyContext();
 }
 
 /**
- * @brief Direct3D デバイス・コンテキスト・スワップチェーンを生成する。
- * @param hWnd プレゼンテーションに使用するウィンドウハンドル。
- * @param width 希望するバックバッファ幅。
- * @param height 希望するバックバッファ高さ。
- * @return 生成に成功した場合は true。
+ * @brief WM_SIZE で通知された大きさを記録する。以降のフレームパケットはこの大きさで作られ、
+ *        描画スレッドが提出の前にデバイスの描画先を合わせる。
+ * @param width 更新後の幅 (ピクセル)。
+ * @param height 更新後の高さ (ピクセル)。
  */
-bool DxApp::CreateDeviceAndSwapChain(HWND hWnd, UINT width, UINT height)
+void DxApp::OnResize(uint32_t width, uint32_t height)
 {
-    DXGI_SWAP_CHAIN_DESC sd{};
-    sd.BufferCount = 2;
-    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    sd.OutputWindow = hWnd;
-    sd.SampleDesc.Count = 1;
-    sd.Windowed = TRUE;
-    sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-    sd.BufferDesc.Width = width;
-    sd.BufferDesc.Height = height;
-
-    UINT deviceFlags = 0;
-#if defined(_DEBUG)
-    deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-
-    D3D_FEATURE_LEVEL req[] = {
-        D3D_FEATURE_LEVEL_11_1,
-        D3D_FEATURE_LEVEL_11_0,
-        D3D_FEATURE_LEVEL_10_1,
-        D3D_FEATURE_LEVEL_10_0,
-    };
-    D3D_FEATURE_LEVEL got{};
-
-    HRESULT hr = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, deviceFlags, req,
-                                               _countof(req), D3D11_SDK_VERSION, &sd, m_swapChain.GetAddressOf(),
-                                               m_device.GetAddressOf(), &got, m_context.GetAddressOf());
-
-    if (FAILED(hr))
-    {
-        hr = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, deviceFlags, req, _countof(req),
-                                           D3D11_SDK_VERSION, &sd, m_swapChain.GetAddressOf(), m_device.GetAddressOf(),
-                                           &got, m_context.GetAddressOf());
-    }
-    return SUCCEEDED(hr);
+    m_width = width;
+    m_height = height;
 }
 
 /**
- * @brief バックバッファを取得しレンダーターゲットビューを作成する。
- * @return ビューの用意に成功した場合は true。
+ * @brief デモ三角形で用いる頂点バッファ・パイプライン (Shader.hlsl)・動的定数バッファを構築する。
+ * @return リソース生成に成功した場合は true。
  */
-bool DxApp::CreateRenderTarget()
+bool DxApp::CreateTriangleResources()
 {
-    ComPtr<ID3D11Texture2D> backBuf;
-    HRESULT hr = m_swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(backBuf.GetAddressOf()));
-    if (FAILED(hr))
-        return false;
-    hr = m_device->CreateRenderTargetView(backBuf.Get(), nullptr, m_rtv.GetAddressOf());
-    return SUCCEEDED(hr);
+    Vertex v[] = {
+        {{0.0f, 0.5f, 0.0f}, {1.f, 0.f, 0.f}},
+        {{0.5f, -0.5f, 0.0f}, {0.f, 1.f, 0.f}},
+        {{-0.5f, -0.5f, 0.0f}, {0.f, 0.f, 1.f}},
+    };
+    m_vb = m_device->CreateBuffer(BufferKind::Vertex, sizeof(v), v);
+
+    PipelineDesc desc;
+    desc.name = "Triangle";
+    desc.shaderFile = L"Shader.hlsl";
+    desc.layout = {
+        {VertexSemantic::Position, VertexFormat::Float3, static_cast<uint32_t>(offsetof(Vertex, pos))},
+        {VertexSemantic::Color, VertexFormat::Float3, static_cast<uint32_t>(offsetof(Vertex, col))},
+    };
+    desc.tinted = true;
+    m_trianglePipeline = m_device->CreatePipeline(desc);
+
+    m_cb = m_device->CreateBuffer(BufferKind::Constant, sizeof(FrameConstants), nullptr);
+    return m_vb != RenderDevice::kNoHandle && m_trianglePipeline != RenderDevice::kNoHandle &&
+           m_cb != RenderDevice::kNoHandle;
 }
 
 /**
- * @brief 現在のレンダーターゲットビューを安全に解放する。
+ * @brief 初期化以降の経過時間を算出する。
+ * @return 起動からの経過秒数。
  */
-void DxApp::ReleaseRenderTarget()
+float DxApp::ElapsedSeconds()
 {
-    if (m_rtv)
-        m_rtv.Reset();
+    if (m_fixedStep > 0.0f)
+        return static_cast<float>(m_frameIndex) * m_fixedStep;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<float> d = now - m_start;
+    return d.count();
 }
 
 /**
- * @brief WM_SIZE に応じてスワップチェーンとビューポートを再設定する。
- * @param width 更新後の幅 (ピクセル)。
- * @param height 更新後の高さ (ピクセル)。
+ * @brief 編集ログを読み込み、次のフレームから記録時の間隔で再生する。
+ * @param path ログファイル。
+ * @return 読み込めた場合は true。
  */
-void DxApp::OnResize(UINT width, UINT height)
+bool DxApp::StartReplay(const std::filesystem::path& path)
 {
-    if (!m_swapChain)
-        return;
-    m_width = width;
-    m_height = height;
-
-    m_context->OMSetRenderTargets(0, nullptr, nullptr);
-    ReleaseRenderTarget();
-
-    if (FAILED(m_swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0)))
-        return;
-    if (!CreateRenderTarget())
-        return;
-
-    D3D11_VIEWPORT vp{};
-    vp.TopLeftX = 0;
-    vp.TopLeftY = 0;
-    vp.Width = (float)m_width;
-    vp.Height = (float)m_height;
-    vp.MinDepth = 0;
-    vp.MaxDepth = 1;
-    m_context->RSSetViewports(1, &vp);
+    m_replaying = m_replay.Open(path);
+    m_replayStart = std::chrono::steady_clock::now();
+    return m_replaying;
 }
 
 /**
- * @brief 頂点／ピクセルシェーダーをソースからコンパイルして生成する。
- * @return 両方のシェーダーが生成できた場合は true。
+ * @brief 永続化された設定値をすべてランタイムパラメータへ反映する。
+ * @details 起動時の既定値適用に用いる。再読み込みは ConfigService が行い、変化した項目だけが購読経由で反映される。
  */
-bool DxApp::LoadShaders()
+void DxApp::UpdateFromSettings()
 {
-    const std::wstring shaderFile = L"Shader.hlsl";
-    UINT compileFlags = 0;
-#if defined(_DEBUG)
-    compileFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-    ComPtr<ID3DBlob> vs, ps, err;
-
-    HRESULT hr = D3DCompileFromFile(shaderFile.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_0",
-                                    compileFlags, 0, vs.GetAddressOf(), err.GetAddressOf());
-    if (FAILED(hr))
-    {
-        if (err)
-            OutputDebugStringA((char*)err->GetBufferPointer());
-        return false;
-    }
-
-    hr = D3DCompileFromFile(shaderFile.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_0",
-                            compileFlags, 0, ps.GetAddressOf(), err.ReleaseAndGetAddressOf());
-    if (FAILED(hr))
-    {
-        if (err)
-            OutputDebugStringA((char*)err->GetBufferPointer());
-        return false;
-    }
-
-    if (FAILED(m_device->CreateVertexShader(vs->GetBufferPointer(), vs->GetBufferSize(), nullptr, m_vs.GetAddressOf())))
-        return false;
-    if (FAILED(m_device->CreatePixelShader(ps->GetBufferPointer(), ps->GetBufferSize(), nullptr, m_ps.GetAddressOf())))
-        return false;
-
-    D3D11_INPUT_ELEMENT_DESC layout[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, col), D3D11_INPUT_PER_VERTEX_DATA, 0},
-    };
-    return SUCCEEDED(m_device->CreateInputLayout(layout, _countof(layout), vs->GetBufferPointer(), vs->GetBufferSize(),
-                                                 m_inputLayout.GetAddressOf()));
+    m_binding.Load(m_settings, &m_config);
+    LogSettingsDiagnostics();
 }
 
 /**
- * @brief デモ三角形で用いる頂点バッファと入力レイアウトを構築する。
- * @return リソース生成に成功した場合は true。
+ * @brief 設定値のポーリング間隔・デバウンス時間を監視中の各ファイルへ反映する。
  */
-bool DxApp::CreateTriangleResources()
+void DxApp::ApplyReloadPolicy()
 {
-    Vertex v[] = {
-        {{0.0f, 0.5f, 0.0f}, {1.f, 0.f, 0.f}},
-        {{0.5f, -0.5f, 0.0f}, {0.f, 1.f, 0.f}},
-        {{-0.5f, -0.5f, 0.0f}, {0.f, 0.f, 1.f}},
-    };
-    D3D11_BUFFER_DESC bd{};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(v);
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    D3D11_SUBRESOURCE_DATA init{v};
-    return SUCCEEDED(m_device->CreateBuffer(&bd, &init, m_vb.GetAddressOf()));
+    ReloadPolicy policy;
+    policy.pollIntervalMs = m_config.hotReloadIntervalMs;
+    policy.debounceMs = m_config.hotReloadDebounceMs;
+    m_configService.SetPolicy(m_baseFile, policy);
+    if (m_userFile != ConfigService::kNoFile)
+        m_configService.SetPolicy(m_userFile, policy);
 }
 
 /**
- * @brief シェーダー間で共有する動的定数バッファを確保する。
- * @return バッファ生成に成功した場合は true。
+ * @brief 設定値のフレームレートの上限と、最小化中・隠れている間のフレームレート、描く契機をスケジューラーへ反映する。
+ * @details Render.OnDemand が有効なら、入力・アニメーション・設定の再読み込み・Invalidate があったときだけ描く。
  */
-bool DxApp::CreateConstantBuffer()
+void DxApp::ApplyFramePacing()
 {
-    D3D11_BUFFER_DESC bd{};
-    bd.Usage = D3D11_USAGE_DYNAMIC;
-    bd.ByteWidth = sizeof(CBData);
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    return SUCCEEDED(m_device->CreateBuffer(&bd, nullptr, m_cb.GetAddressOf()));
+    m_scheduler.SetTargetFps(m_config.maxFps);
+    m_scheduler.SetBackgroundFps(m_config.backgroundFps);
+    m_scheduler.SetMode(m_config.onDemand ? FrameMode::OnDemand : FrameMode::Continuous);
 }
 
 /**
- * @brief 初期化以降の経過時間を算出する。
- * @return 起動からの経過秒数。
+ * @brief 監視中のファイルを取り込んだ後に、再読み込みの方針を反映し直して結果を書き出す。
+ * @details 変化したキーに対応する項目は、このコールバックより前に購読コールバック経由で m_config へ反映済み。
+ * @param id 取り込んだファイル。
  */
-float DxApp::ElapsedSeconds()
+void DxApp::OnSettingsReloaded(ConfigService::FileId id)
 {
-    auto now = std::chrono::steady_clock::now();
-    std::chrono::duration<float> d = now - m_start;
-    return d.count();
+    ApplyReloadPolicy();
+    ApplyFramePacing();
+    const std::filesystem::path name = std::filesystem::path(m_configService.Path(id)).filename();
+    char msg[256];
+    std::snprintf(msg, sizeof(msg), "[Settings] Reloaded %s (%zu keys changed, %.3f ms)\n", name.u8string().c_str(),
+                  m_settings.ChangedKeys().size(), m_settings.Stats().lastMs);
+    DebugLog(msg);
+    LogSettingsDiagnostics();
 }
 
 /**
- * @brief 永続化された設定値をランタイムパラメータへ反映する。
- * @param onDemandReload 手動リロード操作による呼び出しなら true。
+ * @brief スキーマ検証で見つかった設定値の問題をデバッグ出力へ書き出す。
  */
-void DxApp::UpdateFromSettings(bool onDemandReload)
+void DxApp::LogSettingsDiagnostics() const
 {
-    if (onDemandReload)
-        m_settings.ReloadIfChanged();
-
-    m_vsync = m_settings.GetBool("Render", "VSync", true) ? 1 : 0;
-    m_hotReloadIntervalMs = m_settings.GetInt("Render", "HotReloadIntervalMs", 500);
-
-    m_clear[0] = (float)m_settings.GetDouble("Clear", "R", 0.05);
-    m_clear[1] = (float)m_settings.GetDouble("Clear", "G", 0.10);
-    m_clear[2] = (float)m_settings.GetDouble("Clear", "B", 0.20);
-    m_clear[3] = (float)m_settings.GetDouble("Clear", "A", 1.0);
-
-    m_scale = (float)m_settings.GetDouble("Triangle", "Scale", 1.0);
-    m_speed = (float)m_settings.GetDouble("Triangle", "RotationSpeed", 1.0);
-    m_tint[0] = (float)m_settings.GetDouble("Triangle", "TintR", 1.0);
-    m_tint[1] = (float)m_settings.GetDouble("Triangle", "TintG", 1.0);
-    m_tint[2] = (float)m_settings.GetDouble("Triangle", "TintB", 1.0);
+    for (const SettingsDiagnostic& d : m_binding.Diagnostics())
+    {
+        DebugLog("[Settings] " + m_binding.Describe(d) + "\n");
+    }
 }
 
 /**
  * @brief 設定 UI を描画し変更があれば保存する。
+ * @details Ctrl+Z で元に戻し、Ctrl+Y / Ctrl+Shift+Z でやり直す (テキスト入力中を除く)。
  */
 void DxApp::DrawImGui()
 {
-    ImGui_ImplDX11_NewFrame();
-    ImGui_ImplWin32_NewFrame();
+    // ウィンドウがあれば入力・表示サイズ・経過時間はプラットフォームバックエンドが設定する
+#if defined(_WIN32)
+    if (m_window)
+        ImGui_ImplWin32_NewFrame();
+#endif
+    if (!m_window)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(static_cast<float>(m_width), static_cast<float>(m_height));
+        io.DeltaTime = (std::max)(std::chrono::duration<float>(now - m_lastUiFrame).count(), 1e-6f);
+        m_lastUiFrame = now;
+    }
+    if (m_fixedStep > 0.0f)
+        ImGui::GetIO().DeltaTime = m_fixedStep;
     ImGui::NewFrame();
 
-    bool changed = false;
+    // 1 フレーム分の編集は 1 つのトランザクションに溜め、フレームの終わりに一度だけ確定する
+    Settings::Transaction edit = m_settings.Begin();
+
+    bool undo = false;
+    bool redo = false;
+    bool saveNow = false;
+    if (!ImGui::GetIO().WantTextInput)
+    {
+        undo = ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z);
+        redo = ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y) ||
+               ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiMod_Shift | ImGuiKey_Z);
+    }
 
     if (ImGui::Begin("Settings (INI <-> GUI)"))
     {
-        if (ImGui::CollapsingHeader("Render", ImGuiTreeNodeFlags_DefaultOpen))
-        {
-            bool vsync = m_vsync != 0;
-            if (ImGui::Checkbox("VSync", &vsync))
-            {
-                m_vsync = vsync ? 1 : 0;
-                m_settings.SetBool("Render", "VSync", vsync);
-                changed = true;
-            }
-            int interval = m_hotReloadIntervalMs;
-            if (ImGui::SliderInt("HotReloadIntervalMs", &interval, 100, 2000))
-            {
-                m_hotReloadIntervalMs = interval;
-                m_settings.SetInt("Render", "HotReloadIntervalMs", interval);
-                changed = true;
-            }
-        }
+        m_binding.DrawEditor(edit, &m_config);
 
-        if (ImGui::CollapsingHeader("Clear", ImGuiTreeNodeFlags_DefaultOpen))
+        ImGui::Separator();
+        if (ImGui::Button("Save to settings.ini"))
         {
-            if (ImGui::ColorEdit4("ClearColor", m_clear))
-            {
-                m_settings.SetDouble("Clear", "R", m_clear[0]);
-                m_settings.SetDouble("Clear", "G", m_clear[1]);
-                m_settings.SetDouble("Clear", "B", m_clear[2]);
-                m_settings.SetDouble("Clear", "A", m_clear[3]);
-                changed = true;
-            }
+            m_binding.StoreAll(edit, &m_config);
+            saveNow = true;
         }
-
-        if (ImGui::CollapsingHeader("Triangle", ImGuiTreeNodeFlags_DefaultOpen))
+        ImGui::SameLine();
+        if (ImGui::Button("Reload from settings.ini"))
         {
-            if (ImGui::SliderFloat("Scale", &m_scale, 0.1f, 5.0f))
-            {
-                m_settings.SetDouble("Triangle", "Scale", m_scale);
-                changed = true;
-            }
-            if (ImGui::SliderFloat("RotationSpeed", &m_speed, -10.0f, 10.0f))
-            {
-                m_settings.SetDouble("Triangle", "RotationSpeed", m_speed);
-                changed = true;
-            }
-            if (ImGui::ColorEdit3("Tint", m_tint))
-            {
-                m_settings.SetDouble("Triangle", "TintR", m_tint[0]);
-                m_settings.SetDouble("Triangle", "TintG", m_tint[1]);
-                m_settings.SetDouble("Triangle", "TintB", m_tint[2]);
-                changed = true;
-            }
+            m_configService.RequestReload(m_baseFile);
         }
+        ImGui::TextUnformatted("Hint: R key or external edit triggers reload too.");
 
-        ImGui::Separator();
-        if (ImGui::Button("Save to settings.ini"))
+        // 計測値は実行ごとに変わるため、固定の時間刻みで動かすときは表示しない
+        if (m_fixedStep <= 0.0f)
         {
-            changed = true;
+            // 監視スレッドで内容が同じと分かり解析を省いた回数と、描画スレッドでの取り込みの回数・所要時間
+            const FileWatchStats watch = m_configService.WatchStats(m_baseFile);
+            const Settings::ReloadStats& reload = m_settings.Stats();
+            ImGui::Text("Reloads: %llu applied, %llu unchanged (watcher %.3f ms, apply %.3f ms)",
+                        static_cast<unsigned long long>(reload.loads),
+                        static_cast<unsigned long long>(watch.unchanged + reload.skipped), watch.lastLoadMs,
+                        reload.lastMs);
+
+            // 直近のフレームの計測値 (CPU 時間・待機時間・予定時刻からのずれ)
+            const FrameStats frame = m_scheduler.Stats();
+            ImGui::Text("Frame: %.1f fps, cpu %.2f ms, wait %.2f ms, jitter %.3f ms (max %.3f)%s", frame.fps,
+                        frame.cpuMs, frame.waitMs, frame.jitterMs, frame.maxJitterMs,
+                        m_scheduler.Throttled() ? " [throttled]" : "");
+            if (m_scheduler.Mode() == FrameMode::OnDemand)
+                ImGui::Text("On demand: %llu frames drawn, %llu idle wakes",
+                            static_cast<unsigned long long>(frame.frames),
+                            static_cast<unsigned long long>(frame.idleWakes));
+
+            // 描画スレッドでの提出の所要時間と、公開から提出開始までの遅れ。stalls は描画段に追いつかれて待った回数
+            const FramePipelineStats pipeline = m_pipeline.Stats();
+            ImGui::Text("Pipeline: submit %.2f ms, latency %.2f ms, %llu stalls, %llu dropped", pipeline.submitMs,
+                        pipeline.latencyMs, static_cast<unsigned long long>(pipeline.stalls),
+                        static_cast<unsigned long long>(pipeline.dropped));
         }
+
+        ImGui::BeginDisabled(!m_journal.CanUndo());
+        undo |= ImGui::Button("Undo");
+        ImGui::EndDisabled();
         ImGui::SameLine();
-        if (ImGui::Button("Reload from settings.ini"))
+        ImGui::BeginDisabled(!m_journal.CanRedo());
+        redo |= ImGui::Button("Redo");
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (ImGui::Button("Export session"))
         {
-            m_settings.Load(L"settings.ini");
-            UpdateFromSettings(false);
+            const bool ok = m_journal.Export("settings.journal", m_settings);
+            DebugLog(ok ? "[Settings] Exported edit journal to settings.journal\n"
+                        : "[Settings] Failed to export edit journal\n");
         }
-        ImGui::TextUnformatted("Hint: R key or external edit triggers reload too.");
+        if (m_replaying)
+            ImGui::Text("Replaying: %zu / %zu", m_replay.Position(), m_replay.GroupCount());
+
+        // 読み込み時に丸めた・既定値へ戻した項目を示す
+        for (const SettingsDiagnostic& d : m_binding.Diagnostics())
+            ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), "%s", m_binding.Describe(d).c_str());
     }
     ImGui::End();
 
-    if (changed)
+    // 変化があればスナップショットの公開・変化通知を 1 回ずつ行い、保存すべき編集として記録する。
+    // 直列化は PollSettings の SaveIfDue がまとめて行うため、ドラッグ中に毎フレーム確定しても保存の手間はかからない。
+    // 操作中のウィジェットが前のフレームから続いていれば、履歴も 1 回の操作として同じグループへまとめる
+    const bool active = ImGui::IsAnyItemActive();
+    m_journal.MergeNextGroup(active && m_editActive);
+    m_editActive = active;
+    // 旧形式 (成分ごとのキー) から読んだ項目は、保存する編集があるときに新しい形へ書き換える
+    if (edit.Pending())
+        m_binding.StoreMigrations(edit, &m_config);
+    if (edit.Commit())
     {
-        m_settings.Save();
+        // 監視間隔やフレームレートの上限を UI から変えた場合も次の読み込みを待たずに反映する
+        ApplyReloadPolicy();
+        ApplyFramePacing();
     }
+    if (saveNow)
+        m_settings.Save(); // ボタンでの保存は待たずにライターへ渡す
+
+    // 元に戻す・やり直すは、このフレームの編集を確定してから別のトランザクションで適用する
+    if (undo)
+        m_journal.Undo(m_settings);
+    else if (redo)
+        m_journal.Redo(m_settings);
 
     ImGui::Render();
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
 
 /**
- * @brief 毎フレームの更新と描画、表示処理をまとめて実行する。
+ * @brief 監視スレッドが読み込み・解析済みの内容を用意していれば取り込む (描画スレッドではファイル I/O を行わない)。
+ * @details 変化したキーに対応する項目だけが購読コールバック経由で m_config へ反映され、その後 OnSettingsReloaded が
+ *          呼ばれる。ユーザー上書きファイルの更新は、そのファイルが定義しているキーだけを統合し直す。
+ *          UI で確定した編集の保存もここでまとめて行う (書き出し自体はライタースレッド)。
+ * @return 取り込んだファイルがあれば true。
+ */
+bool DxApp::PollSettings()
+{
+    const bool reloaded = m_configService.Poll() > 0;
+    m_settings.SaveIfDue();
+    return reloaded;
+}
+
+/**
+ * @brief 1 フレーム分の UI と描画内容を更新し、フレームパケットとして描画スレッドへ渡す (更新段)。
+ * @details 設定・ImGui・アニメーションの状態はこのスレッドだけが触り、描画に要る値はパケットへ写してから渡す。
+ *          描画スレッドが前のフレームを提出している間に次のフレームを組み立てられる。
  */
 void DxApp::Render()
 {
-    auto now = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastCheck).count() >= m_hotReloadIntervalMs ||
-        (GetAsyncKeyState('R') & 1))
+#if defined(_WIN32)
+    if (m_window && (GetAsyncKeyState('R') & 1))
+        m_configService.RequestReload(m_baseFile);
+#endif
+
+    // 編集ログの再生中は、記録時刻に達した編集をまとめて適用する
+    if (m_replaying)
     {
-        if (m_settings.ReloadIfChanged())
+        m_replay.ApplyUntil(m_settings, std::chrono::steady_clock::now() - m_replayStart);
+        if (m_replay.Done())
         {
-            UpdateFromSettings(false);
-            OutputDebugStringW(L"[Settings] Reloaded settings.ini\n");
+            m_replaying = false;
+            DebugLog("[Settings] Replay finished\n");
         }
-        m_lastCheck = now;
     }
 
-    m_context->OMSetRenderTargets(1, m_rtv.GetAddressOf(), nullptr);
-    m_context->ClearRenderTargetView(m_rtv.Get(), m_clear);
-
-    D3D11_MAPPED_SUBRESOURCE mapped{};
-    if (SUCCEEDED(m_context->Map(m_cb.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    // 描画段が提出待ちを抱えきれないほど遅れていれば、UI を組み立てる前に空きを待つ
+    FramePacket* packet = m_pipeline.Acquire(kAcquireTimeout);
+    if (!packet)
     {
-        auto* cb = reinterpret_cast<CBData*>(mapped.pData);
-        cb->Tint[0] = m_tint[0];
-        cb->Tint[1] = m_tint[1];
-        cb->Tint[2] = m_tint[2];
-        cb->Tint[3] = 0;
-        cb->Screen[0] = (float)m_width;
-        cb->Screen[1] = (float)m_height;
-        cb->Pad0[0] = cb->Pad0[1] = 0;
-        float angle = ElapsedSeconds() * m_speed;
-        MakeZRotateScale(cb->Mvp, angle, m_scale);
-        m_context->Unmap(m_cb.Get(), 0);
+        m_scheduler.Invalidate(1);
+        return;
     }
 
-    UINT stride = sizeof(Vertex), offset = 0;
-    ID3D11Buffer* bufs[] = {m_vb.Get()};
-    m_context->IASetVertexBuffers(0, 1, bufs, &stride, &offset);
-    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    m_context->IASetInputLayout(m_inputLayout.Get());
+    DrawImGui();
+
+    packet->index = m_frameIndex++;
+    packet->width = m_width;
+    packet->height = m_height;
+    packet->vsync = m_config.vsync;
+    std::copy(std::begin(m_config.clear), std::end(m_config.clear), packet->clear);
+    FrameConstants& cb = packet->constants;
+    cb.Tint[0] = m_config.tint[0];
+    cb.Tint[1] = m_config.tint[1];
+    cb.Tint[2] = m_config.tint[2];
+    cb.Tint[3] = 0;
+    cb.Screen[0] = (float)m_width;
+    cb.Screen[1] = (float)m_height;
+    cb.Pad0[0] = cb.Pad0[1] = 0;
+    float angle = ElapsedSeconds() * m_config.speed;
+    MakeZRotateScale(cb.Mvp, angle, m_config.scale);
+    packet->ui.Capture(ImGui::GetDrawData());
+    m_pipeline.Publish(packet);
+
+    // 他のウィンドウに完全に隠れている間は、スケジューラーがフレームレートを絞る
+    m_scheduler.SetOccluded(m_occluded.load(std::memory_order_relaxed));
+
+    // 三角形が回転している間と編集ログの再生中は、入力が無くても次のフレームを描く
+    if (m_config.speed != 0.0f || m_replaying)
+        m_scheduler.Invalidate(1);
+}
 
-    m_context->VSSetShader(m_vs.Get(), nullptr, 0);
-    m_context->PSSetShader(m_ps.Get(), nullptr, 0);
-    ID3D11Buffer* cbs[] = {m_cb.Get()};
-    m_context->VSSetConstantBuffers(0, 1, cbs);
-    m_context->PSSetConstantBuffers(0, 1, cbs);
+/**
+ * @brief フレームパケットをデバイスへ提出して表示する (描画段)。
+ * @details デバイスは描画スレッドだけが使う。パケットの内容は読むだけで書き換えない。
+ * @param packet 更新段が作ったパケット。
+ */
+void DxApp::Submit(FramePacket& packet)
+{
+    if (!m_device->Resize(packet.width, packet.height))
+        return;
 
-    m_context->Draw(3, 0);
+    m_device->BeginPass(packet.clear);
+    m_device->UpdateBuffer(m_cb, &packet.constants, sizeof(FrameConstants));
+    m_device->SetPipeline(m_trianglePipeline);
+    m_device->SetVertexBuffer(m_vb, sizeof(Vertex));
+    m_device->SetConstantBuffer(m_cb);
+    m_device->Draw(3, 0);
 
-    DrawImGui();
+    m_ui.Render(packet.ui.Data());
 
-    m_swapChain->Present(m_vsync ? 1 : 0, 0);
+    const PresentResult result = m_device->Present(packet.vsync);
+    m_occluded.store(result == PresentResult::Occluded, std::memory_order_relaxed);
 }
@@ -1,102 +1,165 @@
 #pragma once
+#include "AppConfig.h"
+#include "ConfigService.h"
+#include "FramePipeline.h"
+#include "FrameScheduler.h"
 #include "Settings.h"
+#include "SettingsJournal.h"
+#include "SettingsSchema.h"
+#include "UiRenderer.h"
 
+#include <atomic>
 #include <chrono>
-#include <d3d11.h>
-#include <d3dcompiler.h>
-#include <dxgi.h>
-#include <vector>
-#include <windows.h>
-#include <wrl.h>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
 
 /**
  * @file DxApp.h
- * @brief Direct3D 11 レンダラーのインターフェースを宣言するヘッダー。
+ * @brief 設定の同期・UI・描画ループをまとめたアプリケーションクラスを宣言するヘッダー。
  * @author 山内陽
  */
 
 /**
- * @brief Direct3D デバイスと描画ループを管理するアプリケーションクラス。
+ * @brief 設定ファイルの同期、ImGui の設定 UI、三角形の描画ループを管理するアプリケーションクラス。
+ * @details 描画はすべて RenderDevice を通じて行うため、Direct3D 11 でもヘッドレスのバックエンドでも同じように動く。
  */
 class DxApp
 {
 public:
+    static constexpr uint32_t kSettleFrames = 3; // 入力の後に ImGui のホバーやアニメーションが落ち着くまで描くフレーム数
+
     /**
-     * @brief Direct3D と ImGui の初期化を行う。
-     * @param hWnd 連携するウィンドウハンドル。
+     * @brief 設定・描画リソース・ImGui の初期化を行い、描画スレッドを起動する。
+     * @param window ImGui が入力を受け取るウィンドウ (Windows では HWND)。nullptr ならヘッドレスで動かす。
+     * @param device 描画に使うデバイス (初期化済みであること)。
      * @param width 初期ウィンドウ幅 (ピクセル)。
      * @param height 初期ウィンドウ高さ (ピクセル)。
+     * @param overrides コマンドラインで指定された上書き設定 (INI テキスト)。
      * @return すべての初期化に成功した場合は true。
      */
-    bool Init(HWND hWnd, UINT width, UINT height);
+    bool Init(void* window, std::unique_ptr<RenderDevice> device, uint32_t width, uint32_t height,
+              const std::string& overrides = {});
+
+    /**
+     * @brief 描画スレッドを止め、ImGui を破棄する。メッセージループを抜けた後に呼ぶ。
+     */
+    void Shutdown();
 
     /**
-     * @brief ウィンドウサイズ変更に合わせてバッファを再作成する。
+     * @brief ウィンドウサイズの変更を記録する。バッファは描画スレッドが次のフレームで作り直す。
      * @param width 新しい幅 (ピクセル)。
      * @param height 新しい高さ (ピクセル)。
      */
-    void OnResize(UINT width, UINT height);
+    void OnResize(uint32_t width, uint32_t height);
 
     /**
-     * @brief 1 フレーム分の描画と UI 更新を処理する。
+     * @brief 1 フレーム分の UI と描画内容を更新し、フレームパケットとして描画スレッドへ渡す (更新段)。
      */
     void Render();
 
-private:
     /**
-     * @brief デバイスとスワップチェーンを生成する。
-     * @param hWnd 描画先ウィンドウハンドル。
-     * @param width バックバッファ幅。
-     * @param height バックバッファ高さ。
-     * @return 作成に成功した場合は true。
+     * @brief 監視スレッドが用意した設定ファイルの内容を取り込む。描画しない間もメッセージループから呼ぶ。
+     * @return 取り込んだファイルがあれば true。
      */
-    bool CreateDeviceAndSwapChain(HWND hWnd, UINT width, UINT height);
+    bool PollSettings();
 
     /**
-     * @brief バックバッファからレンダーターゲットビューを構築する。
-     * @return 作成に成功した場合は true。
+     * @brief 描画し直しを要求する。Render.OnDemand が有効な場合だけ意味を持つ。
+     * @param frames 続けて描くフレーム数。
      */
-    bool CreateRenderTarget();
+    void Invalidate(uint32_t frames = kSettleFrames)
+    {
+        m_scheduler.Invalidate(frames);
+    }
 
     /**
-     * @brief レンダーターゲットビューを解放する。
+     * @brief フレームの描画時刻を決めるスケジューラーを取得する。
+     * @return スケジューラー。
      */
-    void ReleaseRenderTarget();
+    FrameScheduler& Scheduler()
+    {
+        return m_scheduler;
+    }
 
     /**
-     * @brief 三角形描画用の頂点バッファと入力レイアウトを生成する。
+     * @brief 描画パイプラインの統計を取得する。
+     * @return 統計。
+     */
+    FramePipelineStats PipelineStats() const
+    {
+        return m_pipeline.Stats();
+    }
+
+    /**
+     * @brief アニメーションと UI の時間を、実時間ではなくフレームごとに一定量ずつ進める。
+     * @details 同じ設定からは毎回同じ画面ができるよう、実行ごとに変わる計測値は UI に表示しない。
+     *          ヘッドレスでの画像比較に使う。
+     * @param seconds 1 フレームあたりの秒数 (0 なら実時間に戻す)。
+     */
+    void SetFixedTimeStep(float seconds)
+    {
+        m_fixedStep = seconds;
+    }
+
+    /**
+     * @brief 書き出した編集ログの再生を開始する。編集は記録時の間隔で毎フレーム適用される。
+     * @param path SettingsJournal::Export で書き出したログ。
+     * @return ログを読み込めた場合は true。
+     */
+    bool StartReplay(const std::filesystem::path& path);
+
+private:
+    /**
+     * @brief 三角形描画用の頂点バッファ・パイプライン・定数バッファを生成する。
      * @return 作成に成功した場合は true。
      */
     bool CreateTriangleResources();
 
     /**
-     * @brief HLSL シェーダーを読み込みコンパイルする。
-     * @return コンパイルと作成に成功した場合は true。
+     * @brief 読み込み済みの設定値をすべてランタイム状態へ反映する (起動時に 1 回だけ呼ぶ)。
+     * @details ファイルの再読み込みは ConfigService が行うため、ここではファイルを読まない。
      */
-    bool LoadShaders();
+    void UpdateFromSettings();
 
     /**
-     * @brief 定数バッファを作成する。
-     * @return 作成に成功した場合は true。
+     * @brief 設定値のポーリング間隔・デバウンス時間を監視中の各ファイルの再読み込み方針へ反映する。
+     */
+    void ApplyReloadPolicy();
+
+    /**
+     * @brief 設定値のフレームレートの上限と描く契機をスケジューラーへ反映する。
+     */
+    void ApplyFramePacing();
+
+    /**
+     * @brief 監視中のファイルを取り込んだ後の処理 (方針の再反映・ログ出力)。ConfigService::Poll から呼ばれる。
+     * @param id 取り込んだファイル。
+     */
+    void OnSettingsReloaded(ConfigService::FileId id);
+
+    /**
+     * @brief スキーマ検証で見つかった設定値の問題をデバッグ出力へ書き出す。
      */
-    bool CreateConstantBuffer();
+    void LogSettingsDiagnostics() const;
 
     /**
-     * @brief 設定値をランタイム状態へ反映する。
-     * @param onDemandReload 手動リロードで呼ばれた場合は true。
+     * @brief フレームパケットをデバイスへ提出して表示する (描画段、描画スレッドから呼ばれる)。
+     * @param packet 更新段が作ったパケット。
      */
-    void UpdateFromSettings(bool onDemandReload);
+    void Submit(FramePacket& packet);
 
     /**
-     * @brief 設定編集用の ImGui ウィジェットを描画する。
+     * @brief 設定編集用の ImGui ウィジェットを組み立てる。描画データは ImGui::GetDrawData で取得する。
      */
     void DrawImGui();
 
     /**
-     * @brief 指定ウィンドウで ImGui を初期化する。
-     * @param hWnd ImGui が利用するウィンドウハンドル。
+     * @brief ImGui を初期化する。ウィンドウがあればプラットフォームバックエンドも初期化する。
+     * @return レンダラーのリソースを作成できた場合は true。
      */
-    void InitImGui(HWND hWnd);
+    bool InitImGui();
 
     /**
      * @brief ImGui のリソースを破棄する。
@@ -110,29 +173,35 @@ private:
     float ElapsedSeconds();
 
 private:
-    Microsoft::WRL::ComPtr<ID3D11Device> m_device;         // Direct3D デバイス
-    Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context; // 即時コンテキスト
-    Microsoft::WRL::ComPtr<IDXGISwapChain> m_swapChain;    // スワップチェーン
-    Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_rtv;  // レンダーターゲットビュー
-
-    Microsoft::WRL::ComPtr<ID3D11Buffer> m_vb;               // 三角形用頂点バッファ
-    Microsoft::WRL::ComPtr<ID3D11InputLayout> m_inputLayout; // 入力レイアウト
-    Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vs;         // 頂点シェーダー
-    Microsoft::WRL::ComPtr<ID3D11PixelShader> m_ps;          // ピクセルシェーダー
-
-    Microsoft::WRL::ComPtr<ID3D11Buffer> m_cb; // シェーダー用定数バッファ
-
-    UINT m_width = 0;  // バックバッファ幅
-    UINT m_height = 0; // バックバッファ高さ
-
-    Settings m_settings;                                 // 設定ファイル管理
-    std::chrono::steady_clock::time_point m_start{};     // 起動時刻
-    std::chrono::steady_clock::time_point m_lastCheck{}; // 設定ファイル最終確認時刻
-    int m_hotReloadIntervalMs = 500;                     // ホットリロード間隔 (ミリ秒)
-
-    int m_vsync = 1;                           // VSync 設定 (0/1)
-    float m_clear[4]{0.05f, 0.1f, 0.2f, 1.0f}; // クリアカラー RGBA
-    float m_scale = 1.0f;                      // 三角形スケール係数
-    float m_speed = 1.0f;                      // 回転速度係数
-    float m_tint[3]{1.f, 1.f, 1.f};            // 色調補正係数
+    std::unique_ptr<RenderDevice> m_device;                            // 描画に使うデバイス (初期化後は描画スレッドが使う)
+    UiRenderer m_ui;                                                   // ImGui の描画
+    RenderDevice::Handle m_vb = RenderDevice::kNoHandle;               // 三角形用頂点バッファ
+    RenderDevice::Handle m_trianglePipeline = RenderDevice::kNoHandle; // 三角形用パイプライン
+    RenderDevice::Handle m_cb = RenderDevice::kNoHandle;               // シェーダー用定数バッファ
+    void* m_window = nullptr;                                          // ImGui の入力元のウィンドウ (ヘッドレスなら nullptr)
+
+    uint32_t m_width = 0;  // クライアント領域の幅
+    uint32_t m_height = 0; // クライアント領域の高さ
+
+    Settings m_settings;                                       // 設定ファイル管理
+    SettingsBinding m_binding{kAppConfigFields};               // 設定キーと m_config の束縛
+    AppConfig m_config;                                        // 設定値のランタイムコピー
+    ConfigService m_configService;                             // 設定ファイル群の監視・再読み込み
+    ConfigService::FileId m_baseFile = ConfigService::kNoFile; // settings.ini の監視番号
+    ConfigService::FileId m_userFile = ConfigService::kNoFile; // settings.user.ini の監視番号
+    uint32_t m_userLayer = Settings::kNoLayer;                 // ユーザー上書きレイヤー (settings.user.ini)
+    uint32_t m_commandLineLayer = Settings::kNoLayer;          // コマンドライン上書きレイヤー
+    std::chrono::steady_clock::time_point m_start{};           // 起動時刻
+    std::chrono::steady_clock::time_point m_lastUiFrame{};     // 前回 ImGui のフレームを始めた時刻 (ヘッドレス用)
+    SettingsJournal m_journal;                                 // ImGui からの編集の履歴 (元に戻す・やり直す)
+    bool m_editActive = false;                                 // 前のフレームでウィジェットを操作中だった
+    SettingsReplay m_replay;                                   // 再生中の編集ログ
+    bool m_replaying = false;                                  // 編集ログを再生中
+    std::chrono::steady_clock::time_point m_replayStart{};     // 再生開始時刻
+    SystemFrameClock m_frameClock;                             // フレームの待機に使う時計
+    FrameScheduler m_scheduler{m_frameClock};                  // フレームの描画時刻の決定と計測
+    FramePipeline m_pipeline;                                  // 更新段と描画段をつなぐパイプライン
+    uint64_t m_frameIndex = 0;                                 // 公開したフレームの番号
+    float m_fixedStep = 0.0f;                                  // 固定の時間刻み (0 なら実時間)
+    std::atomic<bool> m_occluded{false};                       // 直近の Present で隠れていた (描画段が書く)
 };
@@ -0,0 +1,655 @@
+/**
+ * @file FileWatcher.cpp
+ * @brief 設定ファイル監視スレッドの実装。
+ * @author 山内陽
+ */
+
+#include "FileWatcher.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static constexpr int kWakeIntervalMs = 50; // 停止・再読み込み要求を確認する最大間隔 (ミリ秒)
+
+/**
+ * @brief 監視対象の親ディレクトリを求める。
+ * @param path ファイルパス。
+ * @return 親ディレクトリ (無ければカレントディレクトリ)。
+ */
+static std::filesystem::path ParentDirectory(const std::filesystem::path& path)
+{
+    // 取り込むファイル (絶対パス) と同じディレクトリを同じ表記で比べられるよう、絶対パスへ揃える
+    std::error_code ec;
+    const std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+    return ec ? std::filesystem::path(".") : absolute.lexically_normal().parent_path();
+}
+
+/**
+ * @brief 通知で得たファイル名が監視対象のファイル名と一致するか判定する。
+ * @param a ファイル名。
+ * @param b ファイル名。
+ * @return 一致する場合は true (Windows では大文字小文字を区別しない)。
+ */
+static bool SameName(const std::filesystem::path& a, const std::filesystem::path& b)
+{
+#if defined(_WIN32)
+    return CompareStringOrdinal(a.c_str(), -1, b.c_str(), -1, TRUE) == CSTR_EQUAL;
+#else
+    return a == b;
+#endif
+}
+
+/**
+ * @brief 監視スレッドを停止する。
+ */
+FileWatcher::~FileWatcher()
+{
+    Stop();
+}
+
+/**
+ * @brief 監視するファイルを追加する。
+ * @details 通知の登録はディレクトリ単位で監視スレッドの開始時に行うため、監視中の追加はスレッドを再起動して反映する。
+ *          既存のファイルの未処理の変更や受け渡し待ちの内容は保持される。
+ * @param path 監視するファイルパス。
+ * @param knownHash 取り込み済みの内容のハッシュ (不明なら 0)。
+ * @param dependencies 取り込み済みの内容が取り込んでいるファイル。
+ * @param dependencyHash それらの内容をまとめたハッシュ。
+ * @param prepare 受け渡す内容ごとに監視スレッドで呼ぶ処理。指定した場合は監視の開始直後に取り込み済みの内容を
+ *                一度読み込んで渡す (差分の基準を用意するため。内容が同じなら受け渡しは行わない)。
+ * @return ファイル番号。
+ */
+uint32_t FileWatcher::Add(const std::wstring& path, uint64_t knownHash, const std::vector<std::wstring>& dependencies,
+                          uint64_t dependencyHash, Prepare prepare)
+{
+    const bool running = m_thread.joinable();
+    Stop();
+
+    auto file = std::make_unique<File>();
+    file->path = path;
+    file->dir = ParentDirectory(file->path);
+    file->lastHash = knownHash;
+    file->lastDependencyHash = dependencyHash;
+    std::error_code ec;
+    file->lastWriteTime = std::filesystem::last_write_time(file->path, ec);
+    file->prepare = std::move(prepare);
+    file->dirty = static_cast<bool>(file->prepare);
+    SetDependencies(*file, dependencies);
+    m_files.push_back(std::move(file));
+
+    if (running)
+        Start();
+    return static_cast<uint32_t>(m_files.size() - 1);
+}
+
+/**
+ * @brief 監視を開始する。
+ * @return スレッドを起動できた場合は true。
+ */
+bool FileWatcher::Start()
+{
+    Stop();
+    m_stop = false;
+    m_thread = std::thread(&FileWatcher::Run, this);
+    return m_thread.joinable();
+}
+
+/**
+ * @brief 監視スレッドを停止して合流する。
+ */
+void FileWatcher::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+/**
+ * @brief 次の機会に読み込み直すよう要求する。
+ * @param file ファイル番号。
+ */
+void FileWatcher::RequestReload(uint32_t file)
+{
+    m_files[file]->reloadRequested = true;
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_reloadPending = true;
+    }
+    m_wake.notify_all();
+}
+
+/**
+ * @brief ポーリング方式の確認間隔を変更する。
+ * @param file ファイル番号。
+ * @param ms 確認間隔 (ミリ秒)。
+ */
+void FileWatcher::SetPollInterval(uint32_t file, int ms)
+{
+    m_files[file]->pollIntervalMs = ms;
+}
+
+/**
+ * @brief 連続した変更通知をまとめる待ち時間を変更する。
+ * @param file ファイル番号。
+ * @param ms 待ち時間 (ミリ秒)。
+ */
+void FileWatcher::SetDebounce(uint32_t file, int ms)
+{
+    m_files[file]->debounceMs = ms;
+}
+
+/**
+ * @brief 変更の検知を止める、または再開する。
+ * @details 止めている間の変更は記録しないため、再開時に一度読み込んで取りこぼしを拾う (内容が同じなら受け渡さない)。
+ * @param file ファイル番号。
+ * @param enabled 検知する場合は true。
+ */
+void FileWatcher::SetEnabled(uint32_t file, bool enabled)
+{
+    if (m_files[file]->enabled.exchange(enabled) != enabled && enabled)
+        RequestReload(file);
+}
+
+/**
+ * @brief 読み込みの統計を取得する。
+ * @param file ファイル番号。
+ * @return 統計。
+ */
+FileWatchStats FileWatcher::Stats(uint32_t file) const
+{
+    const File& f = *m_files[file];
+    FileWatchStats stats;
+    stats.loads = f.loads.load(std::memory_order_relaxed);
+    stats.unchanged = f.unchanged.load(std::memory_order_relaxed);
+    stats.lastLoadMs = f.lastLoadNs.load(std::memory_order_relaxed) / 1.0e6;
+    return stats;
+}
+
+/**
+ * @brief 新しい内容が用意されたファイルの番号を取り出す。
+ * @details 取り出した番号は一覧から外れ、次に内容が用意されたときに再び載る。番号を取り出してから
+ *          TakeSnapshot するまでに用意された内容は、その TakeSnapshot で受け取るか次回の一覧に載る。
+ * @param out 番号の格納先。
+ * @return 1 つ以上あれば true。
+ */
+bool FileWatcher::TakeReady(std::vector<uint32_t>& out)
+{
+    out.clear();
+    if (!m_hasReady.load(std::memory_order_acquire))
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(m_readyMutex);
+        out.swap(m_ready);
+        m_hasReady.store(false, std::memory_order_relaxed);
+    }
+    for (uint32_t index : out)
+        m_files[index]->queued.store(false, std::memory_order_release);
+    return !out.empty();
+}
+
+/**
+ * @brief 使用中の検知方式名を取得する。
+ * @return 検知方式名。
+ */
+const char* FileWatcher::Backend() const
+{
+    return m_backend.load();
+}
+
+/**
+ * @brief 監視スレッドの本体。OS の通知が使えなければポーリングへ切り替える。
+ */
+void FileWatcher::Run()
+{
+    // 取り込むファイルのディレクトリが増えた場合は、通知を登録し直して続ける
+    while (!m_stop)
+    {
+        m_rewatch = false;
+        if (!RunNative())
+        {
+            RunPolling();
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 変更を受け取ったことを記録する。検知を止めているファイルは無視する。
+ * @param file 対象ファイル。
+ */
+void FileWatcher::MarkDirty(File& file)
+{
+    if (!file.enabled.load(std::memory_order_relaxed))
+        return;
+    file.dirty = true;
+    file.lastEvent = Clock::now();
+}
+
+/**
+ * @brief ディレクトリ内のファイル名の変更通知を、該当する監視対象へ振り分ける。
+ * @details 取り込んでいるファイルの変更は、取り込んでいる側の変更として扱う。
+ * @param dir 通知を受けたディレクトリ。
+ * @param name 通知で得たファイル名。
+ */
+void FileWatcher::Dispatch(const std::filesystem::path& dir, const std::filesystem::path& name)
+{
+    for (auto& file : m_files)
+    {
+        bool hit = file->dir == dir && SameName(name, file->path.filename());
+        for (size_t i = 0; !hit && i < file->dependencies.size(); ++i)
+        {
+            const Dependency& dep = file->dependencies[i];
+            hit = dep.dir == dir && SameName(name, dep.path.filename());
+        }
+        if (hit)
+            MarkDirty(*file);
+    }
+}
+
+/**
+ * @brief ディレクトリ内の全監視対象に変更があったものとして扱う。
+ * @param dir 対象ディレクトリ (空ならすべて)。
+ */
+void FileWatcher::MarkAllDirty(const std::filesystem::path& dir)
+{
+    for (auto& file : m_files)
+    {
+        bool hit = dir.empty() || file->dir == dir;
+        for (size_t i = 0; !hit && i < file->dependencies.size(); ++i)
+            hit = file->dependencies[i].dir == dir;
+        if (hit)
+            MarkDirty(*file);
+    }
+}
+
+/**
+ * @brief 取り込んでいるファイルの一覧を更新する。
+ * @param file 対象ファイル。
+ * @param dependencies 新しい一覧。
+ */
+void FileWatcher::SetDependencies(File& file, const std::vector<std::wstring>& dependencies)
+{
+    file.dependencies.resize(dependencies.size());
+    for (size_t i = 0; i < dependencies.size(); ++i)
+    {
+        Dependency& dep = file.dependencies[i];
+        if (dep.path == dependencies[i])
+            continue;
+        dep.path = dependencies[i];
+        dep.dir = dep.path.parent_path();
+        std::error_code ec;
+        dep.writeTime = std::filesystem::last_write_time(dep.path, ec);
+        if (ec)
+            dep.writeTime = std::filesystem::file_time_type{};
+        if (std::find(m_watchedDirs.begin(), m_watchedDirs.end(), dep.dir) == m_watchedDirs.end())
+            m_rewatch = true;
+    }
+}
+
+/**
+ * @brief 監視対象と取り込んでいるファイルの親ディレクトリを重複なく列挙する。
+ * @return ディレクトリの一覧。
+ */
+std::vector<std::filesystem::path> FileWatcher::Directories() const
+{
+    std::vector<std::filesystem::path> dirs;
+    auto add = [&dirs](const std::filesystem::path& dir)
+    {
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end())
+            dirs.push_back(dir);
+    };
+    for (const auto& file : m_files)
+    {
+        add(file->dir);
+        // 存在しないディレクトリは監視を登録できないため、取り込むファイルの分は除く (OS の通知全体を諦めないように)
+        for (const Dependency& dep : file->dependencies)
+        {
+            std::error_code ec;
+            if (std::filesystem::is_directory(dep.dir, ec))
+                add(dep.dir);
+        }
+    }
+    return dirs;
+}
+
+/**
+ * @brief すべてのファイルの保留中の変更や再読み込み要求を処理する。
+ */
+void FileWatcher::ServiceAll()
+{
+    m_reloadPending = false;
+    for (uint32_t i = 0; i < m_files.size(); ++i)
+        Service(i);
+}
+
+/**
+ * @brief 保留中の変更を処理する。変更通知が落ち着いてから読み込み、内容が変わっていれば解析してメールボックスへ置く。
+ * @details 再読み込み要求はデバウンスを待たずに処理する。内容のハッシュが直前に受け渡したものと同じなら
+ *          解析を省き、読み込み先のバッファは次回へ持ち越す。"@include" を含むファイルは取り込むファイルも
+ *          比べるため、展開までを行ってからファイル自身と取り込むファイルの両方のハッシュで判定する。
+ *          受け渡す内容は prepare へ通してから置く。prepare には最初の 1 回だけ、同じ内容も解析して渡す。
+ *          受け渡した場合は準備済みの一覧へ番号を載せる。
+ * @param index ファイル番号。
+ */
+void FileWatcher::Service(uint32_t index)
+{
+    File& file = *m_files[index];
+    if (file.reloadRequested.exchange(false))
+    {
+        file.dirty = true;
+        file.lastEvent = Clock::time_point{};
+    }
+    if (!file.dirty || Clock::now() - file.lastEvent < std::chrono::milliseconds(file.debounceMs.load()))
+        return;
+
+    std::error_code ec;
+    if (!std::filesystem::exists(file.path, ec))
+    {
+        file.dirty = false;
+        return;
+    }
+
+    const Clock::time_point start = Clock::now();
+    if (!file.spare)
+        file.spare = std::make_unique<IniDocument>();
+    IniDocument& doc = *file.spare;
+    doc.writeTime = std::filesystem::last_write_time(file.path, ec);
+    if (ec || !ReadFileToBuffer(file.path.wstring(), doc.text))
+    {
+        // 書き込み中でロックされている等。少し待って再試行する
+        file.lastEvent = Clock::now();
+        return;
+    }
+    file.dirty = false;
+    file.lastWriteTime = doc.writeTime;
+    doc.hash = Hash64(doc.text);
+    bool same = doc.hash == file.lastHash;
+    const bool priming = file.prepare && !file.primed;
+    if (!same || !file.dependencies.empty() || priming)
+    {
+        IniIncludeCache::Shared().Parse(file.path, doc, m_links);
+        SetDependencies(file, doc.dependencies);
+        same = same && doc.dependencyHash == file.lastDependencyHash;
+    }
+    if (file.prepare && (!same || priming))
+    {
+        file.prepare(doc);
+        file.primed = true;
+    }
+    if (same)
+    {
+        file.unchanged.fetch_add(1, std::memory_order_relaxed);
+        file.lastLoadNs.store(std::chrono::nanoseconds(Clock::now() - start).count(), std::memory_order_relaxed);
+        return;
+    }
+
+    file.lastHash = doc.hash;
+    file.lastDependencyHash = doc.dependencyHash;
+    file.loads.fetch_add(1, std::memory_order_relaxed);
+    file.lastLoadNs.store(std::chrono::nanoseconds(Clock::now() - start).count(), std::memory_order_relaxed);
+    file.mailbox.Post(std::move(file.spare));
+
+    if (!file.queued.exchange(true, std::memory_order_acq_rel))
+    {
+        std::lock_guard<std::mutex> lock(m_readyMutex);
+        m_ready.push_back(index);
+        m_hasReady.store(true, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief 最終更新時刻をファイルごとの間隔で確認する検知ループ。
+ */
+void FileWatcher::RunPolling()
+{
+    m_backend = "polling";
+    m_watchedDirs.clear();
+    while (!m_stop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(kWakeIntervalMs),
+                            [this] { return m_stop.load() || m_reloadPending.load(); });
+        }
+        if (m_stop)
+            break;
+
+        const auto now = Clock::now();
+        for (auto& file : m_files)
+        {
+            if (now - file->lastPoll < std::chrono::milliseconds((std::max)(1, file->pollIntervalMs.load())))
+                continue;
+            file->lastPoll = now;
+            std::error_code ec;
+            auto t = std::filesystem::last_write_time(file->path, ec);
+            if (!ec && t != file->lastWriteTime)
+            {
+                file->lastWriteTime = t;
+                MarkDirty(*file);
+            }
+            // 取り込んでいるファイルは作成・削除も変更として扱う
+            for (Dependency& dep : file->dependencies)
+            {
+                t = std::filesystem::last_write_time(dep.path, ec);
+                if (ec)
+                    t = std::filesystem::file_time_type{};
+                if (t != dep.writeTime)
+                {
+                    dep.writeTime = t;
+                    MarkDirty(*file);
+                }
+            }
+        }
+        ServiceAll();
+    }
+}
+
+#if defined(_WIN32)
+
+/**
+ * @brief ReadDirectoryChangesW で親ディレクトリの変更を待つ検知ループ。
+ * @details ディレクトリごとに 1 つのハンドルと完了イベントを用意し、WaitForMultipleObjects でまとめて待つ。
+ *          待てるハンドル数 (MAXIMUM_WAIT_OBJECTS) を超える場合やディレクトリを開けない場合はポーリングへ任せる。
+ * @return 通知ループを実行した場合は true。
+ */
+bool FileWatcher::RunNative()
+{
+    /**
+     * @brief 1 ディレクトリ分の監視状態。
+     */
+    struct DirWatch
+    {
+        std::filesystem::path dir;            // 監視ディレクトリ
+        HANDLE handle = INVALID_HANDLE_VALUE; // ディレクトリハンドル
+        OVERLAPPED ov{};                      // 非同期読み取りの状態
+        bool pending = false;                 // 読み取り要求が未完了
+        alignas(DWORD) BYTE buf[8192];        // 通知の受け取り先
+    };
+
+    const std::vector<std::filesystem::path> dirs = Directories();
+    if (dirs.empty() || dirs.size() > MAXIMUM_WAIT_OBJECTS)
+        return false;
+    m_watchedDirs = dirs;
+
+    std::vector<std::unique_ptr<DirWatch>> watches;
+    std::vector<HANDLE> events;
+    auto closeAll = [&]() {
+        for (auto& w : watches)
+        {
+            if (w->pending)
+            {
+                DWORD bytes = 0;
+                CancelIoEx(w->handle, &w->ov);
+                GetOverlappedResult(w->handle, &w->ov, &bytes, TRUE);
+            }
+            if (w->ov.hEvent)
+                CloseHandle(w->ov.hEvent);
+            if (w->handle != INVALID_HANDLE_VALUE)
+                CloseHandle(w->handle);
+        }
+    };
+    for (const auto& dir : dirs)
+    {
+        auto w = std::make_unique<DirWatch>();
+        w->dir = dir;
+        w->handle = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        w->ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        const bool ok = w->handle != INVALID_HANDLE_VALUE && w->ov.hEvent;
+        events.push_back(w->ov.hEvent);
+        watches.push_back(std::move(w));
+        if (!ok)
+        {
+            closeAll();
+            return false;
+        }
+    }
+    m_backend = "ReadDirectoryChangesW";
+
+    const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+    bool failed = false;
+    while (!m_stop && !m_rewatch && !failed)
+    {
+        for (auto& w : watches)
+        {
+            if (w->pending)
+                continue;
+            ResetEvent(w->ov.hEvent);
+            if (!ReadDirectoryChangesW(w->handle, w->buf, sizeof(w->buf), FALSE, filter, nullptr, &w->ov, nullptr))
+            {
+                failed = true;
+                break;
+            }
+            w->pending = true;
+        }
+        if (failed)
+            break;
+
+        const DWORD result =
+            WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE, kWakeIntervalMs);
+        if (result < WAIT_OBJECT_0 + events.size())
+        {
+            // 最初に完了したもの以降も完了していれば同じ周回で処理する
+            for (size_t i = result - WAIT_OBJECT_0; i < watches.size(); ++i)
+            {
+                DirWatch& w = *watches[i];
+                if (WaitForSingleObject(w.ov.hEvent, 0) != WAIT_OBJECT_0)
+                    continue;
+                w.pending = false;
+                DWORD bytes = 0;
+                if (!GetOverlappedResult(w.handle, &w.ov, &bytes, FALSE))
+                    continue;
+                if (bytes == 0)
+                {
+                    // バッファ溢れ。どのファイルか分からないため読み直す
+                    MarkAllDirty(w.dir);
+                }
+                for (DWORD off = 0; bytes > 0;)
+                {
+                    auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(w.buf + off);
+                    Dispatch(w.dir, std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+                    if (info->NextEntryOffset == 0)
+                        break;
+                    off += info->NextEntryOffset;
+                }
+            }
+        }
+        ServiceAll();
+    }
+
+    closeAll();
+    if (failed && !m_stop)
+        return false;
+    return true;
+}
+
+#elif defined(__linux__)
+
+/**
+ * @brief inotify で親ディレクトリの変更を待つ検知ループ。
+ * @details エディタの一時ファイル経由の保存 (rename) も拾うため、ファイルではなくディレクトリを監視する。
+ *          1 つの inotify インスタンスにディレクトリごとの監視を登録し、監視記述子から対象ディレクトリを引く。
+ * @return 通知ループを実行した場合は true。
+ */
+bool FileWatcher::RunNative()
+{
+    const std::vector<std::filesystem::path> dirs = Directories();
+    if (dirs.empty())
+        return false;
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return false;
+    std::vector<std::pair<int, std::filesystem::path>> watches;
+    for (const auto& dir : dirs)
+    {
+        const int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY);
+        if (wd < 0)
+        {
+            close(fd);
+            return false;
+        }
+        watches.emplace_back(wd, dir);
+    }
+    m_backend = "inotify";
+    m_watchedDirs = dirs;
+
+    alignas(inotify_event) char buf[4096];
+    while (!m_stop && !m_rewatch)
+    {
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, kWakeIntervalMs) > 0 && (pfd.revents & POLLIN))
+        {
+            ssize_t len;
+            while ((len = read(fd, buf, sizeof(buf))) > 0)
+            {
+                for (char* p = buf; p < buf + len;)
+                {
+                    const auto* ev = reinterpret_cast<const inotify_event*>(p);
+                    if (ev->mask & IN_Q_OVERFLOW)
+                    {
+                        MarkAllDirty({});
+                    }
+                    else if (ev->len > 0)
+                    {
+                        for (const auto& [wd, dir] : watches)
+                        {
+                            if (wd == ev->wd)
+                                Dispatch(dir, ev->name);
+                        }
+                    }
+                    p += sizeof(inotify_event) + ev->len;
+                }
+            }
+        }
+        ServiceAll();
+    }
+    close(fd);
+    return true;
+}
+
+#else
+
+/**
+ * @brief OS の変更通知を利用できない環境ではポーリングへ任せる。
+ * @return 常に false。
+ */
+bool FileWatcher::RunNative()
+{
+    return false;
+}
+
+#endif
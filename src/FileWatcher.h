@@ -0,0 +1,281 @@
+#pragma once
+#include "IniInclude.h"
+#include "IniParser.h"
+#include "Mailbox.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @file FileWatcher.h
+ * @brief 設定ファイル群を 1 本の専用スレッドで監視し、解析済みの内容を受け渡すウォッチャーの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 監視スレッドでの読み込みの統計。
+ */
+struct FileWatchStats
+{
+    uint64_t loads = 0;      // 解析して受け渡した回数
+    uint64_t unchanged = 0;  // 内容が直前と同じだったため解析を省いた回数
+    double lastLoadMs = 0.0; // 直近の読み込み (ハッシュ計算・解析を含む) の所要時間 (ミリ秒)
+};
+
+/**
+ * @brief 複数の設定ファイルの変更を 1 本の専用スレッドで検知し、読み込み・解析まで済ませて受け渡すクラス。
+ * @details Linux では inotify、Windows では ReadDirectoryChangesW、それ以外ではタイムスタンプの
+ *          ポーリングで変更を検知する。OS の通知はファイルの親ディレクトリ単位で 1 つだけ登録し、
+ *          同じディレクトリのファイルは通知を共有する。描画スレッドは解析済みの IniDocument を受け取るだけで、
+ *          ファイル I/O を一切行わない。新しい内容が用意されたファイルは準備済みの一覧に載るため、
+ *          受け取り側は監視ファイル数によらず HasReady の 1 回の読み取りで変化の有無を確認できる。
+ *          変更通知はファイルごとのデバウンス時間だけ途切れるまで待ってから 1 回だけ読み込む。読み込んだ内容の
+ *          ハッシュが直前に受け渡した内容と同じ場合 (二重保存・touch・一時ファイル経由の置き換えなど) は
+ *          解析も受け渡しも行わない。
+ *          "@include" で取り込んでいるファイルも監視し、それらが変更された場合は取り込んでいる側を読み込み直す。
+ *          取り込むファイルの読み込み・解析は IniIncludeCache::Shared() で共有する。
+ */
+class FileWatcher
+{
+public:
+    static constexpr uint32_t kNoFile = 0xFFFFFFFFu; // 無効なファイル番号
+
+    /**
+     * @brief 解析済みの内容を受け渡す前に監視スレッドで手を加える処理 (Settings::Diff で差分を作るなど)。
+     */
+    using Prepare = std::function<void(IniDocument&)>;
+
+    FileWatcher() = default;
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /**
+     * @brief 監視スレッドを停止する。
+     */
+    ~FileWatcher();
+
+    /**
+     * @brief 監視するファイルを追加する。監視中なら監視スレッドを再起動して登録し直す。
+     * @param path 監視するファイルパス。
+     * @param knownHash 呼び出し側が取り込み済みの内容のハッシュ (同じ内容の読み込みを省く。不明なら 0)。
+     * @param dependencies 取り込み済みの内容が "@include" で取り込んでいるファイル (Settings::Dependencies)。
+     * @param dependencyHash それらの内容をまとめたハッシュ (Settings::DependencyHash)。
+     * @param prepare 受け渡す内容ごとに監視スレッドで呼ぶ処理 (不要なら空)。
+     * @return ファイル番号。
+     */
+    uint32_t Add(const std::wstring& path, uint64_t knownHash = 0, const std::vector<std::wstring>& dependencies = {},
+                 uint64_t dependencyHash = 0, Prepare prepare = {});
+
+    /**
+     * @brief 監視を開始する。
+     * @return スレッドを起動できた場合は true。
+     */
+    bool Start();
+
+    /**
+     * @brief 監視スレッドを停止して合流する。登録したファイルと状態は保持する。
+     */
+    void Stop();
+
+    /**
+     * @brief 監視しているファイル数を取得する。
+     * @return ファイル数。
+     */
+    uint32_t FileCount() const
+    {
+        return static_cast<uint32_t>(m_files.size());
+    }
+
+    /**
+     * @brief 変更の有無にかかわらず次の機会に読み込み直すよう要求する。内容が同じなら受け渡しは行わない。
+     * @param file ファイル番号。
+     */
+    void RequestReload(uint32_t file);
+
+    /**
+     * @brief ポーリング方式の確認間隔を変更する。
+     * @param file ファイル番号。
+     * @param ms 確認間隔 (ミリ秒)。
+     */
+    void SetPollInterval(uint32_t file, int ms);
+
+    /**
+     * @brief 連続した変更通知をまとめる待ち時間を変更する。
+     * @param file ファイル番号。
+     * @param ms 最後の通知からこの時間だけ通知が無ければ読み込む (ミリ秒)。
+     */
+    void SetDebounce(uint32_t file, int ms);
+
+    /**
+     * @brief 変更の検知を一時的に止める、または再開する。再開時は一度読み込んで内容を確認する。
+     * @param file ファイル番号。
+     * @param enabled 検知する場合は true。
+     */
+    void SetEnabled(uint32_t file, bool enabled);
+
+    /**
+     * @brief 読み込みの統計を取得する。
+     * @param file ファイル番号。
+     * @return 統計 (監視スレッドが更新中でも各値は個別に一貫している)。
+     */
+    FileWatchStats Stats(uint32_t file) const;
+
+    /**
+     * @brief 新しい内容が用意されたファイルがあるか判定する。
+     * @return あれば true (アトミック変数 1 回の読み取り)。
+     */
+    bool HasReady() const
+    {
+        return m_hasReady.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 新しい内容が用意されたファイルの番号を取り出す。
+     * @param out 番号の追記先 (事前にクリアされる。容量は再利用される)。
+     * @return 1 つ以上あれば true。
+     */
+    bool TakeReady(std::vector<uint32_t>& out);
+
+    /**
+     * @brief 監視スレッドが用意した最新の解析結果を取り出す。
+     * @param file ファイル番号。
+     * @return 新しい内容があればその所有権、無ければ nullptr。
+     */
+    std::unique_ptr<IniDocument> TakeSnapshot(uint32_t file)
+    {
+        return m_files[file]->mailbox.Take();
+    }
+
+    /**
+     * @brief 使用中の検知方式名を取得する。
+     * @return "inotify" / "ReadDirectoryChangesW" / "polling" のいずれか。
+     */
+    const char* Backend() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief "@include" で取り込んでいるファイル 1 つ分の監視状態。
+     */
+    struct Dependency
+    {
+        std::filesystem::path path;                  // 取り込んでいるファイル (絶対パス)
+        std::filesystem::path dir;                   // 親ディレクトリ
+        std::filesystem::file_time_type writeTime{}; // 最後に確認した最終更新時刻 (ポーリング用)
+    };
+
+    /**
+     * @brief 監視対象 1 ファイル分の状態。
+     */
+    struct File
+    {
+        std::filesystem::path path;               // 監視対象ファイル
+        std::filesystem::path dir;                // 親ディレクトリ
+        std::atomic<bool> reloadRequested{false}; // 強制再読み込み要求
+        std::atomic<bool> enabled{true};          // 変更を検知する
+        std::atomic<int> pollIntervalMs{500};     // ポーリング間隔 (ミリ秒)
+        std::atomic<int> debounceMs{30};          // 変更通知をまとめる待ち時間 (ミリ秒)
+        std::atomic<uint64_t> loads{0};           // 解析して受け渡した回数
+        std::atomic<uint64_t> unchanged{0};       // 内容が同じため解析を省いた回数
+        std::atomic<int64_t> lastLoadNs{0};       // 直近の読み込みの所要時間 (ナノ秒)
+        std::atomic<bool> queued{false};          // 準備済みの一覧に載っている
+        Mailbox<IniDocument> mailbox;             // 解析済み内容の受け渡し口
+
+        // 以下は監視スレッドのみが触れる (停止中は所有スレッド)
+        bool dirty = false;                              // 未処理の変更がある
+        Clock::time_point lastEvent{};                   // 最後に変更を受け取った時刻
+        Clock::time_point lastPoll{};                    // 最後に更新時刻を確認した時刻
+        std::filesystem::file_time_type lastWriteTime{}; // 最後に読み込んだ時点の最終更新時刻
+        uint64_t lastHash = 0;                           // 最後に受け渡した (または既知の) 内容のハッシュ
+        uint64_t lastDependencyHash = 0;                 // 同じく取り込んでいるファイルの内容をまとめたハッシュ
+        std::vector<Dependency> dependencies;            // 取り込んでいるファイル
+        std::unique_ptr<IniDocument> spare;              // 読み込み先 (受け渡さなかった場合は再利用する)
+        Prepare prepare;                                 // 受け渡す前に呼ぶ処理 (無ければ空)
+        bool primed = false;                             // prepare に取り込み済みの内容を一度渡した
+    };
+
+    /**
+     * @brief 監視スレッドの本体。プラットフォームに応じた検知ループへ振り分ける。
+     */
+    void Run();
+
+    /**
+     * @brief OS の変更通知を用いた検知ループ。利用できない場合は false を返す。
+     * @return 通知ループを実行した場合は true。
+     */
+    bool RunNative();
+
+    /**
+     * @brief 最終更新時刻のポーリングによる検知ループ。
+     */
+    void RunPolling();
+
+    /**
+     * @brief 変更を受け取ったことを記録する (読み込みは落ち着くまで遅延する)。
+     * @param file 対象ファイル。
+     */
+    void MarkDirty(File& file);
+
+    /**
+     * @brief ディレクトリ内のファイル名の変更通知を、該当する監視対象へ振り分ける。
+     * @param dir 通知を受けたディレクトリ。
+     * @param name 通知で得たファイル名。
+     */
+    void Dispatch(const std::filesystem::path& dir, const std::filesystem::path& name);
+
+    /**
+     * @brief 全ファイルに変更があったものとして扱う (通知の取りこぼし時)。
+     * @param dir 対象ディレクトリ (空ならすべて)。
+     */
+    void MarkAllDirty(const std::filesystem::path& dir);
+
+    /**
+     * @brief すべてのファイルの保留中の変更や再読み込み要求を処理する。
+     */
+    void ServiceAll();
+
+    /**
+     * @brief 1 ファイル分の保留中の変更を処理し、必要なら読み込んで受け渡す。
+     * @param index ファイル番号。
+     */
+    void Service(uint32_t index);
+
+    /**
+     * @brief 取り込んでいるファイルの一覧を更新する。未監視のディレクトリが増えた場合は通知の登録し直しを要求する。
+     * @param file 対象ファイル。
+     * @param dependencies 新しい一覧 (絶対パス)。
+     */
+    void SetDependencies(File& file, const std::vector<std::wstring>& dependencies);
+
+    /**
+     * @brief 監視対象と取り込んでいるファイルの親ディレクトリを重複なく列挙する。
+     * @return ディレクトリの一覧。
+     */
+    std::vector<std::filesystem::path> Directories() const;
+
+    std::vector<std::unique_ptr<File>> m_files;    // 監視対象 (番号順。追加のみ)
+    std::thread m_thread;                          // 監視スレッド
+    std::atomic<bool> m_stop{false};               // 停止要求
+    std::atomic<const char*> m_backend{"polling"}; // 使用中の検知方式
+    std::mutex m_wakeMutex;                        // m_wake 用ミューテックス
+    std::condition_variable m_wake;                // 停止・再読み込み要求でポーリング待機を起こす
+    std::atomic<bool> m_reloadPending{false};      // いずれかのファイルに再読み込み要求がある
+    std::atomic<bool> m_hasReady{false};           // 準備済みの一覧が空でない
+    std::mutex m_readyMutex;                       // m_ready 用ミューテックス
+    std::vector<uint32_t> m_ready;                 // 新しい内容が用意されたファイルの番号
+
+    // 以下は監視スレッドのみが触れる
+    std::vector<std::filesystem::path> m_watchedDirs; // OS の通知を登録しているディレクトリ
+    bool m_rewatch = false;                           // 通知の登録し直しが必要 (取り込むファイルのディレクトリが増えた)
+    IniLinks m_links;                                 // 参照指定の作業領域 (容量を再利用する)
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file FlatIndex.h
+ * @brief ハッシュ値から添字を引くオープンアドレス法の索引の宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief ハッシュ値から添字を引く、オープンアドレス法 (線形探索) の索引。
+ * @details キー本体は持たず、(ハッシュ値の下位 32bit, 添字) の 8 バイトだけを 1 本の配列に並べる。
+ *          照合は呼び出し側が添字からキーを取り出して行うため、キーはスロット表や文字列アリーナなど
+ *          別の連続領域に置いたままにできる。探索はハッシュ値が一致した要素でだけ照合関数を呼ぶ。
+ *          要素の削除は行わない (添字はスロット表と同じく追加のみ)。
+ */
+class FlatIndex
+{
+public:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu; // 未登録・空きを表す添字
+
+    /**
+     * @brief 添字を検索する。
+     * @tparam Eq bool(uint32_t index) の照合関数。
+     * @param hash 検索するキーのハッシュ値。
+     * @param eq 添字が指すキーが検索キーと等しいかを返す関数。
+     * @return 添字、見つからなければ kNone。
+     */
+    template <typename Eq>
+    uint32_t Find(uint64_t hash, Eq&& eq) const
+    {
+        if (m_buckets.empty())
+            return kNone;
+        const uint32_t tag = static_cast<uint32_t>(hash);
+        for (uint32_t i = tag & m_mask;; i = (i + 1) & m_mask)
+        {
+            const Bucket& b = m_buckets[i];
+            if (b.index == kNone)
+                return kNone;
+            if (b.tag == tag && eq(b.index))
+                return b.index;
+        }
+    }
+
+    /**
+     * @brief 添字を登録する。同じキーが未登録であることは呼び出し側が保証する。
+     * @param hash キーのハッシュ値。
+     * @param index 登録する添字。
+     */
+    void Insert(uint64_t hash, uint32_t index)
+    {
+        if ((m_size + 1) * 2 > m_buckets.size())
+            Rehash(m_buckets.empty() ? 16 : m_buckets.size() * 2);
+        Place(Bucket{static_cast<uint32_t>(hash), index});
+        ++m_size;
+    }
+
+    /**
+     * @brief 再配置なしで登録できる要素数を確保する。
+     * @param count 要素数。
+     */
+    void Reserve(size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity < count * 2)
+            capacity *= 2;
+        if (capacity > m_buckets.size())
+            Rehash(capacity);
+    }
+
+    /**
+     * @brief すべての要素を取り除く (容量は保持する)。
+     */
+    void Clear()
+    {
+        m_buckets.assign(m_buckets.size(), Bucket{0, kNone});
+        m_size = 0;
+    }
+
+    /**
+     * @brief 登録済みの要素数を取得する。
+     * @return 要素数。
+     */
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+    /**
+     * @brief 索引の 1 要素。
+     */
+    struct Bucket
+    {
+        uint32_t tag;   // ハッシュ値の下位 32bit (位置の算出と照合前の絞り込みに使う)
+        uint32_t index; // 添字 (空きなら kNone)
+    };
+
+    /**
+     * @brief 要素を空き位置へ置く。
+     * @param b 置く要素。
+     */
+    void Place(Bucket b)
+    {
+        uint32_t i = b.tag & m_mask;
+        while (m_buckets[i].index != kNone)
+            i = (i + 1) & m_mask;
+        m_buckets[i] = b;
+    }
+
+    /**
+     * @brief 容量を変えて全要素を置き直す。位置は tag から求まるため元のキーは要らない。
+     * @param capacity 新しい容量 (2 の冪)。
+     */
+    void Rehash(size_t capacity)
+    {
+        std::vector<Bucket> old(capacity, Bucket{0, kNone});
+        old.swap(m_buckets);
+        m_mask = static_cast<uint32_t>(capacity - 1);
+        for (const Bucket& b : old)
+        {
+            if (b.index != kNone)
+                Place(b);
+        }
+    }
+
+    std::vector<Bucket> m_buckets; // 負荷率 1/2 以下に保つ要素配列 (容量は 2 の冪)
+    uint32_t m_mask = 0;           // 容量 - 1
+    size_t m_size = 0;             // 登録済みの要素数
+};
@@ -0,0 +1,65 @@
+/**
+ * @file FramePacket.cpp
+ * @brief フレームパケットと ImGui 描画データの複製の実装。
+ * @author 山内陽
+ */
+
+#include "FramePacket.h"
+
+#include <cstring>
+
+/**
+ * @brief ImVector の内容を複製する。容量が足りていれば再確保しない。
+ * @tparam T 要素型。
+ * @param dst 複製先。
+ * @param src 複製元。
+ */
+template <typename T>
+static void CopyVector(ImVector<T>& dst, const ImVector<T>& src)
+{
+    // ImVector::operator= は一度解放してから確保し直すため、resize で容量を使い回す
+    dst.resize(src.Size);
+    if (src.Size > 0)
+        std::memcpy(dst.Data, src.Data, static_cast<size_t>(src.Size) * sizeof(T));
+}
+
+/**
+ * @brief 複製用の描画リストを破棄する。
+ */
+UiDrawSnapshot::~UiDrawSnapshot()
+{
+    for (ImDrawList* list : m_lists)
+        IM_DELETE(list);
+}
+
+/**
+ * @brief 描画データを複製する。描画に使うバッファとコマンドだけを写し、描画リスト構築用の内部状態は写さない。
+ * @param src ImGui::GetDrawData() の結果 (nullptr なら空にする)。
+ */
+void UiDrawSnapshot::Capture(const ImDrawData* src)
+{
+    m_data.Clear();
+    if (!src || !src->Valid)
+        return;
+
+    for (int i = static_cast<int>(m_lists.size()); i < src->CmdListsCount; ++i)
+        m_lists.push_back(IM_NEW(ImDrawList)(nullptr));
+    for (int i = 0; i < src->CmdListsCount; ++i)
+    {
+        const ImDrawList* from = src->CmdLists[i];
+        ImDrawList* to = m_lists[i];
+        CopyVector(to->CmdBuffer, from->CmdBuffer);
+        CopyVector(to->IdxBuffer, from->IdxBuffer);
+        CopyVector(to->VtxBuffer, from->VtxBuffer);
+        to->Flags = from->Flags;
+        m_data.CmdLists.push_back(to);
+    }
+    m_data.Valid = true;
+    m_data.CmdListsCount = src->CmdListsCount;
+    m_data.TotalIdxCount = src->TotalIdxCount;
+    m_data.TotalVtxCount = src->TotalVtxCount;
+    m_data.DisplayPos = src->DisplayPos;
+    m_data.DisplaySize = src->DisplaySize;
+    m_data.FramebufferScale = src->FramebufferScale;
+    m_data.OwnerViewport = src->OwnerViewport;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "RenderDevice.h"
+#include "imgui.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file FramePacket.h
+ * @brief 更新段が作り描画段が提出する 1 フレーム分の不変データの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief ImGui の描画データの複製。
+ * @details ImGui::Render が返す ImDrawData は次の NewFrame で書き換えられるため、描画段へ渡す前に頂点・インデックス・
+ *          コマンドを複製する。描画リストと各バッファはフレームをまたいで使い回すため、定常状態ではヒープ確保が起きない。
+ *          Data() が返す ImDrawData はそのままレンダラーのバックエンドへ渡せる。
+ */
+class UiDrawSnapshot
+{
+public:
+    UiDrawSnapshot() = default;
+    UiDrawSnapshot(const UiDrawSnapshot&) = delete;
+    UiDrawSnapshot& operator=(const UiDrawSnapshot&) = delete;
+
+    /**
+     * @brief 複製用の描画リストを破棄する。
+     */
+    ~UiDrawSnapshot();
+
+    /**
+     * @brief 描画データを複製する。
+     * @param src ImGui::GetDrawData() の結果 (nullptr なら空にする)。
+     */
+    void Capture(const ImDrawData* src);
+
+    /**
+     * @brief 複製した描画データを取得する。
+     * @return 描画データ。
+     */
+    ImDrawData* Data()
+    {
+        return &m_data;
+    }
+
+private:
+    std::vector<ImDrawList*> m_lists; // 複製先の描画リスト (確保済みのものを使い回す)
+    ImDrawData m_data;                // m_lists を指す描画データ
+};
+
+/**
+ * @brief 1 フレームの描画に必要なデータ一式。更新段が埋めて公開した後は、描画段が提出し終えるまで変更しない。
+ * @details パケットは FramePipeline が固定数を確保して使い回す。
+ */
+struct FramePacket
+{
+    uint64_t index = 0;                                // フレーム番号
+    uint32_t width = 0;                                // 描画先の幅 (ピクセル)
+    uint32_t height = 0;                               // 描画先の高さ (ピクセル)
+    bool vsync = true;                                 // 垂直同期を待って表示する
+    float clear[4]{};                                  // クリアカラー
+    FrameConstants constants{};                        // 三角形の定数バッファ
+    UiDrawSnapshot ui;                                 // ImGui の描画データ
+    std::chrono::steady_clock::time_point published{}; // 公開した時刻
+};
@@ -0,0 +1,169 @@
+/**
+ * @file FramePipeline.cpp
+ * @brief フレームパイプラインの実装。
+ * @author 山内陽
+ */
+
+#include "FramePipeline.h"
+
+/**
+ * @brief 時間をナノ秒へ変換する。
+ * @param d 時間。
+ * @return ナノ秒。
+ */
+static int64_t ToNs(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+/**
+ * @brief パケットをすべて空きキューへ積む。
+ */
+FramePipeline::FramePipeline()
+{
+    for (FramePacket& packet : m_packets)
+    {
+        FramePacket* p = &packet;
+        m_free.TryPush(std::move(p));
+    }
+}
+
+/**
+ * @brief 描画段を停止する。
+ */
+FramePipeline::~FramePipeline()
+{
+    Stop();
+}
+
+/**
+ * @brief 描画段のスレッドを起動する。既に動いていれば何もしない。
+ * @param submit パケットを提出する関数 (描画段のスレッドから呼ばれる)。
+ */
+void FramePipeline::Start(SubmitFunc submit)
+{
+    if (m_thread.joinable())
+        return;
+    m_submit = std::move(submit);
+    m_stop.store(false);
+    m_thread = std::thread([this] { Run(); });
+}
+
+/**
+ * @brief 提出待ちのパケットをすべて提出してから描画段を停止する。
+ */
+void FramePipeline::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+    m_stop.store(true);
+    Wake(m_readyWaiter);
+    m_thread.join();
+    m_submit = nullptr;
+}
+
+/**
+ * @brief 書き込み用の空きパケットを取得する (更新段専用)。
+ * @param timeout 最大待ち時間。
+ * @return パケット。待っても空きが無ければ nullptr。
+ */
+FramePacket* FramePipeline::Acquire(std::chrono::milliseconds timeout)
+{
+    FramePacket* packet = nullptr;
+    if (m_free.TryPop(packet))
+        return packet;
+
+    m_stalls.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::unique_lock<std::mutex> lock(m_freeWaiter.mutex);
+        m_freeWaiter.sleepers.fetch_add(1);
+        // sleepers の増加を、空きキューの確認より前に描画段から見えるようにする (Wake 側のフェンスと対)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_freeWaiter.cv.wait_for(lock, timeout, [this] { return m_free.SizeApprox() > 0; });
+        m_freeWaiter.sleepers.fetch_sub(1);
+    }
+    if (m_free.TryPop(packet))
+        return packet;
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+/**
+ * @brief 書き終えたパケットを描画段へ渡す (更新段専用)。
+ * @param packet Acquire で取得したパケット。
+ */
+void FramePipeline::Publish(FramePacket* packet)
+{
+    packet->published = std::chrono::steady_clock::now();
+    // パケットは kPackets 個しか無いため、提出待ちが満杯になることは無い
+    m_ready.TryPush(std::move(packet));
+    m_published.fetch_add(1, std::memory_order_relaxed);
+    Wake(m_readyWaiter);
+}
+
+/**
+ * @brief 統計を取得する。
+ * @return 統計。
+ */
+FramePipelineStats FramePipeline::Stats() const
+{
+    FramePipelineStats s;
+    s.published = m_published.load(std::memory_order_relaxed);
+    s.submitted = m_submitted.load(std::memory_order_relaxed);
+    s.stalls = m_stalls.load(std::memory_order_relaxed);
+    s.dropped = m_dropped.load(std::memory_order_relaxed);
+    s.submitMs = static_cast<double>(m_submitNs.load(std::memory_order_relaxed)) / 1e6;
+    s.latencyMs = static_cast<double>(m_latencyNs.load(std::memory_order_relaxed)) / 1e6;
+    return s;
+}
+
+/**
+ * @brief 描画段のスレッド本体。提出待ちを順に提出して空きへ戻し、停止要求後は残りを提出し切ってから抜ける。
+ */
+void FramePipeline::Run()
+{
+    for (;;)
+    {
+        FramePacket* packet = nullptr;
+        if (m_ready.TryPop(packet))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            m_latencyNs.store(ToNs(start - packet->published), std::memory_order_relaxed);
+            m_submit(*packet);
+            m_submitNs.store(ToNs(std::chrono::steady_clock::now() - start), std::memory_order_relaxed);
+            m_submitted.fetch_add(1, std::memory_order_relaxed);
+            m_free.TryPush(std::move(packet));
+            Wake(m_freeWaiter);
+            continue;
+        }
+        if (m_stop.load())
+        {
+            // 停止要求より前に公開されたパケットが残っていないことを確かめてから抜ける
+            if (m_ready.SizeApprox() == 0)
+                break;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_readyWaiter.mutex);
+        m_readyWaiter.sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_readyWaiter.cv.wait(lock, [this] { return m_ready.SizeApprox() > 0 || m_stop.load(); });
+        m_readyWaiter.sleepers.fetch_sub(1);
+    }
+}
+
+/**
+ * @brief 待機点で眠っている相手を起こす。眠っている相手がいなければミューテックスにも触れない。
+ * @details 起こす側は「キューへ書く → フェンス → sleepers を読む」、眠る側は「sleepers を増やす → フェンス →
+ *          キューを読む」の順に操作するため、少なくとも一方が他方の書き込みを必ず観測し、通知の取りこぼしが起きない。
+ * @param waiter 待機点。
+ */
+void FramePipeline::Wake(Waiter& waiter)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter.sleepers.load(std::memory_order_relaxed) == 0)
+        return;
+    // 相手が述語を確かめてから cv で眠るまでの間に通知しないよう、ミューテックスを経由する
+    std::lock_guard<std::mutex> lock(waiter.mutex);
+    waiter.cv.notify_one();
+}
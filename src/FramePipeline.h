@@ -0,0 +1,139 @@
+#pragma once
+#include "FramePacket.h"
+#include "SpscQueue.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @file FramePipeline.h
+ * @brief 更新段と描画段を別スレッドで並行させるフレームパイプラインの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief パイプラインの統計。
+ */
+struct FramePipelineStats
+{
+    uint64_t published = 0; // 公開したフレーム数
+    uint64_t submitted = 0; // 提出したフレーム数
+    uint64_t stalls = 0;    // 空きパケットが無く更新段が待った回数
+    uint64_t dropped = 0;   // 待っても空きが無く、フレームを作らなかった回数
+    double submitMs = 0.0;  // 直近の提出の所要時間 (ミリ秒)
+    double latencyMs = 0.0; // 直近のフレームの公開から提出開始までの時間 (ミリ秒)
+};
+
+/**
+ * @brief 更新段 (呼び出し側スレッド) が作ったフレームパケットを、描画段 (専用スレッド) が順に提出するパイプライン。
+ * @details 2 段は提出待ちと空きの 2 本の SpscQueue でつながり、パケットはその間を行き来して使い回される。
+ *          更新段が N+1 フレーム目を作る間に描画段が N フレーム目を提出するため、両者の CPU 時間が重なる。
+ *          提出待ちは kDepth 個までで、描画段が追いつかなければ Acquire が空きを待つ (背圧)。
+ *          データの受け渡しはロックフリーで、ミューテックスは相手が眠っている場合に起こすためだけに使う。
+ *          提出処理は関数として渡すため、本体はレンダラーにもプラットフォームにも依存しない。
+ */
+class FramePipeline
+{
+public:
+    using SubmitFunc = std::function<void(FramePacket&)>;
+
+    static constexpr size_t kDepth = 2; // 提出待ちにできるパケット数
+
+    /**
+     * @brief パケットをすべて空きキューへ積む。
+     */
+    FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    /**
+     * @brief 描画段を停止する。
+     */
+    ~FramePipeline();
+
+    /**
+     * @brief 描画段のスレッドを起動する。
+     * @param submit パケットを提出する関数 (描画段のスレッドから呼ばれる)。
+     */
+    void Start(SubmitFunc submit);
+
+    /**
+     * @brief 提出待ちのパケットをすべて提出してから描画段を停止する。
+     */
+    void Stop();
+
+    /**
+     * @brief 描画段が動いているか判定する。
+     * @return 動いていれば true。
+     */
+    bool Running() const
+    {
+        return m_thread.joinable();
+    }
+
+    /**
+     * @brief 書き込み用の空きパケットを取得する (更新段専用)。
+     * @details 空きが無ければ描画段が提出し終えるまで最大 timeout だけ待つ。取得したパケットは必ず Publish すること。
+     * @param timeout 最大待ち時間。
+     * @return パケット。待っても空きが無ければ nullptr。
+     */
+    FramePacket* Acquire(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief 書き終えたパケットを描画段へ渡す (更新段専用)。
+     * @param packet Acquire で取得したパケット。
+     */
+    void Publish(FramePacket* packet);
+
+    /**
+     * @brief 統計を取得する。
+     * @return 統計。
+     */
+    FramePipelineStats Stats() const;
+
+private:
+    /**
+     * @brief 相手のスレッドが眠っている場合だけ起こすための待機点。
+     */
+    struct Waiter
+    {
+        std::mutex mutex;             // cv 用ミューテックス
+        std::condition_variable cv;   // 起床通知
+        std::atomic<int> sleepers{0}; // 眠っている (眠ろうとしている) スレッド数
+    };
+
+    /**
+     * @brief 描画段のスレッド本体。
+     */
+    void Run();
+
+    /**
+     * @brief 待機点で眠っている相手を起こす。
+     * @param waiter 待機点。
+     */
+    static void Wake(Waiter& waiter);
+
+    static constexpr size_t kPackets = kDepth + 1; // 確保するパケット数 (更新中の 1 個を含む)
+
+    std::array<FramePacket, kPackets> m_packets; // パケット本体
+    SpscQueue<FramePacket*, 4> m_ready;          // 提出待ち (更新段 → 描画段)
+    SpscQueue<FramePacket*, 4> m_free;           // 空き (描画段 → 更新段)
+    Waiter m_readyWaiter;                        // 描画段が提出待ちを待つ
+    Waiter m_freeWaiter;                         // 更新段が空きを待つ
+    SubmitFunc m_submit;                         // 提出処理
+    std::thread m_thread;                        // 描画段のスレッド
+    std::atomic<bool> m_stop{false};             // 停止要求
+    std::atomic<uint64_t> m_published{0};        // 公開したフレーム数
+    std::atomic<uint64_t> m_submitted{0};        // 提出したフレーム数
+    std::atomic<uint64_t> m_stalls{0};           // 空きを待った回数
+    std::atomic<uint64_t> m_dropped{0};          // 空きが無くフレームを作らなかった回数
+    std::atomic<int64_t> m_submitNs{0};          // 直近の提出の所要時間
+    std::atomic<int64_t> m_latencyNs{0};         // 直近の公開から提出開始までの時間
+};
@@ -0,0 +1,333 @@
+/**
+ * @file FrameScheduler.cpp
+ * @brief フレームスケジューラーと実時間の時計の実装。
+ * @author 山内陽
+ */
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002 // 古い SDK 向け (Windows 10 1803 で追加)
+#endif
+#endif
+
+/**
+ * @brief 時間をミリ秒へ変換する。
+ * @param d 時間。
+ * @return ミリ秒。
+ */
+static float ToMs(FrameClock::Duration d)
+{
+    return static_cast<float>(std::chrono::duration<double, std::milli>(d).count());
+}
+
+#if defined(_WIN32)
+
+/**
+ * @brief 待機可能タイマーを作成する。高分解能タイマーが使えない環境 (Windows 10 1803 より前) では通常のタイマーにする。
+ */
+SystemFrameClock::SystemFrameClock()
+{
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    m_highResolution = m_timer != nullptr;
+    if (!m_timer)
+    {
+        // 通常のタイマーはシステムのタイマー分解能 (既定 15.6ms) 単位でしか起きないため、スピンを長く取る
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+        m_spin = std::chrono::milliseconds(2);
+    }
+}
+
+/**
+ * @brief 待機可能タイマーを破棄する。
+ */
+SystemFrameClock::~SystemFrameClock()
+{
+    if (m_timer)
+        CloseHandle(m_timer);
+}
+
+/**
+ * @brief 期限まで待つ。スピン閾値より前はタイマーとメッセージを同時に待ち、残りはスピンで待つ。
+ * @param deadline 待機の期限。
+ * @return 期限に達した場合は true、メッセージで起こされた場合は false。
+ */
+bool SystemFrameClock::WaitUntil(TimePoint deadline)
+{
+    for (;;)
+    {
+        const TimePoint now = Now();
+        if (now >= deadline)
+            return true;
+        const Duration left = deadline - now;
+        if (m_timer && left > m_spin)
+        {
+            // 相対時間は負の 100ns 単位で指定する
+            LARGE_INTEGER due{};
+            due.QuadPart = -static_cast<LONGLONG>((left - m_spin).count() / 100);
+            if (due.QuadPart < 0 && SetWaitableTimerEx(m_timer, &due, 0, nullptr, nullptr, nullptr, 0))
+            {
+                HANDLE timer = m_timer;
+                const DWORD r = MsgWaitForMultipleObjectsEx(1, &timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+                if (r != WAIT_OBJECT_0)
+                {
+                    CancelWaitableTimer(m_timer);
+                    return false;
+                }
+                continue;
+            }
+        }
+        if (HIWORD(GetQueueStatus(QS_ALLINPUT)) != 0)
+            return false;
+        std::this_thread::yield();
+    }
+}
+
+#else
+
+SystemFrameClock::SystemFrameClock() = default;
+
+SystemFrameClock::~SystemFrameClock() = default;
+
+/**
+ * @brief 期限まで待つ。スピン閾値より前はスレッドを眠らせ、残りはスピンで待つ。
+ * @param deadline 待機の期限。
+ * @return 常に true (起こすイベントが無いため)。
+ */
+bool SystemFrameClock::WaitUntil(TimePoint deadline)
+{
+    const TimePoint now = Now();
+    if (deadline - now > m_spin)
+        std::this_thread::sleep_for(deadline - now - m_spin);
+    while (Now() < deadline)
+        std::this_thread::yield();
+    return true;
+}
+
+#endif
+
+/**
+ * @brief 現在時刻を取得する。
+ * @return std::chrono::steady_clock の現在時刻。
+ */
+FrameClock::TimePoint SystemFrameClock::Now()
+{
+    return std::chrono::time_point_cast<Duration>(std::chrono::steady_clock::now());
+}
+
+/**
+ * @brief 時計を指定して構築する。
+ * @param clock 時刻の取得と待機に使う時計。
+ */
+FrameScheduler::FrameScheduler(FrameClock& clock) : m_clock(clock)
+{
+}
+
+/**
+ * @brief 描く契機を設定する。OnDemand へ切り替えた直後は 1 フレーム描く。
+ * @param mode 新しい契機。
+ */
+void FrameScheduler::SetMode(FrameMode mode)
+{
+    if (mode == m_mode)
+        return;
+    m_mode = mode;
+    m_pending = mode == FrameMode::OnDemand ? 1u : 0u;
+    m_idleUntil = TimePoint{};
+}
+
+/**
+ * @brief 目標フレームレートを設定する。
+ * @param fps 1 秒あたりのフレーム数の上限 (0 以下なら上限なし)。
+ */
+void FrameScheduler::SetTargetFps(double fps)
+{
+    m_period = PeriodOf(fps);
+}
+
+/**
+ * @brief 最小化中・隠れている間のフレームレートを設定する。
+ * @param fps 1 秒あたりのフレーム数 (0 以下なら絞らない)。
+ */
+void FrameScheduler::SetBackgroundFps(double fps)
+{
+    m_backgroundPeriod = PeriodOf(fps);
+}
+
+/**
+ * @brief OnDemand で描く必要が無い間に起きる間隔を設定する。
+ * @param interval 起床間隔。
+ */
+void FrameScheduler::SetIdleWakeInterval(Duration interval)
+{
+    m_idleWake = interval;
+    m_idleUntil = TimePoint{};
+}
+
+/**
+ * @brief ウィンドウが最小化されているかを設定する。
+ * @param minimized 最小化中なら true。
+ */
+void FrameScheduler::SetMinimized(bool minimized)
+{
+    m_minimized = minimized;
+}
+
+/**
+ * @brief ウィンドウが他のウィンドウに完全に隠れているかを設定する。
+ * @param occluded 隠れていれば true。
+ */
+void FrameScheduler::SetOccluded(bool occluded)
+{
+    m_occluded = occluded;
+}
+
+/**
+ * @brief OnDemand で描くフレームを要求する。
+ * @param frames 続けて描くフレーム数。
+ */
+void FrameScheduler::Invalidate(uint32_t frames)
+{
+    if (m_mode == FrameMode::OnDemand)
+        m_pending = (std::max)(m_pending, frames);
+}
+
+/**
+ * @brief 次のフレームを描く時刻まで待つ。
+ * @return 描くべきなら true。待機がイベントで中断された、または OnDemand で描かないまま起床間隔が過ぎた場合は false。
+ */
+bool FrameScheduler::WaitForFrame()
+{
+    const TimePoint now = m_clock.Now();
+    if (m_mode == FrameMode::OnDemand && m_pending == 0)
+    {
+        // 描く必要が無い間は起床間隔ごとに呼び出し側へ戻り、設定の変化などを確かめさせる
+        if (m_idleUntil <= now)
+            m_idleUntil = now + m_idleWake;
+        if (!m_clock.WaitUntil(m_idleUntil))
+            return false;
+        m_idleUntil = TimePoint{};
+        ++m_idleWakes;
+        return false;
+    }
+
+    const Duration interval = Interval();
+    const TimePoint deadline = m_scheduled + interval;
+    if (interval.count() > 0 && now < deadline && !m_clock.WaitUntil(deadline))
+        return false;
+    return true;
+}
+
+/**
+ * @brief フレームの開始を記録し、次のフレームの予定時刻を決める。
+ * @details 予定時刻からの遅れが 1 周期未満なら予定時刻を基準に次の予定を決め、誤差を蓄積させない。
+ *          それ以上遅れた (またはアイドルから復帰した) 場合は、まとめて描いて取り戻すことはせず現在時刻から数え直す。
+ */
+void FrameScheduler::BeginFrame()
+{
+    const TimePoint now = m_clock.Now();
+    const Duration interval = Interval();
+    const TimePoint deadline = m_scheduled + interval;
+
+    FrameTiming& t = m_history[m_cursor];
+    t = FrameTiming{};
+    const Duration actual = now - m_frameStart;
+    if (m_frames > 0)
+    {
+        t.waitMs = ToMs(now - m_frameEnd);
+        t.intervalMs = ToMs(actual);
+    }
+    if (interval.count() > 0 && now - deadline < interval)
+    {
+        t.jitterMs = ToMs(now >= deadline ? now - deadline : deadline - now);
+        m_scheduled = deadline;
+    }
+    else
+    {
+        // 予定の無い連続描画では、間隔の変動をジッターとする
+        if (interval.count() == 0 && m_mode == FrameMode::Continuous && m_frames > 1)
+            t.jitterMs = ToMs(actual >= m_lastInterval ? actual - m_lastInterval : m_lastInterval - actual);
+        m_scheduled = now;
+    }
+
+    m_lastInterval = actual;
+    m_frameStart = now;
+    if (m_pending > 0)
+        --m_pending;
+    ++m_frames;
+}
+
+/**
+ * @brief フレームの終了を記録する。
+ */
+void FrameScheduler::EndFrame()
+{
+    m_frameEnd = m_clock.Now();
+    m_history[m_cursor].cpuMs = ToMs(m_frameEnd - m_frameStart);
+    m_cursor = (m_cursor + 1) % kHistory;
+    m_count = (std::min)(m_count + 1, kHistory);
+}
+
+/**
+ * @brief 直近のフレームの計測値を集計する。
+ * @return 集計結果。
+ */
+FrameStats FrameScheduler::Stats() const
+{
+    FrameStats s;
+    s.frames = m_frames;
+    s.idleWakes = m_idleWakes;
+    if (m_count == 0)
+        return s;
+
+    double cpu = 0.0, wait = 0.0, jitter = 0.0, interval = 0.0;
+    size_t intervals = 0;
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const FrameTiming& t = Timing(i);
+        cpu += t.cpuMs;
+        wait += t.waitMs;
+        jitter += t.jitterMs;
+        s.maxJitterMs = (std::max)(s.maxJitterMs, t.jitterMs);
+        if (t.intervalMs > 0.0f)
+        {
+            interval += t.intervalMs;
+            ++intervals;
+        }
+    }
+    const double n = static_cast<double>(m_count);
+    s.cpuMs = static_cast<float>(cpu / n);
+    s.waitMs = static_cast<float>(wait / n);
+    s.jitterMs = static_cast<float>(jitter / n);
+    s.fps = interval > 0.0 ? static_cast<float>(1000.0 * static_cast<double>(intervals) / interval) : 0.0f;
+    return s;
+}
+
+/**
+ * @brief 現在の状態でのフレームの周期を求める。絞っている間は目標フレームレートより長い方を使う。
+ * @return 周期 (0 なら待たない)。
+ */
+FrameScheduler::Duration FrameScheduler::Interval() const
+{
+    if (Throttled() && m_backgroundPeriod.count() > 0)
+        return (std::max)(m_period, m_backgroundPeriod);
+    return m_period;
+}
+
+/**
+ * @brief 1 秒あたりのフレーム数を周期へ変換する。
+ * @param fps 1 秒あたりのフレーム数。
+ * @return 周期 (fps が 0 以下なら 0)。
+ */
+FrameScheduler::Duration FrameScheduler::PeriodOf(double fps)
+{
+    if (!(fps > 0.0))
+        return Duration{0};
+    return Duration{static_cast<Duration::rep>(std::llround(1e9 / fps))};
+}
@@ -0,0 +1,285 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @file FrameScheduler.h
+ * @brief フレームの描画時刻を決めて待機するフレームスケジューラーの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief フレームスケジューラーが用いる時計と待機の抽象。
+ * @details スケジューラー本体は時刻の取得と待機をすべてこのインターフェース経由で行うため、
+ *          実時間を進める偽の時計へ差し替えれば、どの環境でもペーシングの精度を決定的に検証できる。
+ */
+class FrameClock
+{
+public:
+    using Duration = std::chrono::nanoseconds;
+    using TimePoint = std::chrono::time_point<std::chrono::steady_clock, Duration>;
+
+    virtual ~FrameClock() = default;
+
+    /**
+     * @brief 現在時刻を取得する。
+     * @return 単調増加する現在時刻。
+     */
+    virtual TimePoint Now() = 0;
+
+    /**
+     * @brief 期限まで待つ。期限前にイベント (ウィンドウメッセージなど) が届いた場合は早く戻ってよい。
+     * @param deadline 待機の期限。
+     * @return 期限に達した場合は true、イベントで起こされた場合は false。
+     */
+    virtual bool WaitUntil(TimePoint deadline) = 0;
+};
+
+/**
+ * @brief 実時間の時計。
+ * @details Windows では高分解能の待機可能タイマー (CREATE_WAITABLE_TIMER_HIGH_RESOLUTION。使えなければ通常の
+ *          待機可能タイマー) と MsgWaitForMultipleObjectsEx で待ち、ウィンドウメッセージが届けば直ちに戻る。
+ *          それ以外の環境ではスレッドを眠らせる。いずれもタイマーの誤差を吸収するため、期限直前の
+ *          スピン閾値の間だけは譲りながら回って待つ。
+ */
+class SystemFrameClock : public FrameClock
+{
+public:
+    SystemFrameClock();
+    ~SystemFrameClock() override;
+    SystemFrameClock(const SystemFrameClock&) = delete;
+    SystemFrameClock& operator=(const SystemFrameClock&) = delete;
+
+    /**
+     * @brief 現在時刻を取得する。
+     * @return std::chrono::steady_clock の現在時刻。
+     */
+    TimePoint Now() override;
+
+    /**
+     * @brief 期限まで待つ。Windows ではメッセージが届けば早く戻る。
+     * @param deadline 待機の期限。
+     * @return 期限に達した場合は true、メッセージで起こされた場合は false。
+     */
+    bool WaitUntil(TimePoint deadline) override;
+
+    /**
+     * @brief 期限直前にタイマーを使わずスピンで待つ時間を設定する。
+     * @param threshold スピンする時間 (長いほど正確だが CPU を使う)。
+     */
+    void SetSpinThreshold(Duration threshold)
+    {
+        m_spin = threshold;
+    }
+
+    /**
+     * @brief 高分解能タイマーを利用しているか判定する。
+     * @return 利用している場合は true。
+     */
+    bool HighResolution() const
+    {
+        return m_highResolution;
+    }
+
+private:
+    void* m_timer = nullptr;                          // 待機可能タイマー (Windows のみ)
+    bool m_highResolution = false;                    // m_timer が高分解能タイマー
+    Duration m_spin = std::chrono::microseconds(200); // 期限直前にスピンで待つ時間
+};
+
+/**
+ * @brief フレームを描く契機。
+ */
+enum class FrameMode : uint8_t
+{
+    Continuous, // 毎フレーム描く (目標フレームレートが 0 なら待たない)
+    OnDemand,   // Invalidate されたときだけ描く
+};
+
+/**
+ * @brief 1 フレーム分の計測値。
+ */
+struct FrameTiming
+{
+    float cpuMs = 0.0f;      // BeginFrame から EndFrame までの時間
+    float waitMs = 0.0f;     // 直前の EndFrame から BeginFrame までの時間 (待機とメッセージ処理)
+    float intervalMs = 0.0f; // 直前のフレームの開始からの間隔
+    float jitterMs = 0.0f;   // 予定した開始時刻からのずれ (予定が無いフレームは間隔の変動)
+};
+
+/**
+ * @brief 直近のフレームの計測値の集計。
+ */
+struct FrameStats
+{
+    uint64_t frames = 0;      // 描いたフレーム数の累計
+    uint64_t idleWakes = 0;   // OnDemand で描かずに起きた回数の累計
+    float fps = 0.0f;         // 直近のフレームレート
+    float cpuMs = 0.0f;       // 直近の平均 CPU 時間
+    float waitMs = 0.0f;      // 直近の平均待機時間
+    float jitterMs = 0.0f;    // 直近の平均ジッター
+    float maxJitterMs = 0.0f; // 直近の最大ジッター
+};
+
+/**
+ * @brief フレームの描画時刻を決め、それまで待つクラス。メッセージループから使う。
+ * @details 使い方は WaitForFrame が true を返したら BeginFrame・描画・EndFrame を行い、false ならメッセージを
+ *          処理してから再び WaitForFrame を呼ぶ。描画時刻は次の規則で決める。
+ *          - 目標フレームレートがあれば、前のフレームの予定時刻に周期を足した時刻まで待つ。予定時刻を基準に
+ *            するため誤差は蓄積しない。1 周期以上遅れた場合は遅れを取り戻そうとせず、現在時刻から数え直す。
+ *          - 最小化中・他のウィンドウに隠れている間は、バックグラウンドのフレームレートまで落とす。
+ *          - FrameMode::OnDemand では Invalidate されるまで描かず、アイドル時の起床間隔ごとに false を返して
+ *            呼び出し側に設定の変化などを確かめる機会を与える。
+ *          時刻の取得と待機は FrameClock 経由で行うため、本体はプラットフォームに依存しない。
+ *          描画スレッド専用 (スレッドセーフではない)。
+ */
+class FrameScheduler
+{
+public:
+    using Duration = FrameClock::Duration;
+    using TimePoint = FrameClock::TimePoint;
+
+    static constexpr size_t kHistory = 128; // 計測値を保持するフレーム数
+
+    /**
+     * @brief 時計を指定して構築する。
+     * @param clock 時刻の取得と待機に使う時計 (スケジューラーより長く生存すること)。
+     */
+    explicit FrameScheduler(FrameClock& clock);
+
+    /**
+     * @brief 描く契機を設定する。
+     * @param mode 新しい契機。
+     */
+    void SetMode(FrameMode mode);
+
+    /**
+     * @brief 描く契機を取得する。
+     * @return 現在の契機。
+     */
+    FrameMode Mode() const
+    {
+        return m_mode;
+    }
+
+    /**
+     * @brief 目標フレームレートを設定する。
+     * @param fps 1 秒あたりのフレーム数の上限 (0 以下なら上限なし)。
+     */
+    void SetTargetFps(double fps);
+
+    /**
+     * @brief 最小化中・隠れている間のフレームレートを設定する。
+     * @param fps 1 秒あたりのフレーム数 (0 以下なら絞らない)。
+     */
+    void SetBackgroundFps(double fps);
+
+    /**
+     * @brief OnDemand で描く必要が無い間に起きる間隔を設定する。
+     * @param interval 起床間隔。
+     */
+    void SetIdleWakeInterval(Duration interval);
+
+    /**
+     * @brief ウィンドウが最小化されているかを設定する。
+     * @param minimized 最小化中なら true。
+     */
+    void SetMinimized(bool minimized);
+
+    /**
+     * @brief ウィンドウが他のウィンドウに完全に隠れているかを設定する (Present の結果から判定する)。
+     * @param occluded 隠れていれば true。
+     */
+    void SetOccluded(bool occluded);
+
+    /**
+     * @brief 最小化中・隠れているためフレームレートを絞っているか判定する。
+     * @return 絞っている場合は true。
+     */
+    bool Throttled() const
+    {
+        return m_minimized || m_occluded;
+    }
+
+    /**
+     * @brief OnDemand で描くフレームを要求する。Continuous では何もしない。
+     * @param frames 続けて描くフレーム数 (既に要求済みの数より多い場合だけ増やす)。
+     */
+    void Invalidate(uint32_t frames = 1);
+
+    /**
+     * @brief 次のフレームを描く時刻まで待つ。
+     * @return 描くべきなら true。待機がイベントで中断された、または OnDemand で描く必要が無いまま
+     *         起床間隔が過ぎた場合は false。
+     */
+    bool WaitForFrame();
+
+    /**
+     * @brief フレームの開始を記録し、次のフレームの予定時刻を決める。
+     */
+    void BeginFrame();
+
+    /**
+     * @brief フレームの終了を記録する。
+     */
+    void EndFrame();
+
+    /**
+     * @brief 直近のフレームの計測値を集計する。
+     * @return 集計結果。
+     */
+    FrameStats Stats() const;
+
+    /**
+     * @brief 直近のフレームの計測値を取得する。
+     * @param age 何フレーム前か (0 が最新。保持しているフレーム数未満であること)。
+     * @return 計測値。
+     */
+    const FrameTiming& Timing(size_t age) const
+    {
+        return m_history[(m_cursor + kHistory - 1 - age) % kHistory];
+    }
+
+    /**
+     * @brief 保持している計測値のフレーム数を取得する。
+     * @return フレーム数 (kHistory 以下)。
+     */
+    size_t TimingCount() const
+    {
+        return m_count;
+    }
+
+private:
+    /**
+     * @brief 現在の状態でのフレームの周期を求める。
+     * @return 周期 (0 なら待たない)。
+     */
+    Duration Interval() const;
+
+    /**
+     * @brief 1 秒あたりのフレーム数を周期へ変換する。
+     * @param fps 1 秒あたりのフレーム数。
+     * @return 周期 (fps が 0 以下なら 0)。
+     */
+    static Duration PeriodOf(double fps);
+
+    FrameClock& m_clock;                                 // 時刻の取得と待機
+    FrameMode m_mode = FrameMode::Continuous;            // 描く契機
+    Duration m_period{0};                                // 目標フレームレートの周期 (0 なら上限なし)
+    Duration m_backgroundPeriod{0};                      // 絞っている間の周期
+    Duration m_idleWake = std::chrono::milliseconds(50); // OnDemand で描かない間の起床間隔
+    bool m_minimized = false;                            // 最小化中
+    bool m_occluded = false;                             // 他のウィンドウに隠れている
+    uint32_t m_pending = 0;                              // OnDemand で描くべき残りフレーム数
+    TimePoint m_scheduled{};                             // 直前のフレームの予定開始時刻
+    TimePoint m_frameStart{};                            // 直前のフレームの実際の開始時刻
+    TimePoint m_frameEnd{};                              // 直前のフレームの終了時刻
+    TimePoint m_idleUntil{};                             // OnDemand で次に起きる時刻
+    Duration m_lastInterval{0};                          // 直前のフレームの間隔
+    std::array<FrameTiming, kHistory> m_history{};       // 直近の計測値 (リングバッファ)
+    size_t m_cursor = 0;                                 // 次に書き込む位置
+    size_t m_count = 0;                                  // 保持している計測値の数
+    uint64_t m_frames = 0;                               // 描いたフレーム数の累計
+    uint64_t m_idleWakes = 0;                            // 描かずに起きた回数の累計
+};
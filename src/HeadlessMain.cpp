@@ -0,0 +1,225 @@
+/**
+ * @file HeadlessMain.cpp
+ * @brief ウィンドウを作らずに DxApp のフレームループを回すコンソール版のエントリーポイント。
+ * @author 山内陽
+ */
+
+#include "DxApp.h"
+#include "ImageFile.h"
+#include "IniParser.h"
+#include "RecordingRenderDevice.h"
+#include "SoftwareRenderDevice.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief ヘッドレス実行の指定。
+ */
+struct HeadlessOptions
+{
+    uint64_t frames = 600;  // 描くフレーム数
+    uint32_t width = 1280;  // 描画先の幅
+    uint32_t height = 720;  // 描画先の高さ
+    bool software = false;  // ソフトウェアラスタライザーで描く (false なら記録だけ)
+    uint32_t threads = 0;   // ラスタライズのスレッド数 (0 ならハードウェアのスレッド数)
+    float fixedStep = 0.0f; // 固定の時間刻み (秒、0 なら実時間)
+    uint32_t tolerance = 1; // 画像比較でチャンネルごとに許す差
+    std::string output;     // 最後のフレームを保存する PPM (空なら保存しない)
+    std::string golden;     // 最後のフレームと比べる PPM (空なら比べない)
+    std::string replay;     // 再生する編集ログ (空なら再生しない)
+    std::string overrides;  // "--Category.Key=value" をまとめた上書き設定
+};
+
+static const char kUsage[] = "Usage: %s [--frames=N] [--size=WxH] [--device=recording|software] [--threads=N]\n"
+                             "          [--fixed-step=SECONDS] [--output=<ppm>] [--golden=<ppm>] [--tolerance=N]\n"
+                             "          [--replay=<path>] [--Category.Key=value ...]\n";
+
+/**
+ * @brief 引数を解釈する。"--Category.Key=value" の形は上書き設定として扱う。
+ * @param argc 引数の数。
+ * @param argv 引数。
+ * @param options 結果を受け取る。
+ * @return 解釈できない引数が無ければ true。
+ */
+static bool ParseArguments(int argc, char** argv, HeadlessOptions& options)
+{
+    bool ok = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        unsigned long long frames = 0;
+        unsigned width = 0, height = 0, count = 0;
+        float step = 0.0f;
+        if (std::sscanf(argv[i], "--frames=%llu", &frames) == 1 && frames > 0)
+            options.frames = frames;
+        else if (std::sscanf(argv[i], "--size=%ux%u", &width, &height) == 2 && width > 0 && height > 0)
+        {
+            options.width = width;
+            options.height = height;
+        }
+        else if (arg == "--device=recording" || arg == "--device=software")
+            options.software = arg == "--device=software";
+        else if (std::sscanf(argv[i], "--threads=%u", &count) == 1)
+            options.threads = count;
+        else if (std::sscanf(argv[i], "--fixed-step=%f", &step) == 1 && step >= 0.0f)
+            options.fixedStep = step;
+        else if (std::sscanf(argv[i], "--tolerance=%u", &count) == 1)
+            options.tolerance = count;
+        else if (arg.substr(0, 9) == "--output=")
+            options.output.assign(arg.substr(9));
+        else if (arg.substr(0, 9) == "--golden=")
+            options.golden.assign(arg.substr(9));
+        else if (arg.substr(0, 9) == "--replay=")
+            options.replay.assign(arg.substr(9));
+        else if (!AppendCommandLineOverride(arg, options.overrides))
+        {
+            std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief 最後のフレームを保存し、基準画像と比べる。
+ * @param options 指定。
+ * @param device 描いたデバイス。
+ * @return 保存に失敗したか、基準画像と食い違えば false。
+ */
+static bool CheckImage(const HeadlessOptions& options, const SoftwareRenderDevice& device)
+{
+    const uint32_t width = device.Width();
+    const uint32_t height = device.Height();
+    bool ok = true;
+    if (!options.output.empty())
+    {
+        if (SavePpm(options.output, device.Pixels(), width, height))
+            std::printf("image       saved %s (%ux%u)\n", options.output.c_str(), width, height);
+        else
+        {
+            std::fprintf(stderr, "Failed to write %s\n", options.output.c_str());
+            ok = false;
+        }
+    }
+    if (!options.golden.empty())
+    {
+        RgbaImage golden;
+        if (!LoadPpm(options.golden, golden))
+        {
+            std::fprintf(stderr, "Failed to read golden image %s (create it with --output)\n", options.golden.c_str());
+            return false;
+        }
+        if (golden.width != width || golden.height != height)
+        {
+            std::fprintf(stderr, "golden      size mismatch: %ux%u expected, %ux%u rendered\n", golden.width,
+                         golden.height, width, height);
+            return false;
+        }
+        const ImageDiff diff =
+            CompareRgb(device.Pixels(), golden.pixels.data(), static_cast<size_t>(width) * height, options.tolerance);
+        std::printf("golden      %s: %llu pixels differ by more than %u (max delta %u)\n",
+                    diff.differing == 0 ? "match" : "MISMATCH", static_cast<unsigned long long>(diff.differing),
+                    options.tolerance, diff.maxDelta);
+        ok = ok && diff.differing == 0;
+    }
+    return ok;
+}
+
+/**
+ * @brief コンソール版のエントリーポイント。指定のデバイスで指定フレーム数を描き、集計を表示する。
+ * @param argc 引数の数。
+ * @param argv 引数。
+ * @return 初期化・画像の保存に失敗したか、デバイスへの不正な呼び出しや基準画像との食い違いがあれば 1。
+ */
+int main(int argc, char** argv)
+{
+    HeadlessOptions options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        std::fprintf(stderr, kUsage, argv[0]);
+        return 1;
+    }
+    if (!options.software && (!options.output.empty() || !options.golden.empty()))
+    {
+        std::fprintf(stderr, "--output and --golden require --device=software\n");
+        return 1;
+    }
+
+    // 集計と画素は描画スレッドを止めてから読む
+    std::unique_ptr<RenderDevice> device;
+    const RecordingRenderDevice* recording = nullptr;
+    const SoftwareRenderDevice* software = nullptr;
+    if (options.software)
+    {
+        auto dev = std::make_unique<SoftwareRenderDevice>(options.threads);
+        software = dev.get();
+        device = std::move(dev);
+    }
+    else
+    {
+        auto dev = std::make_unique<RecordingRenderDevice>();
+        recording = dev.get();
+        device = std::move(dev);
+    }
+
+    DxApp app;
+    app.SetFixedTimeStep(options.fixedStep);
+    if (!app.Init(nullptr, std::move(device), options.width, options.height, options.overrides))
+    {
+        std::fprintf(stderr, "Initialization failed.\n");
+        return 1;
+    }
+    if (!options.replay.empty() && !app.StartReplay(options.replay))
+        std::fprintf(stderr, "[Settings] Failed to open replay log: %s\n", options.replay.c_str());
+
+    // 入力が無いため、Render.OnDemand でも止まらないよう毎フレーム描画を求める。
+    // 空きパケットを待ちきれずに作らなかったフレームは数えず、公開したフレームが指定数になるまで回す
+    FrameScheduler& scheduler = app.Scheduler();
+    const auto start = std::chrono::steady_clock::now();
+    while (app.PipelineStats().published < options.frames)
+    {
+        if (app.PollSettings())
+            app.Invalidate();
+        app.Invalidate(1);
+        if (!scheduler.WaitForFrame())
+            continue;
+        scheduler.BeginFrame();
+        app.Render();
+        scheduler.EndFrame();
+    }
+    const FrameStats frameStats = scheduler.Stats();
+    const FramePipelineStats pipeline = app.PipelineStats();
+    app.Shutdown();
+    const double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("frames      %llu in %.1f ms (%.1f fps, cpu %.3f ms/frame)\n",
+                static_cast<unsigned long long>(options.frames), wallMs,
+                wallMs > 0.0 ? options.frames * 1000.0 / wallMs : 0.0, frameStats.cpuMs);
+    std::printf("pipeline    submitted %llu, stalls %llu, dropped %llu, submit %.3f ms, latency %.3f ms\n",
+                static_cast<unsigned long long>(pipeline.submitted), static_cast<unsigned long long>(pipeline.stalls),
+                static_cast<unsigned long long>(pipeline.dropped), pipeline.submitMs, pipeline.latencyMs);
+    if (recording)
+    {
+        const RecordingStats& stats = recording->Stats();
+        std::printf("last frame  %zu commands, %zu bytes, %u draws, %llu triangles, %llu upload bytes, hash %016llx\n",
+                    stats.commands, stats.bytes, stats.draws, static_cast<unsigned long long>(stats.triangles),
+                    static_cast<unsigned long long>(stats.uploadBytes), static_cast<unsigned long long>(stats.hash));
+        std::printf("device      %llu presents, %llu invalid calls\n", static_cast<unsigned long long>(stats.frames),
+                    static_cast<unsigned long long>(stats.invalid));
+        return stats.invalid == 0 ? 0 : 1;
+    }
+
+    const SoftwareStats& stats = software->Stats();
+    std::printf("last frame  %llu triangles, %llu culled, %llu bin entries, raster %.3f ms on %u threads\n",
+                static_cast<unsigned long long>(stats.triangles), static_cast<unsigned long long>(stats.culled),
+                static_cast<unsigned long long>(stats.binEntries), stats.rasterMs, stats.threads);
+    std::printf("device      %llu presents, %llu invalid calls\n", static_cast<unsigned long long>(stats.frames),
+                static_cast<unsigned long long>(stats.invalid));
+    const bool imageOk = CheckImage(options, *software);
+    return stats.invalid == 0 && imageOk ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file ImageFile.cpp
+ * @brief 描画結果を画像ファイル (バイナリ PPM) として保存・読み込み・比較する関数の実装。
+ * @author 山内陽
+ */
+
+#include "ImageFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+/**
+ * @brief PPM のヘッダーの数値を 1 つ読む。空白と '#' から行末までのコメントを読み飛ばす。
+ * @param in 入力。
+ * @param value 結果を受け取る。
+ * @return 読めた場合は true。
+ */
+static bool ReadHeaderNumber(std::istream& in, uint32_t& value)
+{
+    int c = in.get();
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+                c = in.get();
+        }
+        c = in.get();
+    }
+    if (c < '0' || c > '9')
+        return false;
+    uint64_t v = 0;
+    while (c >= '0' && c <= '9' && v <= 0xFFFFFFFFu)
+    {
+        v = v * 10 + static_cast<uint64_t>(c - '0');
+        c = in.get();
+    }
+    // 数値の直後の空白 1 文字はヘッダーの一部 (画素の先頭を読み過ぎないよう 1 文字だけ消費する)
+    if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+        return false;
+    value = static_cast<uint32_t>(v);
+    return v <= 0xFFFFFFFFu;
+}
+
+/**
+ * @brief RGBA8 の画素をバイナリ PPM (P6) として保存する。アルファは書き出さない。
+ * @param path 保存先。
+ * @param rgba 上の行から並んだ RGBA8。
+ * @param width 幅。
+ * @param height 高さ。
+ * @return 書き込めた場合は true。
+ */
+bool SavePpm(const std::filesystem::path& path, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    std::vector<char> row(static_cast<size_t>(width) * 3);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* src = rgba + static_cast<size_t>(y) * width * 4;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            row[x * 3 + 0] = static_cast<char>(src[x * 4 + 0]);
+            row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+            row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+        }
+        out.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief バイナリ PPM (P6、最大値 255) を読み込む。アルファは 255 とする。
+ * @param path 読み込むファイル。
+ * @param image 結果を受け取る。
+ * @return 読み込めた場合は true。
+ */
+bool LoadPpm(const std::filesystem::path& path, RgbaImage& image)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in || in.get() != 'P' || in.get() != '6')
+        return false;
+    uint32_t width = 0, height = 0, maxValue = 0;
+    if (!ReadHeaderNumber(in, width) || !ReadHeaderNumber(in, height) || !ReadHeaderNumber(in, maxValue))
+        return false;
+    if (width == 0 || height == 0 || maxValue != 255 || static_cast<uint64_t>(width) * height > (1u << 28))
+        return false;
+
+    std::vector<char> rgb(static_cast<size_t>(width) * height * 3);
+    if (!in.read(rgb.data(), static_cast<std::streamsize>(rgb.size())))
+        return false;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0, n = static_cast<size_t>(width) * height; i < n; ++i)
+    {
+        image.pixels[i * 4 + 0] = static_cast<uint8_t>(rgb[i * 3 + 0]);
+        image.pixels[i * 4 + 1] = static_cast<uint8_t>(rgb[i * 3 + 1]);
+        image.pixels[i * 4 + 2] = static_cast<uint8_t>(rgb[i * 3 + 2]);
+        image.pixels[i * 4 + 3] = 255;
+    }
+    return true;
+}
+
+/**
+ * @brief 同じ大きさの 2 枚の画像の RGB を比べる (アルファは比べない)。
+ * @param a 画像 A (RGBA8)。
+ * @param b 画像 B (RGBA8)。
+ * @param pixels 画素数。
+ * @param tolerance チャンネルごとの差の許容値。
+ * @return 比較結果。
+ */
+ImageDiff CompareRgb(const uint8_t* a, const uint8_t* b, size_t pixels, uint32_t tolerance)
+{
+    ImageDiff diff;
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        uint32_t delta = 0;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const int d = static_cast<int>(a[i * 4 + k]) - static_cast<int>(b[i * 4 + k]);
+            delta = (std::max)(delta, static_cast<uint32_t>(d < 0 ? -d : d));
+        }
+        if (delta > tolerance)
+            ++diff.differing;
+        if (delta > diff.maxDelta)
+            diff.maxDelta = delta;
+    }
+    return diff;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * @file ImageFile.h
+ * @brief 描画結果を画像ファイル (バイナリ PPM) として保存・読み込み・比較する関数の宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief メモリ上の RGBA8 画像。
+ */
+struct RgbaImage
+{
+    uint32_t width = 0;          // 幅
+    uint32_t height = 0;         // 高さ
+    std::vector<uint8_t> pixels; // 上の行から並んだ RGBA8
+};
+
+/**
+ * @brief 2 枚の画像の比較結果。
+ */
+struct ImageDiff
+{
+    uint64_t differing = 0; // 許容差を超えた画素数
+    uint32_t maxDelta = 0;  // チャンネルごとの差の最大値
+};
+
+/**
+ * @brief RGBA8 の画素をバイナリ PPM (P6) として保存する。アルファは書き出さない。
+ * @param path 保存先。
+ * @param rgba 上の行から並んだ RGBA8。
+ * @param width 幅。
+ * @param height 高さ。
+ * @return 書き込めた場合は true。
+ */
+bool SavePpm(const std::filesystem::path& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+/**
+ * @brief バイナリ PPM (P6、最大値 255) を読み込む。アルファは 255 とする。
+ * @param path 読み込むファイル。
+ * @param image 結果を受け取る。
+ * @return 読み込めた場合は true。
+ */
+bool LoadPpm(const std::filesystem::path& path, RgbaImage& image);
+
+/**
+ * @brief 同じ大きさの 2 枚の画像の RGB を比べる (アルファは比べない)。
+ * @param a 画像 A (RGBA8)。
+ * @param b 画像 B (RGBA8)。
+ * @param pixels 画素数。
+ * @param tolerance チャンネルごとの差の許容値。
+ * @return 比較結果。
+ */
+ImageDiff CompareRgb(const uint8_t* a, const uint8_t* b, size_t pixels, uint32_t tolerance);
@@ -0,0 +1,361 @@
+/**
+ * @file IniArray.cpp
+ * @brief 配列値の解析・書式化の実装。
+ * @author 山内陽
+ */
+
+#include "IniArray.h"
+
+#include "IniParser.h"
+
+#include <charconv>
+#include <climits>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INI_ARRAY_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static constexpr size_t kBlock = 16;   // 1 回に分類する文字数
+static constexpr size_t kPadding = 24; // 高速経路が要素先頭から読む最大バイト数 (分類 16 + 桁変換の読み出し 8 の余裕)
+
+static constexpr uint64_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+static constexpr float kPow10f[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f};
+
+/**
+ * @brief 16 文字分の文字種ビットマスク (ビット i が先頭から i 文字目)。
+ */
+struct CharMasks
+{
+    uint32_t digit; // '0'〜'9'
+    uint32_t dot;   // '.'
+};
+
+/**
+ * @brief 簡易十進表記として読み取った要素。
+ */
+struct SimpleDecimal
+{
+    uint64_t mantissa; // 小数点を除いた桁列の値
+    uint32_t scale;    // 小数点以下の桁数
+    uint32_t length;   // 符号を含む文字数
+    bool negative;     // 負数
+};
+
+/**
+ * @brief 非ゼロ値の下位から連続する 0 ビットの数を返す。
+ * @param v 対象 (0 以外)。
+ * @return ビット数。
+ */
+static inline uint32_t CountTrailingZeros(uint32_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long i = 0;
+    _BitScanForward(&i, v);
+    return static_cast<uint32_t>(i);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(v));
+#endif
+}
+
+/**
+ * @brief 立っているビットの数を返す。
+ * @param v 対象。
+ * @return ビット数。
+ */
+static inline uint32_t PopCount(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return (((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+}
+
+/**
+ * @brief 16 文字を一度に分類する。
+ * @param p 先頭 (16 バイト読めること)。
+ * @return 文字種ビットマスク。
+ */
+static inline CharMasks Classify(const char* p)
+{
+#if INI_ARRAY_SSE2
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    // 符号なしで d <= 9 ⇔ min(d, 9) == d
+    const __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    const __m128i dot = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+    return CharMasks{static_cast<uint32_t>(_mm_movemask_epi8(digit)), static_cast<uint32_t>(_mm_movemask_epi8(dot))};
+#else
+    CharMasks m{0, 0};
+    for (uint32_t i = 0; i < kBlock; ++i)
+    {
+        m.digit |= static_cast<uint32_t>(static_cast<unsigned char>(p[i] - '0') <= 9) << i;
+        m.dot |= static_cast<uint32_t>(p[i] == '.') << i;
+    }
+    return m;
+#endif
+}
+
+/**
+ * @brief 最大 8 桁の数字列を 64bit レジスタ内で並列に変換する (リトルエンディアン前提)。
+ * @param p 数字列の先頭 (8 バイト読めること)。
+ * @param n 桁数 (1〜8)。
+ * @return 値。
+ */
+static inline uint32_t ParseDigits8(const char* p, uint32_t n)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    v <<= 8 * (8 - n); // 余分な後続文字を捨て、足りない上位桁を 0 で埋める
+    v = (v & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    v = (v & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return static_cast<uint32_t>((v & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+}
+
+/**
+ * @brief 要素が [符号] 整数部 [. 小数部] (各 8 桁以内) の簡易十進表記なら読み取る。
+ * @param p 要素の先頭 (kPadding バイト読めること)。
+ * @param out 読み取り結果。
+ * @return 簡易十進表記だった場合は true。それ以外 (指数表記・長い桁列など) は false。
+ */
+static bool ParseSimpleDecimal(const char* p, SimpleDecimal& out)
+{
+    const CharMasks m = Classify(p);
+    const uint32_t sign = (p[0] == '-' || p[0] == '+') ? 1 : 0;
+    const uint32_t intLen = CountTrailingZeros(~(m.digit >> sign));
+    uint32_t pos = sign + intLen;
+    uint32_t fracLen = 0;
+    if ((m.dot >> pos) & 1)
+    {
+        fracLen = CountTrailingZeros(~(m.digit >> (pos + 1)));
+        pos += 1 + fracLen;
+    }
+    if (intLen + fracLen == 0 || intLen > 8 || fracLen > 8 || pos >= kBlock)
+        return false;
+    const char end = p[pos];
+    if (end != ',' && end != ' ' && end != '\t' && end != '\0')
+        return false;
+
+    uint64_t mantissa = intLen ? ParseDigits8(p + sign, intLen) : 0;
+    if (fracLen)
+        mantissa = mantissa * kPow10[fracLen] + ParseDigits8(p + sign + intLen + 1, fracLen);
+    out.mantissa = mantissa;
+    out.scale = fracLen;
+    out.length = pos;
+    out.negative = p[0] == '-';
+    return true;
+}
+
+/**
+ * @brief 要素 1 つを std::from_chars で変換する (高速経路に乗らない要素用)。
+ * @tparam T 要素型。
+ * @param p 要素の先頭。
+ * @param end 値文字列の終端。
+ * @param out 変換結果。
+ * @return 成功なら std::errc{} とともに要素の直後の位置、失敗ならエラーコード。
+ */
+template <typename T>
+static std::from_chars_result ParseElement(const char* p, const char* end, T& out)
+{
+    const char* last = static_cast<const char*>(std::memchr(p, ',', static_cast<size_t>(end - p)));
+    if (!last)
+        last = end;
+    while (last != p && (last[-1] == ' ' || last[-1] == '\t'))
+        --last;
+    // from_chars は '+' を受け付けないため読み飛ばす ("+-1" のような符号の重複は弾く)
+    const char* first = p;
+    if (first != last && *first == '+')
+    {
+        ++first;
+        if (first != last && (*first == '+' || *first == '-'))
+            return {p, std::errc::invalid_argument};
+    }
+    if (first == last)
+        return {p, std::errc::invalid_argument};
+
+    std::from_chars_result r = std::from_chars(first, last, out);
+    if (r.ec == std::errc{} && r.ptr != last)
+        r.ec = std::errc::invalid_argument;
+    return r;
+}
+
+/**
+ * @brief 簡易十進表記を float へ変換する。仮数が 2^24 以下なら float の除算 1 回で正しく丸まる。
+ * @param d 読み取り結果。
+ * @param out 変換結果。
+ * @return 変換できた場合は true。
+ */
+static inline bool ConvertSimple(const SimpleDecimal& d, float& out)
+{
+    if (d.mantissa > (1u << 24))
+        return false;
+    const float v = static_cast<float>(d.mantissa) / kPow10f[d.scale];
+    out = d.negative ? -v : v;
+    return true;
+}
+
+/**
+ * @brief 簡易十進表記を int へ変換する。小数部を持つものは扱わない。
+ * @param d 読み取り結果。
+ * @param out 変換結果。
+ * @return 変換できた場合は true。
+ */
+static inline bool ConvertSimple(const SimpleDecimal& d, int& out)
+{
+    if (d.scale != 0)
+        return false;
+    const int v = static_cast<int>(d.mantissa); // 8 桁以内なので int に収まる
+    out = d.negative ? -v : v;
+    return true;
+}
+
+/**
+ * @brief カンマ区切りの数値列を解析する共通処理。
+ * @details 末尾 kPadding バイト未満になったら残りをゼロ埋めの一時領域へ写し、以降の要素も同じ高速経路で読む。
+ * @tparam T 要素型。
+ * @param s 値文字列。
+ * @param out 格納先。
+ * @param count 期待する要素数。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+template <typename T>
+static std::errc ParseList(std::string_view s, T* out, size_t count)
+{
+    char pad[kPadding * 2];
+    const char* p = s.data();
+    const char* end = p + s.size();
+    bool padded = false;
+    auto skipSpaces = [&]()
+    {
+        while (p != end && (*p == ' ' || *p == '\t'))
+            ++p;
+        if (!padded && static_cast<size_t>(end - p) < kPadding)
+        {
+            const size_t rest = static_cast<size_t>(end - p);
+            if (rest)
+                std::memcpy(pad, p, rest);
+            std::memset(pad + rest, 0, sizeof(pad) - rest);
+            p = pad;
+            end = pad + rest;
+            padded = true;
+        }
+    };
+
+    skipSpaces();
+    if (p == end)
+        return count == 0 ? std::errc{} : std::errc::invalid_argument;
+
+    size_t n = 0;
+    for (;;)
+    {
+        if (n == count)
+            return std::errc::invalid_argument;
+
+        SimpleDecimal d;
+        if (ParseSimpleDecimal(p, d) && ConvertSimple(d, out[n]))
+        {
+            p += d.length;
+        }
+        else
+        {
+            const std::from_chars_result r = ParseElement(p, end, out[n]);
+            if (r.ec != std::errc{})
+                return r.ec;
+            p = r.ptr;
+        }
+        ++n;
+
+        skipSpaces();
+        if (p == end)
+            return n == count ? std::errc{} : std::errc::invalid_argument;
+        if (*p != ',')
+            return std::errc::invalid_argument;
+        ++p;
+        skipSpaces();
+    }
+}
+
+/**
+ * @brief カンマ区切りの要素数を数える。カンマの検出は 16 文字ずつ一括で行う。
+ * @param s 値文字列。
+ * @return 要素数。
+ */
+size_t CountIniValues(std::string_view s)
+{
+    const size_t first = s.find_first_not_of(" \t");
+    if (first == std::string_view::npos)
+        return 0;
+
+    size_t commas = 0;
+    size_t i = 0;
+#if INI_ARRAY_SSE2
+    const __m128i comma = _mm_set1_epi8(',');
+    for (; i + kBlock <= s.size(); i += kBlock)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+        commas += PopCount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma))));
+    }
+#endif
+    for (; i < s.size(); ++i)
+        commas += s[i] == ',';
+    return commas + 1;
+}
+
+/**
+ * @brief カンマ区切りの数値列を float 配列へ解析する。
+ * @param s 値文字列。
+ * @param out 格納先。
+ * @param count 期待する要素数。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc ParseIniFloats(std::string_view s, float* out, size_t count)
+{
+    return ParseList(s, out, count);
+}
+
+/**
+ * @brief カンマ区切りの整数列を int 配列へ解析する。
+ * @param s 値文字列。
+ * @param out 格納先。
+ * @param count 期待する要素数。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc ParseIniInts(std::string_view s, int* out, size_t count)
+{
+    return ParseList(s, out, count);
+}
+
+/**
+ * @brief float 配列をカンマ区切りで追記する。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ * @param out 追記先。
+ */
+void AppendIniFloats(const float* v, size_t count, std::string& out)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i)
+            out.push_back(',');
+        out.append(FormatIniNumber(v[i]).View());
+    }
+}
+
+/**
+ * @brief int 配列をカンマ区切りで追記する。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ * @param out 追記先。
+ */
+void AppendIniInts(const int* v, size_t count, std::string& out)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i)
+            out.push_back(',');
+        out.append(FormatIniNumber(v[i]).View());
+    }
+}
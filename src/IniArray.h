@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+/**
+ * @file IniArray.h
+ * @brief "1.0,0.5,0.25" 形式の配列値を解析・書式化する関数群の宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 指定境界に揃えた領域を確保するアロケーター。SIMD で直接読み書きする配列に使う。
+ * @tparam T 要素型。
+ * @tparam Align 境界 (2 の冪、alignof(T) 以上)。
+ */
+template <typename T, size_t Align>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    /**
+     * @brief 別の要素型向けの同じ境界のアロケーター。
+     * @tparam U 要素型。
+     */
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&)
+    {
+    }
+
+    /**
+     * @brief 境界に揃えた領域を確保する。
+     * @param n 要素数。
+     * @return 先頭ポインタ。
+     */
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+
+    /**
+     * @brief allocate で確保した領域を解放する。
+     * @param p 先頭ポインタ。
+     */
+    void deallocate(T* p, size_t)
+    {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Align>&) const
+    {
+        return false;
+    }
+};
+
+/**
+ * @brief 16 バイト境界に揃えた float 配列。グラデーションやカーブなどの大きな配列値の読み込み先。
+ */
+using FloatArray = std::vector<float, AlignedAllocator<float, 16>>;
+
+/**
+ * @brief カンマ区切りの要素数を数える。
+ * @param s 値文字列。
+ * @return 要素数 (空文字列なら 0)。
+ */
+size_t CountIniValues(std::string_view s);
+
+/**
+ * @brief カンマ区切りの数値列を float 配列へ解析する。ロケールに依存せず、例外も投げない。
+ * @details 要素の前後の空白は無視する。小数点以下 8 桁以内の単純な十進表記は SIMD で桁を分類して一括変換し、
+ *          指数表記などそれ以外の要素は std::from_chars で変換する。どちらも正しく丸めた値になる。
+ * @param s 値文字列。
+ * @param out 格納先 (count 要素)。失敗時の内容は不定。
+ * @param count 期待する要素数。
+ * @return 成功なら std::errc{}、要素数が異なるか数値でない要素があれば std::errc::invalid_argument、
+ *         float の範囲外の要素があれば std::errc::result_out_of_range。
+ */
+std::errc ParseIniFloats(std::string_view s, float* out, size_t count);
+
+/**
+ * @brief カンマ区切りの整数列を int 配列へ解析する。
+ * @param s 値文字列。
+ * @param out 格納先 (count 要素)。失敗時の内容は不定。
+ * @param count 期待する要素数。
+ * @return ParseIniFloats と同じ。
+ */
+std::errc ParseIniInts(std::string_view s, int* out, size_t count);
+
+/**
+ * @brief float 配列を "1,0.5,0.25" 形式で追記する。各要素は float として最短の表記になる。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ * @param out 追記先。
+ */
+void AppendIniFloats(const float* v, size_t count, std::string& out);
+
+/**
+ * @brief int 配列を "1,2,3" 形式で追記する。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ * @param out 追記先。
+ */
+void AppendIniInts(const int* v, size_t count, std::string& out);
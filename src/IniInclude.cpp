@@ -0,0 +1,407 @@
+/**
+ * @file IniInclude.cpp
+ * @brief "@include" とセクションの継承の展開と、取り込むファイルの解析結果キャッシュの実装。
+ * @author 山内陽
+ */
+
+#include "IniInclude.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+
+/**
+ * @brief 展開中の状態。
+ */
+struct IniIncludeCache::Context
+{
+    IniIncluded& included;                   // 取り込んだ内容の追記先
+    std::vector<std::wstring> stack;         // 展開中のファイル (循環の検出用)
+    std::vector<std::wstring>& dependencies; // 取り込んだファイル (重複の検出を兼ねる)
+    std::vector<uint64_t> hashes;            // dependencies と同じ並びの内容のハッシュ (見つからなければ 0)
+};
+
+/**
+ * @brief エントリのセクション名を取得する。
+ * @param text 基準バッファ。
+ * @param e 対象エントリ。
+ * @return セクション名 (見出しが無ければ "Default")。
+ */
+static std::string_view SectionOf(std::string_view text, const IniEntry& e)
+{
+    return e.section.length ? SpanView(text, e.section) : std::string_view("Default");
+}
+
+/**
+ * @brief (セクション, キー) のハッシュ値を計算する。
+ * @param section セクション名。
+ * @param key キー名。
+ * @return ハッシュ値。
+ */
+static uint64_t HashEntryKey(std::string_view section, std::string_view key)
+{
+    return Hash64(key, Hash64(section));
+}
+
+/**
+ * @brief 継承の展開中の状態。
+ */
+struct InheritContext
+{
+    std::string& text;                       // 展開先のバッファ (補った値を追記する)
+    uint32_t fileLength;                     // text 先頭のうちファイル内容そのものである部分の長さ
+    std::vector<IniEntry>& entries;          // エントリ列 (補ったエントリを追記する)
+    const std::vector<IniInherit>& inherits; // 継承指定
+    std::vector<uint8_t> state;              // 継承指定ごとの状態 (0: 未処理, 1: 処理中, 2: 完了)
+    FlatIndex index;                         // (セクション, キー) から entries の添字を引く索引
+
+    /**
+     * @brief セクションにキーが定義されているか検索する。
+     * @param section セクション名。
+     * @param key キー名。
+     * @param hash HashEntryKey(section, key) の値。
+     * @return エントリの添字。無ければ FlatIndex::kNone。
+     */
+    uint32_t Find(std::string_view section, std::string_view key, uint64_t hash) const
+    {
+        return index.Find(hash,
+                          [&](uint32_t i)
+                          {
+                              return SectionOf(text, entries[i]) == section && SpanView(text, entries[i].key) == key;
+                          });
+    }
+};
+
+/**
+ * @brief 1 つの継承指定を展開し、継承元のキーのうち継承先に無いものを継承先へ補う。
+ * @details 継承元自身の継承指定を先に展開する。継承元に同じキーが複数回現れる場合は、参照時と同じく最後の値
+ *          (取り込んだファイルの値を上書きしたファイル自身の値など) を補う。ファイル自身の値を指すスパンは
+ *          保存時に書き換えられないよう、値をバッファ末尾へ複写して指し直す。
+ * @param ctx 展開中の状態。
+ * @param j 継承指定の添字。
+ */
+static void ApplyInherit(InheritContext& ctx, size_t j)
+{
+    if (ctx.state[j] != 0)
+        return; // 展開済み、または循環している
+    ctx.state[j] = 1;
+
+    const std::string derived(SpanView(ctx.text, ctx.inherits[j].section));
+    const std::string parent(SpanView(ctx.text, ctx.inherits[j].base));
+    for (size_t k = 0; k < ctx.inherits.size(); ++k)
+    {
+        if (SpanView(ctx.text, ctx.inherits[k].section) == parent)
+            ApplyInherit(ctx, k);
+    }
+
+    const size_t count = ctx.entries.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        IniEntry e = ctx.entries[i];
+        if (SectionOf(ctx.text, e) != parent)
+            continue;
+        const uint64_t hash = HashEntryKey(derived, SpanView(ctx.text, e.key));
+        const uint32_t found = ctx.Find(derived, SpanView(ctx.text, e.key), hash);
+        if (found < count)
+            continue; // 継承先自身の値 (または先に展開した継承指定で補った値) を残す
+        if (e.value.offset < ctx.fileLength)
+        {
+            ctx.text.reserve(ctx.text.size() + e.value.length);
+            const uint32_t offset = static_cast<uint32_t>(ctx.text.size());
+            ctx.text.append(ctx.text.data() + e.value.offset, e.value.length);
+            e.value.offset = offset;
+        }
+        if (found != FlatIndex::kNone)
+        {
+            ctx.entries[found].value = e.value; // この展開で補ったキーは継承元の後の値で上書きする
+            continue;
+        }
+        e.section = ctx.inherits[j].section;
+        ctx.index.Insert(hash, static_cast<uint32_t>(ctx.entries.size()));
+        ctx.entries.push_back(e);
+    }
+    ctx.state[j] = 2;
+}
+
+/**
+ * @brief プロセス全体で共有するキャッシュを取得する。
+ * @return 共有キャッシュ。
+ */
+IniIncludeCache& IniIncludeCache::Shared()
+{
+    static IniIncludeCache cache;
+    return cache;
+}
+
+/**
+ * @brief 解析済みのファイル内容の参照指定を展開する。
+ * @param path 展開するファイルのパス。
+ * @param text ファイル内容。
+ * @param entries 解析結果。
+ * @param links 参照指定。
+ * @param dependencies 取り込んだファイルの絶対パスを受け取る。
+ * @param dependencyHash 取り込んだファイルの内容をまとめたハッシュを受け取る。
+ * @param included 取り込んだ内容を受け取る。
+ */
+void IniIncludeCache::Resolve(const std::filesystem::path& path, std::string& text, std::vector<IniEntry>& entries,
+                              const IniLinks& links, std::vector<std::wstring>& dependencies, uint64_t& dependencyHash,
+                              IniIncluded& included)
+{
+    Collect(path, text, links, dependencies, dependencyHash, included);
+    Expand(text, entries, links, included);
+}
+
+/**
+ * @brief "@include" で取り込むファイルを集める。
+ * @param path 展開するファイルのパス。
+ * @param text ファイル内容。
+ * @param links 参照指定。
+ * @param dependencies 取り込んだファイルの絶対パスを受け取る。
+ * @param dependencyHash 取り込んだファイルの内容をまとめたハッシュを受け取る。
+ * @param included 取り込んだ内容を受け取る。
+ */
+void IniIncludeCache::Collect(const std::filesystem::path& path, std::string_view text, const IniLinks& links,
+                              std::vector<std::wstring>& dependencies, uint64_t& dependencyHash, IniIncluded& included)
+{
+    dependencies.clear();
+    dependencyHash = 0;
+    included.clear();
+    if (links.includes.empty())
+        return;
+    Context ctx{included, {}, dependencies, {}};
+
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::current_path(ec);
+    if (!path.empty())
+    {
+        const std::filesystem::path root = std::filesystem::absolute(path, ec).lexically_normal();
+        ctx.stack.push_back(root.wstring());
+        dir = root.parent_path();
+    }
+    std::vector<std::string> names;
+    for (const IniSpan& span : links.includes)
+        names.emplace_back(SpanView(text, span));
+    Include(dir, names, ctx);
+
+    for (uint64_t h : ctx.hashes)
+        dependencyHash = Hash64(&h, sizeof(h), dependencyHash);
+}
+
+/**
+ * @brief 集めた内容を取り込み、継承を展開する。
+ * @details 取り込んだファイルのエントリを先に、ファイル自身のエントリを後に並べるため、同じキーはファイル自身の値が勝つ。
+ *          継承はすべての取り込みを展開した後に、取り込んだファイルの継承指定も含めて展開する。
+ * @param text ファイル内容。
+ * @param entries 解析結果。
+ * @param links 参照指定。
+ * @param included 取り込んだ内容。
+ */
+void IniIncludeCache::Expand(std::string& text, std::vector<IniEntry>& entries, const IniLinks& links,
+                             const IniIncluded& included)
+{
+    const uint32_t fileLength = static_cast<uint32_t>(text.size());
+    std::vector<IniEntry> expanded;
+    std::vector<IniInherit> inherits;
+    expanded.reserve(included.entries.size() + entries.size());
+    inherits.reserve(included.inherits.size() + links.inherits.size());
+
+    // 取り込んだ内容をバッファ末尾へ置き、スパンをその位置へずらす
+    text.append(included.text);
+    for (IniEntry e : included.entries)
+    {
+        e.section.offset += fileLength;
+        e.key.offset += fileLength;
+        e.value.offset += fileLength;
+        expanded.push_back(e);
+    }
+    for (IniInherit inherit : included.inherits)
+    {
+        inherit.section.offset += fileLength;
+        inherit.base.offset += fileLength;
+        inherits.push_back(inherit);
+    }
+    expanded.insert(expanded.end(), entries.begin(), entries.end());
+    inherits.insert(inherits.end(), links.inherits.begin(), links.inherits.end());
+    entries.swap(expanded);
+
+    if (!inherits.empty())
+    {
+        InheritContext inherit{text, fileLength, entries, inherits, std::vector<uint8_t>(inherits.size()), {}};
+        inherit.index.Reserve(entries.size());
+        for (uint32_t i = 0; i < entries.size(); ++i)
+        {
+            const std::string_view section = SectionOf(text, entries[i]);
+            const std::string_view key = SpanView(text, entries[i].key);
+            const uint64_t hash = HashEntryKey(section, key);
+            if (inherit.Find(section, key, hash) == FlatIndex::kNone)
+                inherit.index.Insert(hash, i);
+        }
+        for (size_t j = 0; j < inherits.size(); ++j)
+            ApplyInherit(inherit, j);
+    }
+}
+
+/**
+ * @brief 取り込み指定を順に展開する。
+ * @param dir 相対パスの基準ディレクトリ。
+ * @param names 取り込むファイル名。
+ * @param ctx 展開中の状態。
+ */
+void IniIncludeCache::Include(const std::filesystem::path& dir, const std::vector<std::string>& names, Context& ctx)
+{
+    for (const std::string& name : names)
+    {
+        std::filesystem::path p = std::filesystem::u8path(name);
+        if (p.is_relative())
+            p = dir / p;
+        p = p.lexically_normal();
+        const std::wstring key = p.wstring();
+        if (std::find(ctx.stack.begin(), ctx.stack.end(), key) != ctx.stack.end() ||
+            std::find(ctx.dependencies.begin(), ctx.dependencies.end(), key) != ctx.dependencies.end())
+            continue; // 循環、または別の経路で取り込み済み
+
+        // 見つからないファイルも依存先として残し、作成された時点で読み込み直せるようにする
+        ctx.dependencies.push_back(key);
+        ctx.hashes.push_back(0);
+        const std::shared_ptr<const Unit> unit = Get(key);
+        if (!unit)
+            continue;
+        ctx.hashes.back() = unit->hash;
+
+        std::vector<std::string> nested;
+        for (const IniSpan& span : unit->links.includes)
+            nested.emplace_back(SpanView(unit->text, span));
+        ctx.stack.push_back(key);
+        Include(p.parent_path(), nested, ctx);
+        ctx.stack.pop_back();
+
+        // 取り込んだ内容を連結し、スパンをその位置へずらす
+        IniIncluded& included = ctx.included;
+        const uint32_t base = static_cast<uint32_t>(included.text.size());
+        included.text.append(unit->text);
+        for (IniEntry e : unit->entries)
+        {
+            e.section.offset += base;
+            e.key.offset += base;
+            e.value.offset += base;
+            included.entries.push_back(e);
+        }
+        for (IniInherit inherit : unit->links.inherits)
+        {
+            inherit.section.offset += base;
+            inherit.base.offset += base;
+            included.inherits.push_back(inherit);
+        }
+    }
+}
+
+/**
+ * @brief 読み込み済みのファイル内容を解析して参照指定を展開する。参照指定が無ければ解析だけを行う。
+ * @param path ファイルのパス。
+ * @param doc 出力先。
+ * @param links 参照指定の作業領域。
+ */
+void IniIncludeCache::Parse(const std::filesystem::path& path, IniDocument& doc, IniLinks& links)
+{
+    ParseIni(doc.text, doc.entries, links);
+    doc.fileLength = static_cast<uint32_t>(doc.text.size());
+    if (links.empty())
+    {
+        doc.dependencies.clear();
+        doc.dependencyHash = 0;
+        doc.included.clear();
+        return;
+    }
+    Resolve(path, doc.text, doc.entries, links, doc.dependencies, doc.dependencyHash, doc.included);
+}
+
+/**
+ * @brief 取り込むファイルの現在の内容からハッシュをまとめ直す。
+ * @param dependencies ファイルの一覧。
+ * @return まとめたハッシュ。
+ */
+uint64_t IniIncludeCache::DependencyHash(const std::vector<std::wstring>& dependencies)
+{
+    uint64_t hash = 0;
+    for (const std::wstring& path : dependencies)
+    {
+        const std::shared_ptr<const Unit> unit = Get(path);
+        const uint64_t h = unit ? unit->hash : 0;
+        hash = Hash64(&h, sizeof(h), hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief ファイルの解析結果を取得する。
+ * @details 最終更新時刻とサイズが保持しているものと一致すれば再利用する。読み込みと解析はロックの外で行う。
+ * @param path 絶対パス。
+ * @return 解析結果。ファイルが無ければ nullptr。
+ */
+std::shared_ptr<const IniIncludeCache::Unit> IniIncludeCache::Get(const std::wstring& path)
+{
+    std::error_code ec;
+    const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return nullptr;
+    const uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return nullptr;
+
+    const uint64_t key = Hash64(path.data(), path.size() * sizeof(wchar_t));
+    auto find = [&]() { return m_index.Find(key, [&](uint32_t i) { return m_units[i]->path == path; }); };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint32_t i = find();
+        if (i != FlatIndex::kNone && m_units[i]->writeTime == writeTime && m_units[i]->size == size)
+        {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return m_units[i];
+        }
+    }
+
+    auto unit = std::make_shared<Unit>();
+    unit->path = path;
+    unit->writeTime = writeTime;
+    if (!ReadFileToBuffer(path, unit->text))
+        return nullptr;
+    unit->size = unit->text.size();
+    unit->hash = Hash64(unit->text);
+    ParseIni(unit->text, unit->entries, unit->links);
+    m_reads.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint32_t i = find();
+    if (i == FlatIndex::kNone)
+    {
+        m_index.Insert(key, static_cast<uint32_t>(m_units.size()));
+        m_units.push_back(unit);
+    }
+    else
+    {
+        m_units[i] = unit;
+    }
+    return unit;
+}
+
+/**
+ * @brief 保持している解析結果をすべて破棄する。
+ */
+void IniIncludeCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_units.clear();
+    m_index.Clear();
+}
+
+/**
+ * @brief 読み込みの統計を取得する。
+ * @return 統計。
+ */
+IniIncludeStats IniIncludeCache::Stats() const
+{
+    IniIncludeStats stats;
+    stats.reads = m_reads.load(std::memory_order_relaxed);
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    return stats;
+}
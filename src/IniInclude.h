@@ -0,0 +1,155 @@
+#pragma once
+#include "FlatIndex.h"
+#include "IniParser.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @file IniInclude.h
+ * @brief "@include" とセクションの継承を展開し、取り込むファイルの解析結果を共有するキャッシュの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 取り込むファイルの読み込みの統計。
+ */
+struct IniIncludeStats
+{
+    uint64_t reads = 0; // ファイルを読み込んで解析した回数
+    uint64_t hits = 0;  // 解析済みの内容を再利用した回数
+};
+
+/**
+ * @brief "@include other.ini" と "[Section : Base]" を読み込み時に展開し、1 つの平坦なエントリ列にするクラス。
+ * @details 取り込むファイルはパスごとに 1 度だけ読み込み・解析して保持し、最終更新時刻とサイズが変わるまで再利用する。
+ *          複数のファイル (複数の Settings や監視スレッド) が同じ共通ファイルを取り込んでも、読み込みと解析は 1 回で済む。
+ *          展開の規則は次のとおり。
+ *          - 取り込んだファイルの値は、取り込んだ側のファイル自身の値より優先度が低い (後勝ち)。
+ *          - 同じファイルを複数の経路で取り込んでも 1 回だけ展開し、循環する取り込みは無視する。
+ *          - "[Section : Base]" は Base のキーのうち Section に無いものを Section へ補う。継承元がさらに継承している場合は
+ *            先に解決し、循環する継承は無視する。継承元は取り込んだファイルにあってもよい。
+ *          展開結果は元のテキストの後ろに取り込んだ内容と補った値を追記したバッファ上のスパンで表すため、
+ *          Settings は展開後も通常のファイルと同じ 1 つの値テーブルで値を引く。ファイル自身に無い値は保存時に書き換えない。
+ *          全メンバーはスレッドセーフ。
+ */
+class IniIncludeCache
+{
+public:
+    IniIncludeCache() = default;
+    IniIncludeCache(const IniIncludeCache&) = delete;
+    IniIncludeCache& operator=(const IniIncludeCache&) = delete;
+
+    /**
+     * @brief プロセス全体で共有するキャッシュを取得する。
+     * @return 共有キャッシュ。
+     */
+    static IniIncludeCache& Shared();
+
+    /**
+     * @brief 解析済みのファイル内容の参照指定を展開する (Collect で取り込み、Expand で展開する)。
+     * @param path 展開するファイルのパス (取り込むファイルの相対パスの基準。メモリ上の内容なら空)。
+     * @param text ファイル内容。取り込んだ内容と継承で補った値が末尾へ追記される。
+     * @param entries text を ParseIni で解析した結果。展開後のエントリ列で置き換えられる。
+     * @param links text を ParseIni で解析した参照指定。
+     * @param dependencies 取り込んだ (間接的なものと、見つからなかったものを含む) ファイルの絶対パスを受け取る。
+     * @param dependencyHash dependencies の内容をまとめたハッシュを受け取る。
+     * @param included 取り込んだ内容を受け取る (同じ取り込み指定の内容を Expand で展開し直すときに渡す)。
+     */
+    void Resolve(const std::filesystem::path& path, std::string& text, std::vector<IniEntry>& entries,
+                 const IniLinks& links, std::vector<std::wstring>& dependencies, uint64_t& dependencyHash,
+                 IniIncluded& included);
+
+    /**
+     * @brief "@include" で取り込むファイルを (キャッシュが古ければ読み込んで) 集める。ファイル I/O はここだけで行う。
+     * @param path 展開するファイルのパス (取り込むファイルの相対パスの基準。メモリ上の内容なら空)。
+     * @param text ファイル内容。
+     * @param links text を ParseIni で解析した参照指定。
+     * @param dependencies 取り込んだファイルの絶対パスを受け取る。
+     * @param dependencyHash dependencies の内容をまとめたハッシュを受け取る。
+     * @param included 取り込んだ内容を受け取る。
+     */
+    void Collect(const std::filesystem::path& path, std::string_view text, const IniLinks& links,
+                 std::vector<std::wstring>& dependencies, uint64_t& dependencyHash, IniIncluded& included);
+
+    /**
+     * @brief Collect で集めた内容を取り込み、継承を展開する。ファイルにもキャッシュにも触れない。
+     * @details 取り込み指定を変えない書き換え (保存した内容の解析し直し) では、前回集めた内容を渡せば読み込みを省ける。
+     * @param text ファイル内容。取り込んだ内容と継承で補った値が末尾へ追記される。
+     * @param entries text を ParseIni で解析した結果。展開後のエントリ列で置き換えられる。
+     * @param links text を ParseIni で解析した参照指定。
+     * @param included 取り込んだ内容。
+     */
+    static void Expand(std::string& text, std::vector<IniEntry>& entries, const IniLinks& links,
+                       const IniIncluded& included);
+
+    /**
+     * @brief 読み込み済みのファイル内容を解析して参照指定を展開し、IniDocument を完成させる。
+     * @param path ファイルのパス。
+     * @param doc text と hash を設定済みの出力先 (entries・fileLength・dependencies・dependencyHash を埋める)。
+     * @param links 参照指定の作業領域 (容量を再利用する)。
+     */
+    void Parse(const std::filesystem::path& path, IniDocument& doc, IniLinks& links);
+
+    /**
+     * @brief 取り込むファイルの現在の内容から、Resolve と同じ方法でハッシュをまとめ直す。
+     * @details 変更されていないファイルは最終更新時刻とサイズの確認だけで済む。
+     * @param dependencies Resolve で得たファイルの一覧。
+     * @return まとめたハッシュ (一覧が空なら 0)。
+     */
+    uint64_t DependencyHash(const std::vector<std::wstring>& dependencies);
+
+    /**
+     * @brief 保持している解析結果をすべて破棄する。
+     */
+    void Clear();
+
+    /**
+     * @brief 読み込みの統計を取得する。
+     * @return 統計。
+     */
+    IniIncludeStats Stats() const;
+
+private:
+    /**
+     * @brief 1 ファイル分の解析結果。作成後は変更しないため、ロックの外で参照できる。
+     */
+    struct Unit
+    {
+        std::wstring path;                           // 絶対パス
+        std::filesystem::file_time_type writeTime{}; // 読み込み時点の最終更新時刻
+        uint64_t size = 0;                           // 読み込み時点のサイズ
+        uint64_t hash = 0;                           // 内容のハッシュ
+        std::string text;                            // ファイル内容
+        std::vector<IniEntry> entries;               // 解析済みエントリ (text 基準)
+        IniLinks links;                              // 参照指定 (text 基準)
+    };
+
+    struct Context;
+
+    /**
+     * @brief ファイルの解析結果を取得する。変更されていれば読み込み直す。
+     * @param path 絶対パス。
+     * @return 解析結果。ファイルが無ければ nullptr。
+     */
+    std::shared_ptr<const Unit> Get(const std::wstring& path);
+
+    /**
+     * @brief 取り込み指定を順に展開する。取り込んだファイルの取り込み指定は先に (深さ優先で) 展開する。
+     * @param dir 相対パスの基準ディレクトリ。
+     * @param names 取り込むファイル名 (出現順)。
+     * @param ctx 展開中の状態。
+     */
+    void Include(const std::filesystem::path& dir, const std::vector<std::string>& names, Context& ctx);
+
+    mutable std::mutex m_mutex;                       // m_units / m_index 用ミューテックス
+    std::vector<std::shared_ptr<const Unit>> m_units; // 解析結果 (パスごとに 1 つ)
+    FlatIndex m_index;                                // パスのハッシュ値から m_units の添字を引く索引
+    std::atomic<uint64_t> m_reads{0};                 // 読み込んで解析した回数
+    std::atomic<uint64_t> m_hits{0};                  // 解析結果を再利用した回数
+};
@@ -0,0 +1,276 @@
+/**
+ * @file IniParser.cpp
+ * @brief ゼロコピー INI パーサーの実装。
+ * @author 山内陽
+ */
+
+#include "IniParser.h"
+
+#include "Hash.h"
+
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+/**
+ * @brief 空白文字 (スペース・タブ・改行類) か判定する。
+ * @param c 判定する文字。
+ * @return 空白なら true。
+ */
+static inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief [begin, end) の前後空白を取り除いたスパンを作る。
+ * @param text 基準バッファ。
+ * @param begin 開始オフセット。
+ * @param end 終了オフセット (排他的)。
+ * @return 空白除去後のスパン。
+ */
+static inline IniSpan TrimSpan(std::string_view text, size_t begin, size_t end)
+{
+    while (begin < end && IsSpace(text[begin]))
+        ++begin;
+    while (end > begin && IsSpace(text[end - 1]))
+        --end;
+    return IniSpan{static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin)};
+}
+
+/**
+ * @brief INI テキストを 1 パスで走査しエントリ位置を列挙する。
+ * @details "[Section : Base]" の見出しは Section として扱う。links が渡された場合は "@include" 行と継承指定も記録する。
+ * @param text 解析対象のテキスト。
+ * @param out 解析結果の追記先。
+ * @param links 参照指定の追記先 (不要なら nullptr)。
+ */
+static void ScanIni(std::string_view text, std::vector<IniEntry>& out, IniLinks* links)
+{
+    out.clear();
+    if (links)
+        links->clear();
+    const char* base = text.data();
+    const size_t size = text.size();
+    IniSpan section{};
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        const void* nl = std::memchr(base + pos, '\n', size - pos);
+        const size_t eol = nl ? static_cast<size_t>(static_cast<const char*>(nl) - base) : size;
+
+        // コメント (';' / '#') 以降を切り捨てる
+        size_t end = pos;
+        while (end < eol && base[end] != ';' && base[end] != '#')
+            ++end;
+
+        const IniSpan line = TrimSpan(text, pos, end);
+        pos = eol + 1;
+        if (line.length == 0)
+            continue;
+
+        const size_t lb = line.offset;
+        const size_t le = line.offset + line.length;
+        if (base[lb] == '[' && base[le - 1] == ']')
+        {
+            // "[Section : Base]" は Section の見出しとして扱い、継承元を記録する
+            const void* colon = std::memchr(base + lb + 1, ':', le - lb - 2);
+            if (!colon)
+            {
+                section = TrimSpan(text, lb + 1, le - 1);
+                continue;
+            }
+            const size_t colonPos = static_cast<size_t>(static_cast<const char*>(colon) - base);
+            section = TrimSpan(text, lb + 1, colonPos);
+            const IniSpan parent = TrimSpan(text, colonPos + 1, le - 1);
+            if (links && section.length && parent.length)
+                links->inherits.push_back(IniInherit{section, parent});
+            continue;
+        }
+
+        static constexpr std::string_view kInclude = "@include";
+        if (base[lb] == '@')
+        {
+            const std::string_view directive(base + lb, line.length);
+            if (links && directive.size() > kInclude.size() && directive.substr(0, kInclude.size()) == kInclude &&
+                IsSpace(directive[kInclude.size()]))
+            {
+                IniSpan path = TrimSpan(text, lb + kInclude.size(), le);
+                if (path.length >= 2 && base[path.offset] == '"' && base[path.offset + path.length - 1] == '"')
+                    path = IniSpan{path.offset + 1, path.length - 2};
+                if (path.length)
+                    links->includes.push_back(path);
+            }
+            continue;
+        }
+
+        const void* eq = std::memchr(base + lb, '=', line.length);
+        if (!eq)
+            continue;
+        const size_t eqPos = static_cast<size_t>(static_cast<const char*>(eq) - base);
+
+        IniEntry e;
+        e.section = section;
+        e.key = TrimSpan(text, lb, eqPos);
+        e.value = TrimSpan(text, eqPos + 1, le);
+        out.push_back(e);
+    }
+}
+
+/**
+ * @brief INI テキストを 1 パスで走査しエントリ位置を列挙する。
+ * @param text 解析対象のテキスト。
+ * @param out 解析結果の追記先。
+ */
+void ParseIni(std::string_view text, std::vector<IniEntry>& out)
+{
+    ScanIni(text, out, nullptr);
+}
+
+/**
+ * @brief INI テキストを走査し、エントリ位置と参照指定を列挙する。
+ * @param text 解析対象のテキスト。
+ * @param out 解析結果の追記先。
+ * @param links 参照指定の追記先。
+ */
+void ParseIni(std::string_view text, std::vector<IniEntry>& out, IniLinks& links)
+{
+    ScanIni(text, out, &links);
+}
+
+/**
+ * @brief ファイル全体を 1 回の読み込みでバッファへ取り込む。
+ * @param path 読み込むファイルパス。
+ * @param out 読み込み先。
+ * @return 読み込みに成功した場合は true。
+ */
+bool ReadFileToBuffer(const std::wstring& path, std::string& out)
+{
+    std::ifstream ifs(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+    if (!ifs)
+        return false;
+    const std::streamoff size = ifs.tellg();
+    if (size < 0)
+        return false;
+    out.resize(static_cast<size_t>(size));
+    ifs.seekg(0);
+    if (size > 0 && !ifs.read(out.data(), size))
+        return false;
+    return true;
+}
+
+/**
+ * @brief ファイルを読み込み、内容のハッシュを計算して解析し IniDocument を作る。
+ * @param path 読み込むファイルパス。
+ * @param doc 出力先。
+ * @return 読み込みに成功した場合は true。
+ */
+bool LoadIniDocument(const std::wstring& path, IniDocument& doc)
+{
+    std::error_code ec;
+    doc.writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return false;
+    if (!ReadFileToBuffer(path, doc.text))
+        return false;
+    doc.hash = Hash64(doc.text);
+    ParseIni(doc.text, doc.entries);
+    return true;
+}
+
+/**
+ * @brief コマンドライン引数 "--Category.Key=value" を INI テキストへ変換して追記する。
+ * @param arg コマンドライン引数 1 つ (UTF-8)。
+ * @param ini 追記先の INI テキスト。
+ * @return 上書き指定として解釈できた場合は true。
+ */
+bool AppendCommandLineOverride(std::string_view arg, std::string& ini)
+{
+    if (arg.size() < 3 || arg.substr(0, 2) != "--")
+        return false;
+    arg.remove_prefix(2);
+    const size_t eq = arg.find('=');
+    if (eq == std::string_view::npos || arg.find_first_of("\r\n") != std::string_view::npos)
+        return false;
+
+    std::string_view name = arg.substr(0, eq);
+    std::string_view value = arg.substr(eq + 1);
+    const size_t dot = name.find('.');
+    std::string_view cat = dot == std::string_view::npos ? std::string_view("Default") : name.substr(0, dot);
+    std::string_view key = dot == std::string_view::npos ? name : name.substr(dot + 1);
+    if (cat.empty() || key.empty() || cat.find_first_of("[]") != std::string_view::npos)
+        return false;
+
+    ini.append("[").append(cat).append("]\n");
+    ini.append(key).append("=").append(value).append("\n");
+    return true;
+}
+
+/**
+ * @brief 値文字列を倍精度浮動小数として解釈する。
+ * @param s 値文字列。
+ * @param out 成功時の格納先。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc ParseIniNumber(std::string_view s, double& out)
+{
+    // from_chars は '+' を受け付けないため読み飛ばす ("+-1" のような符号の重複は弾く)
+    if (!s.empty() && s[0] == '+')
+    {
+        s.remove_prefix(1);
+        if (!s.empty() && (s[0] == '+' || s[0] == '-'))
+            return std::errc::invalid_argument;
+    }
+    if (s.empty())
+        return std::errc::invalid_argument;
+
+    double v = 0.0;
+    const std::from_chars_result r = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (r.ec != std::errc{})
+        return r.ec;
+    if (r.ptr != s.data() + s.size())
+        return std::errc::invalid_argument;
+    out = v;
+    return std::errc{};
+}
+
+/**
+ * @brief 倍精度浮動小数を最短の往復可能な十進表記へ書式化する。
+ * @param v 書式化する値。
+ * @return 書式化結果。
+ */
+IniNumberText FormatIniNumber(double v)
+{
+    IniNumberText t;
+    const std::to_chars_result r = std::to_chars(t.data, t.data + sizeof(t.data), v);
+    t.size = r.ec == std::errc{} ? static_cast<uint32_t>(r.ptr - t.data) : 0;
+    return t;
+}
+
+/**
+ * @brief 単精度浮動小数を最短の往復可能な十進表記へ書式化する。
+ * @param v 書式化する値。
+ * @return 書式化結果。
+ */
+IniNumberText FormatIniNumber(float v)
+{
+    IniNumberText t;
+    const std::to_chars_result r = std::to_chars(t.data, t.data + sizeof(t.data), v);
+    t.size = r.ec == std::errc{} ? static_cast<uint32_t>(r.ptr - t.data) : 0;
+    return t;
+}
+
+/**
+ * @brief 整数を十進表記へ書式化する。
+ * @param v 書式化する値。
+ * @return 書式化結果。
+ */
+IniNumberText FormatIniNumber(int v)
+{
+    IniNumberText t;
+    const std::to_chars_result r = std::to_chars(t.data, t.data + sizeof(t.data), v);
+    t.size = r.ec == std::errc{} ? static_cast<uint32_t>(r.ptr - t.data) : 0;
+    return t;
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+/**
+ * @file IniParser.h
+ * @brief INI テキストを走査するゼロコピーパーサーの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief テキストバッファ内の部分文字列をオフセットと長さで表す。
+ */
+struct IniSpan
+{
+    uint32_t offset = 0; // バッファ先頭からのバイトオフセット
+    uint32_t length = 0; // バイト長
+};
+
+/**
+ * @brief 1 つのキー・値ペアの位置情報。
+ * @note section.length が 0 の場合は既定カテゴリ ("Default") を表す。
+ */
+struct IniEntry
+{
+    IniSpan section; // 所属カテゴリ名
+    IniSpan key;     // キー名
+    IniSpan value;   // 値
+};
+
+/**
+ * @brief セクションの継承指定 "[Section : Base]" の位置情報。
+ */
+struct IniInherit
+{
+    IniSpan section; // 継承するセクション名
+    IniSpan base;    // 継承元のセクション名
+};
+
+/**
+ * @brief 他のファイルやセクションを参照する指定 ("@include" 行とセクションの継承) の一覧。
+ */
+struct IniLinks
+{
+    std::vector<IniSpan> includes;    // "@include <path>" のパス部分 (出現順)
+    std::vector<IniInherit> inherits; // "[Section : Base]" の継承指定 (出現順)
+
+    /**
+     * @brief 一覧を空にする (容量は保持する)。
+     */
+    void clear()
+    {
+        includes.clear();
+        inherits.clear();
+    }
+
+    /**
+     * @brief 参照する指定が無いか判定する。
+     * @return 無ければ true。
+     */
+    bool empty() const
+    {
+        return includes.empty() && inherits.empty();
+    }
+};
+
+/**
+ * @brief "@include" で取り込んだファイルの内容を、展開前の形でまとめたもの。
+ * @details 取り込み指定が同じなら、ファイルを読み直さずに IniIncludeCache::Expand で同じ展開をやり直せる。
+ */
+struct IniIncluded
+{
+    std::string text;                 // 取り込んだファイルの内容 (取り込んだ順に連結)
+    std::vector<IniEntry> entries;    // 取り込んだエントリ (text 基準)
+    std::vector<IniInherit> inherits; // 取り込んだファイルの継承指定 (text 基準)
+
+    /**
+     * @brief 空にする (容量は保持する)。
+     */
+    void clear()
+    {
+        text.clear();
+        entries.clear();
+        inherits.clear();
+    }
+};
+
+/**
+ * @brief 直前に取り込んだ内容から値が変わったキー 1 つ (Settings::Diff が作る)。
+ */
+struct IniChange
+{
+    uint32_t id;  // 設定ハンドルの番号
+    bool removed; // キーが無くなった (false なら値が変わったか新たに現れた)
+};
+
+/**
+ * @brief 読み込み・解析済みの INI ファイル一式。別スレッドで作成して Settings へ受け渡す。
+ * @details "@include" で取り込んだファイルの内容と、継承で補ったキーの値は text の fileLength 以降に置かれる。
+ *          incremental が true なら、values 以降は Settings::Diff が監視スレッドで作った差分で、取り込み側は
+ *          changes のキーだけを統合し直せる (基準の内容が取り込み済みのものと異なれば entries から統合し直す)。
+ */
+struct IniDocument
+{
+    static constexpr uint32_t kWholeText = 0xFFFFFFFFu; // fileLength の既定値 (text 全体がファイル内容)
+
+    std::string text;                            // ファイル内容 (entries のスパン基準)
+    std::vector<IniEntry> entries;               // 解析済みエントリ (取り込み・継承を展開済み)
+    std::filesystem::file_time_type writeTime{}; // 読み込み時点の最終更新時刻
+    uint64_t hash = 0;                           // ファイル内容 (text の先頭 fileLength バイト) のハッシュ
+    uint32_t fileLength = kWholeText;            // text 先頭のうちファイル内容そのものである部分の長さ
+    std::vector<std::wstring> dependencies;      // "@include" で (間接的にも) 参照したファイル
+    uint64_t dependencyHash = 0;                 // dependencies の内容をまとめたハッシュ (参照が無ければ 0)
+    IniIncluded included;                        // 取り込んだ内容 (保存後の解析し直しで再利用する)
+    bool incremental = false;                    // values 以降の差分が有効
+    uint64_t baseHash = 0;                       // 差分の基準とした内容の hash
+    uint64_t baseDependencyHash = 0;             // 差分の基準とした内容の dependencyHash
+    std::vector<IniSpan> values;                 // ハンドルごとの値 (text 内。後勝ちで解決済み)
+    std::vector<IniSpan> origin;                 // ハンドルごとのファイル上の値の位置 (ファイルに無ければ offset が 0xFFFFFFFF)
+    std::vector<IniChange> changes;              // 基準の内容から値が変わったキー
+};
+
+/**
+ * @brief INI テキストを 1 パスで走査しエントリ位置を列挙する。
+ * @details 行ごとの文字列コピーは行わず、各エントリは text 内のオフセットとして out へ追記される。
+ *          out の容量は呼び出し側で再利用できるため、定常状態ではヒープ確保が発生しない。
+ * @param text 解析対象のテキスト。
+ * @param out 解析結果の追記先 (事前にクリアされる)。
+ */
+void ParseIni(std::string_view text, std::vector<IniEntry>& out);
+
+/**
+ * @brief INI テキストを走査し、エントリ位置に加えて "@include" 行とセクションの継承指定を列挙する。
+ * @details "[Section : Base]" の見出しは Section のエントリとして扱い、継承元を links へ記録する。
+ *          継承や取り込みの展開は行わない (IniIncludeCache::Resolve が行う)。
+ * @param text 解析対象のテキスト。
+ * @param out 解析結果の追記先 (事前にクリアされる)。
+ * @param links 参照指定の追記先 (事前にクリアされる)。
+ */
+void ParseIni(std::string_view text, std::vector<IniEntry>& out, IniLinks& links);
+
+/**
+ * @brief スパンが指す部分文字列を取得する。
+ * @param text スパンの基準となるバッファ。
+ * @param span 対象スパン。
+ * @return 部分文字列ビュー。
+ */
+inline std::string_view SpanView(std::string_view text, IniSpan span)
+{
+    return text.substr(span.offset, span.length);
+}
+
+/**
+ * @brief ファイル全体を 1 回の読み込みでバッファへ取り込む。
+ * @param path 読み込むファイルパス。
+ * @param out 読み込み先 (容量は再利用される)。
+ * @return 読み込みに成功した場合は true。
+ */
+bool ReadFileToBuffer(const std::wstring& path, std::string& out);
+
+/**
+ * @brief ファイルを読み込み解析して IniDocument を作る。I/O を伴うため描画スレッド外での利用を想定する。
+ * @param path 読み込むファイルパス。
+ * @param doc 出力先 (容量は再利用される)。
+ * @return 読み込みに成功した場合は true。
+ */
+bool LoadIniDocument(const std::wstring& path, IniDocument& doc);
+
+/**
+ * @brief コマンドライン引数 "--Category.Key=value" を INI テキストへ変換して追記する。
+ * @details カテゴリを省略した "--Key=value" は既定カテゴリ ("Default") として扱う。
+ *          値の中の ';' と '#' 以降は INI と同じくコメントとして無視される。
+ * @param arg コマンドライン引数 1 つ (UTF-8)。
+ * @param ini 追記先の INI テキスト。
+ * @return 上書き指定として解釈できた場合は true。
+ */
+bool AppendCommandLineOverride(std::string_view arg, std::string& ini);
+
+/**
+ * @brief 数値を書式化した結果を持つ固定長バッファ。ヒープ確保を伴わない。
+ */
+struct IniNumberText
+{
+    char data[32];     // 文字列 (終端文字なし)
+    uint32_t size = 0; // 文字数
+
+    /**
+     * @brief 書式化した文字列を参照する。
+     * @return 文字列ビュー。
+     */
+    std::string_view View() const
+    {
+        return std::string_view(data, size);
+    }
+};
+
+/**
+ * @brief 値文字列を倍精度浮動小数として解釈する。ロケールに依存せず、例外も投げない。
+ * @details 先頭の '+' を許し、文字列全体が 1 つの数値である場合だけ成功とする ("1.5abc" は失敗)。
+ * @param s 値文字列 (前後の空白は除去済み)。
+ * @param out 成功時の格納先 (失敗時は変更しない)。
+ * @return 成功なら std::errc{}、数値でなければ std::errc::invalid_argument、
+ *         double の範囲を超えれば std::errc::result_out_of_range。
+ */
+std::errc ParseIniNumber(std::string_view s, double& out);
+
+/**
+ * @brief 倍精度浮動小数を、読み戻すと同じ値になる最短の十進表記へ書式化する。ロケールに依存しない。
+ * @param v 書式化する値。
+ * @return 書式化結果 (例: 0.1 → "0.1"、2.0 → "2")。
+ */
+IniNumberText FormatIniNumber(double v);
+
+/**
+ * @brief 単精度浮動小数を、float として読み戻すと同じ値になる最短の十進表記へ書式化する。
+ * @details double へ広げてから書式化すると 0.1f が "0.10000000149011612" になるため、float の値はこちらを使う。
+ * @param v 書式化する値。
+ * @return 書式化結果。
+ */
+IniNumberText FormatIniNumber(float v);
+
+/**
+ * @brief 整数を十進表記へ書式化する。
+ * @param v 書式化する値。
+ * @return 書式化結果。
+ */
+IniNumberText FormatIniNumber(int v);
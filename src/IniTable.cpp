@@ -0,0 +1,321 @@
+/**
+ * @file IniTable.cpp
+ * @brief メモリマップ上の INI データ表の実装。
+ * @author 山内陽
+ */
+
+#include "IniTable.h"
+
+#include "Hash.h"
+
+#include <climits>
+#include <cstring>
+
+/**
+ * @brief 見出しの走査や表の作成で触れたページを物理メモリへ残す量の目安。これを超えたら写像のページを外す。
+ */
+static constexpr size_t kResidentLimit = 8u << 20;
+
+/**
+ * @brief 行が "[名前]" 形式の見出しか判定する。規則は ParseIni と同じ (コメント・前後空白を除いて判定)。
+ * @details "[名前 : 継承元]" は ParseIni と同じく名前だけを見出しとする。継承元のキーは補わない。
+ * @param text ファイル内容。
+ * @param begin 行頭。
+ * @param end 行末 (改行の位置)。
+ * @param name 見出しなら名前のスパンを受け取る。
+ * @return 見出しなら true。
+ */
+static bool ParseHeader(std::string_view text, size_t begin, size_t end, IniSpan& name)
+{
+    auto space = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+    while (begin < end && space(text[begin]))
+        ++begin;
+    if (begin == end || text[begin] != '[')
+        return false;
+
+    size_t last = begin;
+    while (last < end && text[last] != ';' && text[last] != '#')
+        ++last;
+    while (last > begin && space(text[last - 1]))
+        --last;
+    if (last - begin < 2 || text[last - 1] != ']')
+        return false;
+
+    size_t nb = begin + 1;
+    size_t ne = last - 1;
+    const void* colon = std::memchr(text.data() + nb, ':', ne - nb);
+    if (colon)
+        ne = static_cast<size_t>(static_cast<const char*>(colon) - text.data());
+    while (nb < ne && space(text[nb]))
+        ++nb;
+    while (ne > nb && space(text[ne - 1]))
+        --ne;
+    name = IniSpan{static_cast<uint32_t>(nb), static_cast<uint32_t>(ne - nb)};
+    return true;
+}
+
+/**
+ * @brief 見出しでない行が ParseIni でエントリになるキー行か判定する (コメント中の '=' や "@" 指令の行は除く)。
+ * @param text ファイル内容。
+ * @param begin 行頭。
+ * @param end 行末 (改行の位置)。
+ * @return キー行なら true。
+ */
+static bool IsKeyLine(std::string_view text, size_t begin, size_t end)
+{
+    auto space = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+    while (begin < end && space(text[begin]))
+        ++begin;
+    if (begin == end || text[begin] == '@')
+        return false;
+    for (size_t i = begin; i < end && text[i] != ';' && text[i] != '#'; ++i)
+    {
+        if (text[i] == '=')
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief ファイルを写像し、セクション見出しを索引にする。
+ * @details 1 行ずつ見出しかどうかだけを調べ、キー行の中身は解析しない。走査済みの範囲は kResidentLimit ごとに
+ *          物理メモリから外す。最初の見出しより前にキー行があれば、それを "Default" セクションの範囲とする
+ *          (コメント行の '=' では作らない)。
+ * @param path 対象ファイルパス。
+ * @return 成功した場合は true。
+ */
+bool IniTable::Open(const std::filesystem::path& path)
+{
+    Close();
+    if (!m_file.Open(path))
+        return false;
+    if (m_file.Size() > UINT32_MAX)
+    {
+        Close();
+        return false;
+    }
+
+    const std::string_view text = Text();
+    const char* base = text.data();
+    const size_t size = text.size();
+    uint32_t open = kNoSection;
+    bool preamble = false; // 最初の見出しより前にキー行があったか
+    size_t evicted = 0;
+    size_t pos = 0;
+
+    // 範囲を名前のセクションへ追加する。同名のセクションが既にあれば範囲を連結する
+    auto addBlock = [&](IniSpan name, size_t begin)
+    {
+        const std::string_view view = name.length ? SpanView(text, name) : std::string_view("Default");
+        const uint64_t hash = Hash64(view);
+        const uint32_t block = static_cast<uint32_t>(m_blocks.size());
+        m_blocks.push_back(Block{static_cast<uint32_t>(begin), static_cast<uint32_t>(size), kNoSection});
+        const uint32_t found = m_index.Find(hash, [&](uint32_t i) { return SectionName(i) == view; });
+        if (found != kNoSection)
+        {
+            m_blocks[m_sections[found].last].next = block;
+            m_sections[found].last = block;
+        }
+        else
+        {
+            m_index.Insert(hash, static_cast<uint32_t>(m_sections.size()));
+            m_sections.push_back(Section{name, block, block, nullptr});
+        }
+        return block;
+    };
+
+    while (pos < size)
+    {
+        const void* nl = std::memchr(base + pos, '\n', size - pos);
+        const size_t eol = nl ? static_cast<size_t>(static_cast<const char*>(nl) - base) : size;
+
+        IniSpan name;
+        if (ParseHeader(text, pos, eol, name))
+        {
+            if (open != kNoSection)
+                m_blocks[open].end = static_cast<uint32_t>(pos);
+            else if (preamble)
+                m_blocks[addBlock(IniSpan{}, 0)].end = static_cast<uint32_t>(pos);
+            open = addBlock(name, eol < size ? eol + 1 : size);
+        }
+        else if (open == kNoSection && !preamble)
+        {
+            preamble = IsKeyLine(text, pos, eol);
+        }
+        pos = eol + 1;
+
+        if (pos - evicted >= kResidentLimit && pos <= size)
+        {
+            m_file.Evict(evicted, pos - evicted);
+            evicted = pos;
+        }
+    }
+    if (open == kNoSection && preamble)
+        addBlock(IniSpan{}, 0);
+    m_file.Evict(evicted, size - evicted);
+    return true;
+}
+
+/**
+ * @brief 索引と写像を破棄する。
+ */
+void IniTable::Close()
+{
+    m_sections.clear();
+    m_blocks.clear();
+    m_index.Clear();
+    m_touched = 0;
+    m_file.Close();
+}
+
+/**
+ * @brief セクション名を取得する。
+ * @param section セクション番号。
+ * @return セクション名。
+ */
+std::string_view IniTable::SectionName(uint32_t section) const
+{
+    const IniSpan name = m_sections[section].name;
+    return name.length ? SpanView(Text(), name) : std::string_view("Default");
+}
+
+/**
+ * @brief セクション名のハッシュ索引を引く。
+ * @param name セクション名。
+ * @return セクション番号、無ければ kNoSection。
+ */
+uint32_t IniTable::FindSection(std::string_view name) const
+{
+    return m_index.Find(Hash64(name), [&](uint32_t i) { return SectionName(i) == name; });
+}
+
+/**
+ * @brief セクションのすべての範囲を解析し、キー名のハッシュ索引付きの表を作る。同じキーは後勝ち。
+ * @param section セクション番号。
+ * @return 作成済みの表。
+ */
+const IniTable::Table& IniTable::Materialize(uint32_t section)
+{
+    Section& s = m_sections[section];
+    if (s.table)
+        return *s.table;
+
+    // 表を作るたびに触れるページが増えていくため、一定量を超えたら写像全体のページを外す。
+    // 読み取り専用の写像なので、作成済みの表の値も次に触れた時点でファイル (ページキャッシュ) から読み直される。
+    // OS はフォールト時に周囲のページもまとめて写像するため、セクション単位で外すより確実に常駐量を抑えられる
+    for (uint32_t b = s.first; b != kNoSection; b = m_blocks[b].next)
+        m_touched += m_blocks[b].end - m_blocks[b].begin;
+    if (m_touched >= kResidentLimit)
+    {
+        m_file.Evict(0, m_file.Size());
+        m_touched = 0;
+    }
+
+    auto table = std::make_unique<Table>();
+    const std::string_view text = Text();
+    for (uint32_t b = s.first; b != kNoSection; b = m_blocks[b].next)
+    {
+        const Block& block = m_blocks[b];
+        ParseIni(text.substr(block.begin, block.end - block.begin), m_entries);
+        for (const IniEntry& e : m_entries)
+        {
+            const IniSpan key{e.key.offset + block.begin, e.key.length};
+            const IniSpan value{e.value.offset + block.begin, e.value.length};
+            const std::string_view name = SpanView(text, key);
+            const uint64_t hash = Hash64(name);
+            const uint32_t found =
+                table->index.Find(hash, [&](uint32_t i) { return SpanView(text, table->entries[i].key) == name; });
+            if (found != FlatIndex::kNone)
+            {
+                table->entries[found].value = value;
+                continue;
+            }
+            table->index.Insert(hash, static_cast<uint32_t>(table->entries.size()));
+            table->entries.push_back(Entry{key, value});
+        }
+    }
+    s.table = std::move(table);
+    return *s.table;
+}
+
+/**
+ * @brief セクション番号とキー名で値を取得する。
+ * @param section セクション番号。
+ * @param key キー名。
+ * @return 値、無ければ std::nullopt。
+ */
+std::optional<std::string_view> IniTable::Get(uint32_t section, std::string_view key)
+{
+    if (section >= m_sections.size())
+        return std::nullopt;
+    const Table& t = Materialize(section);
+    const std::string_view text = Text();
+    const uint32_t found =
+        t.index.Find(Hash64(key), [&](uint32_t i) { return SpanView(text, t.entries[i].key) == key; });
+    if (found == FlatIndex::kNone)
+        return std::nullopt;
+    return SpanView(text, t.entries[found].value);
+}
+
+/**
+ * @brief セクション名とキー名で値を取得する。
+ * @param section セクション名。
+ * @param key キー名。
+ * @return 値、無ければ std::nullopt。
+ */
+std::optional<std::string_view> IniTable::Get(std::string_view section, std::string_view key)
+{
+    return Get(FindSection(section), key);
+}
+
+/**
+ * @brief セクション内のキー数を取得する。
+ * @param section セクション番号。
+ * @return キー数。
+ */
+size_t IniTable::KeyCount(uint32_t section)
+{
+    return Materialize(section).entries.size();
+}
+
+/**
+ * @brief セクション内の i 番目のキー名を取得する。
+ * @param section セクション番号。
+ * @param i 添字。
+ * @return キー名。
+ */
+std::string_view IniTable::KeyAt(uint32_t section, size_t i) const
+{
+    return SpanView(Text(), m_sections[section].table->entries[i].key);
+}
+
+/**
+ * @brief セクション内の i 番目の値を取得する。
+ * @param section セクション番号。
+ * @param i 添字。
+ * @return 値。
+ */
+std::string_view IniTable::ValueAt(uint32_t section, size_t i) const
+{
+    return SpanView(Text(), m_sections[section].table->entries[i].value);
+}
+
+/**
+ * @brief セクションの表を破棄する。
+ * @param section セクション番号。
+ */
+void IniTable::Release(uint32_t section)
+{
+    m_sections[section].table.reset();
+}
+
+/**
+ * @brief すべてのセクションの表を破棄する。
+ */
+void IniTable::ReleaseAll()
+{
+    for (Section& s : m_sections)
+        s.table.reset();
+    m_file.Evict(0, m_file.Size());
+    m_touched = 0;
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include "FlatIndex.h"
+#include "IniParser.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file IniTable.h
+ * @brief 巨大な INI 形式のデータ表をメモリマップから遅延読み込みするクラスの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 数百 MB 規模の読み取り専用 INI データ表を、ファイルを複写せずに引く表。
+ * @details Open はファイルをメモリマップし、セクション見出しの位置だけを 1 回走査して索引にする。
+ *          セクションのキー・値の表は最初に参照された時点で初めて作られ、値は写像領域を直接指すビューとして返す。
+ *          走査や表の作成で触れたページは一定量ごとに物理メモリから外すため、ファイル内容の常駐量はファイルサイズに
+ *          よらず一定に収まる (ヒープはセクション数と作成済みの表のキー数に比例する)。
+ *          不要になったセクションの表は Release で破棄できる。
+ *          同名のセクションが複数回現れた場合は 1 つにまとめ、同じキーは後勝ちとする (ParseIni と同じ規則)。
+ *          "[Section : Base]" の見出しは Section として扱うが、継承元のキーは補わない ("@include" も展開しない)。
+ *          保存・ホットリロード・レイヤー合成は行わない。アプリケーションの設定には Settings を用いる。
+ */
+class IniTable
+{
+public:
+    static constexpr uint32_t kNoSection = FlatIndex::kNone; // 見つからないセクションを表す番号
+
+    IniTable() = default;
+    IniTable(const IniTable&) = delete;
+    IniTable& operator=(const IniTable&) = delete;
+
+    /**
+     * @brief ファイルを写像し、セクション見出しを索引にする。既に開いていれば先に閉じる。
+     * @param path 対象ファイルパス。
+     * @return 成功した場合は true (4 GiB 以上のファイルは扱わない)。
+     */
+    bool Open(const std::filesystem::path& path);
+
+    /**
+     * @brief 索引と写像を破棄する。
+     */
+    void Close();
+
+    /**
+     * @brief セクション数を取得する。
+     * @return 名前の異なるセクションの数。
+     */
+    uint32_t SectionCount() const
+    {
+        return static_cast<uint32_t>(m_sections.size());
+    }
+
+    /**
+     * @brief セクション名を取得する。
+     * @param section セクション番号。
+     * @return セクション名 (最初の見出しより前のキーは "Default")。
+     */
+    std::string_view SectionName(uint32_t section) const;
+
+    /**
+     * @brief セクションを名前で検索する。表は作らない。
+     * @param name セクション名。
+     * @return セクション番号、無ければ kNoSection。
+     */
+    uint32_t FindSection(std::string_view name) const;
+
+    /**
+     * @brief 値を取得する。セクションの表が未作成ならここで作る。
+     * @param section セクション番号。
+     * @param key キー名。
+     * @return 値 (写像領域を指すビュー。Close まで有効)。無ければ std::nullopt。
+     */
+    std::optional<std::string_view> Get(uint32_t section, std::string_view key);
+
+    /**
+     * @brief 値を取得する。
+     * @param section セクション名。
+     * @param key キー名。
+     * @return 値、無ければ std::nullopt。
+     */
+    std::optional<std::string_view> Get(std::string_view section, std::string_view key);
+
+    /**
+     * @brief セクション内のキー数を取得する。セクションの表が未作成ならここで作る。
+     * @param section セクション番号。
+     * @return キー数 (重複は 1 つに数える)。
+     */
+    size_t KeyCount(uint32_t section);
+
+    /**
+     * @brief セクション内の i 番目のキー名を取得する (最初に現れた順)。
+     * @param section セクション番号 (KeyCount で表を作成済みであること)。
+     * @param i 添字。
+     * @return キー名。
+     */
+    std::string_view KeyAt(uint32_t section, size_t i) const;
+
+    /**
+     * @brief セクション内の i 番目の値を取得する。
+     * @param section セクション番号 (KeyCount で表を作成済みであること)。
+     * @param i 添字。
+     * @return 値。
+     */
+    std::string_view ValueAt(uint32_t section, size_t i) const;
+
+    /**
+     * @brief セクションの表が作成済みか判定する。
+     * @param section セクション番号。
+     * @return 作成済みなら true。
+     */
+    bool IsLoaded(uint32_t section) const
+    {
+        return m_sections[section].table != nullptr;
+    }
+
+    /**
+     * @brief セクションの表を破棄する。以前に返した値のビューは Close まで有効のまま。
+     * @param section セクション番号。
+     */
+    void Release(uint32_t section);
+
+    /**
+     * @brief すべてのセクションの表を破棄し、写像のページを物理メモリから外す。
+     */
+    void ReleaseAll();
+
+private:
+    /**
+     * @brief 1 つの見出しに続くキー行の範囲。同名セクションの範囲は next で連結する。
+     */
+    struct Block
+    {
+        uint32_t begin; // 見出しの次の行の先頭
+        uint32_t end;   // 次の見出し行の先頭 (またはファイル末尾)
+        uint32_t next;  // 同名セクションの次の範囲 (無ければ kNoSection)
+    };
+
+    /**
+     * @brief セクション内の 1 つのキー・値。位置は写像領域の先頭基準。
+     */
+    struct Entry
+    {
+        IniSpan key;   // キー名
+        IniSpan value; // 値
+    };
+
+    /**
+     * @brief 参照時に作るセクションのキー・値の表。
+     */
+    struct Table
+    {
+        std::vector<Entry> entries; // 最初に現れた順のキー・値
+        FlatIndex index;            // キー名のハッシュ値から entries の添字を引く索引
+    };
+
+    /**
+     * @brief 名前の異なるセクション 1 つ分の情報。
+     */
+    struct Section
+    {
+        IniSpan name;                 // セクション名 (写像領域内。長さ 0 は "Default")
+        uint32_t first;               // 最初の範囲 (m_blocks の添字)
+        uint32_t last;                // 最後の範囲
+        std::unique_ptr<Table> table; // キー・値の表 (未作成なら nullptr)
+    };
+
+    /**
+     * @brief セクションの表を作る。
+     * @param section セクション番号。
+     * @return 作成済みの表。
+     */
+    const Table& Materialize(uint32_t section);
+
+    /**
+     * @brief 写像領域全体のビューを取得する。
+     * @return ファイル内容。
+     */
+    std::string_view Text() const
+    {
+        return std::string_view(m_file.Data(), m_file.Size());
+    }
+
+    MappedFile m_file;               // 写像したファイル
+    std::vector<Block> m_blocks;     // 見出しごとの範囲 (ファイル上の順)
+    std::vector<Section> m_sections; // 名前の異なるセクション (初出順)
+    FlatIndex m_index;               // セクション名のハッシュ値から m_sections の添字を引く索引
+    std::vector<IniEntry> m_entries; // 表の作成時の解析結果の作業領域 (容量を再利用)
+    size_t m_touched = 0;            // 最後にページを外してから表の作成で触れたバイト数
+};
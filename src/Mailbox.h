@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <memory>
+
+/**
+ * @file Mailbox.h
+ * @brief スレッド間で最新の値だけを受け渡すロックフリーな単一スロットの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 1 要素だけを保持するロックフリーなメールボックス。
+ * @details 送信側は Post で最新の値を置き、受信側は Take で取り出す。未受信の値は新しい値で上書き
+ *          (破棄) されるため、受信側は常に最新の値だけを受け取る。操作はポインタ 1 個の交換のみ。
+ * @tparam T 受け渡す値の型。
+ */
+template <typename T>
+class Mailbox
+{
+public:
+    Mailbox() = default;
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    /**
+     * @brief 未受信の値を破棄する。
+     */
+    ~Mailbox()
+    {
+        delete m_slot.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 値を置く。未受信の古い値があれば破棄する。
+     * @param item 受け渡す値。
+     */
+    void Post(std::unique_ptr<T> item)
+    {
+        delete m_slot.exchange(item.release(), std::memory_order_acq_rel);
+    }
+
+    /**
+     * @brief 値を取り出す。
+     * @return 値があればその所有権、無ければ nullptr。
+     */
+    std::unique_ptr<T> Take()
+    {
+        if (!m_slot.load(std::memory_order_relaxed))
+            return nullptr;
+        return std::unique_ptr<T>(m_slot.exchange(nullptr, std::memory_order_acq_rel));
+    }
+
+private:
+    std::atomic<T*> m_slot{nullptr}; // 未受信の値 (無ければ nullptr)
+};
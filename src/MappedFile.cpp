@@ -0,0 +1,164 @@
+/**
+ * @file MappedFile.cpp
+ * @brief 読み取り専用メモリマップの実装。
+ * @author 山内陽
+ */
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief 写像を解除する。
+ */
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+/**
+ * @brief ファイルを開いて写像する。
+ * @param path 対象ファイルパス。
+ * @return 成功した場合は true。
+ */
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+    Close();
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    if (size.QuadPart == 0)
+        return true;
+
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping)
+    {
+        Close();
+        return false;
+    }
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+        Close();
+        return false;
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+/**
+ * @brief 写像を解除してファイルを閉じる。
+ */
+void MappedFile::Close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+/**
+ * @brief 範囲内のページを作業セットから外す。
+ * @param offset 先頭からのバイトオフセット。
+ * @param size バイト数。
+ */
+void MappedFile::Evict(size_t offset, size_t size) const
+{
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    const size_t page = info.dwPageSize;
+    const size_t begin = offset / page * page;
+    const size_t end = (offset + size + page - 1) / page * page;
+    if (!m_data || end <= begin)
+        return;
+    // ロックしていないページへの VirtualUnlock は失敗を返すが、作業セットからは外れる
+    VirtualUnlock(const_cast<char*>(m_data) + begin, end - begin);
+}
+
+#else
+
+/**
+ * @brief ファイルを開いて写像する。
+ * @param path 対象ファイルパス。
+ * @return 成功した場合は true。
+ */
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size > 0)
+    {
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        m_data = static_cast<const char*>(p);
+        m_size = static_cast<size_t>(st.st_size);
+    }
+    // 写像はディスクリプタを閉じても有効
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief 写像を解除する。
+ */
+void MappedFile::Close()
+{
+    if (m_data)
+        munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+/**
+ * @brief 範囲内のページを解放する。読み取り専用の写像なので内容はファイルから読み直される。
+ * @param offset 先頭からのバイトオフセット。
+ * @param size バイト数。
+ */
+void MappedFile::Evict(size_t offset, size_t size) const
+{
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset / page * page;
+    const size_t end = (offset + size + page - 1) / page * page;
+    if (!m_data || end <= begin)
+        return;
+    madvise(const_cast<char*>(m_data) + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif
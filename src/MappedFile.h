@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+/**
+ * @file MappedFile.h
+ * @brief ファイルを読み取り専用でメモリへ写像するクラスの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief ファイル全体を読み取り専用でメモリマップする。
+ * @details Windows では CreateFileMappingW / MapViewOfFile、それ以外では mmap を用いる。
+ *          写像した領域はページ単位で必要になった時点で読み込まれるため、開くだけならファイルサイズに依存しない。
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief 写像を解除する。
+     */
+    ~MappedFile();
+
+    /**
+     * @brief ファイルを開いて写像する。既に開いていれば先に閉じる。
+     * @param path 対象ファイルパス。
+     * @return 成功した場合は true (空ファイルも成功とし、Data() は nullptr を返す)。
+     */
+    bool Open(const std::filesystem::path& path);
+
+    /**
+     * @brief 写像を解除してファイルを閉じる。
+     */
+    void Close();
+
+    /**
+     * @brief 写像した領域の先頭を取得する。
+     * @return 先頭ポインタ (未オープンまたは空ファイルなら nullptr)。
+     */
+    const char* Data() const
+    {
+        return m_data;
+    }
+
+    /**
+     * @brief 写像した領域のバイト数を取得する。
+     * @return バイト数。
+     */
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief 範囲内のページを物理メモリから外す。内容は保たれ、次に触れた時点でファイルから読み直される。
+     * @details 大きなファイルを順に走査する際、読み終えた範囲を外すことで常駐量を一定に抑えるために使う。
+     *          範囲はページ境界まで広げる (写像は読み取り専用のため、隣接する範囲のページを外しても害は無い)。
+     * @param offset 先頭からのバイトオフセット。
+     * @param size バイト数。
+     */
+    void Evict(size_t offset, size_t size) const;
+
+private:
+    const char* m_data = nullptr; // 写像領域の先頭
+    size_t m_size = 0;            // 写像領域のバイト数
+#if defined(_WIN32)
+    void* m_file = nullptr;    // ファイルハンドル
+    void* m_mapping = nullptr; // ファイルマッピングオブジェクト
+#endif
+};
@@ -0,0 +1,322 @@
+/**
+ * @file RecordingRenderDevice.cpp
+ * @brief 描画せずにコマンドを記録するヘッドレスのレンダーデバイスの実装。
+ * @author 山内陽
+ */
+
+#include "RecordingRenderDevice.h"
+#include "Hash.h"
+
+/**
+ * @brief 内容のハッシュを計算する。
+ * @return ハッシュ。
+ */
+uint64_t RenderCommandBuffer::Hash() const
+{
+    return Hash64(m_bytes.data(), m_bytes.size());
+}
+
+/**
+ * @brief リソースの枠を確保する。空きがあれば使い回す。
+ * @param type 種類。
+ * @return ハンドル。
+ */
+RenderDevice::Handle RecordingRenderDevice::Allocate(Type type)
+{
+    Handle handle;
+    if (!m_freeList.empty())
+    {
+        handle = m_freeList.back();
+        m_freeList.pop_back();
+    }
+    else
+    {
+        m_resources.emplace_back();
+        handle = static_cast<Handle>(m_resources.size());
+    }
+    m_resources[handle - 1] = Resource{};
+    m_resources[handle - 1].type = type;
+    return handle;
+}
+
+/**
+ * @brief ハンドルが指定の種類のリソースを指しているか確かめる。違えば invalid を数える。
+ * @param handle ハンドル。
+ * @param type 期待する種類。
+ * @return リソース。無効なら nullptr。
+ */
+RecordingRenderDevice::Resource* RecordingRenderDevice::Find(Handle handle, Type type)
+{
+    if (handle == kNoHandle || handle > m_resources.size() || m_resources[handle - 1].type != type)
+    {
+        ++m_stats.invalid;
+        return nullptr;
+    }
+    return &m_resources[handle - 1];
+}
+
+/**
+ * @brief バッファを作成する。動的バッファは CPU 側に内容の置き場を確保する。
+ * @param kind 用途。
+ * @param bytes 大きさ (バイト)。
+ * @param initial 初期内容 (nullptr なら動的バッファ)。
+ * @return ハンドル。
+ */
+RenderDevice::Handle RecordingRenderDevice::CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial)
+{
+    if (bytes == 0)
+    {
+        ++m_stats.invalid;
+        return kNoHandle;
+    }
+    const Handle handle = Allocate(Type::Buffer);
+    Resource& r = m_resources[handle - 1];
+    r.kind = kind;
+    r.bytes = bytes;
+    r.dynamic = initial == nullptr;
+    if (r.dynamic)
+        r.data.resize(bytes);
+    const uint8_t dynamic = r.dynamic ? 1 : 0;
+    const RenderCmdCreateBuffer cmd{handle, bytes, static_cast<uint8_t>(kind), dynamic, {}};
+    m_current.Write(RenderOp::CreateBuffer, cmd);
+    return handle;
+}
+
+/**
+ * @brief テクスチャを作成する。画素は保持しない。
+ * @param width 幅 (ピクセル)。
+ * @param height 高さ (ピクセル)。
+ * @param rgba 画素。
+ * @return ハンドル。
+ */
+RenderDevice::Handle RecordingRenderDevice::CreateTexture(uint32_t width, uint32_t height, const void* rgba)
+{
+    if (width == 0 || height == 0 || !rgba)
+    {
+        ++m_stats.invalid;
+        return kNoHandle;
+    }
+    const Handle handle = Allocate(Type::Texture);
+    m_current.Write(RenderOp::CreateTexture, RenderCmdCreateTexture{handle, width, height});
+    return handle;
+}
+
+/**
+ * @brief パイプラインを作成する。シェーダーはコンパイルせず、レイアウトと状態のフラグだけを記録する。
+ * @param desc 記述。
+ * @return ハンドル。
+ */
+RenderDevice::Handle RecordingRenderDevice::CreatePipeline(const PipelineDesc& desc)
+{
+    if (desc.layout.empty())
+    {
+        ++m_stats.invalid;
+        return kNoHandle;
+    }
+    const Handle handle = Allocate(Type::Pipeline);
+    const uint8_t flags = static_cast<uint8_t>((desc.tinted ? 1 : 0) | (desc.textured ? 2 : 0) |
+                                               (desc.alphaBlend ? 4 : 0) | (desc.scissor ? 8 : 0));
+    m_current.Write(RenderOp::CreatePipeline,
+                    RenderCmdCreatePipeline{handle, static_cast<uint8_t>(desc.layout.size()), flags, {}});
+    return handle;
+}
+
+/**
+ * @brief リソースを破棄し、ハンドルを再利用できるようにする。
+ * @param handle 破棄するリソース。
+ */
+void RecordingRenderDevice::Destroy(Handle handle)
+{
+    if (handle == kNoHandle)
+        return;
+    if (handle > m_resources.size() || m_resources[handle - 1].type == Type::None)
+    {
+        ++m_stats.invalid;
+        return;
+    }
+    m_resources[handle - 1] = Resource{};
+    m_freeList.push_back(handle);
+    m_current.Write(RenderOp::Destroy, RenderCmdHandle{handle});
+}
+
+/**
+ * @brief 動的バッファの CPU 側の置き場を返す。
+ * @param buffer 動的バッファ。
+ * @return 書き込み先。静的バッファや Map 中のバッファなら nullptr。
+ */
+void* RecordingRenderDevice::MapBuffer(Handle buffer)
+{
+    Resource* r = Find(buffer, Type::Buffer);
+    if (!r)
+        return nullptr;
+    if (!r->dynamic || r->mapped)
+    {
+        ++m_stats.invalid;
+        return nullptr;
+    }
+    r->mapped = true;
+    return r->data.data();
+}
+
+/**
+ * @brief 書き込みを終え、大きさと内容のハッシュを記録する。
+ * @param buffer 動的バッファ。
+ */
+void RecordingRenderDevice::UnmapBuffer(Handle buffer)
+{
+    Resource* r = Find(buffer, Type::Buffer);
+    if (!r)
+        return;
+    if (!r->mapped)
+    {
+        ++m_stats.invalid;
+        return;
+    }
+    r->mapped = false;
+    m_uploadBytes += r->bytes;
+    m_current.Write(RenderOp::UpdateBuffer, RenderCmdUpdateBuffer{buffer, r->bytes, Hash64(r->data.data(), r->bytes)});
+}
+
+/**
+ * @brief 描画先の大きさの変更を記録する。
+ * @param width 幅 (ピクセル)。
+ * @param height 高さ (ピクセル)。
+ * @return 大きさが 0 でなければ true。
+ */
+bool RecordingRenderDevice::Resize(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+        return false;
+    m_current.Write(RenderOp::Resize, RenderCmdResize{width, height});
+    return true;
+}
+
+/**
+ * @brief フレームの開始を記録し、描画状態を初期化する。
+ * @param clear クリアカラー。
+ */
+void RecordingRenderDevice::BeginPass(const float clear[4])
+{
+    m_inPass = true;
+    m_hasPipeline = m_hasVertices = m_hasIndices = false;
+    m_current.Write(RenderOp::BeginPass, RenderCmdBeginPass{{clear[0], clear[1], clear[2], clear[3]}});
+}
+
+/**
+ * @brief パイプラインの設定を記録する。
+ * @param pipeline パイプライン。
+ */
+void RecordingRenderDevice::SetPipeline(Handle pipeline)
+{
+    m_hasPipeline = Find(pipeline, Type::Pipeline) != nullptr;
+    m_current.Write(RenderOp::SetPipeline, RenderCmdHandle{pipeline});
+}
+
+/**
+ * @brief 頂点バッファの設定を記録する。
+ * @param buffer 頂点バッファ。
+ * @param stride 頂点 1 つのバイト数。
+ */
+void RecordingRenderDevice::SetVertexBuffer(Handle buffer, uint32_t stride)
+{
+    m_hasVertices = Find(buffer, Type::Buffer) != nullptr;
+    m_current.Write(RenderOp::SetVertexBuffer, RenderCmdSetVertexBuffer{buffer, stride});
+}
+
+/**
+ * @brief インデックスバッファの設定を記録する。
+ * @param buffer インデックスバッファ。
+ * @param format インデックスの型。
+ */
+void RecordingRenderDevice::SetIndexBuffer(Handle buffer, IndexFormat format)
+{
+    m_hasIndices = Find(buffer, Type::Buffer) != nullptr;
+    m_current.Write(RenderOp::SetIndexBuffer, RenderCmdSetIndexBuffer{buffer, static_cast<uint8_t>(format), {}});
+}
+
+/**
+ * @brief 定数バッファの設定を記録する。
+ * @param buffer 定数バッファ。
+ */
+void RecordingRenderDevice::SetConstantBuffer(Handle buffer)
+{
+    Find(buffer, Type::Buffer);
+    m_current.Write(RenderOp::SetConstantBuffer, RenderCmdHandle{buffer});
+}
+
+/**
+ * @brief テクスチャの設定を記録する。
+ * @param texture テクスチャ。
+ */
+void RecordingRenderDevice::SetTexture(Handle texture)
+{
+    Find(texture, Type::Texture);
+    m_current.Write(RenderOp::SetTexture, RenderCmdHandle{texture});
+}
+
+/**
+ * @brief シザー矩形の設定を記録する。
+ * @param rect 矩形。
+ */
+void RecordingRenderDevice::SetScissor(const ScissorRect& rect)
+{
+    m_current.Write(RenderOp::SetScissor, rect);
+}
+
+/**
+ * @brief 描画を記録する。
+ * @param vertexCount 頂点数。
+ * @param firstVertex 最初の頂点。
+ */
+void RecordingRenderDevice::Draw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    if (!m_inPass || !m_hasPipeline || !m_hasVertices)
+        ++m_stats.invalid;
+    ++m_draws;
+    m_triangles += vertexCount / 3;
+    m_current.Write(RenderOp::Draw, RenderCmdDraw{vertexCount, firstVertex});
+}
+
+/**
+ * @brief インデックス付きの描画を記録する。
+ * @param indexCount インデックス数。
+ * @param firstIndex 最初のインデックス。
+ * @param baseVertex 各インデックスへ足す値。
+ */
+void RecordingRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+    if (!m_inPass || !m_hasPipeline || !m_hasVertices || !m_hasIndices)
+        ++m_stats.invalid;
+    ++m_draws;
+    m_triangles += indexCount / 3;
+    m_current.Write(RenderOp::DrawIndexed, RenderCmdDrawIndexed{indexCount, firstIndex, baseVertex});
+}
+
+/**
+ * @brief フレームの記録を確定し、集計を更新する。待機はしない。
+ * @param vsync 垂直同期を待つ場合は true (記録するだけ)。
+ * @return 常に PresentResult::Ok。
+ */
+PresentResult RecordingRenderDevice::Present(bool vsync)
+{
+    if (!m_inPass)
+        ++m_stats.invalid;
+    m_current.Write(RenderOp::Present, RenderCmdPresent{vsync ? uint8_t(1) : uint8_t(0)});
+
+    ++m_stats.frames;
+    m_stats.commands = m_current.Count();
+    m_stats.bytes = m_current.Bytes();
+    m_stats.draws = m_draws;
+    m_stats.triangles = m_triangles;
+    m_stats.uploadBytes = m_uploadBytes;
+    m_stats.hash = m_current.Hash();
+
+    // 直前のフレームのバッファを次の記録に回し、容量を使い回す
+    m_last.Swap(m_current);
+    m_current.Clear();
+    m_draws = 0;
+    m_triangles = 0;
+    m_uploadBytes = 0;
+    m_inPass = false;
+    return PresentResult::Ok;
+}
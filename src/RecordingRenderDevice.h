@@ -0,0 +1,363 @@
+#pragma once
+#include "RenderDevice.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @file RecordingRenderDevice.h
+ * @brief 描画せずにコマンドを記録するヘッドレスのレンダーデバイスの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 記録するコマンドの種類。RenderDevice のメソッドに 1 対 1 で対応する。
+ */
+enum class RenderOp : uint8_t
+{
+    CreateBuffer,      // RenderCmdCreateBuffer
+    CreateTexture,     // RenderCmdCreateTexture
+    CreatePipeline,    // RenderCmdCreatePipeline
+    Destroy,           // RenderCmdHandle
+    UpdateBuffer,      // RenderCmdUpdateBuffer (Unmap の時点で記録する)
+    Resize,            // RenderCmdResize
+    BeginPass,         // RenderCmdBeginPass
+    SetPipeline,       // RenderCmdHandle
+    SetVertexBuffer,   // RenderCmdSetVertexBuffer
+    SetIndexBuffer,    // RenderCmdSetIndexBuffer
+    SetConstantBuffer, // RenderCmdHandle
+    SetTexture,        // RenderCmdHandle
+    SetScissor,        // ScissorRect
+    Draw,              // RenderCmdDraw
+    DrawIndexed,       // RenderCmdDrawIndexed
+    Present,           // RenderCmdPresent
+};
+
+/**
+ * @brief リソース 1 つを対象とするコマンドの引数。
+ */
+struct RenderCmdHandle
+{
+    uint32_t handle; // 対象のリソース
+};
+
+/**
+ * @brief CreateBuffer の引数。
+ */
+struct RenderCmdCreateBuffer
+{
+    uint32_t handle; // 作成したバッファ
+    uint32_t bytes;  // 大きさ
+    uint8_t kind;    // BufferKind
+    uint8_t dynamic; // 動的バッファなら 1
+    uint8_t pad[2];  // 0 (ハッシュが不定にならないよう詰め物を明示する)
+};
+
+/**
+ * @brief CreateTexture の引数。
+ */
+struct RenderCmdCreateTexture
+{
+    uint32_t handle; // 作成したテクスチャ
+    uint32_t width;  // 幅
+    uint32_t height; // 高さ
+};
+
+/**
+ * @brief CreatePipeline の引数。
+ */
+struct RenderCmdCreatePipeline
+{
+    uint32_t handle;    // 作成したパイプライン
+    uint8_t attributes; // 頂点属性の数
+    uint8_t flags;      // bit0: tinted, bit1: textured, bit2: alphaBlend, bit3: scissor
+    uint8_t pad[2];     // 0
+};
+
+/**
+ * @brief 動的バッファへの書き込みの記録。
+ */
+struct RenderCmdUpdateBuffer
+{
+    uint32_t handle; // 書き込んだバッファ
+    uint32_t bytes;  // 大きさ
+    uint64_t hash;   // 内容のハッシュ
+};
+
+/**
+ * @brief Resize の引数。
+ */
+struct RenderCmdResize
+{
+    uint32_t width;  // 幅
+    uint32_t height; // 高さ
+};
+
+/**
+ * @brief BeginPass の引数。
+ */
+struct RenderCmdBeginPass
+{
+    float clear[4]; // クリアカラー
+};
+
+/**
+ * @brief SetVertexBuffer の引数。
+ */
+struct RenderCmdSetVertexBuffer
+{
+    uint32_t handle; // 頂点バッファ
+    uint32_t stride; // 頂点 1 つのバイト数
+};
+
+/**
+ * @brief SetIndexBuffer の引数。
+ */
+struct RenderCmdSetIndexBuffer
+{
+    uint32_t handle; // インデックスバッファ
+    uint8_t format;  // IndexFormat
+    uint8_t pad[3];  // 0
+};
+
+/**
+ * @brief Draw の引数。
+ */
+struct RenderCmdDraw
+{
+    uint32_t vertexCount; // 頂点数
+    uint32_t firstVertex; // 最初の頂点
+};
+
+/**
+ * @brief DrawIndexed の引数。
+ */
+struct RenderCmdDrawIndexed
+{
+    uint32_t indexCount; // インデックス数
+    uint32_t firstIndex; // 最初のインデックス
+    int32_t baseVertex;  // 各インデックスへ足す値
+};
+
+/**
+ * @brief Present の引数。
+ */
+struct RenderCmdPresent
+{
+    uint8_t vsync; // 垂直同期を待つなら 1
+};
+
+/**
+ * @brief コマンドを詰めて並べるバイト列。
+ * @details 1 コマンドは 1 バイトの種類、1 バイトの引数の大きさ、引数の順に並ぶ。引数の構造体はそのまま書き込むため、
+ *          詰め物はメンバーとして明示して 0 で埋め、同じ呼び出しからは同じバイト列ができるようにしている。
+ *          Clear は容量を残すため、フレームごとに使い回せば定常状態ではヒープ確保が起きない。
+ */
+class RenderCommandBuffer
+{
+public:
+    /**
+     * @brief コマンドを追記する。
+     * @tparam T 引数の型 (RenderCmd の構造体)。
+     * @param op 種類。
+     * @param args 引数。
+     */
+    template <typename T>
+    void Write(RenderOp op, const T& args)
+    {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= 255, "引数は 255 バイト以下の POD に限る");
+        const size_t at = m_bytes.size();
+        m_bytes.resize(at + 2 + sizeof(T));
+        m_bytes[at] = static_cast<uint8_t>(op);
+        m_bytes[at + 1] = static_cast<uint8_t>(sizeof(T));
+        std::memcpy(&m_bytes[at + 2], &args, sizeof(T));
+        ++m_count;
+    }
+
+    /**
+     * @brief 記録したコマンドを順に渡す。
+     * @tparam Func void(RenderOp op, const uint8_t* args, size_t size) として呼べる関数。
+     * @param func 各コマンドで呼ぶ関数。
+     */
+    template <typename Func>
+    void ForEach(Func&& func) const
+    {
+        for (size_t at = 0; at + 2 <= m_bytes.size();)
+        {
+            const size_t size = m_bytes[at + 1];
+            func(static_cast<RenderOp>(m_bytes[at]), m_bytes.data() + at + 2, size);
+            at += 2 + size;
+        }
+    }
+
+    /**
+     * @brief 記録を空にする (容量は残す)。
+     */
+    void Clear()
+    {
+        m_bytes.clear();
+        m_count = 0;
+    }
+
+    /**
+     * @brief 内容を入れ替える。
+     * @param other 相手。
+     */
+    void Swap(RenderCommandBuffer& other)
+    {
+        m_bytes.swap(other.m_bytes);
+        std::swap(m_count, other.m_count);
+    }
+
+    /**
+     * @brief コマンド数を取得する。
+     * @return コマンド数。
+     */
+    size_t Count() const
+    {
+        return m_count;
+    }
+
+    /**
+     * @brief バイト数を取得する。
+     * @return バイト数。
+     */
+    size_t Bytes() const
+    {
+        return m_bytes.size();
+    }
+
+    /**
+     * @brief 内容のハッシュを計算する。同じコマンド列 (アップロードの内容を含む) なら同じ値になる。
+     * @return ハッシュ。
+     */
+    uint64_t Hash() const;
+
+private:
+    std::vector<uint8_t> m_bytes; // コマンド列
+    size_t m_count = 0;           // コマンド数
+};
+
+/**
+ * @brief 直近のフレームの記録の集計。
+ */
+struct RecordingStats
+{
+    uint64_t frames = 0;      // Present した回数
+    uint64_t invalid = 0;     // 無効なハンドルや未設定の状態で呼ばれた回数 (累計)
+    size_t commands = 0;      // 直近のフレームのコマンド数
+    size_t bytes = 0;         // 直近のフレームのコマンド列のバイト数
+    uint32_t draws = 0;       // 直近のフレームの描画呼び出し数
+    uint64_t triangles = 0;   // 直近のフレームの三角形数
+    uint64_t uploadBytes = 0; // 直近のフレームでバッファへ書き込んだバイト数
+    uint64_t hash = 0;        // 直近のフレームのコマンド列のハッシュ
+};
+
+/**
+ * @brief 何も描かずに、呼び出しをコマンドバッファへ記録するレンダーデバイス。
+ * @details GPU もウィンドウも要らないため、どのプラットフォームでも DxApp のフレームループを動かせる。
+ *          動的バッファは CPU 側のメモリで受け、Unmap の時点で大きさと内容のハッシュだけを記録する。
+ *          Present でそのフレームの記録を確定し、LastFrame と Stats で参照できるようにする。
+ *          ハンドルと描画状態を検査し、不正な呼び出しは RecordingStats::invalid に数える。
+ */
+class RecordingRenderDevice : public RenderDevice
+{
+public:
+    const char* Name() const override
+    {
+        return "Recording";
+    }
+
+    Handle CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial) override;
+    Handle CreateTexture(uint32_t width, uint32_t height, const void* rgba) override;
+    Handle CreatePipeline(const PipelineDesc& desc) override;
+    void Destroy(Handle handle) override;
+    void* MapBuffer(Handle buffer) override;
+    void UnmapBuffer(Handle buffer) override;
+    bool Resize(uint32_t width, uint32_t height) override;
+    void BeginPass(const float clear[4]) override;
+    void SetPipeline(Handle pipeline) override;
+    void SetVertexBuffer(Handle buffer, uint32_t stride) override;
+    void SetIndexBuffer(Handle buffer, IndexFormat format) override;
+    void SetConstantBuffer(Handle buffer) override;
+    void SetTexture(Handle texture) override;
+    void SetScissor(const ScissorRect& rect) override;
+    void Draw(uint32_t vertexCount, uint32_t firstVertex) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+    PresentResult Present(bool vsync) override;
+
+    /**
+     * @brief 直近に Present したフレームの記録を取得する。
+     * @return コマンドバッファ。
+     */
+    const RenderCommandBuffer& LastFrame() const
+    {
+        return m_last;
+    }
+
+    /**
+     * @brief 記録の集計を取得する。
+     * @return 集計。
+     */
+    const RecordingStats& Stats() const
+    {
+        return m_stats;
+    }
+
+private:
+    /**
+     * @brief リソースの種類。
+     */
+    enum class Type : uint8_t
+    {
+        None,     // 空き
+        Buffer,   // バッファ
+        Texture,  // テクスチャ
+        Pipeline, // パイプライン
+    };
+
+    /**
+     * @brief 記録側で保持するリソースの情報。
+     */
+    struct Resource
+    {
+        Type type = Type::None;    // 種類
+        BufferKind kind{};         // バッファの用途
+        bool dynamic = false;      // 動的バッファ
+        bool mapped = false;       // Map 中
+        uint32_t bytes = 0;        // バッファの大きさ
+        std::vector<uint8_t> data; // 動的バッファの CPU 側の内容
+    };
+
+    /**
+     * @brief リソースの枠を確保する。空きがあれば使い回す。
+     * @param type 種類。
+     * @return ハンドル。
+     */
+    Handle Allocate(Type type);
+
+    /**
+     * @brief ハンドルが指定の種類のリソースを指しているか確かめる。違えば invalid を数える。
+     * @param handle ハンドル。
+     * @param type 期待する種類。
+     * @return リソース。無効なら nullptr。
+     */
+    Resource* Find(Handle handle, Type type);
+
+    std::vector<Resource> m_resources; // ハンドル - 1 で引くリソース
+    std::vector<Handle> m_freeList;    // 破棄されたハンドル
+    RenderCommandBuffer m_current;     // 記録中のフレーム
+    RenderCommandBuffer m_last;        // 直近に Present したフレーム
+    RecordingStats m_stats;            // 集計
+    uint32_t m_draws = 0;              // 記録中のフレームの描画呼び出し数
+    uint64_t m_triangles = 0;          // 記録中のフレームの三角形数
+    uint64_t m_uploadBytes = 0;        // 記録中のフレームのアップロード量
+    bool m_inPass = false;             // BeginPass から Present まで
+    bool m_hasPipeline = false;        // パイプラインが設定されている
+    bool m_hasVertices = false;        // 頂点バッファが設定されている
+    bool m_hasIndices = false;         // インデックスバッファが設定されている
+};
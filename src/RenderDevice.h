@@ -0,0 +1,271 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @file RenderDevice.h
+ * @brief 描画 API を抽象化したレンダーデバイスのインターフェースの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief シェーダーと共有する定数バッファのレイアウト。すべてのパイプラインがこのレイアウトを使う。
+ */
+struct FrameConstants
+{
+    float Tint[4];   // 色調係数 (w は未使用)
+    float Screen[2]; // 画面サイズ
+    float Pad0[2];   // アライメント調整用パディング
+    float Mvp[16];   // モデルビュー射影行列 (行 i が出力の i 成分。HLSL の mul(p, Mvp) と同じ結果になる並び)
+};
+
+static_assert(sizeof(FrameConstants) % 16 == 0, "定数バッファのサイズは 16 バイトの倍数である必要がある");
+
+/**
+ * @brief バッファの用途。
+ */
+enum class BufferKind : uint8_t
+{
+    Vertex,   // 頂点バッファ
+    Index,    // インデックスバッファ
+    Constant, // 定数バッファ
+};
+
+/**
+ * @brief インデックスの型。
+ */
+enum class IndexFormat : uint8_t
+{
+    U16, // 16 ビット
+    U32, // 32 ビット
+};
+
+/**
+ * @brief 頂点属性の意味。
+ */
+enum class VertexSemantic : uint8_t
+{
+    Position, // 位置 (Mvp で変換する)
+    Color,    // 頂点色
+    TexCoord, // テクスチャ座標
+};
+
+/**
+ * @brief 頂点属性の型。
+ */
+enum class VertexFormat : uint8_t
+{
+    Float2,   // float x 2
+    Float3,   // float x 3
+    Unorm8x4, // 0..255 の 8 ビット x 4 (0..1 へ正規化する)
+};
+
+/**
+ * @brief 頂点属性 1 つの配置。
+ */
+struct VertexAttribute
+{
+    VertexSemantic semantic = VertexSemantic::Position; // 意味
+    VertexFormat format = VertexFormat::Float3;         // 型
+    uint32_t offset = 0;                                // 頂点の先頭からのバイト位置
+};
+
+/**
+ * @brief パイプライン (シェーダー・頂点レイアウト・固定機能の状態) の記述。
+ * @details GPU のバックエンドは HLSL をコンパイルして使う。シェーダーを実行しないバックエンドは、
+ *          「位置を FrameConstants::Mvp で変換し、頂点色に tinted なら Tint を、textured ならテクスチャを掛ける」
+ *          という、このアプリのシェーダーが行う処理を記述のフラグから再現する。
+ */
+struct PipelineDesc
+{
+    std::string name;                    // デバッグ用の名前
+    std::wstring shaderFile;             // HLSL ファイル (空なら shaderSource を使う)
+    std::string shaderSource;            // HLSL ソース
+    std::string vsEntry = "VSMain";      // 頂点シェーダーの関数名
+    std::string psEntry = "PSMain";      // ピクセルシェーダーの関数名
+    std::vector<VertexAttribute> layout; // 頂点レイアウト
+    bool tinted = false;                 // 頂点色に FrameConstants::Tint を掛ける
+    bool textured = false;               // 頂点色にテクスチャ (バイリニア) を掛ける
+    bool alphaBlend = false;             // アルファブレンドする
+    bool scissor = false;                // シザー矩形で切り抜く
+};
+
+/**
+ * @brief シザー矩形 (ピクセル、right・bottom は含まない)。
+ */
+struct ScissorRect
+{
+    int32_t left = 0;   // 左端
+    int32_t top = 0;    // 上端
+    int32_t right = 0;  // 右端
+    int32_t bottom = 0; // 下端
+};
+
+/**
+ * @brief Present の結果。
+ */
+enum class PresentResult : uint8_t
+{
+    Ok,       // 表示した
+    Occluded, // ウィンドウが隠れていて表示されなかった
+    Failed,   // 失敗した (デバイスの消失など)
+};
+
+/**
+ * @brief 描画 API の差し替え点。DxApp はこのインターフェースだけを通じて描く。
+ * @details リソースはハンドルで指し、ハンドルの 0 (kNoHandle) は無効を表す。
+ *          生成・破棄は初期化時と描画スレッドから、それ以外は描画スレッドからだけ呼ぶ。
+ *          1 フレームは BeginPass で始まり Present で終わる。
+ */
+class RenderDevice
+{
+public:
+    using Handle = uint32_t;
+
+    static constexpr Handle kNoHandle = 0; // 無効なハンドル
+
+    virtual ~RenderDevice() = default;
+
+    /**
+     * @brief バックエンドの名前を取得する。
+     * @return 名前。
+     */
+    virtual const char* Name() const = 0;
+
+    /**
+     * @brief バッファを作成する。
+     * @param kind 用途。
+     * @param bytes 大きさ (バイト)。
+     * @param initial 初期内容 (nullptr なら MapBuffer で毎フレーム書き込む動的バッファにする)。
+     * @return ハンドル。失敗した場合は kNoHandle。
+     */
+    virtual Handle CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial) = 0;
+
+    /**
+     * @brief RGBA8 のテクスチャを作成する。
+     * @param width 幅 (ピクセル)。
+     * @param height 高さ (ピクセル)。
+     * @param rgba 画素 (width * height * 4 バイト)。
+     * @return ハンドル。失敗した場合は kNoHandle。
+     */
+    virtual Handle CreateTexture(uint32_t width, uint32_t height, const void* rgba) = 0;
+
+    /**
+     * @brief パイプラインを作成する。
+     * @param desc 記述。
+     * @return ハンドル。失敗した場合は kNoHandle。
+     */
+    virtual Handle CreatePipeline(const PipelineDesc& desc) = 0;
+
+    /**
+     * @brief リソースを破棄する。
+     * @param handle 破棄するリソース (kNoHandle なら何もしない)。
+     */
+    virtual void Destroy(Handle handle) = 0;
+
+    /**
+     * @brief 動的バッファへ書き込むためにメモリを得る。以前の内容は破棄される。
+     * @param buffer 動的バッファ。
+     * @return 書き込み先 (作成時の大きさ分)。失敗した場合は nullptr。
+     */
+    virtual void* MapBuffer(Handle buffer) = 0;
+
+    /**
+     * @brief MapBuffer で得たメモリへの書き込みを終える。
+     * @param buffer 動的バッファ。
+     */
+    virtual void UnmapBuffer(Handle buffer) = 0;
+
+    /**
+     * @brief 動的バッファの内容を置き換える。
+     * @param buffer 動的バッファ。
+     * @param data 内容。
+     * @param bytes 大きさ (作成時の大きさ以下)。
+     * @return 書き込めた場合は true。
+     */
+    bool UpdateBuffer(Handle buffer, const void* data, uint32_t bytes)
+    {
+        void* dst = MapBuffer(buffer);
+        if (!dst)
+            return false;
+        std::memcpy(dst, data, bytes);
+        UnmapBuffer(buffer);
+        return true;
+    }
+
+    /**
+     * @brief 描画先の大きさを変える。今と同じなら何もしない。
+     * @param width 幅 (ピクセル)。
+     * @param height 高さ (ピクセル)。
+     * @return 描画先を用意できた場合は true。
+     */
+    virtual bool Resize(uint32_t width, uint32_t height) = 0;
+
+    /**
+     * @brief フレームを始める。描画先とビューポートを全体に設定し、クリアする。
+     * @param clear クリアカラー (RGBA)。
+     */
+    virtual void BeginPass(const float clear[4]) = 0;
+
+    /**
+     * @brief パイプラインを設定する。
+     * @param pipeline パイプライン。
+     */
+    virtual void SetPipeline(Handle pipeline) = 0;
+
+    /**
+     * @brief 頂点バッファを設定する。
+     * @param buffer 頂点バッファ。
+     * @param stride 頂点 1 つのバイト数。
+     */
+    virtual void SetVertexBuffer(Handle buffer, uint32_t stride) = 0;
+
+    /**
+     * @brief インデックスバッファを設定する。
+     * @param buffer インデックスバッファ。
+     * @param format インデックスの型。
+     */
+    virtual void SetIndexBuffer(Handle buffer, IndexFormat format) = 0;
+
+    /**
+     * @brief 定数バッファ (FrameConstants) を設定する。
+     * @param buffer 定数バッファ。
+     */
+    virtual void SetConstantBuffer(Handle buffer) = 0;
+
+    /**
+     * @brief テクスチャを設定する。
+     * @param texture テクスチャ。
+     */
+    virtual void SetTexture(Handle texture) = 0;
+
+    /**
+     * @brief シザー矩形を設定する。scissor が有効なパイプラインでだけ使われる。
+     * @param rect 矩形。
+     */
+    virtual void SetScissor(const ScissorRect& rect) = 0;
+
+    /**
+     * @brief 三角形リストを描く。
+     * @param vertexCount 頂点数。
+     * @param firstVertex 最初の頂点。
+     */
+    virtual void Draw(uint32_t vertexCount, uint32_t firstVertex) = 0;
+
+    /**
+     * @brief インデックス付きの三角形リストを描く。
+     * @param indexCount インデックス数。
+     * @param firstIndex 最初のインデックス。
+     * @param baseVertex 各インデックスへ足す値。
+     */
+    virtual void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) = 0;
+
+    /**
+     * @brief フレームを終えて表示する。
+     * @param vsync 垂直同期を待つ場合は true。
+     * @return 結果。
+     */
+    virtual PresentResult Present(bool vsync) = 0;
+};
@@ -6,114 +6,1193 @@
 
 #include "Settings.h"
 
+#include "Hash.h"
+#include "IniInclude.h"
+#include "MappedFile.h"
+#include "SettingsCache.h"
+#include "SettingsJournal.h"
+
 #include <algorithm>
 #include <cctype>
-#include <fstream>
-#include <sstream>
 
-using namespace std;
+using namespace std;
+
+/**
+ * @brief レイヤーが取り込んでいるファイルの現在の内容から、取り込み時と同じ方法でハッシュをまとめる。
+ * @param dependencies レイヤーが取り込んでいるファイル。
+ * @return まとめたハッシュ (取り込みが無ければ 0)。
+ */
+static uint64_t CurrentDependencyHash(const std::vector<std::wstring>& dependencies)
+{
+    return dependencies.empty() ? 0 : IniIncludeCache::Shared().DependencyHash(dependencies);
+}
+
+/**
+ * @brief 空のスナップショットを公開した状態で構築する。他スレッドの Read() は常に有効な表を得る。
+ * @details 保存のまとめは SaveIfDue が行うため、ライターは渡された内容をすぐに書き出す。
+ */
+Settings::Settings()
+    : m_writer(std::chrono::milliseconds(0), std::chrono::milliseconds(0))
+{
+    m_layers.emplace_back();
+    m_layers[0].name = "Base";
+    PublishSnapshot();
+}
+
+/**
+ * @brief 保存を待っている編集があれば書き出しを予約する。書き出しはライターの破棄時に完了する。
+ */
+Settings::~Settings()
+{
+    if (m_saveDirty)
+        Save();
+}
+
+/**
+ * @brief 設定ファイルを読み込む。
+ * @param path ファイルパス。
+ * @return 読み込みに成功した場合は true。
+ */
+bool Settings::Load(const std::wstring& path)
+{
+    m_layers[0].path = path;
+    if (!std::filesystem::exists(path))
+        return false;
+
+    // 読み込み前の時刻を記録する。読み込み中に更新されても次の ReloadIfChanged で拾える
+    m_lastWriteTime = std::filesystem::last_write_time(path);
+    if (LoadCache())
+        return true;
+    if (!ReadAndParse())
+        return false;
+    WriteCache();
+    return true;
+}
+
+/**
+ * @brief キャッシュファイルのパスを取得する。
+ * @return INI と同じ場所に置く "<INI 名>.cache"。
+ */
+std::filesystem::path Settings::CachePath() const
+{
+    std::filesystem::path p = m_layers[0].path;
+    p += L".cache";
+    return p;
+}
+
+/**
+ * @brief 元 INI と一致するキャッシュがあれば、テキスト解析を行わずに値テーブルへ取り込む。
+ * @details サイズと最終更新時刻が一致すれば元 INI を開かない。時刻だけが異なる場合 (touch やチェックアウト) は
+ *          内容のハッシュを比べ、一致すればキャッシュを使ってヘッダーを更新する。
+ * @return キャッシュから読み込んだ場合は true。
+ */
+bool Settings::LoadCache()
+{
+    std::error_code ec;
+    Layer& base = m_layers[0];
+    const uint64_t size = std::filesystem::file_size(base.path, ec);
+    if (ec)
+        return false;
+
+    MappedFile file;
+    SettingsCacheView cache;
+    if (!file.Open(CachePath()) || !cache.Attach(file.Data(), file.Size()))
+        return false;
+    const SettingsCacheHeader& h = cache.Header();
+    if (h.sourceSize != size)
+        return false;
+    const bool sameTime = h.sourceTime == static_cast<int64_t>(m_lastWriteTime.time_since_epoch().count());
+    if (!sameTime && (!ReadFileToBuffer(base.path, base.spare) || Hash64(base.spare) != h.sourceHash))
+        return false;
+
+    // 文字列領域 (先頭は元 INI の内容) をそのまま解析結果として扱い、解析済みの数値・真偽値も引き継ぐ
+    const auto start = std::chrono::steady_clock::now();
+    base.spare.assign(cache.Strings());
+    m_entries.resize(cache.Count());
+    std::vector<SettingValue> values(cache.Count());
+    for (uint32_t i = 0; i < cache.Count(); ++i)
+    {
+        const SettingsCacheEntry& e = cache.Entry(i);
+        IniEntry& entry = m_entries[i];
+        entry.section = IniSpan{e.cat, e.catLen};
+        entry.key = IniSpan{e.key, e.keyLen};
+        entry.value = IniSpan{e.value, e.valueLen};
+        values[i].value = entry.value;
+        values[i].number = e.number;
+        values[i].flags = static_cast<uint8_t>(e.flags);
+    }
+    m_sourceSize = size;
+    base.hash = h.sourceHash;
+    base.dependencies.clear(); // "@include" を含む内容はキャッシュを作らない
+    base.dependencyHash = 0;
+    MergeLayer(0, static_cast<uint32_t>(h.sourceSize), values.data()); // 文字列領域の先頭は元 INI の内容そのもの
+    PublishChanges();
+    Publish();
+    CountLoad(start);
+
+    if (!sameTime)
+        WriteCache();
+    return true;
+}
+
+/**
+ * @brief 現在の値テーブルをキャッシュファイルへ書き出す。
+ * @details 基本レイヤーの値だけを書く。文字列領域の先頭には元 INI の内容を置き、値はその中の位置で表す。
+ *          これにより、キャッシュから読み込んだ場合も保存時にファイルの体裁を保ったまま差分を作れる。
+ *          エントリはスロットの登録順に並べるため、次回キャッシュから読み込んでも同じ順でキーが登録される。
+ *          上位レイヤーに覆われた値は解析済みキャッシュを持たないため、flags を 0 として書く。
+ *          "@include" や継承で補った値を含む内容は書かない。
+ */
+void Settings::WriteCache()
+{
+    const Layer& base = m_layers[0];
+    if (!base.dependencies.empty())
+        return; // 取り込んだファイルの変更はキャッシュの照合で検出できないため作らない
+    SettingsCacheBuilder builder(std::string_view(base.text.data(), base.fileLength));
+    for (uint32_t id = 0; id < m_slots.size(); ++id)
+    {
+        const Slot& s = m_slots[id];
+        if (!(s.layers & 1u))
+            continue;
+        if (base.origin[id].offset == kNoOrigin || base.values[id].offset != base.origin[id].offset)
+            return; // 未保存の編集がある内容はファイルと一致しないため書かない
+        const bool resolved = s.source == 0;
+        builder.Add(SpanView(m_names, s.cat), SpanView(m_names, s.key), base.values[id], resolved ? s.number : 0.0,
+                    resolved ? s.flags : 0u);
+    }
+    builder.Write(CachePath(), m_sourceSize, static_cast<int64_t>(m_lastWriteTime.time_since_epoch().count()),
+                  base.hash);
+}
+
+/**
+ * @brief ファイルの更新を監視し、変化が落ち着いていれば再読み込みする。
+ * @details 更新時刻が変わるたびに待ち始めをやり直し、m_reloadDebounce の間変化が無ければ読み込む。
+ * @return 再読み込みを実施した場合は true。
+ */
+bool Settings::ReloadIfChanged()
+{
+    const std::wstring& path = m_layers[0].path;
+    std::error_code ec;
+    if (path.empty() || !std::filesystem::exists(path, ec))
+        return false;
+    auto now = std::filesystem::last_write_time(path, ec);
+    if (ec || now == m_lastWriteTime)
+        return false;
+
+    const auto tick = std::chrono::steady_clock::now();
+    if (now != m_pendingWriteTime)
+    {
+        m_pendingWriteTime = now;
+        m_pendingSince = tick;
+    }
+    if (tick - m_pendingSince < m_reloadDebounce)
+        return false;
+    if (!ReadAndParse())
+        return false;
+    m_lastWriteTime = now;
+    return true;
+}
+
+/**
+ * @brief ファイル内容を予備バッファへ読み込み、内容が変わっていれば差分解析して変化を通知する。
+ * @return 成功した場合は true。
+ */
+bool Settings::ReadAndParse()
+{
+    Layer& base = m_layers[0];
+    const auto start = std::chrono::steady_clock::now();
+    if (!ReadFileToBuffer(base.path, base.spare))
+        return false;
+    const uint64_t hash = Hash64(base.spare);
+    if (SkipUnchanged(0, hash, CurrentDependencyHash(base.dependencies)))
+        return true;
+    m_sourceSize = base.spare.size();
+    base.hash = hash;
+    Parse(0);
+    PublishChanges();
+    Publish();
+    CountLoad(start);
+    return true;
+}
+
+/**
+ * @brief 読み込んだ内容が取り込み済みのものと同じなら、解析を省いたことを記録する。
+ * @details 基本レイヤーでは、直近に自身が保存した内容の読み戻しも省く。以降の編集を古い値で上書きしないため。
+ *          "@include" で取り込んだファイルの内容が変わっていれば、ファイル自身が同じでも取り込み直す。
+ * @param layer 対象レイヤー。
+ * @param hash 読み込んだ内容のハッシュ。
+ * @param dependencyHash 取り込むファイルの内容をまとめたハッシュ。
+ * @return 取り込みを省く場合は true。
+ */
+bool Settings::SkipUnchanged(uint32_t layer, uint64_t hash, uint64_t dependencyHash)
+{
+    const Layer& l = m_layers[layer];
+    if (hash != l.hash && !(layer == 0 && IsOwnWrite(hash)))
+        return false;
+    if (dependencyHash != l.dependencyHash)
+        return false;
+    ++m_reloadStats.skipped;
+    m_changed.clear();
+    return true;
+}
+
+/**
+ * @brief 取り込み 1 回分の所要時間を統計へ加える。
+ * @param start 取り込みを始めた時刻。
+ */
+void Settings::CountLoad(std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    ++m_reloadStats.loads;
+    m_reloadStats.lastMs = elapsed.count();
+    m_reloadStats.totalMs += elapsed.count();
+}
+
+/**
+ * @brief 別スレッドで解析済みの内容を指定レイヤーへ取り込み、変化を通知する。
+ * @details doc に Diff の差分があり、その基準が取り込み済みの内容と同じなら、変化したキーだけを統合し直す。
+ *          基準が異なる (受け渡しを取りこぼした、編集した、SetLayerText で置き換えた) 場合は entries から統合し直す。
+ * @param doc 取り込む内容。
+ * @param layer 取り込み先レイヤー。
+ * @return 成功した場合は true。
+ */
+bool Settings::Apply(IniDocument& doc, uint32_t layer)
+{
+    if (layer >= m_layers.size())
+        return false;
+    if (layer == 0)
+        m_lastWriteTime = doc.writeTime;
+    const uint32_t fileLength = static_cast<uint32_t>((std::min<size_t>)(doc.fileLength, doc.text.size()));
+    const uint64_t hash = doc.hash ? doc.hash : Hash64(std::string_view(doc.text.data(), fileLength));
+    if (SkipUnchanged(layer, hash, doc.dependencyHash))
+        return true;
+
+    const auto start = std::chrono::steady_clock::now();
+    Layer& l = m_layers[layer];
+    const bool incremental = doc.incremental && l.pristine && doc.baseHash == l.hash &&
+                             doc.baseDependencyHash == l.dependencyHash;
+    if (layer == 0)
+        m_sourceSize = fileLength;
+    l.hash = hash;
+    l.dependencyHash = doc.dependencyHash;
+    l.dependencies.swap(doc.dependencies);
+    std::swap(l.included, doc.included);
+    if (incremental)
+    {
+        MergeDelta(layer, doc, fileLength);
+        ++m_reloadStats.incremental;
+    }
+    else
+    {
+        l.spare.swap(doc.text);
+        m_entries.swap(doc.entries);
+        MergeLayer(layer, fileLength);
+    }
+    PublishChanges();
+    Publish();
+    CountLoad(start);
+    return true;
+}
+
+/**
+ * @brief 解析済みの内容を直前に受け渡した内容とキー単位で比較し、Apply が使う差分を doc へ書き込む。
+ * @details キー名表は公開済みのスナップショットから参照だけを複製し、ガードはすぐに手放す
+ *          (照合の間に所有スレッドの公開を待たせないため)。キー名表は追記のみなのでハンドルは版をまたいで同じ。
+ * @param doc 解析済みの内容。
+ * @param base 直前に受け渡した内容。doc の内容へ更新される。
+ */
+void Settings::Diff(IniDocument& doc, DiffBase& base) const
+{
+    doc.incremental = false;
+    doc.changes.clear();
+    std::shared_ptr<const SettingsKeyTable> keys;
+    {
+        ReadGuard guard = Read();
+        keys = guard->m_keys;
+    }
+    if (!keys)
+    {
+        base.valid = false;
+        return;
+    }
+
+    const SettingsKeyTable& t = *keys;
+    const uint32_t count = static_cast<uint32_t>(t.cats.size());
+    base.entryOf.assign(count, FlatIndex::kNone);
+    for (size_t i = 0; i < doc.entries.size(); ++i)
+    {
+        const IniEntry& e = doc.entries[i];
+        const std::string_view cat = e.section.length ? SpanView(doc.text, e.section) : std::string_view("Default");
+        const std::string_view key = SpanView(doc.text, e.key);
+        const uint32_t id = t.index.Find(HashSettingKey(cat, key),
+                                         [&](uint32_t k)
+                                         {
+                                             return SpanView(t.names, t.keys[k]) == key &&
+                                                    SpanView(t.names, t.cats[k]) == cat;
+                                         });
+        if (id == FlatIndex::kNone)
+        {
+            base.valid = false; // 未登録のキーがある。Apply が entries から登録した後の内容を次の基準にする
+            return;
+        }
+        base.entryOf[id] = static_cast<uint32_t>(i); // 同一キーは後勝ち
+    }
+
+    const uint32_t fileLength = static_cast<uint32_t>((std::min<size_t>)(doc.fileLength, doc.text.size()));
+    doc.values.assign(count, IniSpan{});
+    doc.origin.assign(count, IniSpan{kNoOrigin, 0});
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        if (base.entryOf[id] == FlatIndex::kNone)
+            continue;
+        const IniSpan v = doc.entries[base.entryOf[id]].value;
+        doc.values[id] = v;
+        if (v.offset < fileLength)
+            doc.origin[id] = v;
+    }
+
+    const uint64_t hash = doc.hash ? doc.hash : Hash64(std::string_view(doc.text.data(), fileLength));
+    if (base.valid && base.present.size() <= count)
+    {
+        for (uint32_t id = 0; id < count; ++id)
+        {
+            const bool had = id < base.present.size() && base.present[id];
+            const bool has = base.entryOf[id] != FlatIndex::kNone;
+            if (had != has || (has && SpanView(base.text, base.values[id]) != SpanView(doc.text, doc.values[id])))
+                doc.changes.push_back(IniChange{id, !has});
+        }
+        doc.incremental = true;
+        doc.baseHash = base.hash;
+        doc.baseDependencyHash = base.dependencyHash;
+    }
+
+    base.valid = true;
+    base.hash = hash;
+    base.dependencyHash = doc.dependencyHash;
+    base.text = doc.text;
+    base.values = doc.values;
+    base.present.resize(count);
+    for (uint32_t id = 0; id < count; ++id)
+        base.present[id] = base.entryOf[id] != FlatIndex::kNone;
+}
+
+/**
+ * @brief 上位レイヤーを追加する。
+ * @param name レイヤー名。
+ * @param path 読み込むファイルパス (メモリ上のみのレイヤーなら空)。
+ * @return レイヤー番号。上限に達している場合は kNoLayer。
+ */
+uint32_t Settings::AddLayer(std::string_view name, const std::wstring& path)
+{
+    if (m_layers.size() >= kMaxLayers)
+        return kNoLayer;
+    m_layers.emplace_back();
+    Layer& layer = m_layers.back();
+    layer.name.assign(name.data(), name.size());
+    layer.path = path;
+    return static_cast<uint32_t>(m_layers.size() - 1);
+}
+
+/**
+ * @brief レイヤーのファイルを読み込んで取り込む。
+ * @param layer 対象レイヤー。
+ * @return 読み込めた場合は true。
+ */
+bool Settings::LoadLayer(uint32_t layer)
+{
+    if (layer == 0)
+        return ReadAndParse();
+    if (layer >= m_layers.size() || m_layers[layer].path.empty())
+        return false;
+    Layer& l = m_layers[layer];
+    const auto start = std::chrono::steady_clock::now();
+    if (!std::filesystem::exists(l.path) || !ReadFileToBuffer(l.path, l.spare))
+        return false;
+    const uint64_t hash = Hash64(l.spare);
+    if (SkipUnchanged(layer, hash, CurrentDependencyHash(l.dependencies)))
+        return true;
+    l.hash = hash;
+    Parse(layer);
+    PublishChanges();
+    Publish();
+    CountLoad(start);
+    return true;
+}
+
+/**
+ * @brief レイヤーの内容を INI テキストで置き換える。
+ * @param layer 対象レイヤー。
+ * @param text INI テキスト。
+ * @return 取り込めた場合は true。
+ */
+bool Settings::SetLayerText(uint32_t layer, std::string_view text)
+{
+    if (layer >= m_layers.size())
+        return false;
+    m_layers[layer].spare.assign(text.data(), text.size());
+    Parse(layer);
+    m_layers[layer].pristine = false; // ファイルの内容ではないため、監視スレッドの差分の基準と一致しない
+    PublishChanges();
+    Publish();
+    return true;
+}
+
+/**
+ * @brief ハンドルの実効値を提供しているレイヤーを取得する。
+ * @param h 対象ハンドル。
+ * @return レイヤー番号。値が無ければ kNoLayer。
+ */
+uint32_t Settings::SourceLayer(Handle h) const
+{
+    const Slot* s = SlotOf(h);
+    return (s && (s->flags & SettingValue::kPresent)) ? s->source : kNoLayer;
+}
+
+/**
+ * @brief 値を定義しているレイヤーのうち最上位のものを返す。
+ * @param mask レイヤーのビット集合。
+ * @return レイヤー番号。どのレイヤーも定義していなければ kNoLayer。
+ */
+uint32_t Settings::TopLayer(uint32_t mask) const
+{
+    for (uint32_t i = static_cast<uint32_t>(m_layers.size()); i-- > 0;)
+    {
+        if (mask & (1u << i))
+            return i;
+    }
+    return kNoLayer;
+}
+
+/**
+ * @brief 自身が保存した内容がそのまま読み戻されたものか判定する。
+ * @param hash 読み込んだ内容のハッシュ。
+ * @return 直近に保存した内容と一致する場合は true。
+ */
+bool Settings::IsOwnWrite(uint64_t hash) const
+{
+    for (uint64_t w : m_ownWrites)
+    {
+        if (w != 0 && w == hash)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief レイヤーの予備バッファの INI テキストを解析し値テーブルへ反映する。
+ * @details "@include" とセクションの継承があれば展開する。取り込んだ内容と補った値は予備バッファの末尾へ追記される。
+ * @param layer 対象レイヤー。
+ */
+void Settings::Parse(uint32_t layer)
+{
+    Layer& l = m_layers[layer];
+    const uint32_t fileLength = static_cast<uint32_t>(l.spare.size());
+    ParseIni(l.spare, m_entries, m_links);
+    if (m_links.empty())
+    {
+        l.dependencies.clear();
+        l.dependencyHash = 0;
+        l.included.clear();
+    }
+    else
+    {
+        IniIncludeCache::Shared().Resolve(l.path, l.spare, m_entries, m_links, l.dependencies, l.dependencyHash,
+                                          l.included);
+    }
+    MergeLayer(layer, fileLength);
+}
+
+/**
+ * @brief 取り込み指定を変えずに書き換えたテキスト (保存した内容) を予備バッファから解析し直す。
+ * @details "@include" の内容は直前の読み込みで集めたものを再利用し、継承だけを展開し直す。
+ *          ファイル I/O も取り込みキャッシュのロックも伴わないため、所有スレッドのフレームの合間に呼んでよい。
+ *          取り込んだファイル自体の変化は、監視スレッドの読み込み (Apply) で反映される。
+ * @param layer 対象レイヤー。
+ */
+void Settings::Reparse(uint32_t layer)
+{
+    Layer& l = m_layers[layer];
+    const uint32_t fileLength = static_cast<uint32_t>(l.spare.size());
+    ParseIni(l.spare, m_entries, m_links);
+    if (!m_links.empty())
+        IniIncludeCache::Expand(l.spare, m_entries, m_links, l.included);
+    MergeLayer(layer, fileLength);
+}
+
+/**
+ * @brief レイヤーの解析結果を直前の内容とキー単位で比較し、そのレイヤーが関わるキーだけを統合し直す。
+ * @details 既存スロットは保持したまま値だけを差し替えるため、解決済みハンドルは再読み込み後も有効。
+ *          各スロットは実効値のキャッシュと提供元レイヤーを直接持つため、レイヤー数に関わらず Get* は定数回の参照で済む。
+ *          上位レイヤーに覆われたキーは実効値が変わらないので通知しない。ファイルから消えたキーは下位レイヤーの値
+ *          (無ければ値なし) へ戻る。同一キーが複数回現れた場合は後勝ち。
+ *          キャッシュの再計算は実効値が変化したスロットに限られ、解析済みの値が渡された場合はそれを用いる。
+ * @param layer 対象レイヤー (解析結果は m_layers[layer].spare / m_entries)。
+ * @param fileLength spare 先頭のうちファイル内容そのものである部分の長さ。
+ * @param cached m_entries と同じ並びの解析済み値 (無ければ nullptr)。
+ */
+void Settings::MergeLayer(uint32_t layer, uint32_t fileLength, const SettingValue* cached)
+{
+    Layer& l = m_layers[layer];
+    const uint32_t bit = 1u << layer;
+    const uint32_t gen = ++m_generation;
+
+    if (m_entries.size() > m_slots.size())
+    {
+        m_slots.reserve(m_entries.size());
+        m_index.Reserve(m_entries.size());
+    }
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        const IniEntry& e = m_entries[i];
+        std::string_view cat = e.section.length ? SpanView(l.spare, e.section) : std::string_view("Default");
+        Slot& slot = m_slots[Intern(cat, SpanView(l.spare, e.key))];
+        slot.pending = cached ? cached[i] : SettingValue{e.value};
+        slot.seen = gen;
+    }
+    l.Grow(m_slots.size());
+
+    m_changed.clear();
+    for (uint32_t id = 0; id < m_slots.size(); ++id)
+    {
+        Slot& slot = m_slots[id];
+        const bool had = (slot.layers & bit) != 0;
+        const bool has = slot.seen == gen;
+        if (!had && !has)
+            continue;
+
+        const bool same = had && has && SpanView(l.text, l.values[id]) == SpanView(l.spare, slot.pending.value);
+        const std::string_view before =
+            (slot.flags & SettingValue::kPresent) ? ValueText(id) : std::string_view(); // l.values を書き換える前に取る
+        if (has)
+        {
+            // 取り込んだファイルや継承で補った値はファイル上に位置を持たない (保存時は書き換えずにキーを足す)
+            l.values[id] = slot.pending.value;
+            l.origin[id] = slot.pending.value.offset < fileLength ? slot.pending.value : IniSpan{kNoOrigin, 0};
+            slot.layers |= bit;
+        }
+        else
+        {
+            l.origin[id] = IniSpan{kNoOrigin, 0};
+            slot.layers &= ~bit;
+        }
+
+        if (same && slot.source == layer)
+            continue; // 実効値のまま値も変わらない (値の位置は l.values が新しいバッファ上のものへ変わった)
+        Settle(id, layer, l.spare, before, slot.pending.flags ? &slot.pending : nullptr);
+    }
+
+    l.text.swap(l.spare);
+    l.fileLength = fileLength;
+    l.resolvedLength = static_cast<uint32_t>(l.text.size());
+    l.pristine = true;
+}
+
+/**
+ * @brief 監視スレッドが Diff で作った差分を取り込み、値が変わったキーだけを統合し直す。
+ * @details ハンドルごとの値と位置は監視スレッドが新しい内容に合わせて作り済みのため、レイヤーとは交換するだけで済む。
+ *          差分の基準はレイヤーの内容と同じなので、changes に無いキーは値の有無も文字列も変わっておらず触れない。
+ *          所要時間は内容の大きさによらず、変化したキー数に比例する。
+ * @param layer 対象レイヤー。
+ * @param doc 取り込む内容。交換後は直前の内容が入り、変化したキーの以前の値の参照に使う。
+ * @param fileLength doc.text 先頭のうちファイル内容そのものである部分の長さ。
+ */
+void Settings::MergeDelta(uint32_t layer, IniDocument& doc, uint32_t fileLength)
+{
+    Layer& l = m_layers[layer];
+    const uint32_t bit = 1u << layer;
+    l.text.swap(doc.text);
+    l.values.swap(doc.values);
+    l.origin.swap(doc.origin);
+    l.Grow(m_slots.size());
+
+    m_changed.clear();
+    for (const IniChange& c : doc.changes)
+    {
+        Slot& slot = m_slots[c.id];
+        std::string_view before;
+        if (slot.flags & SettingValue::kPresent)
+            before = slot.source == layer ? SpanView(doc.text, doc.values[c.id]) : ValueText(c.id);
+        if (c.removed)
+            slot.layers &= ~bit;
+        else
+            slot.layers |= bit;
+        Settle(c.id, layer, l.text, before, nullptr);
+    }
+
+    l.fileLength = fileLength;
+    l.resolvedLength = static_cast<uint32_t>(l.text.size());
+    l.pristine = true;
+}
+
+/**
+ * @brief レイヤーの値が変わったスロットの実効値を決め直す。
+ * @param id 対象スロット。
+ * @param layer 値が変わったレイヤー。
+ * @param text そのレイヤーの新しい値の基準バッファ。
+ * @param before 直前の実効値 (値が無かった場合は空)。
+ * @param parsed そのレイヤーの新しい値の解析済みキャッシュ (無ければ nullptr)。
+ */
+void Settings::Settle(uint32_t id, uint32_t layer, std::string_view text, std::string_view before,
+                      const SettingValue* parsed)
+{
+    Slot& slot = m_slots[id];
+    const uint32_t top = TopLayer(slot.layers);
+    if (top != layer && slot.source != layer)
+        return; // 上位レイヤーが覆っているため実効値は変わらない
+
+    const bool wasPresent = (slot.flags & SettingValue::kPresent) != 0;
+    slot.source = static_cast<uint8_t>(top);
+    if (top == kNoLayer)
+    {
+        slot.flags = 0;
+        m_changed.push_back(Handle{id});
+        MarkDirty(id);
+        return;
+    }
+
+    const std::string_view now = SpanView(top == layer ? text : std::string_view(m_layers[top].text),
+                                          m_layers[top].values[id]);
+    if (wasPresent && before == now)
+        return;
+    if (top == layer && parsed)
+        static_cast<SettingValue&>(slot) = *parsed;
+    else
+        UpdateCache(slot, now);
+    m_changed.push_back(Handle{id});
+    MarkDirty(id);
+}
+
+/**
+ * @brief 未公開の変更があればスナップショットを公開する。
+ */
+void Settings::Publish()
+{
+    if (m_snapshotDirty)
+        PublishSnapshot();
+}
+
+/**
+ * @brief 値テーブルを写したスナップショットを作って公開する。
+ * @details 値は SettingsSnapshotChunk の区画単位で写す。MarkDirty された区画と、キーが増えて長さの変わった
+ *          区画だけを作り直し、値は存在するものだけを区画の文字列領域へ詰めて複写する。それ以外の区画と
+ *          キー名表 (キーが増えたときだけ作り直す) は直前の版と共有するため、公開の費用は変化したキー数に比例する。
+ *          古い版は読者が抜けた時点で SnapshotCell が破棄し、共有されていない区画もそのとき解放される。
+ */
+void Settings::PublishSnapshot()
+{
+    if (!m_keys || m_keys->cats.size() != m_slots.size())
+    {
+        auto keys = std::make_shared<SettingsKeyTable>();
+        keys->names = m_names;
+        keys->cats.reserve(m_slots.size());
+        keys->keys.reserve(m_slots.size());
+        for (const Slot& slot : m_slots)
+        {
+            keys->cats.push_back(slot.cat);
+            keys->keys.push_back(slot.key);
+        }
+        keys->index = m_index;
+        m_keys = std::move(keys);
+    }
+
+    const uint32_t count = static_cast<uint32_t>(m_slots.size());
+    const uint32_t chunks = (count + SettingsSnapshotChunk::kSize - 1) >> SettingsSnapshotChunk::kShift;
+    m_chunks.resize(chunks);
+    m_dirtyChunks.resize(chunks);
+    for (uint32_t c = 0; c < chunks; ++c)
+    {
+        const uint32_t begin = c << SettingsSnapshotChunk::kShift;
+        const uint32_t end = (std::min)(begin + SettingsSnapshotChunk::kSize, count);
+        if (m_chunks[c] && !m_dirtyChunks[c] && m_chunks[c]->values.size() == end - begin)
+            continue;
+
+        auto chunk = std::make_shared<SettingsSnapshotChunk>();
+        chunk->values.resize(end - begin);
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const Slot& slot = m_slots[i];
+            SettingValue& v = chunk->values[i - begin];
+            v = slot;
+            if (slot.flags & SettingValue::kPresent)
+            {
+                const std::string_view text = ValueText(i);
+                v.value = IniSpan{static_cast<uint32_t>(chunk->text.size()), static_cast<uint32_t>(text.size())};
+                chunk->text.append(text);
+            }
+        }
+        m_chunks[c] = std::move(chunk);
+        m_dirtyChunks[c] = 0;
+    }
+
+    auto snap = std::make_unique<SettingsSnapshot>();
+    snap->m_version = ++m_snapshotVersion;
+    snap->m_count = count;
+    snap->m_chunks = m_chunks;
+    snap->m_keys = m_keys;
+    m_snapshotDirty = false;
+    m_snapshot.Publish(std::move(snap));
+}
+
+/**
+ * @brief スロットの実効値の変化を記録する。
+ * @param id 対象スロット。
+ */
+void Settings::MarkDirty(uint32_t id)
+{
+    const uint32_t c = id >> SettingsSnapshotChunk::kShift;
+    if (c >= m_dirtyChunks.size())
+        m_dirtyChunks.resize(c + 1);
+    m_dirtyChunks[c] = 1;
+    m_snapshotDirty = true;
+}
+
+/**
+ * @brief 変化したキーをキー購読者・カテゴリ購読者へ通知する。
+ */
+void Settings::PublishChanges()
+{
+    if (m_changed.empty() || m_subscribers.empty())
+        return;
+
+    for (Handle h : m_changed)
+    {
+        std::string_view cat = SpanView(m_names, m_slots[h.id].cat);
+        for (size_t i = 0; i < m_subscribers.size(); ++i)
+        {
+            const Subscriber& sub = m_subscribers[i];
+            if (sub.slot == h.id || (sub.slot == Handle::kInvalid && sub.category == cat))
+                sub.callback(h);
+        }
+    }
+}
+
+/**
+ * @brief 特定キーの変化を購読する。
+ * @param h 対象ハンドル。
+ * @param callback 変化時に呼ばれるコールバック。
+ * @return 購読 ID。
+ */
+Settings::SubscriptionId Settings::Subscribe(Handle h, ChangeCallback callback)
+{
+    Subscriber sub;
+    sub.id = m_nextSubscription++;
+    sub.slot = h.id;
+    sub.callback = std::move(callback);
+    m_subscribers.push_back(std::move(sub));
+    return m_subscribers.back().id;
+}
+
+/**
+ * @brief カテゴリ内のキーの変化を購読する。
+ * @param cat カテゴリ名。
+ * @param callback 変化したキーごとに呼ばれるコールバック。
+ * @return 購読 ID。
+ */
+Settings::SubscriptionId Settings::SubscribeCategory(std::string_view cat, ChangeCallback callback)
+{
+    Subscriber sub;
+    sub.id = m_nextSubscription++;
+    sub.category.assign(cat.data(), cat.size());
+    sub.callback = std::move(callback);
+    m_subscribers.push_back(std::move(sub));
+    return m_subscribers.back().id;
+}
+
+/**
+ * @brief 購読を解除する。
+ * @param id 購読 ID。
+ */
+void Settings::Unsubscribe(SubscriptionId id)
+{
+    m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                                       [id](const Subscriber& s) { return s.id == id; }),
+                        m_subscribers.end());
+}
+
+/**
+ * @brief ハッシュ索引からスロットを検索する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return スロット添字、未登録なら Handle::kInvalid。
+ */
+uint32_t Settings::Find(std::string_view cat, std::string_view key) const
+{
+    return Find(cat, key, HashSettingKey(cat, key));
+}
+
+/**
+ * @brief 計算済みのハッシュ値でスロットを検索する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @param hash HashSettingKey(cat, key) の値。
+ * @return スロット添字、未登録なら Handle::kInvalid。
+ */
+uint32_t Settings::Find(std::string_view cat, std::string_view key, uint64_t hash) const
+{
+    const uint32_t id = m_index.Find(hash,
+                                     [&](uint32_t i)
+                                     {
+                                         const Slot& s = m_slots[i];
+                                         return SpanView(m_names, s.key) == key && SpanView(m_names, s.cat) == cat;
+                                     });
+    return id == FlatIndex::kNone ? Handle::kInvalid : id;
+}
+
+/**
+ * @brief キーを登録しスロット添字を返す。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return スロット添字。
+ */
+uint32_t Settings::Intern(std::string_view cat, std::string_view key)
+{
+    const uint64_t hash = HashSettingKey(cat, key);
+    const uint32_t found = Find(cat, key, hash);
+    if (found != Handle::kInvalid)
+        return found;
+
+    // キーはセクション単位で続けて登録されることが多いため、直前のスロットと同じカテゴリなら名前を共有する
+    Slot slot;
+    if (!m_slots.empty() && SpanView(m_names, m_slots.back().cat) == cat)
+    {
+        slot.cat = m_slots.back().cat;
+    }
+    else
+    {
+        slot.cat.offset = static_cast<uint32_t>(m_names.size());
+        slot.cat.length = static_cast<uint32_t>(cat.size());
+        m_names.append(cat.data(), cat.size());
+    }
+    slot.key.offset = static_cast<uint32_t>(m_names.size());
+    slot.key.length = static_cast<uint32_t>(key.size());
+    m_names.append(key.data(), key.size());
+
+    const uint32_t id = static_cast<uint32_t>(m_slots.size());
+    m_slots.push_back(slot);
+    m_index.Insert(hash, id);
+    return id;
+}
+
+/**
+ * @brief 値文字列を一度だけ解釈し、数値・真偽値キャッシュへ格納する。
+ * @param slot 対象スロット。
+ * @param v 新しい実効値の文字列。
+ */
+void Settings::UpdateCache(Slot& slot, std::string_view v) const
+{
+    slot.flags = SettingValue::kPresent;
+
+    const std::errc ec = ParseIniNumber(v, slot.number);
+    if (ec == std::errc{})
+        slot.flags |= SettingValue::kNumeric;
+    else if (ec == std::errc::result_out_of_range)
+        slot.flags |= SettingValue::kOutOfRange;
+
+    char lower[8];
+    if (v.size() < sizeof(lower))
+    {
+        for (size_t i = 0; i < v.size(); ++i)
+            lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(v[i])));
+        const std::string_view lv(lower, v.size());
+        if (lv == "1" || lv == "true" || lv == "on" || lv == "yes")
+            slot.flags |= SettingValue::kBoolValid | SettingValue::kBoolTrue;
+        else if (lv == "0" || lv == "false" || lv == "off" || lv == "no")
+            slot.flags |= SettingValue::kBoolValid;
+    }
+}
+
+/**
+ * @brief 文字列を基本レイヤーのアリーナ末尾へ追記する。
+ * @param s 追記する文字列。
+ * @return 追記領域を指すスパン。
+ */
+IniSpan Settings::Append(std::string_view s)
+{
+    std::string& text = m_layers[0].text;
+    IniSpan span{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(s.size())};
+    text.append(s.data(), s.size());
+    return span;
+}
+
+/**
+ * @brief (カテゴリ, キー) をハンドルへ解決する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return 解決済みハンドル。
+ */
+Settings::Handle Settings::Resolve(std::string_view cat, std::string_view key)
+{
+    return Handle{Intern(cat, key)};
+}
+
+/**
+ * @brief ハンドルが値を持っているか判定する。
+ * @param h 対象ハンドル。
+ * @return 値が存在する場合は true。
+ */
+bool Settings::Has(Handle h) const
+{
+    const Slot* s = SlotOf(h);
+    return s && (s->flags & SettingValue::kPresent);
+}
+
+/**
+ * @brief ハンドル経由で文字列値を参照する。
+ * @param h 対象ハンドル。
+ * @return 値が存在すればビュー、無ければ std::nullopt。
+ */
+std::optional<std::string_view> Settings::GetView(Handle h) const
+{
+    const Slot* s = SlotOf(h);
+    if (!s || !(s->flags & SettingValue::kPresent))
+        return std::nullopt;
+    return ValueText(h.id);
+}
+
+/**
+ * @brief ハンドル経由でキャッシュ済み数値を取得する。
+ * @param h 対象ハンドル。
+ * @param def 既定値。
+ * @return 値または既定値。
+ */
+double Settings::GetDouble(Handle h, double def) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? s->AsDouble(def) : def;
+}
+
+/**
+ * @brief ハンドル経由でキャッシュ済み整数値を取得する。
+ * @param h 対象ハンドル。
+ * @param def 既定値。
+ * @return 値または既定値。
+ */
+int Settings::GetInt(Handle h, int def) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? s->AsInt(def) : def;
+}
+
+/**
+ * @brief ハンドル経由でキャッシュ済み真偽値を取得する。
+ * @param h 対象ハンドル。
+ * @param def 既定値。
+ * @return 値または既定値。
+ */
+bool Settings::GetBool(Handle h, bool def) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? s->AsBool(def) : def;
+}
+
+/**
+ * @brief ハンドル経由でキャッシュ済み倍精度浮動小数値を、失敗理由付きで取得する。
+ * @param h 対象ハンドル。
+ * @param out 成功時の格納先。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc Settings::TryGetDouble(Handle h, double& out) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? s->ToDouble(out) : std::errc::invalid_argument;
+}
+
+/**
+ * @brief ハンドル経由でキャッシュ済み整数値を、失敗理由付きで取得する。
+ * @param h 対象ハンドル。
+ * @param out 成功時の格納先。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc Settings::TryGetInt(Handle h, int& out) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? s->ToInt(out) : std::errc::invalid_argument;
+}
+
+/**
+ * @brief ハンドル経由でキャッシュ済み真偽値を、失敗理由付きで取得する。
+ * @param h 対象ハンドル。
+ * @param out 成功時の格納先。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc Settings::TryGetBool(Handle h, bool& out) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? s->ToBool(out) : std::errc::invalid_argument;
+}
 
 /**
- * @brief 文字列の前後空白を取り除くヘルパー。
- * @param s 処理対象の文字列。
+ * @brief ハンドル経由で配列値を float 配列として取得する。
+ * @param h 対象ハンドル。
+ * @param out 格納先。
+ * @param count 期待する要素数。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
  */
-static inline void trim(string& s)
+std::errc Settings::GetFloats(Handle h, float* out, size_t count) const
 {
-    auto issp = [](int ch) { return std::isspace(ch); };
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [&](char c) { return !issp((unsigned char)c); }));
-    s.erase(std::find_if(s.rbegin(), s.rend(), [&](char c) { return !issp((unsigned char)c); }).base(), s.end());
+    auto v = GetView(h);
+    return v ? ParseIniFloats(*v, out, count) : std::errc::invalid_argument;
 }
 
 /**
- * @brief 設定ファイルを読み込む。
- * @param path ファイルパス。
- * @return 読み込みに成功した場合は true。
+ * @brief ハンドル経由で配列値を int 配列として取得する。
+ * @param h 対象ハンドル。
+ * @param out 格納先。
+ * @param count 期待する要素数。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
  */
-bool Settings::Load(const std::wstring& path)
+std::errc Settings::GetInts(Handle h, int* out, size_t count) const
 {
-    m_path = path;
-    if (!std::filesystem::exists(path))
-        return false;
+    auto v = GetView(h);
+    return v ? ParseIniInts(*v, out, count) : std::errc::invalid_argument;
+}
 
-    std::ifstream ifs(path);
-    if (!ifs)
+/**
+ * @brief ハンドル経由で任意長の配列値を整列済み float 配列へ読み込む。
+ * @param h 対象ハンドル。
+ * @param out 格納先。
+ * @return 成功なら std::errc{}、それ以外はエラーコード。
+ */
+std::errc Settings::GetFloatArray(Handle h, FloatArray& out) const
+{
+    auto v = GetView(h);
+    if (!v)
+        return std::errc::invalid_argument;
+    out.resize(CountIniValues(*v));
+    return ParseIniFloats(*v, out.data(), out.size());
+}
+
+/**
+ * @brief ハンドル経由で基本レイヤーの文字列値を設定する。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::SetString(Handle h, std::string_view v)
+{
+    bool stored = false;
+    Assign(h, v, stored);
+}
+
+/**
+ * @brief 基本レイヤーの値を差し替える。値が同じならアリーナへ追記しない。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ * @param stored 基本レイヤーの値を書き換えた場合に true を受け取る。
+ * @return 実効値が変化した場合は true。
+ */
+bool Settings::Assign(Handle h, std::string_view v, bool& stored)
+{
+    stored = false;
+    if (h.id >= m_slots.size())
         return false;
-    std::stringstream buf;
-    buf << ifs.rdbuf();
-    if (!Parse(buf.str()))
+    Layer& base = m_layers[0];
+    base.Grow(m_slots.size());
+    Slot& s = m_slots[h.id];
+    if ((s.layers & 1u) && SpanView(base.text, base.values[h.id]) == v)
         return false;
-
-    m_lastWriteTime = std::filesystem::last_write_time(path);
+    stored = true;
+    base.pristine = false;
+    base.values[h.id] = Append(v);
+    s.layers |= 1u;
+    if (TopLayer(s.layers) != 0)
+        return false; // 上位レイヤーが上書きしているため実効値は変わらない
+    s.source = 0;
+    UpdateCache(s, SpanView(base.text, base.values[h.id]));
+    MarkDirty(h.id);
     return true;
 }
 
 /**
- * @brief ファイルの更新を監視し変化があれば再読み込みする。
- * @return 再読み込みを実施した場合は true。
+ * @brief 基本レイヤーからキーの値を取り除き、実効値を残ったレイヤーの定義へ切り替える。
+ * @param h 対象ハンドル。
+ * @param stored 基本レイヤーの値を取り除いた場合に true を受け取る。
+ * @return 実効値が変化した場合は true。
  */
-bool Settings::ReloadIfChanged()
+bool Settings::Unassign(Handle h, bool& stored)
 {
-    if (m_path.empty() || !std::filesystem::exists(m_path))
+    stored = false;
+    if (h.id >= m_slots.size() || !(m_slots[h.id].layers & 1u))
         return false;
-    auto now = std::filesystem::last_write_time(m_path);
-    if (now != m_lastWriteTime)
-    {
-        std::ifstream ifs(m_path);
-        if (!ifs)
-            return false;
-        std::stringstream buf;
-        buf << ifs.rdbuf();
-        if (!Parse(buf.str()))
-            return false;
-        m_lastWriteTime = now;
-        return true;
-    }
-    return false;
+    stored = true;
+    m_layers[0].pristine = false;
+    Slot& s = m_slots[h.id];
+    s.layers &= ~1u;
+    if (s.source != 0)
+        return false; // 上位レイヤーが上書きしているため実効値は変わらない
+    const uint32_t top = TopLayer(s.layers);
+    s.source = static_cast<uint8_t>(top);
+    if (top == kNoLayer)
+        s.flags = 0;
+    else
+        UpdateCache(s, ValueText(h.id));
+    MarkDirty(h.id);
+    return true;
 }
 
 /**
- * @brief INI テキストを解析して内部辞書に展開する。
- * @param text 解析対象のテキスト。
- * @return 成功した場合は true。
+ * @brief ハンドル経由で倍精度浮動小数値を設定する。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
  */
-bool Settings::Parse(const std::string& text)
+void Settings::SetDouble(Handle h, double v)
 {
-    m_data.clear();
-    std::istringstream iss(text);
-    std::string line;
-    std::string currentCat = "Default";
+    SetString(h, FormatIniNumber(v).View());
+}
 
-    while (std::getline(iss, line))
-    {
-        auto semi = line.find(';');
-        if (semi != std::string::npos)
-            line.erase(semi);
-        auto hash = line.find('#');
-        if (hash != std::string::npos)
-            line.erase(hash);
+/**
+ * @brief ハンドル経由で単精度浮動小数値を設定する。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::SetFloat(Handle h, float v)
+{
+    SetString(h, FormatIniNumber(v).View());
+}
 
-        trim(line);
-        if (line.empty())
-            continue;
+/**
+ * @brief ハンドル経由で float 配列を設定する。
+ * @param h 対象ハンドル。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ */
+void Settings::SetFloats(Handle h, const float* v, size_t count)
+{
+    m_formatBuffer.clear();
+    AppendIniFloats(v, count, m_formatBuffer);
+    SetString(h, m_formatBuffer);
+}
 
-        if (line.front() == '[' && line.back() == ']')
-        {
-            currentCat = line.substr(1, line.size() - 2);
-            trim(currentCat);
-            continue;
-        }
+/**
+ * @brief ハンドル経由で int 配列を設定する。
+ * @param h 対象ハンドル。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ */
+void Settings::SetInts(Handle h, const int* v, size_t count)
+{
+    m_formatBuffer.clear();
+    AppendIniInts(v, count, m_formatBuffer);
+    SetString(h, m_formatBuffer);
+}
 
-        auto eq = line.find('=');
-        if (eq == std::string::npos)
-            continue;
+/**
+ * @brief ハンドル経由で整数値を設定する。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::SetInt(Handle h, int v)
+{
+    SetString(h, FormatIniNumber(v).View());
+}
 
-        std::string key = line.substr(0, eq);
-        std::string val = line.substr(eq + 1);
-        trim(key);
-        trim(val);
-        m_data[currentCat][key] = val;
-    }
-    return true;
+/**
+ * @brief ハンドル経由で真偽値を設定する。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::SetBool(Handle h, bool v)
+{
+    SetString(h, v ? "1" : "0");
 }
 
 /**
@@ -122,15 +1201,23 @@ bool Settings::Parse(const std::string& text)
  * @param key キー名。
  * @return 値が存在すればその文字列、無ければ std::nullopt。
  */
-std::optional<std::string> Settings::GetString(const std::string& cat, const std::string& key) const
+std::optional<std::string> Settings::GetString(std::string_view cat, std::string_view key) const
 {
-    auto itc = m_data.find(cat);
-    if (itc == m_data.end())
+    auto v = GetView(cat, key);
+    if (!v)
         return std::nullopt;
-    auto itk = itc->second.find(key);
-    if (itk == itc->second.end())
-        return std::nullopt;
-    return itk->second;
+    return std::string(*v);
+}
+
+/**
+ * @brief 文字列値をコピーせずに参照する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return 値が存在すればアリーナ内のビュー、無ければ std::nullopt。
+ */
+std::optional<std::string_view> Settings::GetView(std::string_view cat, std::string_view key) const
+{
+    return GetView(Handle{Find(cat, key)});
 }
 
 /**
@@ -140,19 +1227,9 @@ std::optional<std::string> Settings::GetString(const std::string& cat, const std
  * @param def 見つからない場合の既定値。
  * @return 値または既定値。
  */
-double Settings::GetDouble(const std::string& cat, const std::string& key, double def) const
+double Settings::GetDouble(std::string_view cat, std::string_view key, double def) const
 {
-    auto s = GetString(cat, key);
-    if (!s)
-        return def;
-    try
-    {
-        return std::stod(*s);
-    }
-    catch (...)
-    {
-        return def;
-    }
+    return GetDouble(Handle{Find(cat, key)}, def);
 }
 
 /**
@@ -162,19 +1239,9 @@ double Settings::GetDouble(const std::string& cat, const std::string& key, doubl
  * @param def 見つからない場合の既定値。
  * @return 値または既定値。
  */
-int Settings::GetInt(const std::string& cat, const std::string& key, int def) const
+int Settings::GetInt(std::string_view cat, std::string_view key, int def) const
 {
-    auto s = GetString(cat, key);
-    if (!s)
-        return def;
-    try
-    {
-        return std::stoi(*s);
-    }
-    catch (...)
-    {
-        return def;
-    }
+    return GetInt(Handle{Find(cat, key)}, def);
 }
 
 /**
@@ -184,18 +1251,9 @@ int Settings::GetInt(const std::string& cat, const std::string& key, int def) co
  * @param def 見つからない場合の既定値。
  * @return 値または既定値。
  */
-bool Settings::GetBool(const std::string& cat, const std::string& key, bool def) const
+bool Settings::GetBool(std::string_view cat, std::string_view key, bool def) const
 {
-    auto s = GetString(cat, key);
-    if (!s)
-        return def;
-    std::string v = *s;
-    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
-    if (v == "1" || v == "true" || v == "on" || v == "yes")
-        return true;
-    if (v == "0" || v == "false" || v == "off" || v == "no")
-        return false;
-    return def;
+    return GetBool(Handle{Find(cat, key)}, def);
 }
 
 /**
@@ -204,9 +1262,9 @@ bool Settings::GetBool(const std::string& cat, const std::string& key, bool def)
  * @param key キー名。
  * @param v 設定する値。
  */
-void Settings::SetString(const std::string& cat, const std::string& key, const std::string& v)
+void Settings::SetString(std::string_view cat, std::string_view key, std::string_view v)
 {
-    m_data[cat][key] = v;
+    SetString(Resolve(cat, key), v);
 }
 /**
  * @brief 倍精度浮動小数値を設定する。
@@ -214,9 +1272,19 @@ void Settings::SetString(const std::string& cat, const std::string& key, const s
  * @param key キー名。
  * @param v 設定する値。
  */
-void Settings::SetDouble(const std::string& cat, const std::string& key, double v)
+void Settings::SetDouble(std::string_view cat, std::string_view key, double v)
+{
+    SetDouble(Resolve(cat, key), v);
+}
+/**
+ * @brief 単精度浮動小数値を設定する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @param v 設定する値。
+ */
+void Settings::SetFloat(std::string_view cat, std::string_view key, float v)
 {
-    m_data[cat][key] = std::to_string(v);
+    SetFloat(Resolve(cat, key), v);
 }
 /**
  * @brief 整数値を設定する。
@@ -224,9 +1292,9 @@ void Settings::SetDouble(const std::string& cat, const std::string& key, double
  * @param key キー名。
  * @param v 設定する値。
  */
-void Settings::SetInt(const std::string& cat, const std::string& key, int v)
+void Settings::SetInt(std::string_view cat, std::string_view key, int v)
 {
-    m_data[cat][key] = std::to_string(v);
+    SetInt(Resolve(cat, key), v);
 }
 /**
  * @brief 真偽値を設定する。
@@ -234,36 +1302,462 @@ void Settings::SetInt(const std::string& cat, const std::string& key, int v)
  * @param key キー名。
  * @param v 設定する値。
  */
-void Settings::SetBool(const std::string& cat, const std::string& key, bool v)
+void Settings::SetBool(std::string_view cat, std::string_view key, bool v)
 {
-    m_data[cat][key] = v ? "1" : "0";
+    SetBool(Resolve(cat, key), v);
 }
 
 /**
- * @brief 現在の設定内容をファイルへ書き出す。
- * @return 保存に成功した場合は true。
+ * @brief ハンドルのカテゴリ名を取得する。
+ * @param h 対象ハンドル。
+ * @return カテゴリ名。
  */
-bool Settings::Save()
+std::string_view Settings::CategoryOf(Handle h) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? SpanView(m_names, s->cat) : std::string_view();
+}
+
+/**
+ * @brief ハンドルのキー名を取得する。
+ * @param h 対象ハンドル。
+ * @return キー名。
+ */
+std::string_view Settings::KeyOf(Handle h) const
+{
+    const Slot* s = SlotOf(h);
+    return s ? SpanView(m_names, s->key) : std::string_view();
+}
+
+/**
+ * @brief 複数キーの編集をまとめて確定するトランザクションを開始する。
+ * @return トランザクション。
+ */
+Settings::Transaction Settings::Begin()
+{
+    return Transaction(*this);
+}
+
+/**
+ * @brief 対象の Settings へ結び付けて開始する。
+ * @param settings 編集対象。
+ */
+Settings::Transaction::Transaction(Settings& settings)
+    : m_settings(settings)
+{
+}
+
+/**
+ * @brief 確定していない編集を破棄する。
+ */
+Settings::Transaction::~Transaction()
+{
+    Rollback();
+}
+
+/**
+ * @brief m_text の末尾に書式化した値を編集として積む。
+ * @param h 対象ハンドル。
+ * @param start 値の m_text 上の開始位置。
+ */
+void Settings::Transaction::Stage(Handle h, size_t start)
+{
+    m_edits.push_back(
+        Edit{h, IniSpan{static_cast<uint32_t>(start), static_cast<uint32_t>(m_text.size() - start)}});
+}
+
+/**
+ * @brief 文字列値の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::Transaction::SetString(Handle h, std::string_view v)
+{
+    const size_t start = m_text.size();
+    m_text.append(v.data(), v.size());
+    Stage(h, start);
+}
+
+/**
+ * @brief 倍精度浮動小数値の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::Transaction::SetDouble(Handle h, double v)
+{
+    SetString(h, FormatIniNumber(v).View());
+}
+
+/**
+ * @brief 単精度浮動小数値の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::Transaction::SetFloat(Handle h, float v)
+{
+    SetString(h, FormatIniNumber(v).View());
+}
+
+/**
+ * @brief 整数値の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::Transaction::SetInt(Handle h, int v)
+{
+    SetString(h, FormatIniNumber(v).View());
+}
+
+/**
+ * @brief 真偽値の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 設定する値。
+ */
+void Settings::Transaction::SetBool(Handle h, bool v)
+{
+    SetString(h, v ? "1" : "0");
+}
+
+/**
+ * @brief 基本ファイルからキーを取り除く操作を積む。
+ * @param h 対象ハンドル。
+ */
+void Settings::Transaction::Remove(Handle h)
+{
+    m_edits.push_back(Edit{h, IniSpan{kRemove, 0}});
+}
+
+/**
+ * @brief float 配列の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ */
+void Settings::Transaction::SetFloats(Handle h, const float* v, size_t count)
+{
+    const size_t start = m_text.size();
+    AppendIniFloats(v, count, m_text);
+    Stage(h, start);
+}
+
+/**
+ * @brief int 配列の設定を積む。
+ * @param h 対象ハンドル。
+ * @param v 要素の先頭。
+ * @param count 要素数。
+ */
+void Settings::Transaction::SetInts(Handle h, const int* v, size_t count)
 {
-    if (m_path.empty())
+    const size_t start = m_text.size();
+    AppendIniInts(v, count, m_text);
+    Stage(h, start);
+}
+
+/**
+ * @brief 積んだ編集を一度に適用し、公開・通知を 1 回ずつ行い、基本ファイルの未保存の編集として記録する。
+ * @details 適用はすべて所有スレッド上で完了してからスナップショットを公開するため、他スレッドの読み手には
+ *          全編集が反映された版か、それ以前の版のどちらかだけが見える。
+ *          ジャーナルが設定されていれば、基本レイヤーの値を実際に変えた編集を 1 つのグループとして記録する。
+ * @return いずれかのキーの実効値が変化した場合は true。
+ */
+bool Settings::Transaction::Commit()
+{
+    Settings& s = m_settings;
+    SettingsJournal* journal = m_edits.empty() ? nullptr : s.m_journal; // 空の Commit はグループを作らない
+    bool anyStored = false;
+    s.m_changed.clear();
+    if (journal)
+        journal->BeginGroup();
+    for (const Edit& e : m_edits)
+    {
+        const bool remove = e.value.offset == kRemove;
+        const std::string_view value = remove ? std::string_view() : SpanView(m_text, e.value);
+        if (journal && e.handle.id < s.m_slots.size())
+        {
+            // 追記でアリーナが移動する前に、置き換わる値を記録する
+            const Layer& base = s.m_layers[0];
+            const bool had = (s.m_slots[e.handle.id].layers & 1u) != 0;
+            const std::string_view before = had ? SpanView(base.text, base.values[e.handle.id]) : std::string_view();
+            if (had != !remove || (had && before != value))
+                journal->Record(e.handle, had ? &before : nullptr, remove ? nullptr : &value);
+        }
+
+        bool stored = false;
+        const bool changed = remove ? s.Unassign(e.handle, stored) : s.Assign(e.handle, value, stored);
+        if (changed &&
+            std::none_of(s.m_changed.begin(), s.m_changed.end(), [&](Handle c) { return c.id == e.handle.id; }))
+            s.m_changed.push_back(e.handle);
+        anyStored |= stored;
+    }
+    if (journal)
+        journal->EndGroup();
+    Rollback();
+
+    // 上位レイヤーに覆われたキーは実効値が変わらなくても、基本ファイルへは保存する。
+    // 直列化はドラッグ中のように毎フレーム確定されても重ならないよう、SaveIfDue でまとめて行う
+    if (anyStored && !s.m_layers[0].path.empty())
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (!s.m_saveDirty)
+            s.m_firstUnsaved = now;
+        s.m_lastUnsaved = now;
+        s.m_saveDirty = true;
+    }
+    if (s.m_changed.empty())
         return false;
-    std::ofstream ofs(m_path, std::ios::trunc);
-    if (!ofs)
+    s.PublishSnapshot();
+    s.PublishChanges();
+    return true;
+}
+
+/**
+ * @brief 積んだ編集を破棄する。
+ */
+void Settings::Transaction::Rollback()
+{
+    m_edits.clear();
+    m_text.clear();
+}
+
+/**
+ * @brief ファイルに無いキーの挿入位置を決める。
+ * @details 既存セクションのキーは、そのセクションの最後のキー行の直後へ挿入する。ファイルに無いセクションのキーは
+ *          offset を kNoOrigin のまま残し、セクションの出現順の通し番号を付けて末尾にまとめて足す。
+ *          セクション名はハッシュ索引で引くため、セクション数が多くてもキー数に比例した時間で済む。
+ * @param file 現在のファイル内容。
+ * @param edits 書き換え一覧 (insert のものの offset と section を埋める)。
+ */
+void Settings::PlaceInsertions(std::string_view file, std::vector<SaveEdit>& edits)
+{
+    // セクションごとに最後のキー行の直後の位置を求める (同名セクションが複数あれば最後のもの)。
+    // ファイルに無いセクションは end を kNoOrigin として同じ表に足し、通し番号を振る
+    struct SectionEnd
+    {
+        std::string_view name;
+        uint32_t end;
+        uint32_t ordinal;
+    };
+    std::vector<SectionEnd> ends;
+    FlatIndex index;
+    auto lookup = [&](std::string_view cat, uint64_t hash)
+    { return index.Find(hash, [&](uint32_t i) { return ends[i].name == cat; }); };
+
+    ParseIni(file, m_entries);
+    for (const IniEntry& e : m_entries)
+    {
+        std::string_view cat = e.section.length ? SpanView(file, e.section) : std::string_view("Default");
+        const size_t nl = file.find('\n', e.value.offset + e.value.length);
+        const uint32_t end = nl == std::string_view::npos ? static_cast<uint32_t>(file.size())
+                                                           : static_cast<uint32_t>(nl + 1);
+        const uint64_t hash = Hash64(cat);
+        const uint32_t i = lookup(cat, hash);
+        if (i != FlatIndex::kNone)
+        {
+            ends[i].end = end;
+        }
+        else
+        {
+            index.Insert(hash, static_cast<uint32_t>(ends.size()));
+            ends.push_back(SectionEnd{cat, end, 0});
+        }
+    }
+
+    uint32_t newSections = 0;
+    for (SaveEdit& e : edits)
+    {
+        if (!e.insert)
+            continue;
+        std::string_view cat = SpanView(m_names, m_slots[e.slot].cat);
+        const uint64_t hash = Hash64(cat);
+        uint32_t i = lookup(cat, hash);
+        if (i == FlatIndex::kNone)
+        {
+            i = static_cast<uint32_t>(ends.size());
+            index.Insert(hash, i);
+            ends.push_back(SectionEnd{cat, kNoOrigin, ++newSections});
+        }
+        e.offset = ends[i].end;
+        e.section = ends[i].ordinal;
+    }
+}
+
+/**
+ * @brief 基本レイヤーの編集をファイルへ反映する保存をライタースレッドへ予約する。
+ * @details 直前に読み込んだ (または保存した) ファイル内容を土台に、値が変わったキーの値の部分だけを置き換える。
+ *          コメント・空行・キーの順序・改行コードはそのまま残り、ファイルに無いキーは所属セクションの末尾
+ *          (セクションも無ければファイル末尾の新しいセクション) へ足し、取り除いたキーは行ごと削除する。
+ *          "@include" や継承で補った値は、編集された場合だけファイルへ足す。変化が無ければ何も書かない。
+ *          書き換えが 1 箇所だけで、同じ長さで 1 セクター内に収まる場合は、ライターにその位置だけを書き換えさせる
+ *          (ライターはディスク上の内容が土台と一致することを確かめてから書く)。それ以外は一時ファイル経由で書き出す。
+ *          保存した内容は直ちに基本レイヤーのファイル内容として取り込み直し、以降の保存の土台にする。
+ * @return 保存を予約した、または保存の必要が無かった場合は true。
+ */
+bool Settings::Save()
+{
+    Layer& base = m_layers[0];
+    if (base.path.empty())
         return false;
+    m_saveDirty = false;
+    base.Grow(m_slots.size());
+
+    const std::string_view file(base.text.data(), base.fileLength);
+    std::vector<SaveEdit>& edits = m_saveEdits;
+    edits.clear();
+    bool inPlace = true;
+    bool hasInsert = false;
+    for (uint32_t id = 0; id < m_slots.size(); ++id)
+    {
+        const IniSpan origin = base.origin[id];
+        if (!(m_slots[id].layers & 1u))
+        {
+            if (origin.offset == kNoOrigin)
+                continue;
+            // 取り除いたキーは、行頭から改行までの行全体を削除する
+            const size_t nl = origin.offset ? file.rfind('\n', origin.offset - 1) : std::string_view::npos;
+            const size_t begin = nl == std::string_view::npos ? 0 : nl + 1;
+            const size_t eol = file.find('\n', origin.offset + origin.length);
+            const size_t end = eol == std::string_view::npos ? file.size() : eol + 1;
+            edits.push_back(SaveEdit{static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin), id, false,
+                                     true, 0});
+            inPlace = false;
+            continue;
+        }
+        const std::string_view value = SpanView(base.text, base.values[id]);
+        if (origin.offset == kNoOrigin && base.values[id].offset >= base.fileLength &&
+            base.values[id].offset < base.resolvedLength)
+        {
+            continue; // 取り込んだファイルや継承元の値のまま編集されていない
+        }
+        if (origin.offset == kNoOrigin)
+        {
+            edits.push_back(SaveEdit{kNoOrigin, 0, id, true, false, 0});
+            hasInsert = true;
+        }
+        else if (SpanView(file, origin) != value)
+        {
+            edits.push_back(SaveEdit{origin.offset, origin.length, id, false, false, 0});
+            inPlace = inPlace && value.size() == origin.length &&
+                      AsyncFileWriter::FitsInSector(origin.offset, origin.length);
+        }
+    }
+    if (edits.empty())
+        return true; // ファイルの内容と同じなので書かない
 
-    for (auto& [cat, kv] : m_data)
+    if (hasInsert)
     {
-        ofs << "[" << cat << "]\n";
-        for (auto& [k, v] : kv)
-            ofs << k << "=" << v << "\n";
-        ofs << "\n";
+        inPlace = false;
+        PlaceInsertions(file, edits);
     }
-    ofs.flush();
-    ofs.close();
+    // 同じ位置では挿入を行の削除より先に置く (削除した行の先頭へ挿入する場合に範囲が重ならないように)
+    std::stable_sort(edits.begin(), edits.end(),
+                     [](const SaveEdit& a, const SaveEdit& b)
+                     {
+                         if (a.offset != b.offset)
+                             return a.offset < b.offset;
+                         return a.section != b.section ? a.section < b.section : a.erase < b.erase;
+                     });
 
-    if (std::filesystem::exists(m_path))
+    const std::string_view newline = file.find("\r\n") != std::string_view::npos ? "\r\n" : "\n";
+    std::string& out = m_saveBuffer;
+    out.clear();
+    out.reserve(file.size() + 256);
+    size_t cursor = 0;
+    size_t tail = edits.size();
+    for (size_t i = 0; i < edits.size(); ++i)
     {
-        m_lastWriteTime = std::filesystem::last_write_time(m_path);
+        const SaveEdit& e = edits[i];
+        if (e.offset == kNoOrigin)
+        {
+            tail = i;
+            break;
+        }
+        out.append(file.substr(cursor, e.offset - cursor));
+        const std::string_view value = SpanView(base.text, base.values[e.slot]);
+        if (e.insert)
+        {
+            if (!out.empty() && out.back() != '\n')
+                out.append(newline);
+            out.append(SpanView(m_names, m_slots[e.slot].key)).append("=").append(value).append(newline);
+        }
+        else if (!e.erase)
+        {
+            out.append(value);
+        }
+        cursor = e.offset + e.length; // 削除する行はここで読み飛ばす
+    }
+    out.append(file.substr(cursor));
+
+    // ファイルに無いセクションは、カテゴリの初出順 (整列で隣接済み) に、キーは登録順で末尾へ足す
+    for (size_t i = tail; i < edits.size(); ++i)
+    {
+        const Slot& s = m_slots[edits[i].slot];
+        if (i == tail || edits[i].section != edits[i - 1].section)
+        {
+            if (!out.empty() && out.back() != '\n')
+                out.append(newline);
+            if (!out.empty())
+                out.append(newline);
+            out.append("[").append(SpanView(m_names, s.cat)).append("]").append(newline);
+        }
+        out.append(SpanView(m_names, s.key)).append("=");
+        out.append(SpanView(base.text, base.values[edits[i].slot])).append(newline);
+    }
+
+    m_sourceSize = out.size();
+    base.hash = Hash64(out);
+    m_ownWrites[m_ownWriteCursor++ % 4] = base.hash;
+    base.spare.assign(out);
+    if (inPlace && edits.size() == 1)
+    {
+        // 複数箇所の書き換えは途中でクラッシュすると書きかけが残るため、1 回の書き込みで済む場合に限る
+        const SaveEdit& e = edits[0];
+        m_savePatch.offset = e.offset;
+        m_savePatch.bytes.assign(SpanView(base.text, base.values[e.slot]));
+        m_savePatch.before.assign(file.substr(e.offset, e.length));
+        m_writer.SubmitPatch(base.path, out, m_savePatch);
+    }
+    else
+    {
+        m_writer.Submit(base.path, out);
+    }
+
+    // 書き出す内容を新しいファイル内容として取り込み直す。値は変わらないため通知は起きない。
+    // 保存は取り込み指定を変えないため、取り込んだファイルは読み直さない
+    std::vector<Handle> changed;
+    changed.swap(m_changed);
+    Reparse(0);
+    m_changed.swap(changed);
+
+    // 削除したキーは基本レイヤーに値を持たないため、統合では位置が更新されない
+    for (const SaveEdit& e : edits)
+    {
+        if (e.erase)
+            base.origin[e.slot] = IniSpan{kNoOrigin, 0};
     }
     return true;
 }
+
+/**
+ * @brief 未保存の編集を、編集が途切れてから kSaveDebounce (編集が続いていれば最初の編集から kSaveMaxLatency) 後に
+ *        まとめて保存する。
+ * @return 保存を予約した場合は true。
+ */
+bool Settings::SaveIfDue()
+{
+    if (!m_saveDirty)
+        return false;
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastUnsaved < kSaveDebounce && now - m_firstUnsaved < kSaveMaxLatency)
+        return false;
+    return Save();
+}
+
+/**
+ * @brief 未保存の編集を直ちに保存し、書き出しの完了まで待つ。
+ */
+void Settings::FlushSave()
+{
+    if (m_saveDirty)
+        Save();
+    m_writer.Flush();
+}
@@ -1,8 +1,19 @@
 #pragma once
+#include "AsyncFileWriter.h"
+#include "FlatIndex.h"
+#include "IniArray.h"
+#include "IniParser.h"
+#include "SettingsSnapshot.h"
+#include "SnapshotCell.h"
+
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 
 /**
  * @file Settings.h
@@ -10,38 +21,489 @@
  * @author 山内陽
  */
 
+class SettingsJournal;
+
 /**
  * @brief INI 形式の設定を読み込み・保存するクラス。
+ * @details 設定は優先度順に積んだレイヤーの合成として扱う。レイヤー 0 は Load で読む基本ファイルで、Set* と Save の対象。
+ *          AddLayer で追加したレイヤーほど優先され、各キーの実効値は読み込み時に 1 つの表へ統合される。
+ *          Read() と SettingsSnapshot を除くメンバーは所有スレッド (描画スレッド) 専用。
+ *          他スレッドは Read() で得た不変スナップショットから値を読む。
  */
 class Settings
 {
 public:
+    /**
+     * @brief (カテゴリ, キー) を登録時に解決した固定 ID。
+     */
+    using Handle = SettingHandle;
+
+    static constexpr uint32_t kMaxLayers = 32; // レイヤー数の上限 (スロットのビット集合の幅)
+    static constexpr uint32_t kNoLayer = 0xFF; // 「どのレイヤーにも無い」を表す番号
+
+    /**
+     * @brief 他スレッドが保持するスナップショット参照。
+     */
+    using ReadGuard = SnapshotCell<SettingsSnapshot>::ReadGuard;
+
+    /**
+     * @brief 空のスナップショットを公開した状態で構築する。
+     */
+    Settings();
+
+    /**
+     * @brief 保存を待っている編集があれば書き出しを予約してから破棄する (ライターは保留分を書き切ってから止まる)。
+     */
+    ~Settings();
+
     /**
      * @brief 設定ファイルを読み込む。
+     * @details 隣に元ファイルと一致するバイナリキャッシュ ("<path>.cache") があればテキスト解析を省略する。
+     *          無いか古い場合は通常どおり解析し、キャッシュを作り直す。
      * @param path 対象ファイルパス。
      * @return 読み込みに成功した場合は true。
      */
     bool Load(const std::wstring& path);
 
+    /**
+     * @brief ファイルからの読み込みの統計。
+     */
+    struct ReloadStats
+    {
+        uint64_t loads = 0;       // 内容を解析して取り込んだ回数 (初回の読み込みを含む)
+        uint64_t skipped = 0;     // 内容が取り込み済みのものと同じだったため解析を省いた回数
+        uint64_t incremental = 0; // loads のうち、Diff の差分で変化したキーだけを統合し直した回数
+        double lastMs = 0.0;      // 直近の取り込み (解析・統合・通知) の所要時間 (ミリ秒)
+        double totalMs = 0.0;     // 取り込みの所要時間の合計 (ミリ秒)
+    };
+
     /**
      * @brief ファイルの更新を検知して再読み込みする。
+     * @details 更新時刻の変化を見つけてから SetReloadDebounce の時間だけ変化が落ち着くのを待って読み込む。
+     *          内容のハッシュが取り込み済みのものと同じなら解析を省く。変化があれば直前の内容とキー単位で比較し、
+     *          変化したキーだけを ChangedKeys() に載せて購読者へ通知する。
      * @return 再読み込みを行った場合は true。
      */
     bool ReloadIfChanged();
 
     /**
-     * @brief 現在の設定をファイルへ保存する。
-     * @return 保存に成功した場合は true。
+     * @brief ReloadIfChanged が更新時刻の変化を見つけてから読み込むまでの待ち時間を設定する。
+     * @details エディタの二重保存や一時ファイル経由の置き換えのように短時間に続く更新を 1 回の読み込みにまとめる。
+     * @param debounce 待ち時間 (0 なら変化を見つけた時点で読み込む)。
+     */
+    void SetReloadDebounce(std::chrono::milliseconds debounce)
+    {
+        m_reloadDebounce = debounce;
+    }
+
+    /**
+     * @brief 読み込みの統計を取得する。
+     * @return 統計。
+     */
+    const ReloadStats& Stats() const
+    {
+        return m_reloadStats;
+    }
+
+    /**
+     * @brief レイヤーに取り込み済みのファイル内容のハッシュを取得する。FileWatcher::Add へ渡すと同じ内容の読み込みを省ける。
+     * @param layer 対象レイヤー。
+     * @return Hash64 のハッシュ値 (未取り込みなら 0)。
+     */
+    uint64_t ContentHash(uint32_t layer = 0) const
+    {
+        return layer < m_layers.size() ? m_layers[layer].hash : 0;
+    }
+
+    /**
+     * @brief レイヤーのファイルが "@include" で (間接的にも) 取り込んでいるファイルを取得する。
+     * @param layer 対象レイヤー。
+     * @return 取り込んだファイルの絶対パス (取り込みが無ければ空)。
+     */
+    const std::vector<std::wstring>& Dependencies(uint32_t layer = 0) const
+    {
+        return m_layers[layer].dependencies;
+    }
+
+    /**
+     * @brief レイヤーに取り込み済みの、"@include" で取り込んだファイルの内容をまとめたハッシュを取得する。
+     * @param layer 対象レイヤー。
+     * @return IniIncludeCache::DependencyHash と同じ方法でまとめた値 (取り込みが無ければ 0)。
+     */
+    uint64_t DependencyHash(uint32_t layer = 0) const
+    {
+        return layer < m_layers.size() ? m_layers[layer].dependencyHash : 0;
+    }
+
+    /**
+     * @brief 別スレッドで読み込み・解析済みの内容を取り込む。ファイル I/O は行わない。
+     * @details ReloadIfChanged と同様に差分を取り、実効値が変化したキーを購読者へ通知する。
+     *          統合し直すのはそのレイヤーが定義している (いた) キーだけ。内容のハッシュ (doc.hash) が
+     *          取り込み済みのものと同じなら何もしない。
+     * @param doc 取り込む内容 (バッファは内部と交換され、呼び出し後は古い内容が入る)。
+     * @param layer 取り込み先レイヤー。
+     * @return 取り込みに成功した場合は true。
+     */
+    bool Apply(IniDocument& doc, uint32_t layer = 0);
+
+    /**
+     * @brief Diff が差分の基準として覚えておく、直前に受け渡した内容。監視するファイルごとに 1 つ持つ。
+     */
+    struct DiffBase
+    {
+        bool valid = false;            // 基準がある (無ければ次の Diff は差分を作らずに基準だけを覚える)
+        uint64_t hash = 0;             // 内容の hash
+        uint64_t dependencyHash = 0;   // 内容の dependencyHash
+        std::string text;              // 内容 (values の基準)
+        std::vector<IniSpan> values;   // ハンドルごとの値
+        std::vector<uint8_t> present;  // ハンドルごとの値の有無
+        std::vector<uint32_t> entryOf; // 作業領域 (ハンドルごとの最後のエントリ)
+    };
+
+    /**
+     * @brief 解析済みの内容を直前に受け渡した内容 (base) とキー単位で比較し、Apply が変化したキーだけを
+     *        統合し直せる差分を doc へ書き込む。任意のスレッドから呼べる (Read() のスナップショットだけを参照する)。
+     * @details キーは公開済みのキー名表でハンドルへ引く。表に無いキー (新しく現れたキー) があれば差分を作らずに
+     *          基準を捨てる。その内容は Apply が entries から統合し直してキーを登録する。
+     *          Apply は差分の基準が取り込み済みの内容と同じで、レイヤーが編集されていない場合だけ差分を使う。
+     * @param doc 解析済みの内容。incremental 以降を書き込む。
+     * @param base 直前に受け渡した内容。doc の内容へ更新される。
+     */
+    void Diff(IniDocument& doc, DiffBase& base) const;
+
+    /**
+     * @brief 既存のレイヤーより優先される上位レイヤーを追加する。
+     * @param name レイヤー名 (表示・診断用)。
+     * @param path 読み込むファイルパス。コマンドライン指定などメモリ上のみのレイヤーなら空。
+     * @return レイヤー番号。上限に達している場合は kNoLayer。
+     */
+    uint32_t AddLayer(std::string_view name, const std::wstring& path = {});
+
+    /**
+     * @brief レイヤーのファイルを読み込んで取り込む。
+     * @param layer 対象レイヤー。
+     * @return 読み込めた場合は true (ファイルが無い場合は false)。
+     */
+    bool LoadLayer(uint32_t layer);
+
+    /**
+     * @brief レイヤーの内容を INI テキストで置き換える。
+     * @param layer 対象レイヤー。
+     * @param text INI テキスト。
+     * @return 取り込めた場合は true。
+     */
+    bool SetLayerText(uint32_t layer, std::string_view text);
+
+    /**
+     * @brief レイヤー数を取得する。
+     * @return 基本レイヤーを含むレイヤー数。
+     */
+    uint32_t LayerCount() const
+    {
+        return static_cast<uint32_t>(m_layers.size());
+    }
+
+    /**
+     * @brief レイヤー名を取得する。
+     * @param layer 対象レイヤー。
+     * @return レイヤー名。
+     */
+    const std::string& LayerName(uint32_t layer) const
+    {
+        return m_layers[layer].name;
+    }
+
+    /**
+     * @brief レイヤーのファイルパスを取得する。
+     * @param layer 対象レイヤー。
+     * @return ファイルパス (メモリ上のみのレイヤーなら空)。
+     */
+    const std::wstring& LayerPath(uint32_t layer) const
+    {
+        return m_layers[layer].path;
+    }
+
+    /**
+     * @brief ハンドルの実効値を提供しているレイヤーを取得する。
+     * @param h 対象ハンドル。
+     * @return レイヤー番号。値が無ければ kNoLayer。
+     */
+    uint32_t SourceLayer(Handle h) const;
+
+    /**
+     * @brief 最新のスナップショットを参照する。任意のスレッドから待ちなしで呼べる。
+     * @return スナップショットへのガード。ガードは短時間で破棄すること (保持中は次の公開が古い版の回収を待つ)。
+     */
+    ReadGuard Read() const
+    {
+        return m_snapshot.Read();
+    }
+
+    /**
+     * @brief 前回の公開以降に Set* で変更された値があれば、新しいスナップショットとして公開する。
+     * @details 再読み込みによる変化は取り込み時に自動で公開される。編集はフレームごとなど区切りの良い時点でまとめて公開する。
+     */
+    void Publish();
+
+    /**
+     * @brief 値が変化したキーを受け取るコールバック型。
+     */
+    using ChangeCallback = std::function<void(Handle)>;
+
+    /**
+     * @brief 購読を識別する ID。
+     */
+    using SubscriptionId = uint32_t;
+
+    /**
+     * @brief 特定キーの変化を購読する。
+     * @param h 対象ハンドル。
+     * @param callback 変化時に呼ばれるコールバック。
+     * @return 購読 ID。
+     * @note コールバック内で購読の追加・解除を行ってはならない。
+     */
+    SubscriptionId Subscribe(Handle h, ChangeCallback callback);
+
+    /**
+     * @brief カテゴリ内いずれかのキーの変化を購読する。
+     * @param cat カテゴリ名。
+     * @param callback 変化したキーごとに呼ばれるコールバック。
+     * @return 購読 ID。
+     */
+    SubscriptionId SubscribeCategory(std::string_view cat, ChangeCallback callback);
+
+    /**
+     * @brief 購読を解除する。
+     * @param id Subscribe / SubscribeCategory が返した ID。
+     */
+    void Unsubscribe(SubscriptionId id);
+
+    class Transaction;
+
+    /**
+     * @brief 複数キーの編集をまとめて確定するトランザクションを開始する。
+     * @details 編集はトランザクション内に溜められ、Commit で一度に反映される。反映はスナップショットの公開 1 回・
+     *          変化通知 1 回にまとまり、他スレッドの読み手が編集の途中の状態を見ることはない。保存は SaveIfDue が
+     *          複数回の Commit をまとめて行う。
+     * @return トランザクション。Commit せずに破棄すると編集は捨てられる。
+     */
+    Transaction Begin();
+
+    /**
+     * @brief 直近の Load / ReloadIfChanged / Transaction::Commit で値が変化したキーの一覧を取得する。
+     * @return 変化したキーのハンドル列 (追加・削除を含む)。
+     */
+    const std::vector<Handle>& ChangedKeys() const
+    {
+        return m_changed;
+    }
+
+    /**
+     * @brief 現在の設定をファイルへ保存するよう予約する。
+     * @details 読み込んだファイルのうち値が変わったキーの値だけを書き換え、コメント・空行・順序・改行コードは保つ。
+     *          ファイルに無いキーは所属セクションの末尾へ足し、取り除いたキーは行ごと削除する。変化が無ければ何も書かない。
+     *          内容はメモリ上で組み立ててライタースレッドへ渡すだけで、呼び出し元はディスクを待たない。
+     *          短時間の連続した保存はまとめられ、同じ長さの書き換えだけならその位置のみ、それ以外は一時ファイル経由で
+     *          原子的に置き換えられる。
+     * @return 保存を予約した、または保存の必要が無かった場合は true。
      */
     bool Save();
 
+    /**
+     * @brief Transaction::Commit が溜めた未保存の編集を、待ち時間が過ぎていれば Save でまとめて保存する。
+     * @details Commit は基本レイヤーに未保存の編集があることを記録するだけで、直列化と取り込み直しは行わない。
+     *          編集が kSaveDebounce だけ途切れるか、最初の編集から kSaveMaxLatency を過ぎた時点でここで 1 回だけ行うため、
+     *          スライダーのドラッグのように毎フレーム確定しても保存の手間はフレームごとにはかからない。
+     *          所有スレッドでフレームの合間 (ファイル監視の取り込みと同じ契機) に呼ぶ。
+     * @return 保存を予約した場合は true。
+     */
+    bool SaveIfDue();
+
+    /**
+     * @brief 未保存の編集があるか取得する。
+     * @return Commit 後にまだ Save していない編集がある場合は true。
+     */
+    bool HasUnsavedChanges() const
+    {
+        return m_saveDirty;
+    }
+
+    /**
+     * @brief 未保存の編集を待ち時間に関わらず保存し、書き出しの完了まで待つ。
+     */
+    void FlushSave();
+
+    /**
+     * @brief (カテゴリ, キー) を値テーブル上のハンドルへ解決する。
+     * @details 未登録のキーは値を持たない状態で登録されるため、後から読み込まれた値も同じハンドルで参照できる。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @return 解決済みハンドル。
+     */
+    Handle Resolve(std::string_view cat, std::string_view key);
+
+    /**
+     * @brief ハンドルが指す値を持っているか判定する。
+     * @param h 対象ハンドル。
+     * @return 値が存在する場合は true。
+     */
+    bool Has(Handle h) const;
+
+    /**
+     * @brief ハンドル経由で文字列値を参照する。
+     * @param h 対象ハンドル。
+     * @return 値が存在すればビュー、無ければ std::nullopt。
+     * @note 返したビューは次の Set* / Load / ReloadIfChanged 呼び出しまで有効。
+     */
+    std::optional<std::string_view> GetView(Handle h) const;
+
+    /**
+     * @brief ハンドル経由でキャッシュ済みの倍精度浮動小数値を取得する。
+     * @param h 対象ハンドル。
+     * @param def 値が無いか数値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    double GetDouble(Handle h, double def) const;
+
+    /**
+     * @brief ハンドル経由でキャッシュ済みの整数値を取得する。
+     * @param h 対象ハンドル。
+     * @param def 値が無いか数値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    int GetInt(Handle h, int def) const;
+
+    /**
+     * @brief ハンドル経由でキャッシュ済みの真偽値を取得する。
+     * @param h 対象ハンドル。
+     * @param def 値が無いか真偽値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    bool GetBool(Handle h, bool def) const;
+
+    /**
+     * @brief ハンドル経由でキャッシュ済みの倍精度浮動小数値を、失敗理由付きで取得する。
+     * @param h 対象ハンドル。
+     * @param out 成功時の格納先 (失敗時は変更しない)。
+     * @return 成功なら std::errc{}、値が無いか数値でなければ std::errc::invalid_argument、
+     *         double の範囲外なら std::errc::result_out_of_range。
+     */
+    std::errc TryGetDouble(Handle h, double& out) const;
+
+    /**
+     * @brief ハンドル経由でキャッシュ済みの整数値を、失敗理由付きで取得する。小数部は切り捨てる。
+     * @param h 対象ハンドル。
+     * @param out 成功時の格納先 (失敗時は変更しない)。
+     * @return 成功なら std::errc{}、値が無いか数値でなければ std::errc::invalid_argument、
+     *         int の範囲外なら std::errc::result_out_of_range。
+     */
+    std::errc TryGetInt(Handle h, int& out) const;
+
+    /**
+     * @brief ハンドル経由でキャッシュ済みの真偽値を、失敗理由付きで取得する。
+     * @param h 対象ハンドル。
+     * @param out 成功時の格納先 (失敗時は変更しない)。
+     * @return 成功なら std::errc{}、値が無いか真偽値として解釈できなければ std::errc::invalid_argument。
+     */
+    std::errc TryGetBool(Handle h, bool& out) const;
+
+    /**
+     * @brief ハンドル経由で "1,0.5,0.25" 形式の値を float 配列として取得する。
+     * @param h 対象ハンドル。
+     * @param out 格納先 (count 要素)。失敗時の内容は不定。
+     * @param count 期待する要素数。
+     * @return 成功なら std::errc{}、値が無い・要素数が異なる・数値でない要素があれば std::errc::invalid_argument、
+     *         範囲外の要素があれば std::errc::result_out_of_range。
+     */
+    std::errc GetFloats(Handle h, float* out, size_t count) const;
+
+    /**
+     * @brief ハンドル経由で "1,2,3" 形式の値を int 配列として取得する。
+     * @param h 対象ハンドル。
+     * @param out 格納先 (count 要素)。失敗時の内容は不定。
+     * @param count 期待する要素数。
+     * @return GetFloats と同じ。
+     */
+    std::errc GetInts(Handle h, int* out, size_t count) const;
+
+    /**
+     * @brief ハンドル経由で任意長の配列値を 16 バイト境界の float 配列へ読み込む。
+     * @details 要素数を数えてから out を一度だけ確保し直し、値文字列から直接書き込む。
+     *          グラデーションやカーブなどの大きな配列に使う。
+     * @param h 対象ハンドル。
+     * @param out 格納先 (要素数に合わせて resize される。失敗時の内容は不定)。
+     * @return GetFloats と同じ。
+     */
+    std::errc GetFloatArray(Handle h, FloatArray& out) const;
+
+    /**
+     * @brief ハンドル経由で文字列値を設定する。
+     * @details 値は基本レイヤーへ書かれる。上位レイヤーが同じキーを定義している場合、実効値は変わらない。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetString(Handle h, std::string_view v);
+
+    /**
+     * @brief ハンドル経由で倍精度浮動小数値を設定する。値は読み戻すと同じ値になる最短の表記で書かれる。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetDouble(Handle h, double v);
+
+    /**
+     * @brief ハンドル経由で単精度浮動小数値を設定する。float として最短の表記で書かれる (0.1f は "0.1")。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetFloat(Handle h, float v);
+
+    /**
+     * @brief ハンドル経由で float 配列を "1,0.5,0.25" 形式で設定する。
+     * @param h 対象ハンドル。
+     * @param v 要素の先頭。
+     * @param count 要素数。
+     */
+    void SetFloats(Handle h, const float* v, size_t count);
+
+    /**
+     * @brief ハンドル経由で int 配列を "1,2,3" 形式で設定する。
+     * @param h 対象ハンドル。
+     * @param v 要素の先頭。
+     * @param count 要素数。
+     */
+    void SetInts(Handle h, const int* v, size_t count);
+
+    /**
+     * @brief ハンドル経由で整数値を設定する。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetInt(Handle h, int v);
+
+    /**
+     * @brief ハンドル経由で真偽値を設定する。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetBool(Handle h, bool v);
+
     /**
      * @brief 文字列値を取得する。
      * @param cat カテゴリ名。
      * @param key キー名。
      * @return 値が存在する場合は文字列、存在しなければ std::nullopt。
      */
-    std::optional<std::string> GetString(const std::string& cat, const std::string& key) const;
+    std::optional<std::string> GetString(std::string_view cat, std::string_view key) const;
+
+    /**
+     * @brief 文字列値をコピーせずに参照する。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @return 値が存在する場合は内部バッファを指すビュー、存在しなければ std::nullopt。
+     * @note 返したビューは次の Set* / Load / ReloadIfChanged 呼び出しまで有効。
+     */
+    std::optional<std::string_view> GetView(std::string_view cat, std::string_view key) const;
 
     /**
      * @brief 倍精度浮動小数値を取得する。
@@ -50,7 +512,7 @@ public:
      * @param def 見つからない場合の既定値。
      * @return 取得した値、または既定値。
      */
-    double GetDouble(const std::string& cat, const std::string& key, double def) const;
+    double GetDouble(std::string_view cat, std::string_view key, double def) const;
 
     /**
      * @brief 整数値を取得する。
@@ -59,7 +521,7 @@ public:
      * @param def 見つからない場合の既定値。
      * @return 取得した値、または既定値。
      */
-    int GetInt(const std::string& cat, const std::string& key, int def) const;
+    int GetInt(std::string_view cat, std::string_view key, int def) const;
 
     /**
      * @brief 真偽値を取得する。
@@ -68,7 +530,7 @@ public:
      * @param def 見つからない場合の既定値。
      * @return 取得した値、または既定値。
      */
-    bool GetBool(const std::string& cat, const std::string& key, bool def) const;
+    bool GetBool(std::string_view cat, std::string_view key, bool def) const;
 
     /**
      * @brief 文字列値を設定する。
@@ -76,7 +538,7 @@ public:
      * @param key キー名。
      * @param v 設定する値。
      */
-    void SetString(const std::string& cat, const std::string& key, const std::string& v);
+    void SetString(std::string_view cat, std::string_view key, std::string_view v);
 
     /**
      * @brief 倍精度浮動小数値を設定する。
@@ -84,7 +546,15 @@ public:
      * @param key キー名。
      * @param v 設定する値。
      */
-    void SetDouble(const std::string& cat, const std::string& key, double v);
+    void SetDouble(std::string_view cat, std::string_view key, double v);
+
+    /**
+     * @brief 単精度浮動小数値を設定する。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @param v 設定する値。
+     */
+    void SetFloat(std::string_view cat, std::string_view key, float v);
 
     /**
      * @brief 整数値を設定する。
@@ -92,7 +562,7 @@ public:
      * @param key キー名。
      * @param v 設定する値。
      */
-    void SetInt(const std::string& cat, const std::string& key, int v);
+    void SetInt(std::string_view cat, std::string_view key, int v);
 
     /**
      * @brief 真偽値を設定する。
@@ -100,7 +570,39 @@ public:
      * @param key キー名。
      * @param v 設定する値。
      */
-    void SetBool(const std::string& cat, const std::string& key, bool v);
+    void SetBool(std::string_view cat, std::string_view key, bool v);
+
+    /**
+     * @brief ハンドルのカテゴリ名を取得する。
+     * @param h 対象ハンドル。
+     * @return カテゴリ名 (無効なハンドルなら空)。
+     */
+    std::string_view CategoryOf(Handle h) const;
+
+    /**
+     * @brief ハンドルのキー名を取得する。
+     * @param h 対象ハンドル。
+     * @return キー名 (無効なハンドルなら空)。
+     */
+    std::string_view KeyOf(Handle h) const;
+
+    /**
+     * @brief Transaction::Commit で確定した編集を記録するジャーナルを設定する。
+     * @param journal 記録先 (nullptr で記録しない。Settings より長く生存すること)。
+     */
+    void SetJournal(SettingsJournal* journal)
+    {
+        m_journal = journal;
+    }
+
+    /**
+     * @brief 設定中のジャーナルを取得する。
+     * @return 記録先 (無ければ nullptr)。
+     */
+    SettingsJournal* Journal() const
+    {
+        return m_journal;
+    }
 
     /**
      * @brief 現在参照しているパスを取得する。
@@ -108,19 +610,439 @@ public:
      */
     std::wstring Path() const
     {
-        return m_path;
+        return m_layers[0].path;
+    }
+
+private:
+    static constexpr uint32_t kNoOrigin = 0xFFFFFFFFu;                // ファイル上に位置を持たないことを表す値
+    static constexpr std::chrono::milliseconds kSaveDebounce{250};    // 編集が途切れてから保存するまでの待ち時間
+    static constexpr std::chrono::milliseconds kSaveMaxLatency{1000}; // 編集が続いていても保存するまでの最大待ち時間
+
+    /**
+     * @brief 値テーブルの 1 要素。名前は m_names 内に持つ。
+     * @details 数値・真偽値キャッシュ (SettingValue) は実効値のものを持つ。値文字列は提供元レイヤーの values が指す
+     *          (SettingValue::value は使わない)。そのため差分の取り込みで変化しなかったキーには触れずに済む。
+     */
+    struct Slot : SettingValue
+    {
+        IniSpan cat;               // カテゴリ名 (m_names 内)
+        IniSpan key;               // キー名 (m_names 内)
+        SettingValue pending;      // 解析中の新しい値 (解析中レイヤーの spare 内。flags が 0 ならキャッシュ未計算)
+        uint32_t seen = 0;         // 最後に値が現れた解析世代
+        uint32_t layers = 0;       // 値を定義しているレイヤーのビット集合
+        uint8_t source = kNoLayer; // 実効値の提供元レイヤー
+    };
+
+    /**
+     * @brief 1 つの設定レイヤー。値は text 内のスパンとしてスロット順に持つ。
+     */
+    struct Layer
+    {
+        std::string name;                       // レイヤー名
+        std::wstring path;                      // 読み込むファイル (メモリ上のみなら空)
+        std::string text;                       // 現在の内容 (基本レイヤーでは編集値の追記先も兼ねる)
+        std::string spare;                      // 再読み込み用の読み込み先 (統合後に text と交換)
+        std::vector<IniSpan> values;            // スロットごとの値 (Slot::layers のビットが立っているものだけ有効)
+        std::vector<IniSpan> origin;            // スロットごとのファイル上の値の位置 (ファイルに無ければ offset が kNoOrigin)
+        uint32_t fileLength = 0;                // text 先頭のうちファイル内容そのものである部分の長さ
+        uint32_t resolvedLength = 0;            // 取り込み・継承の展開を含む長さ (以降は編集で追記した値)
+        uint64_t hash = 0;                      // 取り込んだファイル内容のハッシュ (未取り込みなら 0)
+        std::vector<std::wstring> dependencies; // "@include" で取り込んだファイル
+        uint64_t dependencyHash = 0;            // dependencies の内容をまとめたハッシュ (取り込みが無ければ 0)
+        IniIncluded included;                   // "@include" で取り込んだ内容 (保存後の解析し直しで再利用する)
+        bool pristine = false;                  // 内容が hash のファイルを解析したものそのまま (差分を取り込める)
+
+        /**
+         * @brief スロット数に合わせて配列を伸ばす。
+         * @param n スロット数。
+         */
+        void Grow(size_t n)
+        {
+            if (values.size() < n)
+            {
+                values.resize(n);
+                origin.resize(n, IniSpan{kNoOrigin, 0});
+            }
+        }
+    };
+
+    /**
+     * @brief 保存時の 1 件の書き換え。
+     */
+    struct SaveEdit
+    {
+        uint32_t offset;  // ファイル上の位置 (末尾に新しいセクションとして足す場合は kNoOrigin)
+        uint32_t length;  // 置き換える長さ (挿入なら 0)
+        uint32_t slot;    // 対象スロット
+        bool insert;      // キー行ごと挿入する
+        bool erase;       // キー行ごと削除する (offset / length は行全体)
+        uint32_t section; // 末尾に足す新しいセクションの通し番号 (出現順。それ以外は 0)
+    };
+
+    /**
+     * @brief 変化通知の購読者。
+     */
+    struct Subscriber
+    {
+        SubscriptionId id = 0;            // 購読 ID
+        uint32_t slot = Handle::kInvalid; // 対象スロット (カテゴリ購読時は無効値)
+        std::string category;             // 対象カテゴリ (キー購読時は空)
+        ChangeCallback callback;          // 通知先
+    };
+
+    /**
+     * @brief レイヤーの spare に読み込んだ INI テキストを解析し、差分を取りながら値テーブルへ反映する。
+     * @details "@include" とセクションの継承は IniIncludeCache で展開してから統合する。読み込みの経路専用
+     *          (取り込むファイルを読むことがある)。
+     * @param layer 対象レイヤー。
+     */
+    void Parse(uint32_t layer);
+
+    /**
+     * @brief 取り込み指定を変えずに書き換えた spare のテキストを、直前に取り込んだ内容を再利用して解析し直す。
+     * @details ファイル I/O も取り込みキャッシュのロックも伴わない。保存した内容の取り込み直しに使う。
+     * @param layer 対象レイヤー。
+     */
+    void Reparse(uint32_t layer);
+
+    /**
+     * @brief レイヤーの spare / m_entries の解析結果を直前の内容と比較し、そのレイヤーが関わるキーを統合し直す。
+     * @param layer 対象レイヤー。
+     * @param fileLength spare 先頭のうちファイル内容そのものである部分の長さ (以降の値はファイル上の位置を持たない)。
+     * @param cached m_entries と同じ並びの解析済み値 (バイナリキャッシュから読んだ場合)。nullptr なら値文字列から解析する。
+     */
+    void MergeLayer(uint32_t layer, uint32_t fileLength, const SettingValue* cached = nullptr);
+
+    /**
+     * @brief Diff で作った差分を取り込み、値が変わったキーだけを統合し直す。
+     * @param layer 対象レイヤー (内容は doc の差分の基準と同じであること)。
+     * @param doc 取り込む内容 (text / values / origin はレイヤーと交換され、呼び出し後は古い内容が入る)。
+     * @param fileLength doc.text 先頭のうちファイル内容そのものである部分の長さ。
+     */
+    void MergeDelta(uint32_t layer, IniDocument& doc, uint32_t fileLength);
+
+    /**
+     * @brief レイヤーの値が変わったスロットの実効値を決め直し、変化していれば通知とスナップショットの更新に載せる。
+     * @details 上位レイヤーに覆われたキーは実効値が変わらないので何もしない。
+     * @param id 対象スロット (layers のビットは更新済み)。
+     * @param layer 値が変わったレイヤー。
+     * @param text そのレイヤーの新しい値の基準バッファ。
+     * @param before 直前の実効値 (値が無かった場合は空)。
+     * @param parsed そのレイヤーの新しい値の解析済みキャッシュ (無ければ nullptr)。
+     */
+    void Settle(uint32_t id, uint32_t layer, std::string_view text, std::string_view before,
+                const SettingValue* parsed);
+
+    /**
+     * @brief スロットの実効値の文字列を取得する。
+     * @param id 値を持つスロット。
+     * @return 提供元レイヤーのテキスト内のビュー。
+     */
+    std::string_view ValueText(uint32_t id) const
+    {
+        const Layer& l = m_layers[m_slots[id].source];
+        return SpanView(l.text, l.values[id]);
+    }
+
+    /**
+     * @brief 値を定義しているレイヤーのうち最上位のものを返す。
+     * @param mask レイヤーのビット集合。
+     * @return レイヤー番号。どのレイヤーも定義していなければ kNoLayer。
+     */
+    uint32_t TopLayer(uint32_t mask) const;
+
+    /**
+     * @brief バイナリキャッシュのパスを取得する。
+     * @return キャッシュファイルのパス。
+     */
+    std::filesystem::path CachePath() const;
+
+    /**
+     * @brief 元 INI と一致するバイナリキャッシュがあれば、テキスト解析を行わずに取り込む。
+     * @return キャッシュから読み込んだ場合は true。
+     */
+    bool LoadCache();
+
+    /**
+     * @brief 現在の値テーブルをバイナリキャッシュへ書き出す。
+     */
+    void WriteCache();
+
+    /**
+     * @brief ファイルに無いキーの挿入位置を決める。既存セクションには最後のキー行の直後へ、それ以外は末尾へ足す。
+     * @param file 現在のファイル内容。
+     * @param edits 書き換え一覧 (insert のものの offset を埋める)。
+     */
+    void PlaceInsertions(std::string_view file, std::vector<SaveEdit>& edits);
+
+    /**
+     * @brief m_changed に載ったキーを購読者へ通知する。
+     */
+    void PublishChanges();
+
+    /**
+     * @brief 現在の値テーブルを写したスナップショットを作って公開する。
+     */
+    void PublishSnapshot();
+
+    /**
+     * @brief スロットの実効値が変わったことを記録し、次の公開でそのスロットを含む区画を作り直させる。
+     * @param id 対象スロット。
+     */
+    void MarkDirty(uint32_t id);
+
+    /**
+     * @brief 自身が保存した内容がそのまま読み戻されたものか判定する。
+     * @param hash 読み込んだ内容のハッシュ。
+     * @return 直近に保存した内容と一致する場合は true。
+     */
+    bool IsOwnWrite(uint64_t hash) const;
+
+    /**
+     * @brief 読み込んだ内容が取り込み済みのものと同じなら、解析を省いたことを記録する。
+     * @param layer 対象レイヤー。
+     * @param hash 読み込んだ内容のハッシュ。
+     * @param dependencyHash "@include" で取り込むファイルの内容をまとめたハッシュ。
+     * @return 取り込みを省く場合は true (ChangedKeys() は空になる)。
+     */
+    bool SkipUnchanged(uint32_t layer, uint64_t hash, uint64_t dependencyHash);
+
+    /**
+     * @brief 取り込み 1 回分の所要時間を統計へ加える。
+     * @param start 取り込みを始めた時刻。
+     */
+    void CountLoad(std::chrono::steady_clock::time_point start);
+
+    /**
+     * @brief ファイルを内部バッファへ読み込み解析する。
+     * @return 成功した場合は true。
+     */
+    bool ReadAndParse();
+
+    /**
+     * @brief カテゴリとキーから登録済みスロットを検索する。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @return スロット添字、未登録なら Handle::kInvalid。
+     */
+    uint32_t Find(std::string_view cat, std::string_view key) const;
+
+    /**
+     * @brief 計算済みのハッシュ値で登録済みスロットを検索する。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @param hash HashSettingKey(cat, key) の値。
+     * @return スロット添字、未登録なら Handle::kInvalid。
+     */
+    uint32_t Find(std::string_view cat, std::string_view key, uint64_t hash) const;
+
+    /**
+     * @brief キーを登録しスロット添字を返す (登録済みなら既存の添字)。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @return スロット添字。
+     */
+    uint32_t Intern(std::string_view cat, std::string_view key);
+
+    /**
+     * @brief スロットの値文字列から数値・真偽値キャッシュを更新する。
+     * @param slot 対象スロット。
+     * @param v 新しい実効値の文字列。
+     */
+    void UpdateCache(Slot& slot, std::string_view v) const;
+
+    /**
+     * @brief 基本レイヤーの値を差し替える。値が同じなら何もしない。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     * @param stored 基本レイヤーの値を書き換えた場合に true を受け取る。
+     * @return 実効値が変化した場合は true。
+     */
+    bool Assign(Handle h, std::string_view v, bool& stored);
+
+    /**
+     * @brief 基本レイヤーからキーの値を取り除く。実効値は他のレイヤーの定義 (無ければ値なし) になる。
+     * @param h 対象ハンドル。
+     * @param stored 基本レイヤーの値を取り除いた場合に true を受け取る。
+     * @return 実効値が変化した場合は true。
+     */
+    bool Unassign(Handle h, bool& stored);
+
+    /**
+     * @brief 文字列を基本レイヤーのアリーナ末尾へ追記しスパンを返す。
+     * @param s 追記する文字列。
+     * @return 追記した領域を指すスパン。
+     */
+    IniSpan Append(std::string_view s);
+
+    /**
+     * @brief 登録済みスロットの取得 (範囲外なら nullptr)。
+     * @param h 対象ハンドル。
+     * @return スロットへのポインタ。
+     */
+    const Slot* SlotOf(Handle h) const
+    {
+        return h.id < m_slots.size() ? &m_slots[h.id] : nullptr;
+    }
+
+    std::vector<Layer> m_layers;                            // 優先度の低い順に並べたレイヤー (0 は基本ファイル)
+    std::string m_names;                                    // 登録済みカテゴリ名・キー名の格納領域
+    std::vector<Slot> m_slots;                              // ハンドルで引く値テーブル (登録順)
+    FlatIndex m_index;                                      // (カテゴリ, キー) のハッシュ値からスロット添字を引く索引
+    std::vector<IniEntry> m_entries;                        // 解析結果の作業領域 (容量を再利用)
+    IniLinks m_links;                                       // 参照指定の作業領域 (容量を再利用)
+    std::vector<Handle> m_changed;                          // 直近の再読み込みで変化したキー
+    std::vector<Subscriber> m_subscribers;                  // 変化通知の購読者
+    SubscriptionId m_nextSubscription = 1;                  // 次に発行する購読 ID
+    uint32_t m_generation = 0;                              // 解析世代カウンタ
+    std::filesystem::file_time_type m_lastWriteTime{};      // 最終更新時刻
+    uint64_t m_sourceSize = 0;                              // 直近に読み込んだ INI のバイト数
+    std::chrono::milliseconds m_reloadDebounce{0};          // ReloadIfChanged の待ち時間
+    std::filesystem::file_time_type m_pendingWriteTime{};   // 見つけたが読み込みを待っている更新時刻
+    std::chrono::steady_clock::time_point m_pendingSince{}; // m_pendingWriteTime を見つけた時刻
+    ReloadStats m_reloadStats;                              // 読み込みの統計
+    std::string m_saveBuffer;                               // 保存内容の直列化先 (容量を再利用)
+    std::string m_formatBuffer;                             // 配列値の書式化先 (容量を再利用)
+    std::vector<SaveEdit> m_saveEdits;                      // 保存時の書き換え一覧 (容量を再利用)
+    FilePatch m_savePatch;                                  // 同じ長さの書き換えを差分として渡す作業領域
+    uint64_t m_ownWrites[4]{};                              // 自身が保存した内容のハッシュ (直近分)
+    uint32_t m_ownWriteCursor = 0;                          // m_ownWrites の次の書き込み位置
+    AsyncFileWriter m_writer;                               // 保存を担うライタースレッド (待ち時間は SaveIfDue 側で取る)
+    bool m_saveDirty = false;                               // Commit 後にまだ保存していない編集がある
+    std::chrono::steady_clock::time_point m_firstUnsaved{}; // 未保存の最初の編集の時刻
+    std::chrono::steady_clock::time_point m_lastUnsaved{};  // 未保存の最後の編集の時刻
+    SnapshotCell<SettingsSnapshot> m_snapshot;              // 他スレッドへ公開中のスナップショット
+    std::shared_ptr<const SettingsKeyTable> m_keys;         // 直近のスナップショットと共有するキー名表
+    std::vector<SettingsSnapshotChunk::Ptr> m_chunks;       // 直近のスナップショットと共有する値の区画
+    std::vector<uint8_t> m_dirtyChunks;                     // 区画ごとの未公開の変更の有無
+    uint64_t m_snapshotVersion = 0;                         // 最後に公開した版番号
+    bool m_snapshotDirty = false;                           // 未公開の編集がある
+    SettingsJournal* m_journal = nullptr;                   // 確定した編集の記録先 (無ければ nullptr)
+};
+
+/**
+ * @brief Settings への複数キーの編集を溜め、一度に確定するトランザクション。
+ * @details Set* は値を書式化して内部の小さなバッファへ積むだけで、Settings の値テーブルには触れない。
+ *          Commit ですべてを適用し、基本ファイルの値が変わった場合は未保存の編集として記録し (保存は Settings::SaveIfDue)、
+ *          実効値が変化した場合はスナップショットの公開と変化通知を 1 回ずつ行う。同じキーへの複数回の設定は最後の値が残る。
+ *          Settings と同じく所有スレッド専用で、同時に複数のトランザクションを開かないこと。
+ */
+class Settings::Transaction
+{
+public:
+    /**
+     * @brief 対象の Settings へ結び付けて開始する。
+     * @param settings 編集対象。
+     */
+    explicit Transaction(Settings& settings);
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    /**
+     * @brief 確定していない編集を破棄する。
+     */
+    ~Transaction();
+
+    /**
+     * @brief 文字列値の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetString(Handle h, std::string_view v);
+
+    /**
+     * @brief 倍精度浮動小数値の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetDouble(Handle h, double v);
+
+    /**
+     * @brief 単精度浮動小数値の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetFloat(Handle h, float v);
+
+    /**
+     * @brief 整数値の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetInt(Handle h, int v);
+
+    /**
+     * @brief 真偽値の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 設定する値。
+     */
+    void SetBool(Handle h, bool v);
+
+    /**
+     * @brief 基本ファイルからキーを取り除く操作を積む。保存時にはファイルのキー行も削除する。
+     * @param h 対象ハンドル。
+     */
+    void Remove(Handle h);
+
+    /**
+     * @brief float 配列の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 要素の先頭。
+     * @param count 要素数。
+     */
+    void SetFloats(Handle h, const float* v, size_t count);
+
+    /**
+     * @brief int 配列の設定を積む。
+     * @param h 対象ハンドル。
+     * @param v 要素の先頭。
+     * @param count 要素数。
+     */
+    void SetInts(Handle h, const int* v, size_t count);
+
+    /**
+     * @brief 積んだ編集を一度に適用し、公開・通知を 1 回ずつ行い、基本ファイルの未保存の編集として記録する。
+     * @details 直列化とファイルへの保存は Settings::SaveIfDue が待ち時間ごとに 1 回行う。基本ファイルのパスが無い
+     *          (メモリ上のみの) 場合は保存しない。確定後は空のトランザクションとして再利用できる。
+     * @return いずれかのキーの実効値が変化した場合は true。
+     */
+    bool Commit();
+
+    /**
+     * @brief 積んだ編集を破棄する。
+     */
+    void Rollback();
+
+    /**
+     * @brief 未確定の編集があるか判定する。
+     * @return 編集が積まれていれば true。
+     */
+    bool Pending() const
+    {
+        return !m_edits.empty();
     }
 
 private:
     /**
-     * @brief INI 形式文字列を解析して内部データに反映する。
-     * @param text 解析するテキスト。
-     * @return 解析に成功した場合は true。
+     * @brief 積まれた 1 件の編集。
+     */
+    struct Edit
+    {
+        Handle handle; // 対象ハンドル
+        IniSpan value; // 値 (m_text 内。offset が kRemove なら取り除く)
+    };
+
+    static constexpr uint32_t kRemove = 0xFFFFFFFFu; // Edit::value.offset に入れる「取り除く」の印
+
+    /**
+     * @brief m_text の末尾に書式化した値を編集として積む。
+     * @param h 対象ハンドル。
+     * @param start 値の m_text 上の開始位置。
      */
-    bool Parse(const std::string& text);
+    void Stage(Handle h, size_t start);
 
-    using KV = std::unordered_map<std::string, std::string>;
-    std::unordered_map<std::string, KV> m_data;        // カテゴリ別のキー・値テーブル
-    std::wstring m_path;                               // 設定ファイルのパス
-    std::filesystem::file_time_type m_lastWriteTime{}; // 最終更新時刻
+    Settings& m_settings;      // 編集対象
+    std::string m_text;        // 積んだ値の文字列
+    std::vector<Edit> m_edits; // 積んだ編集 (設定順)
 };
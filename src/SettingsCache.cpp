@@ -0,0 +1,184 @@
+/**
+ * @file SettingsCache.cpp
+ * @brief 設定バイナリキャッシュの読み書きの実装。
+ * @author 山内陽
+ */
+
+#include "SettingsCache.h"
+
+#include "AsyncFileWriter.h"
+#include "Hash.h"
+
+#include <cstring>
+
+/**
+ * @brief (カテゴリ, キー) からハッシュ索引用の値を計算する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return 32bit ハッシュ値。
+ */
+uint32_t SettingsCacheHash(std::string_view cat, std::string_view key)
+{
+    return static_cast<uint32_t>(Hash64(key, Hash64(cat)));
+}
+
+/**
+ * @brief キャッシュ内容を割り当てて検証する。壊れた・途中までのファイルは拒否する。
+ * @param data 先頭ポインタ。
+ * @param size バイト数。
+ * @return 形式が正しい場合は true。
+ */
+bool SettingsCacheView::Attach(const char* data, size_t size)
+{
+    m_header = nullptr;
+    if (!data || size < sizeof(SettingsCacheHeader) || reinterpret_cast<uintptr_t>(data) % alignof(double) != 0)
+        return false;
+
+    const auto* h = reinterpret_cast<const SettingsCacheHeader*>(data);
+    if (h->magic != SettingsCacheHeader::kMagic || h->version != SettingsCacheHeader::kVersion)
+        return false;
+
+    // 各領域がファイル内に収まり、正しく整列していることを確かめる
+    const uint64_t entriesEnd = h->entriesOffset + uint64_t(h->entryCount) * sizeof(SettingsCacheEntry);
+    const uint64_t bucketsEnd = h->bucketsOffset + uint64_t(h->bucketCount) * sizeof(uint32_t);
+    const uint64_t stringsEnd = h->stringsOffset + uint64_t(h->stringsSize);
+    if (entriesEnd > size || bucketsEnd > size || stringsEnd > size || h->sourceSize > h->stringsSize)
+        return false;
+    if (h->entriesOffset % alignof(SettingsCacheEntry) != 0 || h->bucketsOffset % alignof(uint32_t) != 0)
+        return false;
+    if (h->bucketCount == 0 || (h->bucketCount & (h->bucketCount - 1)) != 0 || h->bucketCount <= h->entryCount)
+        return false;
+
+    const auto* entries = reinterpret_cast<const SettingsCacheEntry*>(data + h->entriesOffset);
+    for (uint32_t i = 0; i < h->entryCount; ++i)
+    {
+        const SettingsCacheEntry& e = entries[i];
+        if (uint64_t(e.cat) + e.catLen > h->stringsSize || uint64_t(e.key) + e.keyLen > h->stringsSize ||
+            uint64_t(e.value) + e.valueLen > h->stringsSize)
+            return false;
+    }
+
+    m_header = h;
+    m_entries = entries;
+    m_buckets = reinterpret_cast<const uint32_t*>(data + h->bucketsOffset);
+    m_strings = std::string_view(data + h->stringsOffset, h->stringsSize);
+    return true;
+}
+
+/**
+ * @brief ハッシュ索引を線形探査してエントリを検索する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return エントリ、見つからなければ nullptr。
+ */
+const SettingsCacheEntry* SettingsCacheView::Find(std::string_view cat, std::string_view key) const
+{
+    if (!m_header)
+        return nullptr;
+    const uint32_t hash = SettingsCacheHash(cat, key);
+    const uint32_t mask = m_header->bucketCount - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        const uint32_t slot = m_buckets[i];
+        if (slot == 0 || slot > m_header->entryCount)
+            return nullptr;
+        const SettingsCacheEntry& e = m_entries[slot - 1];
+        if (e.hash == hash && m_strings.substr(e.cat, e.catLen) == cat && m_strings.substr(e.key, e.keyLen) == key)
+            return &e;
+    }
+}
+
+/**
+ * @brief 元 INI の内容を文字列領域の先頭へ複写する。
+ * @param source 元 INI の内容。
+ */
+SettingsCacheBuilder::SettingsCacheBuilder(std::string_view source)
+    : m_strings(source)
+{
+}
+
+/**
+ * @brief エントリを追加する。値は元 INI 内の位置をそのまま使い、連続する同一カテゴリ名は文字列領域を共有する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @param value 元 INI 内の値の位置。
+ * @param number 解析済み数値。
+ * @param flags SettingValue::Flags。
+ */
+void SettingsCacheBuilder::Add(std::string_view cat, std::string_view key, IniSpan value, double number,
+                               uint32_t flags)
+{
+    SettingsCacheEntry e{};
+    if (!m_entries.empty() && std::string_view(m_strings).substr(m_entries.back().cat, m_entries.back().catLen) == cat)
+        e.cat = m_entries.back().cat;
+    else
+        e.cat = AppendString(cat);
+    e.catLen = static_cast<uint32_t>(cat.size());
+    e.key = AppendString(key);
+    e.keyLen = static_cast<uint32_t>(key.size());
+    e.value = value.offset;
+    e.valueLen = value.length;
+    e.flags = flags;
+    e.hash = SettingsCacheHash(cat, key);
+    e.number = number;
+    m_entries.push_back(e);
+}
+
+/**
+ * @brief 文字列を文字列領域へ追記する。
+ * @param s 追記する文字列。
+ * @return 文字列領域内の位置。
+ */
+uint32_t SettingsCacheBuilder::AppendString(std::string_view s)
+{
+    const uint32_t offset = static_cast<uint32_t>(m_strings.size());
+    m_strings.append(s.data(), s.size());
+    return offset;
+}
+
+/**
+ * @brief ハッシュ索引を作り、ヘッダー・エントリ・索引・文字列の順に直列化して書き出す。
+ * @param path 書き出し先パス。
+ * @param sourceSize 元 INI のバイト数。
+ * @param sourceTime 元 INI の最終更新時刻。
+ * @param sourceHash 元 INI 内容のハッシュ。
+ * @return 成功した場合は true。
+ */
+bool SettingsCacheBuilder::Write(const std::filesystem::path& path, uint64_t sourceSize, int64_t sourceTime,
+                                 uint64_t sourceHash)
+{
+    // 負荷率 50% 以下になるバケット数
+    uint32_t bucketCount = 8;
+    while (bucketCount < m_entries.size() * 2)
+        bucketCount <<= 1;
+    std::vector<uint32_t> buckets(bucketCount, 0);
+    for (uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        uint32_t b = m_entries[i].hash & (bucketCount - 1);
+        while (buckets[b] != 0)
+            b = (b + 1) & (bucketCount - 1);
+        buckets[b] = i + 1;
+    }
+
+    SettingsCacheHeader h{};
+    h.magic = SettingsCacheHeader::kMagic;
+    h.version = SettingsCacheHeader::kVersion;
+    h.sourceSize = sourceSize;
+    h.sourceTime = sourceTime;
+    h.sourceHash = sourceHash;
+    h.entryCount = static_cast<uint32_t>(m_entries.size());
+    h.bucketCount = bucketCount;
+    h.entriesOffset = sizeof(SettingsCacheHeader);
+    h.bucketsOffset = h.entriesOffset + h.entryCount * static_cast<uint32_t>(sizeof(SettingsCacheEntry));
+    h.stringsOffset = h.bucketsOffset + bucketCount * static_cast<uint32_t>(sizeof(uint32_t));
+    h.stringsSize = static_cast<uint32_t>(m_strings.size());
+
+    std::string out(h.stringsOffset + m_strings.size(), '\0');
+    std::memcpy(&out[0], &h, sizeof(h));
+    if (!m_entries.empty())
+        std::memcpy(&out[h.entriesOffset], m_entries.data(), m_entries.size() * sizeof(SettingsCacheEntry));
+    std::memcpy(&out[h.bucketsOffset], buckets.data(), buckets.size() * sizeof(uint32_t));
+    if (!m_strings.empty())
+        std::memcpy(&out[h.stringsOffset], m_strings.data(), m_strings.size());
+    return AsyncFileWriter::WriteAtomically(path, out);
+}
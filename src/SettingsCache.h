@@ -0,0 +1,176 @@
+#pragma once
+#include "IniParser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file SettingsCache.h
+ * @brief 解析済み設定を保存するバイナリキャッシュの形式と読み書きの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief キャッシュファイル先頭のヘッダー。
+ * @details ファイルはヘッダー・エントリ配列・ハッシュ索引・文字列領域の順に並び、位置はすべて先頭からのオフセットで表す。
+ *          ポインタを含まないため、メモリマップしたまま直接参照できる。
+ *          文字列領域の先頭 sourceSize バイトは元 INI の内容そのもので、値はその中の位置を指す。
+ */
+struct SettingsCacheHeader
+{
+    uint32_t magic;         // kMagic
+    uint32_t version;       // kVersion
+    uint64_t sourceSize;    // 元 INI のバイト数
+    int64_t sourceTime;     // 元 INI の最終更新時刻 (file_time_type の刻み数)
+    uint64_t sourceHash;    // 元 INI 内容の Hash64
+    uint32_t entryCount;    // エントリ数
+    uint32_t bucketCount;   // ハッシュ索引のバケット数 (2 の冪)
+    uint32_t entriesOffset; // エントリ配列の位置
+    uint32_t bucketsOffset; // ハッシュ索引の位置
+    uint32_t stringsOffset; // 文字列領域の位置
+    uint32_t stringsSize;   // 文字列領域のバイト数
+
+    static constexpr uint32_t kMagic = 0x31435348; // "HSC1"
+    static constexpr uint32_t kVersion = 3;
+};
+static_assert(sizeof(SettingsCacheHeader) == 56, "SettingsCacheHeader layout must be stable");
+
+/**
+ * @brief 1 キー分のエントリ。文字列は文字列領域内のオフセットで持ち、数値・真偽値は解析済みの形で持つ。
+ */
+struct SettingsCacheEntry
+{
+    uint32_t cat;      // カテゴリ名の位置
+    uint32_t catLen;   // カテゴリ名の長さ
+    uint32_t key;      // キー名の位置
+    uint32_t keyLen;   // キー名の長さ
+    uint32_t value;    // 値文字列の位置
+    uint32_t valueLen; // 値文字列の長さ
+    uint32_t flags;    // SettingValue::Flags
+    uint32_t hash;     // (カテゴリ, キー) のハッシュ下位 32bit
+    double number;     // 解析済み数値
+};
+static_assert(sizeof(SettingsCacheEntry) == 40, "SettingsCacheEntry layout must be stable");
+
+/**
+ * @brief (カテゴリ, キー) からハッシュ索引用の値を計算する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return 32bit ハッシュ値。
+ */
+uint32_t SettingsCacheHash(std::string_view cat, std::string_view key);
+
+/**
+ * @brief メモリ上のキャッシュ内容を検証し、型付きで参照するビュー。
+ * @details 内容はコピーしない。参照元 (MappedFile など) の寿命を超えて使わないこと。
+ */
+class SettingsCacheView
+{
+public:
+    /**
+     * @brief キャッシュ内容を割り当てて検証する。
+     * @param data 先頭ポインタ (8 バイト境界)。
+     * @param size バイト数。
+     * @return 形式が正しく、全エントリが範囲内を指している場合は true。
+     */
+    bool Attach(const char* data, size_t size);
+
+    /**
+     * @brief ヘッダーを取得する。
+     * @return ヘッダー。
+     */
+    const SettingsCacheHeader& Header() const
+    {
+        return *m_header;
+    }
+
+    /**
+     * @brief エントリ数を取得する。
+     * @return エントリ数。
+     */
+    uint32_t Count() const
+    {
+        return m_header->entryCount;
+    }
+
+    /**
+     * @brief エントリを取得する。エントリは Settings のスロット登録順に並んでいる。
+     * @param i 添字。
+     * @return エントリ。
+     */
+    const SettingsCacheEntry& Entry(uint32_t i) const
+    {
+        return m_entries[i];
+    }
+
+    /**
+     * @brief 文字列領域全体を取得する。エントリの位置はこの領域の先頭が基準。
+     * @return 文字列領域。
+     */
+    std::string_view Strings() const
+    {
+        return m_strings;
+    }
+
+    /**
+     * @brief ハッシュ索引を引いてエントリを検索する。設定全体を読み込まずに個別の値を得たい場合に使う。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @return エントリ、見つからなければ nullptr。
+     */
+    const SettingsCacheEntry* Find(std::string_view cat, std::string_view key) const;
+
+private:
+    const SettingsCacheHeader* m_header = nullptr; // ヘッダー
+    const SettingsCacheEntry* m_entries = nullptr; // エントリ配列
+    const uint32_t* m_buckets = nullptr;           // ハッシュ索引 (エントリ添字 + 1、0 は空き)
+    std::string_view m_strings;                    // 文字列領域
+};
+
+/**
+ * @brief キャッシュファイルを組み立てて書き出す。
+ */
+class SettingsCacheBuilder
+{
+public:
+    /**
+     * @brief 元 INI の内容を文字列領域の先頭に置いて組み立てを始める。
+     * @param source 元 INI の内容。
+     */
+    explicit SettingsCacheBuilder(std::string_view source);
+
+    /**
+     * @brief エントリを追加する。(カテゴリ, キー) 順に追加すること。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @param value 元 INI 内の値の位置。
+     * @param number 解析済み数値。
+     * @param flags SettingValue::Flags。
+     */
+    void Add(std::string_view cat, std::string_view key, IniSpan value, double number, uint32_t flags);
+
+    /**
+     * @brief 組み立てた内容を原子的に書き出す。
+     * @param path 書き出し先パス。
+     * @param sourceSize 元 INI のバイト数。
+     * @param sourceTime 元 INI の最終更新時刻。
+     * @param sourceHash 元 INI 内容のハッシュ。
+     * @return 成功した場合は true。
+     */
+    bool Write(const std::filesystem::path& path, uint64_t sourceSize, int64_t sourceTime, uint64_t sourceHash);
+
+private:
+    /**
+     * @brief 文字列を文字列領域へ追記し位置を返す。
+     * @param s 追記する文字列。
+     * @return 文字列領域内の位置。
+     */
+    uint32_t AppendString(std::string_view s);
+
+    std::vector<SettingsCacheEntry> m_entries; // 追加済みエントリ
+    std::string m_strings;                     // 文字列領域 (先頭は元 INI の内容)
+};
@@ -0,0 +1,419 @@
+/**
+ * @file SettingsJournal.cpp
+ * @brief 設定の編集履歴と、その記録の書き出し・再生の実装。
+ * @author 山内陽
+ */
+
+#include "SettingsJournal.h"
+
+#include "AsyncFileWriter.h"
+#include "Settings.h"
+
+#include <cstring>
+
+/**
+ * @brief ログファイル先頭の識別子。
+ */
+static constexpr char kJournalMagic[4] = {'S', 'J', 'N', 'L'};
+
+/**
+ * @brief ログファイルの形式の版。
+ */
+static constexpr uint64_t kJournalVersion = 1;
+
+/**
+ * @brief 符号なし整数を 7bit ずつの可変長整数として追記する。
+ * @param out 追記先。
+ * @param v 値。
+ */
+static void AppendVarint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+/**
+ * @brief 可変長整数を読み取る。
+ * @param data 入力。
+ * @param pos 読み取り位置 (読んだ分だけ進む)。
+ * @param v 値を受け取る。
+ * @return 読み取れた場合は true。
+ */
+static bool ReadVarint(std::string_view data, size_t& pos, uint64_t& v)
+{
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && pos < data.size(); shift += 7)
+    {
+        const uint8_t b = static_cast<uint8_t>(data[pos++]);
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 長さ付きの文字列を読み取る。
+ * @param data 入力。
+ * @param pos 読み取り位置 (読んだ分だけ進む)。
+ * @param length 長さ。
+ * @param span data 上の位置を受け取る。
+ * @return 範囲内に収まっていれば true。
+ */
+static bool ReadBytes(std::string_view data, size_t& pos, uint64_t length, IniSpan& span)
+{
+    if (length > data.size() - pos)
+        return false;
+    span = IniSpan{static_cast<uint32_t>(pos), static_cast<uint32_t>(length)};
+    pos += static_cast<size_t>(length);
+    return true;
+}
+
+/**
+ * @brief 記録と文字列のリングバッファを確保する。
+ * @param maxRecords 保持する編集の最大件数。
+ * @param maxTextBytes 文字列領域のバイト数。
+ */
+SettingsJournal::SettingsJournal(size_t maxRecords, size_t maxTextBytes)
+    : m_entries(maxRecords ? maxRecords : 1)
+    , m_text(maxTextBytes ? maxTextBytes : 1, '\0')
+{
+}
+
+/**
+ * @brief 1 回の Commit 分のグループを開始する。MergeNextGroup の指定があり、直前のグループが履歴の末尾にあれば
+ *        それを続ける。
+ */
+void SettingsJournal::BeginGroup()
+{
+    const bool merge = m_mergeNext && m_cursor == m_end && m_end > m_first && At(m_end - 1).group == m_group;
+    m_mergeNext = false;
+    if (!merge)
+        ++m_group;
+    m_dropped = false;
+}
+
+/**
+ * @brief 現在のグループへ 1 件の編集を記録する。
+ * @details やり直し分を捨ててから、文字列が入るまで古いグループを捨てる。記録中のグループ自体が
+ *          容量に収まらない場合は、途中までしか戻せない履歴を残さないよう履歴全体を破棄する。
+ *          同じグループの直前の編集と同じキーであれば、その旧値を引き継いで 1 件に置き換える
+ *          (ドラッグ中の毎フレームの編集が 1 件にまとまる)。
+ * @param h 対象ハンドル。
+ * @param before 変更前の値 (無ければ nullptr)。
+ * @param after 変更後の値 (無ければ nullptr)。
+ */
+void SettingsJournal::Record(Handle h, const std::string_view* before, const std::string_view* after)
+{
+    if (m_dropped)
+        return;
+    m_end = m_cursor;
+
+    std::string_view carried;
+    if (m_end > m_first && At(m_end - 1).group == m_group && At(m_end - 1).handle.id == h.id)
+    {
+        // 直前の編集を取り除き、その旧値 (リング上に残っている) を新しい編集の旧値にする
+        const Entry& last = At(--m_end);
+        m_cursor = m_end;
+        m_textEnd = last.text;
+        carried = OldValue(last);
+        before = last.hasOld ? &carried : nullptr;
+    }
+
+    const size_t oldLength = before ? before->size() : 0;
+    const size_t newLength = after ? after->size() : 0;
+    const size_t length = oldLength + newLength;
+    const size_t capacity = m_text.size();
+    if (length > capacity)
+    {
+        Clear();
+        m_dropped = true;
+        return;
+    }
+
+    uint64_t pos = 0;
+    for (;;)
+    {
+        // 1 件分の文字列は折り返さずに置くため、末尾に収まらなければ先頭へ送る
+        pos = m_textEnd;
+        if (pos % capacity + length > capacity)
+            pos += capacity - pos % capacity;
+        const bool full = m_end - m_first == m_entries.size();
+        const uint64_t begin = m_first == m_end ? pos : At(m_first).text;
+        if (!full && pos + length - begin <= capacity)
+            break;
+        if (At(m_first).group == m_group)
+        {
+            Clear();
+            m_dropped = true;
+            return;
+        }
+        EvictOldestGroup();
+    }
+
+    char* dst = &m_text[pos % capacity];
+    if (before)
+        std::memmove(dst, before->data(), oldLength); // 引き継いだ旧値は同じ領域内にあるため重なり得る
+    if (after)
+        std::memcpy(dst + oldLength, after->data(), newLength);
+
+    Entry& e = m_entries[m_end % m_entries.size()];
+    e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    e.handle = h;
+    e.group = m_group;
+    e.text = pos;
+    e.oldLength = static_cast<uint32_t>(oldLength);
+    e.newLength = static_cast<uint32_t>(newLength);
+    e.hasOld = before != nullptr;
+    e.hasNew = after != nullptr;
+    m_textEnd = pos + length;
+    m_cursor = ++m_end;
+}
+
+/**
+ * @brief 現在のグループを閉じる。
+ */
+void SettingsJournal::EndGroup()
+{
+    m_dropped = false;
+}
+
+/**
+ * @brief 最も古いグループを捨てる。
+ */
+void SettingsJournal::EvictOldestGroup()
+{
+    const uint32_t group = At(m_first).group;
+    while (m_first < m_end && At(m_first).group == group)
+        ++m_first;
+    if (m_cursor < m_first)
+        m_cursor = m_first;
+}
+
+/**
+ * @brief 直前のグループを元に戻す。
+ * @details 新しい編集から順に旧値を積むため、同じキーを複数回変えたグループでも最初の旧値が残る。
+ *          適用中はジャーナルを外し、元に戻す操作自体が履歴に載らないようにする。
+ * @param settings 適用先。
+ * @return 元に戻した場合は true。
+ */
+bool SettingsJournal::Undo(Settings& settings)
+{
+    if (!CanUndo())
+        return false;
+    const uint32_t group = At(m_cursor - 1).group;
+    Settings::Transaction edit(settings);
+    while (m_cursor > m_first && At(m_cursor - 1).group == group)
+    {
+        const Entry& e = At(--m_cursor);
+        if (e.hasOld)
+            edit.SetString(e.handle, OldValue(e));
+        else
+            edit.Remove(e.handle);
+    }
+
+    SettingsJournal* journal = settings.Journal();
+    settings.SetJournal(nullptr);
+    edit.Commit();
+    settings.SetJournal(journal);
+    return true;
+}
+
+/**
+ * @brief 元に戻したグループをやり直す。
+ * @param settings 適用先。
+ * @return やり直した場合は true。
+ */
+bool SettingsJournal::Redo(Settings& settings)
+{
+    if (!CanRedo())
+        return false;
+    const uint32_t group = At(m_cursor).group;
+    Settings::Transaction edit(settings);
+    while (m_cursor < m_end && At(m_cursor).group == group)
+    {
+        const Entry& e = At(m_cursor++);
+        if (e.hasNew)
+            edit.SetString(e.handle, NewValue(e));
+        else
+            edit.Remove(e.handle);
+    }
+
+    SettingsJournal* journal = settings.Journal();
+    settings.SetJournal(nullptr);
+    edit.Commit();
+    settings.SetJournal(journal);
+    return true;
+}
+
+/**
+ * @brief 履歴をすべて破棄する。
+ */
+void SettingsJournal::Clear()
+{
+    m_first = m_end = m_cursor = 0;
+    m_textEnd = 0;
+}
+
+/**
+ * @brief 元に戻せる範囲の編集をログとして書き出す。
+ * @details 形式は "SJNL"・版・キー数・(カテゴリ名, キー名) の表・編集数に続けて、編集ごとに
+ *          前の編集からの時刻差・グループが変わったか (0/1)・キー番号・旧値の長さ + 1・旧値・新値の長さ + 1・新値。
+ *          長さ + 1 が 0 の場合は値が無いことを表す。整数はすべて可変長整数。
+ * @param path 書き出し先。
+ * @param settings キー名を引く Settings。
+ * @return 書き出しに成功した場合は true。
+ */
+bool SettingsJournal::Export(const std::filesystem::path& path, const Settings& settings) const
+{
+    // 記録に現れるハンドルだけを出現順に番号付けする
+    std::vector<uint32_t> keyOf;
+    std::vector<Handle> keys;
+    for (uint64_t seq = m_first; seq < m_cursor; ++seq)
+    {
+        const uint32_t id = At(seq).handle.id;
+        if (id >= keyOf.size())
+            keyOf.resize(id + 1, UINT32_MAX);
+        if (keyOf[id] == UINT32_MAX)
+        {
+            keyOf[id] = static_cast<uint32_t>(keys.size());
+            keys.push_back(At(seq).handle);
+        }
+    }
+
+    std::string out(kJournalMagic, sizeof(kJournalMagic));
+    AppendVarint(out, kJournalVersion);
+    AppendVarint(out, keys.size());
+    for (Handle h : keys)
+    {
+        const std::string_view cat = settings.CategoryOf(h);
+        const std::string_view key = settings.KeyOf(h);
+        AppendVarint(out, cat.size());
+        out.append(cat);
+        AppendVarint(out, key.size());
+        out.append(key);
+    }
+
+    AppendVarint(out, m_cursor - m_first);
+    int64_t prevTime = m_first < m_cursor ? At(m_first).time : 0;
+    uint32_t prevGroup = 0;
+    for (uint64_t seq = m_first; seq < m_cursor; ++seq)
+    {
+        const Entry& e = At(seq);
+        AppendVarint(out, static_cast<uint64_t>(e.time - prevTime));
+        AppendVarint(out, seq == m_first || e.group != prevGroup ? 1 : 0);
+        AppendVarint(out, keyOf[e.handle.id]);
+        AppendVarint(out, e.hasOld ? e.oldLength + 1ull : 0);
+        out.append(OldValue(e));
+        AppendVarint(out, e.hasNew ? e.newLength + 1ull : 0);
+        out.append(NewValue(e));
+        prevTime = e.time;
+        prevGroup = e.group;
+    }
+    return AsyncFileWriter::WriteAtomically(path, out);
+}
+
+/**
+ * @brief ログを読み込み、キー表・編集・グループへ展開する。
+ * @param path ログファイル。
+ * @return 形式が正しく読み込めた場合は true。
+ */
+bool SettingsReplay::Open(const std::filesystem::path& path)
+{
+    m_keys.clear();
+    m_edits.clear();
+    m_groups.clear();
+    m_next = 0;
+    if (!ReadFileToBuffer(path.wstring(), m_data) || m_data.size() > UINT32_MAX ||
+        m_data.compare(0, sizeof(kJournalMagic), kJournalMagic, sizeof(kJournalMagic)) != 0)
+        return false;
+
+    const std::string_view data = m_data;
+    size_t pos = sizeof(kJournalMagic);
+    uint64_t version = 0;
+    uint64_t count = 0;
+    if (!ReadVarint(data, pos, version) || version != kJournalVersion || !ReadVarint(data, pos, count))
+        return false;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t length = 0;
+        Key k;
+        if (!ReadVarint(data, pos, length) || !ReadBytes(data, pos, length, k.cat) ||
+            !ReadVarint(data, pos, length) || !ReadBytes(data, pos, length, k.key))
+            return false;
+        m_keys.push_back(k);
+    }
+
+    if (!ReadVarint(data, pos, count))
+        return false;
+    int64_t time = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t delta = 0;
+        uint64_t newGroup = 0;
+        uint64_t key = 0;
+        uint64_t oldLength = 0;
+        uint64_t newLength = 0;
+        IniSpan old;
+        Edit e{};
+        if (!ReadVarint(data, pos, delta) || !ReadVarint(data, pos, newGroup) || !ReadVarint(data, pos, key) ||
+            key >= m_keys.size() || !ReadVarint(data, pos, oldLength) ||
+            !ReadBytes(data, pos, oldLength ? oldLength - 1 : 0, old) || !ReadVarint(data, pos, newLength) ||
+            !ReadBytes(data, pos, newLength ? newLength - 1 : 0, e.value))
+            return false;
+        time += static_cast<int64_t>(delta);
+        e.key = static_cast<uint32_t>(key);
+        e.remove = newLength == 0;
+        if (newGroup || m_groups.empty())
+            m_groups.push_back(Group{time, static_cast<uint32_t>(m_edits.size()), 0});
+        m_edits.push_back(e);
+        ++m_groups.back().count;
+    }
+    return pos == data.size();
+}
+
+/**
+ * @brief 次のグループを 1 つのトランザクションとして適用する。
+ * @param settings 適用先。
+ * @return 適用した場合は true。
+ */
+bool SettingsReplay::Step(Settings& settings)
+{
+    if (Done())
+        return false;
+    const Group& g = m_groups[m_next++];
+    Settings::Transaction edit(settings);
+    for (uint32_t i = g.first; i < g.first + g.count; ++i)
+    {
+        const Edit& e = m_edits[i];
+        const Key& k = m_keys[e.key];
+        const Settings::Handle h = settings.Resolve(SpanView(m_data, k.cat), SpanView(m_data, k.key));
+        if (e.remove)
+            edit.Remove(h);
+        else
+            edit.SetString(h, SpanView(m_data, e.value));
+    }
+    edit.Commit();
+    return true;
+}
+
+/**
+ * @brief 記録時刻が経過時間以下のグループをすべて適用する。
+ * @param settings 適用先。
+ * @param elapsed 再生開始からの経過時間。
+ * @return 適用したグループ数。
+ */
+size_t SettingsReplay::ApplyUntil(Settings& settings, std::chrono::nanoseconds elapsed)
+{
+    size_t applied = 0;
+    while (!Done() && GroupTime(m_next) <= elapsed)
+    {
+        Step(settings);
+        ++applied;
+    }
+    return applied;
+}
@@ -0,0 +1,291 @@
+#pragma once
+#include "IniParser.h"
+#include "SettingsSnapshot.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file SettingsJournal.h
+ * @brief 設定の編集履歴 (元に戻す・やり直す) と、その記録の書き出し・再生を行うクラスの宣言。
+ * @author 山内陽
+ */
+
+class Settings;
+
+/**
+ * @brief Transaction::Commit で確定した編集を (時刻, キー, 旧値, 新値) として記録する固定容量の履歴。
+ * @details 記録と値の文字列はどちらも構築時に確保したリングバッファへ置くため、記録の追加でメモリ確保は起きない。
+ *          容量を超えた分は最も古いトランザクション単位で捨てる。1 回の Commit が 1 つのグループになり、
+ *          Undo / Redo はグループ単位で適用する。Undo した後に新しい編集を記録すると、やり直し分は破棄される。
+ *          Settings::SetJournal で結び付けて使う。Settings と同じく所有スレッド専用。
+ */
+class SettingsJournal
+{
+public:
+    using Handle = SettingHandle;
+
+    /**
+     * @brief 容量を確保して構築する。
+     * @param maxRecords 保持する編集の最大件数。
+     * @param maxTextBytes 旧値・新値の文字列を保持する領域のバイト数。
+     */
+    explicit SettingsJournal(size_t maxRecords = 4096, size_t maxTextBytes = 256u << 10);
+
+    SettingsJournal(const SettingsJournal&) = delete;
+    SettingsJournal& operator=(const SettingsJournal&) = delete;
+
+    /**
+     * @brief 1 回の Commit 分のグループを開始する。Settings::Transaction::Commit から呼ばれる。
+     */
+    void BeginGroup();
+
+    /**
+     * @brief 次の Commit を新しいグループにせず、直前のグループへ続けて記録するかを指定する。
+     * @details ドラッグなど 1 回の操作が複数フレームの Commit にまたがる場合に、操作全体を 1 回の Undo で戻せるようにする。
+     *          直前のグループを Undo した後など、続ける対象が無ければ通常どおり新しいグループになる。
+     * @param merge 続ける場合は true。
+     */
+    void MergeNextGroup(bool merge)
+    {
+        m_mergeNext = merge;
+    }
+
+    /**
+     * @brief 現在のグループへ 1 件の編集を記録する。文字列は内部へ複写する。
+     * @param h 対象ハンドル。
+     * @param before 変更前の基本ファイルの値 (値が無かった場合は nullptr)。
+     * @param after 変更後の値 (キーを取り除いた場合は nullptr)。
+     */
+    void Record(Handle h, const std::string_view* before, const std::string_view* after);
+
+    /**
+     * @brief 現在のグループを閉じる。
+     */
+    void EndGroup();
+
+    /**
+     * @brief 元に戻せる編集があるか判定する。
+     * @return あれば true。
+     */
+    bool CanUndo() const
+    {
+        return m_cursor > m_first;
+    }
+
+    /**
+     * @brief やり直せる編集があるか判定する。
+     * @return あれば true。
+     */
+    bool CanRedo() const
+    {
+        return m_cursor < m_end;
+    }
+
+    /**
+     * @brief 直前のグループを元に戻す。適用は 1 つのトランザクションで行い、その編集自体は記録しない。
+     * @param settings 適用先 (記録時と同じ Settings)。
+     * @return 元に戻した場合は true。
+     */
+    bool Undo(Settings& settings);
+
+    /**
+     * @brief 元に戻したグループをやり直す。
+     * @param settings 適用先。
+     * @return やり直した場合は true。
+     */
+    bool Redo(Settings& settings);
+
+    /**
+     * @brief 履歴をすべて破棄する。
+     */
+    void Clear();
+
+    /**
+     * @brief 元に戻せる範囲の編集 (やり直し分は含まない) をバイナリ形式のログとして書き出す。
+     * @details キー名の表と、時刻差・キー番号・値の長さを可変長整数で詰めた記録を並べる。SettingsReplay で読める。
+     * @param path 書き出し先。
+     * @param settings ハンドルからキー名を引く Settings (記録時と同じもの)。
+     * @return 書き出しに成功した場合は true。
+     */
+    bool Export(const std::filesystem::path& path, const Settings& settings) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 1 件の編集。旧値と新値は m_text 上に続けて置く。
+     */
+    struct Entry
+    {
+        int64_t time;       // 記録時刻 (steady_clock のナノ秒)
+        Handle handle;      // 対象ハンドル
+        uint32_t group;     // 所属グループ (Commit ごとの通し番号)
+        uint64_t text;      // 旧値の m_text 上の通し位置 (新値はその直後)
+        uint32_t oldLength; // 旧値の長さ
+        uint32_t newLength; // 新値の長さ
+        bool hasOld;        // 旧値があるか (無ければ元に戻すとキーを取り除く)
+        bool hasNew;        // 新値があるか (無ければキーを取り除いた編集)
+    };
+
+    /**
+     * @brief 通し番号の編集を取得する。
+     * @param seq 通し番号 (m_first 以上 m_end 未満)。
+     * @return 編集。
+     */
+    const Entry& At(uint64_t seq) const
+    {
+        return m_entries[seq % m_entries.size()];
+    }
+
+    /**
+     * @brief 編集の旧値を取得する。
+     * @param e 対象の編集。
+     * @return 旧値。
+     */
+    std::string_view OldValue(const Entry& e) const
+    {
+        return std::string_view(m_text.data() + e.text % m_text.size(), e.oldLength);
+    }
+
+    /**
+     * @brief 編集の新値を取得する。
+     * @param e 対象の編集。
+     * @return 新値。
+     */
+    std::string_view NewValue(const Entry& e) const
+    {
+        return std::string_view(m_text.data() + e.text % m_text.size() + e.oldLength, e.newLength);
+    }
+
+    /**
+     * @brief 最も古いグループを捨てる。
+     */
+    void EvictOldestGroup();
+
+    std::vector<Entry> m_entries; // 編集のリングバッファ (通し番号 % 容量 の位置に置く)
+    std::string m_text;           // 旧値・新値の文字列のリングバッファ (1 件分は折り返さずに置く)
+    uint64_t m_first = 0;         // 最も古い編集の通し番号
+    uint64_t m_end = 0;           // 最後の編集の次の通し番号
+    uint64_t m_cursor = 0;        // 適用済みの編集の次の通し番号 (これ以降はやり直し分)
+    uint64_t m_textEnd = 0;       // 文字列の次の書き込み位置 (通し位置)
+    uint32_t m_group = 0;         // 記録中のグループ番号
+    bool m_dropped = false;       // 記録中のグループが容量に収まらず破棄された
+    bool m_mergeNext = false;     // 次の BeginGroup で直前のグループを続ける
+};
+
+/**
+ * @brief SettingsJournal::Export で書き出したログを読み込み、記録時の時間間隔どおりに Settings へ適用し直す。
+ * @details ウィンドウや描画を必要としないため、ヘッドレスな検証や不具合の再現にも使える。キーは名前で解決するので、
+ *          記録時と別の Settings インスタンスにも適用できる。各グループは 1 つのトランザクションとして適用する。
+ */
+class SettingsReplay
+{
+public:
+    /**
+     * @brief ログを読み込む。
+     * @param path ログファイル。
+     * @return 形式が正しく読み込めた場合は true。
+     */
+    bool Open(const std::filesystem::path& path);
+
+    /**
+     * @brief グループ数を取得する。
+     * @return 記録されていた Commit の回数。
+     */
+    size_t GroupCount() const
+    {
+        return m_groups.size();
+    }
+
+    /**
+     * @brief グループの記録時刻を取得する。
+     * @param group グループ番号。
+     * @return 最初の編集からの経過時間。
+     */
+    std::chrono::nanoseconds GroupTime(size_t group) const
+    {
+        return std::chrono::nanoseconds(m_groups[group].time);
+    }
+
+    /**
+     * @brief 次に適用するグループ番号を取得する。
+     * @return グループ番号 (すべて適用済みなら GroupCount())。
+     */
+    size_t Position() const
+    {
+        return m_next;
+    }
+
+    /**
+     * @brief すべてのグループを適用したか判定する。
+     * @return 適用済みなら true。
+     */
+    bool Done() const
+    {
+        return m_next >= m_groups.size();
+    }
+
+    /**
+     * @brief 最初のグループへ戻す。設定値は戻さない。
+     */
+    void Rewind()
+    {
+        m_next = 0;
+    }
+
+    /**
+     * @brief 次のグループを 1 つ適用する。
+     * @param settings 適用先。
+     * @return 適用した場合は true。
+     */
+    bool Step(Settings& settings);
+
+    /**
+     * @brief 記録時刻が経過時間以下のグループをすべて適用する。毎フレーム呼べば記録時の間隔で再生される。
+     * @param settings 適用先。
+     * @param elapsed 再生開始からの経過時間。
+     * @return 適用したグループ数。
+     */
+    size_t ApplyUntil(Settings& settings, std::chrono::nanoseconds elapsed);
+
+private:
+    /**
+     * @brief キー名 (m_data 内)。
+     */
+    struct Key
+    {
+        IniSpan cat; // カテゴリ名
+        IniSpan key; // キー名
+    };
+
+    /**
+     * @brief 1 件の編集。
+     */
+    struct Edit
+    {
+        uint32_t key;  // m_keys の添字
+        IniSpan value; // 新値 (m_data 内)
+        bool remove;   // キーを取り除く編集
+    };
+
+    /**
+     * @brief 1 回の Commit 分の編集。
+     */
+    struct Group
+    {
+        int64_t time;   // 最初の編集からの経過時間 (ナノ秒)
+        uint32_t first; // 最初の編集 (m_edits の添字)
+        uint32_t count; // 編集数
+    };
+
+    std::string m_data;          // ログファイルの内容
+    std::vector<Key> m_keys;     // キー名の表
+    std::vector<Edit> m_edits;   // 全編集 (記録順)
+    std::vector<Group> m_groups; // グループ (記録順)
+    size_t m_next = 0;           // 次に適用するグループ
+};
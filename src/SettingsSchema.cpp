@@ -0,0 +1,592 @@
+/**
+ * @file SettingsSchema.cpp
+ * @brief 設定スキーマバインダーの実装。
+ * @author 山内陽
+ */
+
+#include "SettingsSchema.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief 記述子が束縛するメンバーを指すポインタを得る。
+ * @tparam T メンバー型 (配列型の項目は要素型)。
+ * @param object 構造体の先頭アドレス。
+ * @param f 記述子。
+ * @return メンバーへのポインタ。
+ */
+template <typename T>
+static T* MemberAt(void* object, const FieldDesc& f)
+{
+    return static_cast<T*>(f.member.address(object));
+}
+
+/**
+ * @brief MemberAt の const 版。
+ * @tparam T メンバー型 (配列型の項目は要素型)。
+ * @param object 構造体の先頭アドレス。
+ * @param f 記述子。
+ * @return メンバーへのポインタ。
+ */
+template <typename T>
+static const T* MemberAt(const void* object, const FieldDesc& f)
+{
+    return static_cast<const T*>(f.member.address(const_cast<void*>(object)));
+}
+
+/**
+ * @brief Enum の候補名を数える。
+ * @param choices '|' 区切りの候補名。
+ * @return 候補数。
+ */
+static int ChoiceCount(const char* choices)
+{
+    if (!choices || !*choices)
+        return 0;
+    return 1 + static_cast<int>(std::count(choices, choices + std::strlen(choices), '|'));
+}
+
+/**
+ * @brief Enum の候補名を取得する。
+ * @param choices '|' 区切りの候補名。
+ * @param index 添字。
+ * @return 候補名 (範囲外なら空)。
+ */
+static std::string_view ChoiceAt(const char* choices, int index)
+{
+    std::string_view rest = choices ? choices : "";
+    for (int i = 0; i < index; ++i)
+    {
+        const size_t bar = rest.find('|');
+        if (bar == std::string_view::npos)
+            return {};
+        rest.remove_prefix(bar + 1);
+    }
+    return rest.substr(0, rest.find('|'));
+}
+
+/**
+ * @brief 値文字列に一致する Enum の候補を大文字小文字を区別せずに探す。
+ * @param choices '|' 区切りの候補名。
+ * @param name 値文字列。
+ * @return 候補の添字、見つからなければ -1。
+ */
+static int FindChoice(const char* choices, std::string_view name)
+{
+    const int count = ChoiceCount(choices);
+    for (int i = 0; i < count; ++i)
+    {
+        const std::string_view c = ChoiceAt(choices, i);
+        if (c.size() == name.size() &&
+            std::equal(c.begin(), c.end(), name.begin(),
+                       [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) ==
+                                                   std::tolower(static_cast<unsigned char>(b)); }))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief 項目を記述子の既定値へ戻す。
+ * @param f 記述子。
+ * @param object 束縛先構造体の先頭アドレス。
+ */
+static void ApplyFieldDefaults(const FieldDesc& f, void* object)
+{
+    switch (f.member.type)
+    {
+    case FieldType::Bool:
+        *MemberAt<bool>(object, f) = f.defaults[0] != 0.0;
+        break;
+    case FieldType::Int:
+    case FieldType::Enum:
+        *MemberAt<int>(object, f) = static_cast<int>(f.defaults[0]);
+        break;
+    default:
+    {
+        float* v = MemberAt<float>(object, f);
+        for (int c = 0; c < ComponentCount(f.member.type); ++c)
+            v[c] = static_cast<float>(f.defaults[c]);
+        break;
+    }
+    }
+}
+
+/**
+ * @brief float 系の項目に NaN の成分が含まれるか調べる。
+ * @param f 記述子。
+ * @param object 束縛先構造体の先頭アドレス。
+ * @return NaN の成分があれば true。
+ */
+static bool HasNaN(const FieldDesc& f, const void* object)
+{
+    if (f.member.type == FieldType::Bool || f.member.type == FieldType::Int || f.member.type == FieldType::Enum)
+        return false;
+    const float* v = MemberAt<float>(object, f);
+    return std::any_of(v, v + ComponentCount(f.member.type), [](float x) { return std::isnan(x); });
+}
+
+/**
+ * @brief 型名を取得する (診断メッセージ用)。
+ * @param type 対象の型。
+ * @return 型名。
+ */
+static const char* TypeName(FieldType type)
+{
+    switch (type)
+    {
+    case FieldType::Bool:
+        return "bool";
+    case FieldType::Int:
+        return "int";
+    case FieldType::Float:
+        return "float";
+    case FieldType::Float2:
+        return "float2";
+    case FieldType::Float3:
+        return "float3";
+    case FieldType::Float4:
+        return "float4";
+    case FieldType::Color3:
+        return "color3";
+    case FieldType::Color4:
+        return "color4";
+    case FieldType::Enum:
+        return "enum";
+    }
+    return "?";
+}
+
+/**
+ * @brief 全項目を記述子の既定値にする。
+ * @param object 束縛先構造体の先頭アドレス。
+ */
+void SettingsBinding::ApplyDefaults(void* object) const
+{
+    for (size_t i = 0; i < m_count; ++i)
+        ApplyFieldDefaults(m_fields[i], object);
+}
+
+/**
+ * @brief 全記述子のキーをハンドルへ解決する。
+ * @param settings 対象の設定。
+ */
+void SettingsBinding::Resolve(Settings& settings)
+{
+    m_handles.resize(m_count);
+    m_legacy.assign(m_count * kMaxComponents, Settings::Handle{});
+    m_migrate.assign(m_count, 0);
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const FieldDesc& f = m_fields[i];
+        m_handles[i] = settings.Resolve(f.category, f.key);
+        const int legacy = (std::min)(ChoiceCount(f.legacyKeys), ComponentCount(f.member.type));
+        for (int c = 0; c < legacy; ++c)
+            m_legacy[i * kMaxComponents + c] = settings.Resolve(f.category, ChoiceAt(f.legacyKeys, c));
+    }
+}
+
+/**
+ * @brief 記述子表を順に走査し、キャッシュ済みの値を範囲へ丸めて束縛先へ書き込む。
+ * @param settings 読み込み元。
+ * @param object 束縛先構造体の先頭アドレス。
+ */
+void SettingsBinding::Load(const Settings& settings, void* object)
+{
+    m_diagnostics.clear();
+    for (size_t i = 0; i < m_count; ++i)
+        LoadField(settings, object, i);
+}
+
+/**
+ * @brief 1 項目を型・候補・範囲の順に検証しながら束縛先へ読み込む。
+ * @details キーが無く旧形式の成分ごとのキーがあればそれを読み (無い成分は既定値)、新しいキーへの書き換えを予約する。
+ *          どちらも無い場合は既定値を使い、問題とはしない。型として解釈できない値と候補に無い値は既定値へ、
+ *          範囲外の値は記述子の RangePolicy に従って丸めるか既定値へ戻し、その内容を診断として残す。
+ * @param settings 読み込み元。
+ * @param object 束縛先構造体の先頭アドレス。
+ * @param field 記述子の添字。
+ * @return 問題が見つからなかった場合は true。
+ */
+bool SettingsBinding::LoadField(const Settings& settings, void* object, size_t field)
+{
+    const FieldDesc& f = m_fields[field];
+    const Settings::Handle h = m_handles[field];
+    const bool present = settings.Has(h);
+    std::errc ec = std::errc{};
+    SettingsIssue issue = SettingsIssue::TypeMismatch;
+
+    ApplyFieldDefaults(f, object);
+    m_migrate[field] = 0;
+    if (!present && f.legacyKeys)
+    {
+        float* v = MemberAt<float>(object, f);
+        for (int c = 0; c < ComponentCount(f.member.type); ++c)
+        {
+            const Settings::Handle legacy = m_legacy[field * kMaxComponents + c];
+            double d = 0.0;
+            if (!legacy.IsValid() || !settings.Has(legacy))
+                continue;
+            const std::errc e = settings.TryGetDouble(legacy, d);
+            if (e != std::errc{} && ec == std::errc{})
+                ec = e;
+            v[c] = static_cast<float>(d);
+            m_migrate[field] = 1;
+        }
+    }
+    else if (present)
+    {
+        switch (f.member.type)
+        {
+        case FieldType::Bool:
+            ec = settings.TryGetBool(h, *MemberAt<bool>(object, f));
+            break;
+        case FieldType::Int:
+            ec = settings.TryGetInt(h, *MemberAt<int>(object, f));
+            break;
+        case FieldType::Float:
+        {
+            double v = 0.0;
+            ec = settings.TryGetDouble(h, v);
+            if (ec == std::errc{})
+                *MemberAt<float>(object, f) = static_cast<float>(v);
+            break;
+        }
+        case FieldType::Float2:
+        case FieldType::Float3:
+        case FieldType::Float4:
+        case FieldType::Color3:
+        case FieldType::Color4:
+            // 全成分を 1 回で読む
+            ec = settings.GetFloats(h, MemberAt<float>(object, f), ComponentCount(f.member.type));
+            break;
+        case FieldType::Enum:
+        {
+            const int index = FindChoice(f.choices, *settings.GetView(h));
+            if (index < 0)
+            {
+                ec = std::errc::invalid_argument;
+                issue = SettingsIssue::NotInSet;
+            }
+            else
+            {
+                *MemberAt<int>(object, f) = index;
+            }
+            break;
+        }
+        }
+    }
+    if (ec == std::errc::result_out_of_range)
+        issue = SettingsIssue::OutOfRange;
+    else if (ec == std::errc{} && HasNaN(f, object))
+        ec = std::errc::invalid_argument; // "nan" は数値として読めても範囲を持たないため型の不一致とする
+
+    bool rejected = ec != std::errc{};
+    if (rejected)
+    {
+        ApplyFieldDefaults(f, object); // 失敗時に途中まで書かれた成分も含めて戻す
+    }
+    else if (Clamp(object, field))
+    {
+        issue = SettingsIssue::OutOfRange;
+        rejected = f.policy == RangePolicy::Reject;
+        if (rejected)
+            ApplyFieldDefaults(f, object);
+    }
+    else
+    {
+        SetDiagnostic(field, nullptr);
+        return true;
+    }
+
+    SettingsDiagnostic d{field, issue, rejected, {}};
+    if (auto v = settings.GetView(h))
+        d.value.assign(v->data(), v->size());
+    SetDiagnostic(field, &d);
+    return false;
+}
+
+/**
+ * @brief 項目の診断を差し替える。一覧は記述子順に保つ。
+ * @param field 記述子の添字。
+ * @param d 新しい診断 (問題が無ければ nullptr)。
+ */
+void SettingsBinding::SetDiagnostic(size_t field, const SettingsDiagnostic* d)
+{
+    auto it = std::lower_bound(m_diagnostics.begin(), m_diagnostics.end(), field,
+                               [](const SettingsDiagnostic& a, size_t f) { return a.field < f; });
+    const bool exists = it != m_diagnostics.end() && it->field == field;
+    if (d && exists)
+        *it = *d;
+    else if (d)
+        m_diagnostics.insert(it, *d);
+    else if (exists)
+        m_diagnostics.erase(it);
+}
+
+/**
+ * @brief 診断をログ向けの 1 行へ整形する。
+ * @param d 診断。
+ * @return 整形した文字列。
+ */
+std::string SettingsBinding::Describe(const SettingsDiagnostic& d) const
+{
+    const FieldDesc& f = m_fields[d.field];
+    std::string s;
+    s.append(f.category).append(".").append(f.key).append("=").append(d.value).append(": ");
+    switch (d.issue)
+    {
+    case SettingsIssue::TypeMismatch:
+        s.append("expected ").append(TypeName(f.member.type));
+        break;
+    case SettingsIssue::OutOfRange:
+        s.append("out of range [").append(FormatIniNumber(f.min).View());
+        s.append(", ").append(FormatIniNumber(f.max).View()).append("]");
+        break;
+    case SettingsIssue::NotInSet:
+        s.append("expected one of ").append(f.choices ? f.choices : "");
+        break;
+    }
+    s.append(d.rejected ? ", using default" : ", clamped");
+    return s;
+}
+
+/**
+ * @brief 各項目のキーを購読し、変化した項目だけを読み直す。
+ * @param settings 購読先の設定。
+ * @param object 束縛先構造体の先頭アドレス。
+ * @param onChanged 項目を読み直した後の通知。
+ */
+void SettingsBinding::Subscribe(Settings& settings, void* object, std::function<void(size_t)> onChanged)
+{
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        auto reload = [this, &settings, object, i, onChanged](Settings::Handle)
+        {
+            LoadField(settings, object, i);
+            if (onChanged)
+                onChanged(i);
+        };
+        settings.Subscribe(m_handles[i], reload);
+        // 旧形式のキーを外部で編集した場合も読み直す
+        for (int c = 0; c < kMaxComponents; ++c)
+        {
+            if (m_legacy[i * kMaxComponents + c].IsValid())
+                settings.Subscribe(m_legacy[i * kMaxComponents + c], reload);
+        }
+    }
+}
+
+/**
+ * @brief 1 項目の値を設定への書き戻しとしてトランザクションへ積む。
+ * @details 旧形式のキーを持つ項目は、旧キーを取り除く操作も積む (基本ファイルに無ければ何も起きない)。
+ * @param edit 書き込み先のトランザクション。
+ * @param object 束縛元構造体の先頭アドレス。
+ * @param field 記述子の添字。
+ */
+void SettingsBinding::Store(Settings::Transaction& edit, const void* object, size_t field) const
+{
+    const FieldDesc& f = m_fields[field];
+    const Settings::Handle h = m_handles[field];
+    switch (f.member.type)
+    {
+    case FieldType::Bool:
+        edit.SetBool(h, *MemberAt<bool>(object, f));
+        break;
+    case FieldType::Enum:
+        edit.SetString(h, ChoiceAt(f.choices, *MemberAt<int>(object, f)));
+        break;
+    case FieldType::Int:
+        edit.SetInt(h, *MemberAt<int>(object, f));
+        break;
+    case FieldType::Float:
+        edit.SetFloat(h, *MemberAt<float>(object, f));
+        break;
+    case FieldType::Float2:
+    case FieldType::Float3:
+    case FieldType::Float4:
+    case FieldType::Color3:
+    case FieldType::Color4:
+        edit.SetFloats(h, MemberAt<float>(object, f), ComponentCount(f.member.type));
+        break;
+    }
+    for (int c = 0; f.legacyKeys && c < kMaxComponents; ++c)
+    {
+        if (m_legacy[field * kMaxComponents + c].IsValid())
+            edit.Remove(m_legacy[field * kMaxComponents + c]);
+    }
+}
+
+/**
+ * @brief 全項目の値を設定への書き戻しとしてトランザクションへ積む。
+ * @param edit 書き込み先のトランザクション。
+ * @param object 束縛元構造体の先頭アドレス。
+ */
+void SettingsBinding::StoreAll(Settings::Transaction& edit, const void* object) const
+{
+    for (size_t i = 0; i < m_count; ++i)
+        Store(edit, object, i);
+}
+
+/**
+ * @brief 旧形式のキーから読み込んだ項目を新しいキーへ書き換える編集を積む。
+ * @param edit 書き込み先のトランザクション。
+ * @param object 束縛元構造体の先頭アドレス。
+ * @return 積んだ項目があれば true。
+ */
+bool SettingsBinding::StoreMigrations(Settings::Transaction& edit, const void* object)
+{
+    bool stored = false;
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        if (!m_migrate[i])
+            continue;
+        Store(edit, object, i);
+        m_migrate[i] = 0;
+        stored = true;
+    }
+    return stored;
+}
+
+/**
+ * @brief 1 項目の値を記述子の範囲へ丸める。
+ * @param object 束縛先構造体の先頭アドレス。
+ * @param field 記述子の添字。
+ * @return 値を修正した場合は true。
+ */
+bool SettingsBinding::Clamp(void* object, size_t field) const
+{
+    const FieldDesc& f = m_fields[field];
+    bool clamped = false;
+    switch (f.member.type)
+    {
+    case FieldType::Bool:
+        break;
+    case FieldType::Int:
+    {
+        int* v = MemberAt<int>(object, f);
+        const int c = std::clamp(*v, static_cast<int>(f.min), static_cast<int>(f.max));
+        clamped = c != *v;
+        *v = c;
+        break;
+    }
+    case FieldType::Enum:
+    {
+        int* v = MemberAt<int>(object, f);
+        const int c = std::clamp(*v, 0, (std::max)(ChoiceCount(f.choices) - 1, 0));
+        clamped = c != *v;
+        *v = c;
+        break;
+    }
+    case FieldType::Float:
+    case FieldType::Float2:
+    case FieldType::Float3:
+    case FieldType::Float4:
+    case FieldType::Color3:
+    case FieldType::Color4:
+    {
+        float* v = MemberAt<float>(object, f);
+        for (int i = 0; i < ComponentCount(f.member.type); ++i)
+        {
+            // NaN は比較で丸められないため既定値へ置き換える
+            const float c = std::isnan(v[i]) ? static_cast<float>(f.defaults[i])
+                                             : std::clamp(v[i], static_cast<float>(f.min), static_cast<float>(f.max));
+            clamped |= !(c == v[i]);
+            v[i] = c;
+        }
+        break;
+    }
+    }
+    return clamped;
+}
+
+/**
+ * @brief 記述子の型に応じたウィジェットをカテゴリごとの折りたたみヘッダー内へ並べる。
+ * @param edit 書き込み先のトランザクション。
+ * @param object 束縛先構造体の先頭アドレス。
+ * @return いずれかの項目が変更された場合は true。
+ */
+bool SettingsBinding::DrawEditor(Settings::Transaction& edit, void* object) const
+{
+    bool changed = false;
+    const char* openCategory = nullptr;
+    bool open = false;
+
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const FieldDesc& f = m_fields[i];
+        if (!openCategory || std::strcmp(openCategory, f.category) != 0)
+        {
+            openCategory = f.category;
+            open = ImGui::CollapsingHeader(f.category, ImGuiTreeNodeFlags_DefaultOpen);
+        }
+        if (!open)
+            continue;
+
+        bool edited = false;
+        switch (f.member.type)
+        {
+        case FieldType::Bool:
+            edited = ImGui::Checkbox(f.label, MemberAt<bool>(object, f));
+            break;
+        case FieldType::Int:
+            edited = ImGui::SliderInt(f.label, MemberAt<int>(object, f), static_cast<int>(f.min),
+                                      static_cast<int>(f.max));
+            break;
+        case FieldType::Float:
+            edited = ImGui::SliderFloat(f.label, MemberAt<float>(object, f), static_cast<float>(f.min),
+                                        static_cast<float>(f.max));
+            break;
+        case FieldType::Float2:
+            edited = ImGui::SliderFloat2(f.label, MemberAt<float>(object, f), static_cast<float>(f.min),
+                                         static_cast<float>(f.max));
+            break;
+        case FieldType::Float3:
+            edited = ImGui::SliderFloat3(f.label, MemberAt<float>(object, f), static_cast<float>(f.min),
+                                         static_cast<float>(f.max));
+            break;
+        case FieldType::Float4:
+            edited = ImGui::SliderFloat4(f.label, MemberAt<float>(object, f), static_cast<float>(f.min),
+                                         static_cast<float>(f.max));
+            break;
+        case FieldType::Color3:
+            edited = ImGui::ColorEdit3(f.label, MemberAt<float>(object, f));
+            break;
+        case FieldType::Color4:
+            edited = ImGui::ColorEdit4(f.label, MemberAt<float>(object, f));
+            break;
+        case FieldType::Enum:
+        {
+            int* v = MemberAt<int>(object, f);
+            const std::string current(ChoiceAt(f.choices, *v));
+            if (ImGui::BeginCombo(f.label, current.c_str()))
+            {
+                for (int c = 0; c < ChoiceCount(f.choices); ++c)
+                {
+                    const std::string name(ChoiceAt(f.choices, c));
+                    if (ImGui::Selectable(name.c_str(), c == *v) && c != *v)
+                    {
+                        *v = c;
+                        edited = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            break;
+        }
+        }
+
+        if (edited)
+        {
+            Clamp(object, i);
+            Store(edit, object, i);
+            changed = true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,323 @@
+#pragma once
+#include "Settings.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @file SettingsSchema.h
+ * @brief 設定キーと構造体メンバーを静的な記述子表で結び付けるスキーマの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 記述子が束縛するメンバーの型。
+ */
+enum class FieldType : uint8_t
+{
+    Bool,   // bool
+    Int,    // int
+    Float,  // float
+    Float2, // float[2] ("x,y" の 1 キー)
+    Float3, // float[3] ("x,y,z" の 1 キー)
+    Float4, // float[4] ("x,y,z,w" の 1 キー)
+    Color3, // float[3] ("r,g,b" の 1 キー)
+    Color4, // float[4] ("r,g,b,a" の 1 キー)
+    Enum,   // int (FieldDesc::choices 内の添字。INI には候補名で書く)
+};
+
+/**
+ * @brief 範囲外の値の扱い。
+ */
+enum class RangePolicy : uint8_t
+{
+    Clamp,  // 範囲へ丸めて使う
+    Reject, // 既定値へ戻す
+};
+
+/**
+ * @brief FieldType が束縛先メンバーの型と一致するか判定する。
+ * @tparam M メンバーの型。
+ * @param type 記述子の型。
+ * @return 一致する場合は true。
+ */
+template <typename M>
+constexpr bool IsFieldTypeOf(FieldType type)
+{
+    switch (type)
+    {
+    case FieldType::Bool:
+        return std::is_same_v<M, bool>;
+    case FieldType::Int:
+    case FieldType::Enum:
+        return std::is_same_v<M, int>;
+    case FieldType::Float:
+        return std::is_same_v<M, float>;
+    case FieldType::Float2:
+        return std::is_same_v<M, float[2]>;
+    case FieldType::Float3:
+    case FieldType::Color3:
+        return std::is_same_v<M, float[3]>;
+    case FieldType::Float4:
+    case FieldType::Color4:
+        return std::is_same_v<M, float[4]>;
+    }
+    return false;
+}
+
+/**
+ * @brief 記述子の型と、束縛先構造体からメンバーのアドレスを得る関数の組。BindField で作る。
+ */
+struct FieldMember
+{
+    FieldType type;                 // メンバー型
+    void* (*address)(void* object); // 束縛先構造体の先頭アドレスからメンバーのアドレスを得る
+};
+
+/**
+ * @brief メンバーポインターを FieldMember::address の形の関数にする。型が合わなければコンパイルエラーにする。
+ * @tparam Type 記述子の型。
+ * @tparam Member 束縛先のメンバーポインター (&Struct::member)。
+ */
+template <FieldType Type, auto Member>
+struct BoundMember;
+
+template <FieldType Type, typename Class, typename M, M Class::*Member>
+struct BoundMember<Type, Member>
+{
+    static_assert(IsFieldTypeOf<M>(Type), "FieldType と束縛先メンバーの型が一致しない");
+
+    /**
+     * @brief メンバーのアドレスを得る。
+     * @param object 束縛先構造体の先頭アドレス。
+     * @return メンバーのアドレス。
+     */
+    static void* Address(void* object)
+    {
+        return &(static_cast<Class*>(object)->*Member);
+    }
+};
+
+/**
+ * @brief 記述子の型と束縛先メンバーを組にする。例: BindField<FieldType::Color4, &AppConfig::clear>。
+ * @tparam Type 記述子の型。
+ * @tparam Member 束縛先のメンバーポインター。
+ */
+template <FieldType Type, auto Member>
+inline constexpr FieldMember BindField{Type, &BoundMember<Type, Member>::Address};
+
+/**
+ * @brief 1 つの設定項目 (カテゴリ・キー・型と束縛先・既定値・範囲) を表す記述子。
+ * @details constexpr 配列として宣言し、読み込み・保存・UI・範囲検証と既定値のすべてをこの表から導く。
+ *          束縛先はメンバーポインターで指定するため、型の取り違えはコンパイル時に検出される。
+ */
+struct FieldDesc
+{
+    const char* category;                    // カテゴリ名
+    const char* label;                       // UI 表示名
+    const char* key;                         // キー名 (複数成分の型も 1 キーにカンマ区切りで持つ)
+    FieldMember member;                      // メンバー型と束縛先 (BindField で作る)
+    double defaults[4];                      // 成分ごとの既定値
+    double min;                              // 許容最小値
+    double max;                              // 許容最大値
+    const char* choices = nullptr;           // Enum の候補名 ("Low|Medium|High" のように '|' 区切り)
+    RangePolicy policy = RangePolicy::Clamp; // 範囲外の値の扱い
+    const char* legacyKeys = nullptr;        // 旧形式の成分ごとのキー名 ("R|G|B|A" のように '|' 区切り。float 系の型のみ)
+};
+
+/**
+ * @brief 1 つの記述子が持つ成分数の上限。
+ */
+inline constexpr int kMaxComponents = 4;
+
+/**
+ * @brief 検証で見つかった問題の種類。
+ */
+enum class SettingsIssue : uint8_t
+{
+    TypeMismatch, // 型として解釈できない、または成分数が合わない (既定値を使う)
+    OutOfRange,   // 範囲外 (RangePolicy に従って丸めるか既定値を使う)
+    NotInSet,     // Enum の候補に無い (既定値を使う)
+};
+
+/**
+ * @brief 読み込み時の検証で見つかった 1 件の問題。
+ */
+struct SettingsDiagnostic
+{
+    size_t field;        // 記述子の添字
+    SettingsIssue issue; // 問題の種類
+    bool rejected;       // 既定値へ戻した場合は true、範囲へ丸めた場合は false
+    std::string value;   // 問題のあった元の値文字列
+};
+
+/**
+ * @brief 型が持つ成分数を返す。
+ * @param type 対象の型。
+ * @return 成分数 (1〜4)。
+ */
+constexpr int ComponentCount(FieldType type)
+{
+    switch (type)
+    {
+    case FieldType::Float2:
+        return 2;
+    case FieldType::Float3:
+    case FieldType::Color3:
+        return 3;
+    case FieldType::Float4:
+    case FieldType::Color4:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief 記述子表を Settings と構造体インスタンスへ結び付けるバインダー。
+ */
+class SettingsBinding
+{
+public:
+    /**
+     * @brief 記述子表を指定して構築する。
+     * @tparam N 記述子数。
+     * @param fields 静的な記述子配列。
+     */
+    template <size_t N>
+    explicit SettingsBinding(const FieldDesc (&fields)[N]) : m_fields(fields), m_count(N)
+    {
+    }
+
+    /**
+     * @brief 全項目を記述子の既定値にする。束縛先構造体の既定値はこの表だけが持つ。
+     * @param object 束縛先構造体の先頭アドレス。
+     */
+    void ApplyDefaults(void* object) const;
+
+    /**
+     * @brief 全記述子のキーをハンドルへ解決する。起動時に一度だけ呼ぶ。
+     * @param settings 対象の設定。
+     */
+    void Resolve(Settings& settings);
+
+    /**
+     * @brief 設定値を検証しながら束縛先へ読み込み、診断一覧を作り直す。
+     * @details 型・範囲・候補の検証はここ (と再読み込み時の LoadField) だけで行う。束縛先の値は常に記述子の
+     *          範囲内にあるため、毎フレームの処理は値をそのまま信頼してよい。
+     * @param settings 読み込み元。
+     * @param object 束縛先構造体の先頭アドレス。
+     */
+    void Load(const Settings& settings, void* object);
+
+    /**
+     * @brief 1 項目だけを検証しながら束縛先へ読み込み、その項目の診断を更新する。
+     * @param settings 読み込み元。
+     * @param object 束縛先構造体の先頭アドレス。
+     * @param field 記述子の添字。
+     * @return 問題が見つからなかった場合は true。
+     */
+    bool LoadField(const Settings& settings, void* object, size_t field);
+
+    /**
+     * @brief 直近の読み込みで見つかった問題の一覧を取得する。
+     * @return 記述子順の診断一覧。
+     */
+    const std::vector<SettingsDiagnostic>& Diagnostics() const
+    {
+        return m_diagnostics;
+    }
+
+    /**
+     * @brief 診断をログ向けの 1 行へ整形する。
+     * @param d 診断。
+     * @return "Render.HotReloadIntervalMs=0: out of range [100, 2000], clamped" のような文字列。
+     */
+    std::string Describe(const SettingsDiagnostic& d) const;
+
+    /**
+     * @brief 各項目のキーの変化を購読し、変化した項目だけを束縛先へ読み直すようにする。
+     * @param settings 購読先の設定 (バインダーより長く生存すること)。
+     * @param object 束縛先構造体の先頭アドレス (バインダーより長く生存すること)。
+     * @param onChanged 項目を読み直した後に記述子の添字で呼ばれる通知 (省略可)。
+     */
+    void Subscribe(Settings& settings, void* object, std::function<void(size_t)> onChanged = {});
+
+    /**
+     * @brief 1 項目の値を設定への書き戻しとしてトランザクションへ積む。
+     * @param edit 書き込み先のトランザクション。
+     * @param object 束縛元構造体の先頭アドレス。
+     * @param field 記述子の添字。
+     */
+    void Store(Settings::Transaction& edit, const void* object, size_t field) const;
+
+    /**
+     * @brief 全項目の値を設定への書き戻しとしてトランザクションへ積む。
+     * @param edit 書き込み先のトランザクション。
+     * @param object 束縛元構造体の先頭アドレス。
+     */
+    void StoreAll(Settings::Transaction& edit, const void* object) const;
+
+    /**
+     * @brief 旧形式の成分ごとのキーから読み込んだ項目を、新しいキーへの書き込みと旧キーの削除としてトランザクションへ積む。
+     * @details 保存する編集があるトランザクションへ積めば、次の保存で旧形式のキーが新しい形へ書き換わる。
+     * @param edit 書き込み先のトランザクション。
+     * @param object 束縛元構造体の先頭アドレス。
+     * @return 積んだ項目があれば true。
+     */
+    bool StoreMigrations(Settings::Transaction& edit, const void* object);
+
+    /**
+     * @brief 1 項目の値を記述子の範囲へ丸める。
+     * @param object 束縛先構造体の先頭アドレス。
+     * @param field 記述子の添字。
+     * @return 値を修正した場合は true。
+     */
+    bool Clamp(void* object, size_t field) const;
+
+    /**
+     * @brief 記述子表から ImGui の編集ウィジェットを描画し、変更項目をトランザクションへ積む。
+     * @param edit 書き込み先のトランザクション (確定は呼び出し側が行う)。
+     * @param object 束縛先構造体の先頭アドレス。
+     * @return いずれかの項目が変更された場合は true。
+     */
+    bool DrawEditor(Settings::Transaction& edit, void* object) const;
+
+    /**
+     * @brief 記述子数を取得する。
+     * @return 記述子数。
+     */
+    size_t Count() const
+    {
+        return m_count;
+    }
+
+    /**
+     * @brief 記述子を取得する。
+     * @param field 記述子の添字。
+     * @return 記述子。
+     */
+    const FieldDesc& Field(size_t field) const
+    {
+        return m_fields[field];
+    }
+
+private:
+    const FieldDesc* m_fields = nullptr; // 静的な記述子配列
+    size_t m_count = 0;                  // 記述子数
+    /**
+     * @brief 項目の診断を差し替える。
+     * @param field 記述子の添字。
+     * @param d 新しい診断 (問題が無ければ nullptr)。
+     */
+    void SetDiagnostic(size_t field, const SettingsDiagnostic* d);
+
+    std::vector<Settings::Handle> m_handles;       // 記述子ごとの解決済みハンドル
+    std::vector<Settings::Handle> m_legacy;        // 記述子ごとに kMaxComponents 個の旧形式キーのハンドル (無ければ無効)
+    std::vector<uint8_t> m_migrate;                // 旧形式のキーから読み込み、新しいキーへの書き換えを待っている項目
+    std::vector<SettingsDiagnostic> m_diagnostics; // 直近の読み込みで見つかった問題 (記述子順)
+};
@@ -0,0 +1,25 @@
+/**
+ * @file SettingsSnapshot.cpp
+ * @brief 設定値スナップショットの実装。
+ * @author 山内陽
+ */
+
+#include "SettingsSnapshot.h"
+
+/**
+ * @brief ハッシュ索引からハンドルを検索する。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return ハンドル。未登録なら無効なハンドル。
+ */
+SettingHandle SettingsSnapshot::Find(std::string_view cat, std::string_view key) const
+{
+    if (!m_keys)
+        return SettingHandle{};
+
+    const SettingsKeyTable& t = *m_keys;
+    const uint32_t id = t.index.Find(HashSettingKey(cat, key),
+                                     [&](uint32_t i)
+                                     { return SpanView(t.names, t.keys[i]) == key && SpanView(t.names, t.cats[i]) == cat; });
+    return id == FlatIndex::kNone ? SettingHandle{} : SettingHandle{id};
+}
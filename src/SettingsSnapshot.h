@@ -0,0 +1,336 @@
+#pragma once
+#include "FlatIndex.h"
+#include "Hash.h"
+#include "IniArray.h"
+#include "IniParser.h"
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+/**
+ * @file SettingsSnapshot.h
+ * @brief 他スレッドから参照する設定値の不変スナップショットの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief (カテゴリ, キー) を登録時に解決した固定 ID。
+ * @details 値テーブルの添字そのものであり、再読み込み後も同じキーを指し続ける。
+ *          Settings とそのスナップショットで共通に使える。
+ */
+struct SettingHandle
+{
+    static constexpr uint32_t kInvalid = UINT32_MAX;
+    uint32_t id = kInvalid; // 値テーブル上の添字
+
+    /**
+     * @brief 有効なハンドルか判定する。
+     * @return 解決済みなら true。
+     */
+    bool IsValid() const
+    {
+        return id != kInvalid;
+    }
+};
+
+/**
+ * @brief 1 キー分の値と、解析済みの数値・真偽値キャッシュ。
+ */
+struct SettingValue
+{
+    /**
+     * @brief flags に格納する状態ビット。
+     */
+    enum Flags : uint8_t
+    {
+        kPresent = 1 << 0,    // 値を保持している
+        kNumeric = 1 << 1,    // number が有効
+        kBoolValid = 1 << 2,  // 真偽値として解釈できる
+        kBoolTrue = 1 << 3,   // 真偽値の結果
+        kOutOfRange = 1 << 4, // 数値の表記だが double の範囲を超えている
+    };
+
+    IniSpan value;     // 値文字列 (所有者のテキスト領域内)
+    double number = 0; // 解析済み数値キャッシュ
+    uint8_t flags = 0; // Flags の組み合わせ
+
+    /**
+     * @brief キャッシュ済みの倍精度浮動小数値を取得する。
+     * @param def 値が無いか数値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    double AsDouble(double def) const
+    {
+        return (flags & kNumeric) ? number : def;
+    }
+
+    /**
+     * @brief キャッシュ済みの整数値を取得する。
+     * @param def 値が無いか数値でない、または範囲外の場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    int AsInt(int def) const
+    {
+        if (!(flags & kNumeric))
+            return def;
+        if (number < static_cast<double>(INT_MIN) || number > static_cast<double>(INT_MAX))
+            return def;
+        return static_cast<int>(number);
+    }
+
+    /**
+     * @brief キャッシュ済みの真偽値を取得する。
+     * @param def 値が無いか真偽値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    bool AsBool(bool def) const
+    {
+        return (flags & kBoolValid) ? (flags & kBoolTrue) != 0 : def;
+    }
+
+    /**
+     * @brief キャッシュ済みの倍精度浮動小数値を、失敗理由付きで取得する。
+     * @param out 成功時の格納先 (失敗時は変更しない)。
+     * @return 成功なら std::errc{}、値が無いか数値でなければ std::errc::invalid_argument、
+     *         double の範囲外なら std::errc::result_out_of_range。
+     */
+    std::errc ToDouble(double& out) const
+    {
+        if (flags & kNumeric)
+        {
+            out = number;
+            return std::errc{};
+        }
+        return (flags & kOutOfRange) ? std::errc::result_out_of_range : std::errc::invalid_argument;
+    }
+
+    /**
+     * @brief キャッシュ済みの整数値を、失敗理由付きで取得する。小数部は切り捨てる。
+     * @param out 成功時の格納先 (失敗時は変更しない)。
+     * @return 成功なら std::errc{}、値が無いか数値でなければ std::errc::invalid_argument、
+     *         int の範囲外なら std::errc::result_out_of_range。
+     */
+    std::errc ToInt(int& out) const
+    {
+        double v = 0.0;
+        const std::errc ec = ToDouble(v);
+        if (ec != std::errc{})
+            return ec;
+        if (!(v >= static_cast<double>(INT_MIN) && v <= static_cast<double>(INT_MAX)))
+            return std::errc::result_out_of_range;
+        out = static_cast<int>(v);
+        return std::errc{};
+    }
+
+    /**
+     * @brief キャッシュ済みの真偽値を、失敗理由付きで取得する。
+     * @param out 成功時の格納先 (失敗時は変更しない)。
+     * @return 成功なら std::errc{}、値が無いか真偽値として解釈できなければ std::errc::invalid_argument。
+     */
+    std::errc ToBool(bool& out) const
+    {
+        if (!(flags & kBoolValid))
+            return std::errc::invalid_argument;
+        out = (flags & kBoolTrue) != 0;
+        return std::errc{};
+    }
+};
+
+/**
+ * @brief (カテゴリ, キー) の組のハッシュ値を計算する。Settings とスナップショットの索引で共通に使う。
+ * @param cat カテゴリ名。
+ * @param key キー名。
+ * @return ハッシュ値。
+ */
+inline uint64_t HashSettingKey(std::string_view cat, std::string_view key)
+{
+    return Hash64(key, Hash64(cat));
+}
+
+/**
+ * @brief 登録済みキー名の表。キーが増えたときだけ作り直し、スナップショット間で共有する。
+ */
+struct SettingsKeyTable
+{
+    std::string names;         // カテゴリ名・キー名の格納領域
+    std::vector<IniSpan> cats; // ハンドルごとのカテゴリ名 (names 内)
+    std::vector<IniSpan> keys; // ハンドルごとのキー名 (names 内)
+    FlatIndex index;           // (カテゴリ, キー) のハッシュ値からハンドルを引く索引
+};
+
+/**
+ * @brief スナップショットの値テーブルを固定数のハンドルごとに区切った区画。
+ * @details 値文字列も区画ごとに持つため、値の変わらなかった区画は版をまたいでそのまま共有できる。
+ *          公開後は変更しない。
+ */
+struct SettingsSnapshotChunk
+{
+    static constexpr uint32_t kShift = 10;          // 1 区画のハンドル数の log2
+    static constexpr uint32_t kSize = 1u << kShift; // 1 区画のハンドル数
+    using Ptr = std::shared_ptr<const SettingsSnapshotChunk>;
+
+    std::vector<SettingValue> values; // 区画内のハンドル順の値 (末尾の区画だけ kSize より短い)
+    std::string text;                 // values が指す値文字列の格納領域
+};
+
+/**
+ * @brief ある時点の設定値を写した読み取り専用の表。
+ * @details 公開後は一切変更されないため、任意のスレッドから同期なしで参照できる。値テーブルは
+ *          SettingsSnapshotChunk の区画に分かれ、公開時には値が変わった区画だけを作り直して残りは直前の版と共有する。
+ *          Settings::Read() が返すガード越しに使い、ガードの寿命を超えて参照を保持しないこと。
+ */
+class SettingsSnapshot
+{
+public:
+    /**
+     * @brief スナップショットの版番号を取得する。公開のたびに増える。
+     * @return 版番号。
+     */
+    uint64_t Version() const
+    {
+        return m_version;
+    }
+
+    /**
+     * @brief (カテゴリ, キー) から登録済みハンドルを検索する。
+     * @param cat カテゴリ名。
+     * @param key キー名。
+     * @return ハンドル。未登録なら無効なハンドル。
+     */
+    SettingHandle Find(std::string_view cat, std::string_view key) const;
+
+    /**
+     * @brief ハンドルが指す値を持っているか判定する。
+     * @param h 対象ハンドル。
+     * @return 値が存在する場合は true。
+     */
+    bool Has(SettingHandle h) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v && (v->flags & SettingValue::kPresent);
+    }
+
+    /**
+     * @brief 文字列値を参照する。
+     * @param h 対象ハンドル。
+     * @return 値が存在すればビュー、無ければ std::nullopt。
+     */
+    std::optional<std::string_view> GetView(SettingHandle h) const
+    {
+        const SettingValue* v = ValueOf(h);
+        if (!v || !(v->flags & SettingValue::kPresent))
+            return std::nullopt;
+        return SpanView(m_chunks[h.id >> SettingsSnapshotChunk::kShift]->text, v->value);
+    }
+
+    /**
+     * @brief 倍精度浮動小数値を取得する。
+     * @param h 対象ハンドル。
+     * @param def 値が無いか数値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    double GetDouble(SettingHandle h, double def) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v ? v->AsDouble(def) : def;
+    }
+
+    /**
+     * @brief 整数値を取得する。
+     * @param h 対象ハンドル。
+     * @param def 値が無いか数値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    int GetInt(SettingHandle h, int def) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v ? v->AsInt(def) : def;
+    }
+
+    /**
+     * @brief 真偽値を取得する。
+     * @param h 対象ハンドル。
+     * @param def 値が無いか真偽値でない場合の既定値。
+     * @return 取得した値、または既定値。
+     */
+    bool GetBool(SettingHandle h, bool def) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v ? v->AsBool(def) : def;
+    }
+
+    /**
+     * @brief 倍精度浮動小数値を、失敗理由付きで取得する。
+     * @param h 対象ハンドル。
+     * @param out 成功時の格納先。
+     * @return SettingValue::ToDouble と同じ。
+     */
+    std::errc TryGetDouble(SettingHandle h, double& out) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v ? v->ToDouble(out) : std::errc::invalid_argument;
+    }
+
+    /**
+     * @brief 整数値を、失敗理由付きで取得する。
+     * @param h 対象ハンドル。
+     * @param out 成功時の格納先。
+     * @return SettingValue::ToInt と同じ。
+     */
+    std::errc TryGetInt(SettingHandle h, int& out) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v ? v->ToInt(out) : std::errc::invalid_argument;
+    }
+
+    /**
+     * @brief 真偽値を、失敗理由付きで取得する。
+     * @param h 対象ハンドル。
+     * @param out 成功時の格納先。
+     * @return SettingValue::ToBool と同じ。
+     */
+    std::errc TryGetBool(SettingHandle h, bool& out) const
+    {
+        const SettingValue* v = ValueOf(h);
+        return v ? v->ToBool(out) : std::errc::invalid_argument;
+    }
+
+    /**
+     * @brief "1,0.5,0.25" 形式の値を float 配列として取得する。
+     * @param h 対象ハンドル。
+     * @param out 格納先 (count 要素)。失敗時の内容は不定。
+     * @param count 期待する要素数。
+     * @return ParseIniFloats と同じ (値が無ければ std::errc::invalid_argument)。
+     */
+    std::errc GetFloats(SettingHandle h, float* out, size_t count) const
+    {
+        auto v = GetView(h);
+        return v ? ParseIniFloats(*v, out, count) : std::errc::invalid_argument;
+    }
+
+private:
+    friend class Settings;
+
+    /**
+     * @brief ハンドルに対応する値の取得 (範囲外なら nullptr)。
+     * @param h 対象ハンドル。
+     * @return 値へのポインタ。
+     */
+    const SettingValue* ValueOf(SettingHandle h) const
+    {
+        if (h.id >= m_count)
+            return nullptr;
+        return &m_chunks[h.id >> SettingsSnapshotChunk::kShift]->values[h.id & (SettingsSnapshotChunk::kSize - 1)];
+    }
+
+    uint64_t m_version = 0;                           // 版番号
+    uint32_t m_count = 0;                             // 値テーブルのハンドル数
+    std::vector<SettingsSnapshotChunk::Ptr> m_chunks; // ハンドルで引く値テーブルの区画 (版をまたいで共有)
+    std::shared_ptr<const SettingsKeyTable> m_keys;   // 登録済みキー名 (版をまたいで共有)
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * @file SnapshotCell.h
+ * @brief 不変スナップショットを任意のスレッドから待ちなしで読めるようにする公開セルの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 不変オブジェクトへのポインタを原子的に差し替え、古いものを安全に回収するセル。
+ * @details Left-Right 方式の読者カウンタで回収時期を判断する。読者は版番号の読み出し・カウンタ加算・
+ *          ポインタ読み出しの固定手順だけで参照でき (wait-free)、ロックも再試行も行わない。カウンタは
+ *          キャッシュライン単位で分散しているため、多数のコアから同時に読んでも競合しにくい。
+ *          書き手は新しいポインタを公開した後、古いポインタを掴んでいる可能性のある読者が抜けるのを待って
+ *          から破棄する。読者がガードを保持する時間はその分だけ書き手を待たせるため、短く保つこと。
+ * @tparam T 公開する不変オブジェクトの型。
+ */
+template <typename T>
+class SnapshotCell
+{
+    static constexpr uint32_t kShards = 16; // 読者カウンタの分散数
+
+    /**
+     * @brief キャッシュライン 1 本を占有する読者カウンタ対。
+     */
+    struct alignas(64) Shard
+    {
+        std::atomic<uint32_t> readers[2] = {}; // 版ごとの読者数
+    };
+
+public:
+    /**
+     * @brief 読者が保持する参照。破棄時に読者カウンタを戻す。
+     */
+    class ReadGuard
+    {
+    public:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        /**
+         * @brief 所有権を移す。
+         * @param other 移動元。
+         */
+        ReadGuard(ReadGuard&& other) noexcept : m_ptr(other.m_ptr), m_counter(other.m_counter)
+        {
+            other.m_counter = nullptr;
+        }
+
+        /**
+         * @brief 読者カウンタを戻す。
+         */
+        ~ReadGuard()
+        {
+            if (m_counter)
+                m_counter->fetch_sub(1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 参照先を取得する。
+         * @return 公開中のオブジェクト (未公開なら nullptr)。
+         */
+        const T* get() const
+        {
+            return m_ptr;
+        }
+
+        /**
+         * @brief 参照先のメンバーへアクセスする。
+         * @return 公開中のオブジェクト。
+         */
+        const T* operator->() const
+        {
+            return m_ptr;
+        }
+
+        /**
+         * @brief 参照先を取得する。
+         * @return 公開中のオブジェクト。
+         */
+        const T& operator*() const
+        {
+            return *m_ptr;
+        }
+
+        /**
+         * @brief 参照先が存在するか判定する。
+         * @return 公開済みなら true。
+         */
+        explicit operator bool() const
+        {
+            return m_ptr != nullptr;
+        }
+
+    private:
+        friend class SnapshotCell;
+
+        /**
+         * @brief SnapshotCell::Read からのみ構築する。
+         * @param ptr 参照先。
+         * @param counter 解放時に戻す読者カウンタ。
+         */
+        ReadGuard(const T* ptr, std::atomic<uint32_t>* counter) : m_ptr(ptr), m_counter(counter)
+        {
+        }
+
+        const T* m_ptr;                   // 参照先
+        std::atomic<uint32_t>* m_counter; // 解放時に戻す読者カウンタ
+    };
+
+    SnapshotCell() = default;
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    /**
+     * @brief 公開中のオブジェクトを破棄する。読者が残っていないこと。
+     */
+    ~SnapshotCell()
+    {
+        delete m_current.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 公開中のオブジェクトを参照する。任意のスレッドから待ちなしで呼べる。
+     * @return ガードが生きている間有効な参照。
+     */
+    ReadGuard Read() const
+    {
+        Shard& shard = m_shards[ShardIndex()];
+        const uint32_t v = m_version.load(std::memory_order_seq_cst);
+        shard.readers[v].fetch_add(1, std::memory_order_seq_cst);
+        return ReadGuard(m_current.load(std::memory_order_seq_cst), &shard.readers[v]);
+    }
+
+    /**
+     * @brief 新しいオブジェクトを公開し、古いものを読者が抜けた後に破棄する。
+     * @param next 公開するオブジェクト。
+     */
+    void Publish(std::unique_ptr<T> next)
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        T* old = m_current.exchange(next.release(), std::memory_order_seq_cst);
+
+        // 古いポインタを読んだ読者はどちらかの版のカウンタに載っている。
+        // 反対側が空くのを待ってから版を切り替え、元の版が空くのを待てば全員が抜けたことになる
+        const uint32_t prev = m_version.load(std::memory_order_relaxed);
+        const uint32_t next_ = prev ^ 1u;
+        WaitForReaders(next_);
+        m_version.store(next_, std::memory_order_seq_cst);
+        WaitForReaders(prev);
+        delete old;
+    }
+
+private:
+    /**
+     * @brief 指定した版の読者がいなくなるまで待つ。
+     * @param v 版番号 (0/1)。
+     */
+    void WaitForReaders(uint32_t v) const
+    {
+        for (const Shard& shard : m_shards)
+        {
+            while (shard.readers[v].load(std::memory_order_seq_cst) != 0)
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief 呼び出しスレッドに割り当てた読者カウンタの添字を返す。
+     * @return 0〜kShards-1 の添字。
+     */
+    static uint32_t ShardIndex()
+    {
+        static std::atomic<uint32_t> s_next{0};
+        thread_local const uint32_t index = s_next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    mutable Shard m_shards[kShards];    // 分散した読者カウンタ
+    std::atomic<uint32_t> m_version{0}; // 新規読者が載る版
+    std::atomic<T*> m_current{nullptr}; // 公開中のオブジェクト
+    std::mutex m_writeMutex;            // 書き手同士の直列化
+};
@@ -0,0 +1,873 @@
+/**
+ * @file SoftwareRenderDevice.cpp
+ * @brief CPU で画素を塗るソフトウェアラスタライザーのレンダーデバイスの実装。
+ * @author 山内陽
+ */
+
+#include "SoftwareRenderDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_RASTER_SSE2 1
+#endif
+
+static constexpr int32_t kSubPixelBits = 4;              // 座標の小数部のビット数 (1/16 ピクセル)
+static constexpr int32_t kSubPixel = 1 << kSubPixelBits; // 1 ピクセルあたりの単位数
+static constexpr float kGuardBand = 16384.0f;            // 頂点の画面座標の許容範囲 (エッジ関数を 32 ビットに収める)
+
+/**
+ * @brief 値を 0..1 に収める。
+ * @param v 値。
+ * @return 収めた値。
+ */
+static float Saturate(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+/**
+ * @brief 0..1 の値を 8 ビットへ丸める。
+ * @param v 値。
+ * @return 0..255。
+ */
+static uint8_t ToUnorm8(float v)
+{
+    return static_cast<uint8_t>(Saturate(v) * 255.0f + 0.5f);
+}
+
+/**
+ * @brief 切り捨ての除算 (負の数も -∞ 方向へ丸める)。
+ * @param a 被除数。
+ * @param b 除数 (正)。
+ * @return 商。
+ */
+static int64_t FloorDiv(int64_t a, int64_t b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * @brief 4 画素分のエッジ関数の値から、3 辺すべての内側にある画素を求める。
+ * @param e 各辺の先頭の画素での値。
+ * @param lanes 各辺の 4 画素分の増分 ({0, 1, 2, 3} * 1 画素あたりの増分)。
+ * @return 内側にある画素のビットマスク (bit i が i 番目の画素)。
+ */
+static uint32_t Coverage4(const int32_t e[3], const int32_t lanes[3][4])
+{
+#if defined(SOFTWARE_RASTER_SSE2)
+    const __m128i e0 = _mm_add_epi32(_mm_set1_epi32(e[0]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[0])));
+    const __m128i e1 = _mm_add_epi32(_mm_set1_epi32(e[1]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[1])));
+    const __m128i e2 = _mm_add_epi32(_mm_set1_epi32(e[2]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[2])));
+    // 符号ビットが 1 つでも立っていれば外側
+    const __m128i any = _mm_or_si128(e0, _mm_or_si128(e1, e2));
+    return ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(any))) & 0xFu;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (((e[0] + lanes[0][i]) | (e[1] + lanes[1][i]) | (e[2] + lanes[2][i])) >= 0)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief テクスチャをバイリニアでサンプリングする (アドレスはクランプ)。
+ * @param texels 画素 (RGBA8)。
+ * @param width 幅。
+ * @param height 高さ。
+ * @param u テクスチャ座標 u。
+ * @param v テクスチャ座標 v。
+ * @param out RGBA (0..1)。
+ */
+static void SampleBilinear(const uint8_t* texels, uint32_t width, uint32_t height, float u, float v, float out[4])
+{
+    // 画素の中心が整数座標になるよう半画素ずらす (Direct3D の線形フィルターと同じ)
+    const float tx = u * static_cast<float>(width) - 0.5f;
+    const float ty = v * static_cast<float>(height) - 0.5f;
+    const float fx0 = std::floor(tx);
+    const float fy0 = std::floor(ty);
+    const float fx = tx - fx0;
+    const float fy = ty - fy0;
+    const int32_t maxX = static_cast<int32_t>(width) - 1;
+    const int32_t maxY = static_cast<int32_t>(height) - 1;
+    const int32_t x0 = std::clamp(static_cast<int32_t>(fx0), 0, maxX);
+    const int32_t x1 = std::clamp(static_cast<int32_t>(fx0) + 1, 0, maxX);
+    const int32_t y0 = std::clamp(static_cast<int32_t>(fy0), 0, maxY);
+    const int32_t y1 = std::clamp(static_cast<int32_t>(fy0) + 1, 0, maxY);
+    const uint8_t* t00 = texels + (static_cast<size_t>(y0) * width + x0) * 4;
+    const uint8_t* t10 = texels + (static_cast<size_t>(y0) * width + x1) * 4;
+    const uint8_t* t01 = texels + (static_cast<size_t>(y1) * width + x0) * 4;
+    const uint8_t* t11 = texels + (static_cast<size_t>(y1) * width + x1) * 4;
+    for (int i = 0; i < 4; ++i)
+    {
+        const float top = t00[i] + (t10[i] - t00[i]) * fx;
+        const float bottom = t01[i] + (t11[i] - t01[i]) * fx;
+        out[i] = (top + (bottom - top) * fy) * (1.0f / 255.0f);
+    }
+}
+
+/**
+ * @brief 画素へ色を書き込む。
+ * @param dst 書き込み先 (RGBA8)。
+ * @param src 色 (0..1)。
+ * @param alphaBlend アルファブレンドする場合は true。
+ */
+static void WritePixel(uint8_t* dst, const float src[4], bool alphaBlend)
+{
+    if (alphaBlend)
+    {
+        // 色は SRC_ALPHA / INV_SRC_ALPHA、アルファは ONE / INV_SRC_ALPHA (D3D11RenderDevice と同じ)
+        const float inv = 1.0f - src[3];
+        for (int k = 0; k < 3; ++k)
+            dst[k] = ToUnorm8(src[k] * src[3] + dst[k] * (1.0f / 255.0f) * inv);
+        dst[3] = ToUnorm8(src[3] + dst[3] * (1.0f / 255.0f) * inv);
+    }
+    else
+    {
+        for (int k = 0; k < 4; ++k)
+            dst[k] = ToUnorm8(src[k]);
+    }
+}
+
+/**
+ * @brief ワーカースレッドを起動する。
+ * @param threads ラスタライズに使うスレッド数 (描画スレッドを含む)。0 ならハードウェアのスレッド数。
+ */
+SoftwareRenderDevice::SoftwareRenderDevice(uint32_t threads)
+{
+    if (threads == 0)
+        threads = (std::max)(1u, std::thread::hardware_concurrency());
+    m_stats.threads = threads;
+    for (uint32_t i = 1; i < threads; ++i)
+        m_workers.emplace_back([this] { WorkerMain(); });
+}
+
+/**
+ * @brief ワーカースレッドを停止する。
+ */
+SoftwareRenderDevice::~SoftwareRenderDevice()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+/**
+ * @brief リソースの枠を確保する。空きがあれば使い回す。
+ * @param type 種類。
+ * @return ハンドル。
+ */
+RenderDevice::Handle SoftwareRenderDevice::Allocate(Type type)
+{
+    Handle handle;
+    if (!m_freeList.empty())
+    {
+        handle = m_freeList.back();
+        m_freeList.pop_back();
+    }
+    else
+    {
+        m_resources.emplace_back();
+        handle = static_cast<Handle>(m_resources.size());
+    }
+    m_resources[handle - 1] = Resource{};
+    m_resources[handle - 1].type = type;
+    return handle;
+}
+
+/**
+ * @brief ハンドルが指定の種類のリソースを指しているか確かめる。違えば invalid を数える。
+ * @param handle ハンドル。
+ * @param type 期待する種類。
+ * @return リソース。無効なら nullptr。
+ */
+SoftwareRenderDevice::Resource* SoftwareRenderDevice::Find(Handle handle, Type type)
+{
+    if (handle == kNoHandle || handle > m_resources.size() || m_resources[handle - 1].type != type)
+    {
+        ++m_stats.invalid;
+        return nullptr;
+    }
+    return &m_resources[handle - 1];
+}
+
+/**
+ * @brief バッファを作成する。内容は CPU 側のメモリに置く。
+ * @param kind 用途 (区別しない)。
+ * @param bytes 大きさ (バイト)。
+ * @param initial 初期内容 (nullptr なら動的バッファ)。
+ * @return ハンドル。
+ */
+RenderDevice::Handle SoftwareRenderDevice::CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial)
+{
+    (void)kind;
+    if (bytes == 0)
+        return kNoHandle;
+    const Handle handle = Allocate(Type::Buffer);
+    Resource& r = m_resources[handle - 1];
+    r.dynamic = initial == nullptr;
+    r.data.resize(bytes);
+    if (initial)
+        std::memcpy(r.data.data(), initial, bytes);
+    return handle;
+}
+
+/**
+ * @brief テクスチャを作成する。画素を複製して持つ。
+ * @param width 幅 (ピクセル)。
+ * @param height 高さ (ピクセル)。
+ * @param rgba 画素。
+ * @return ハンドル。
+ */
+RenderDevice::Handle SoftwareRenderDevice::CreateTexture(uint32_t width, uint32_t height, const void* rgba)
+{
+    if (width == 0 || height == 0 || !rgba)
+        return kNoHandle;
+    auto texture = std::make_unique<Texture>();
+    texture->width = width;
+    texture->height = height;
+    const auto* src = static_cast<const uint8_t*>(rgba);
+    texture->texels.assign(src, src + static_cast<size_t>(width) * height * 4);
+    const Handle handle = Allocate(Type::Texture);
+    m_resources[handle - 1].texture = std::move(texture);
+    return handle;
+}
+
+/**
+ * @brief パイプラインを作成する。頂点レイアウトから位置・頂点色・テクスチャ座標の配置を読み取る。
+ * @param desc 記述 (シェーダーは使わない)。
+ * @return ハンドル。位置の属性が無ければ kNoHandle。
+ */
+RenderDevice::Handle SoftwareRenderDevice::CreatePipeline(const PipelineDesc& desc)
+{
+    Pipeline p;
+    bool hasPosition = false;
+    for (const VertexAttribute& attr : desc.layout)
+    {
+        switch (attr.semantic)
+        {
+        case VertexSemantic::Position:
+            hasPosition = attr.format != VertexFormat::Unorm8x4;
+            p.positionOffset = attr.offset;
+            p.positionFormat = attr.format;
+            break;
+        case VertexSemantic::Color:
+            p.hasColor = true;
+            p.colorOffset = attr.offset;
+            p.colorFormat = attr.format;
+            break;
+        case VertexSemantic::TexCoord:
+            p.hasTexCoord = attr.format == VertexFormat::Float2;
+            p.texCoordOffset = attr.offset;
+            break;
+        }
+    }
+    if (!hasPosition)
+        return kNoHandle;
+    p.tinted = desc.tinted;
+    p.textured = desc.textured && p.hasTexCoord;
+    p.alphaBlend = desc.alphaBlend;
+    p.scissor = desc.scissor;
+    const Handle handle = Allocate(Type::Pipeline);
+    m_resources[handle - 1].pipeline = p;
+    return handle;
+}
+
+/**
+ * @brief リソースを破棄し、ハンドルを再利用できるようにする。
+ * @details 記録中のフレームの三角形がテクスチャを指している可能性があるため、テクスチャの解放は Present の後へ遅らせる。
+ * @param handle 破棄するリソース。
+ */
+void SoftwareRenderDevice::Destroy(Handle handle)
+{
+    if (handle == kNoHandle || handle > m_resources.size() || m_resources[handle - 1].type == Type::None)
+        return;
+    if (m_resources[handle - 1].texture)
+        m_retired.push_back(std::move(m_resources[handle - 1].texture));
+    m_resources[handle - 1] = Resource{};
+    m_freeList.push_back(handle);
+}
+
+/**
+ * @brief 動的バッファの内容へのポインターを返す。
+ * @param buffer 動的バッファ。
+ * @return 書き込み先。静的バッファや Map 中のバッファなら nullptr。
+ */
+void* SoftwareRenderDevice::MapBuffer(Handle buffer)
+{
+    Resource* r = Find(buffer, Type::Buffer);
+    if (!r || !r->dynamic || r->mapped)
+        return nullptr;
+    r->mapped = true;
+    return r->data.data();
+}
+
+/**
+ * @brief 書き込みを終える。内容は次の描画呼び出しから使われる。
+ * @param buffer 動的バッファ。
+ */
+void SoftwareRenderDevice::UnmapBuffer(Handle buffer)
+{
+    if (Resource* r = Find(buffer, Type::Buffer))
+        r->mapped = false;
+}
+
+/**
+ * @brief 描画先とタイルの振り分け先を作り直す。
+ * @param width 幅 (ピクセル)。
+ * @param height 高さ (ピクセル)。
+ * @return 大きさが 0 でなければ true。
+ */
+bool SoftwareRenderDevice::Resize(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+        return false;
+    if (width == m_width && height == m_height)
+        return true;
+    m_width = width;
+    m_height = height;
+    m_tilesX = (width + kTileSize - 1) / kTileSize;
+    m_tilesY = (height + kTileSize - 1) / kTileSize;
+    m_color.assign(static_cast<size_t>(width) * height * 4, 0);
+    m_bins.assign(static_cast<size_t>(m_tilesX) * m_tilesY, {});
+    return true;
+}
+
+/**
+ * @brief フレームを始める。クリアはタイルを塗る直前に行う。
+ * @param clear クリアカラー。
+ */
+void SoftwareRenderDevice::BeginPass(const float clear[4])
+{
+    for (int i = 0; i < 4; ++i)
+        m_clear[i] = ToUnorm8(clear[i]);
+    m_triangles.clear();
+    for (std::vector<uint32_t>& bin : m_bins)
+        bin.clear();
+    m_stats.triangles = 0;
+    m_stats.culled = 0;
+    m_stats.binEntries = 0;
+    m_pipeline = m_vertexBuffer = m_indexBuffer = m_constantBuffer = m_texture = kNoHandle;
+    m_scissor = ScissorRect{0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height)};
+}
+
+void SoftwareRenderDevice::SetPipeline(Handle pipeline)
+{
+    m_pipeline = pipeline;
+}
+
+void SoftwareRenderDevice::SetVertexBuffer(Handle buffer, uint32_t stride)
+{
+    m_vertexBuffer = buffer;
+    m_stride = stride;
+}
+
+void SoftwareRenderDevice::SetIndexBuffer(Handle buffer, IndexFormat format)
+{
+    m_indexBuffer = buffer;
+    m_indexFormat = format;
+}
+
+void SoftwareRenderDevice::SetConstantBuffer(Handle buffer)
+{
+    m_constantBuffer = buffer;
+}
+
+void SoftwareRenderDevice::SetTexture(Handle texture)
+{
+    m_texture = texture;
+}
+
+void SoftwareRenderDevice::SetScissor(const ScissorRect& rect)
+{
+    m_scissor = rect;
+}
+
+/**
+ * @brief 描画の前に、設定中の状態から三角形に共通する値を用意する。
+ * @return パイプラインと頂点バッファが有効なら true。
+ */
+bool SoftwareRenderDevice::PrepareDraw()
+{
+    const Resource* pipeline = Find(m_pipeline, Type::Pipeline);
+    const Resource* vertices = Find(m_vertexBuffer, Type::Buffer);
+    if (!pipeline || !vertices || m_stride == 0 || m_width == 0)
+        return false;
+    m_draw = &pipeline->pipeline;
+    m_vertices = &vertices->data;
+
+    m_constants = FrameConstants{};
+    m_constants.Tint[0] = m_constants.Tint[1] = m_constants.Tint[2] = m_constants.Tint[3] = 1.0f;
+    for (int i = 0; i < 16; i += 5)
+        m_constants.Mvp[i] = 1.0f;
+    if (m_constantBuffer != kNoHandle)
+    {
+        const Resource* cb = Find(m_constantBuffer, Type::Buffer);
+        if (cb && cb->data.size() >= sizeof(FrameConstants))
+            std::memcpy(&m_constants, cb->data.data(), sizeof(FrameConstants));
+    }
+
+    m_drawTexture = nullptr;
+    if (m_draw->textured)
+    {
+        const Resource* texture = Find(m_texture, Type::Texture);
+        m_drawTexture = texture ? texture->texture.get() : nullptr;
+    }
+
+    m_clip = ScissorRect{0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height)};
+    if (m_draw->scissor)
+    {
+        m_clip.left = (std::max)(m_clip.left, m_scissor.left);
+        m_clip.top = (std::max)(m_clip.top, m_scissor.top);
+        m_clip.right = (std::min)(m_clip.right, m_scissor.right);
+        m_clip.bottom = (std::min)(m_clip.bottom, m_scissor.bottom);
+    }
+    return m_clip.left < m_clip.right && m_clip.top < m_clip.bottom;
+}
+
+/**
+ * @brief 頂点を読み出し、Mvp で変換して画面座標へ写す。頂点色には tinted なら Tint を掛けておく。
+ * @param index 頂点番号。
+ * @param out 変換結果。
+ * @return 頂点バッファの範囲内で、w が正なら true。
+ */
+bool SoftwareRenderDevice::FetchVertex(int64_t index, Vertex& out) const
+{
+    const Pipeline& p = *m_draw;
+    const std::vector<uint8_t>& data = *m_vertices;
+    if (index < 0 || static_cast<uint64_t>(index + 1) * m_stride > data.size())
+        return false;
+    const uint8_t* v = data.data() + static_cast<size_t>(index) * m_stride;
+
+    float pos[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const uint32_t posBytes = p.positionFormat == VertexFormat::Float2 ? 8 : 12;
+    if (p.positionOffset + posBytes > m_stride)
+        return false;
+    std::memcpy(pos, v + p.positionOffset, posBytes);
+
+    // 行 i が出力の i 成分 (HLSL の mul(p, Mvp) と同じ)
+    float clip[4];
+    const float* m = m_constants.Mvp;
+    for (int i = 0; i < 4; ++i)
+        clip[i] = m[i * 4 + 0] * pos[0] + m[i * 4 + 1] * pos[1] + m[i * 4 + 2] * pos[2] + m[i * 4 + 3] * pos[3];
+    if (!(clip[3] > 0.0f))
+        return false;
+    const float invW = 1.0f / clip[3];
+    out.x = (clip[0] * invW * 0.5f + 0.5f) * static_cast<float>(m_width);
+    out.y = (0.5f - clip[1] * invW * 0.5f) * static_cast<float>(m_height);
+
+    float* attr = out.attr;
+    attr[0] = attr[1] = attr[2] = attr[3] = 1.0f;
+    if (p.hasColor)
+    {
+        if (p.colorFormat == VertexFormat::Unorm8x4)
+        {
+            uint8_t c[4];
+            std::memcpy(c, v + p.colorOffset, 4);
+            for (int i = 0; i < 4; ++i)
+                attr[i] = c[i] * (1.0f / 255.0f);
+        }
+        else
+        {
+            std::memcpy(attr, v + p.colorOffset, p.colorFormat == VertexFormat::Float2 ? 8 : 12);
+        }
+    }
+    if (p.tinted)
+    {
+        // Tint の w は使わない (Shader.hlsl と同じ)
+        for (int i = 0; i < 3; ++i)
+            attr[i] *= m_constants.Tint[i];
+    }
+    attr[4] = attr[5] = 0.0f;
+    if (p.hasTexCoord)
+        std::memcpy(attr + 4, v + p.texCoordOffset, 8);
+    return true;
+}
+
+/**
+ * @brief 三角形のエッジ関数と属性の平面を求め、重なるタイルへ振り分ける。
+ * @param v0 頂点 0。
+ * @param v1 頂点 1。
+ * @param v2 頂点 2。
+ */
+void SoftwareRenderDevice::SetupTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2)
+{
+    const Vertex* v[3] = {&v0, &v1, &v2};
+    for (const Vertex* p : v)
+    {
+        if (!(std::fabs(p->x) < kGuardBand && std::fabs(p->y) < kGuardBand))
+        {
+            ++m_stats.culled;
+            return;
+        }
+    }
+
+    int32_t X[3], Y[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        X[i] = static_cast<int32_t>(std::lround(v[i]->x * kSubPixel));
+        Y[i] = static_cast<int32_t>(std::lround(v[i]->y * kSubPixel));
+    }
+    const int64_t area =
+        static_cast<int64_t>(X[1] - X[0]) * (Y[2] - Y[0]) - static_cast<int64_t>(X[2] - X[0]) * (Y[1] - Y[0]);
+    if (area == 0)
+    {
+        ++m_stats.culled;
+        return;
+    }
+    // カリングはしない。裏向きなら頂点 1 と 2 を入れ替えて内側が正になる向きに揃える
+    if (area < 0)
+    {
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+        std::swap(v[1], v[2]);
+    }
+
+    // 画素の中心 (px + 0.5) が頂点の範囲に入る画素だけを、描画先とシザーの範囲で塗る
+    const int64_t half = kSubPixel / 2;
+    const int64_t loX = *std::min_element(X, X + 3) - half;
+    const int64_t loY = *std::min_element(Y, Y + 3) - half;
+    const int64_t hiX = *std::max_element(X, X + 3) - half;
+    const int64_t hiY = *std::max_element(Y, Y + 3) - half;
+    const int32_t minX = (std::max)(m_clip.left, static_cast<int32_t>(FloorDiv(loX + kSubPixel - 1, kSubPixel)));
+    const int32_t minY = (std::max)(m_clip.top, static_cast<int32_t>(FloorDiv(loY + kSubPixel - 1, kSubPixel)));
+    const int32_t maxX = (std::min)(m_clip.right - 1, static_cast<int32_t>(FloorDiv(hiX, kSubPixel)));
+    const int32_t maxY = (std::min)(m_clip.bottom - 1, static_cast<int32_t>(FloorDiv(hiY, kSubPixel)));
+    if (minX > maxX || minY > maxY)
+    {
+        ++m_stats.culled;
+        return;
+    }
+
+    Triangle t;
+    for (int e = 0; e < 3; ++e)
+    {
+        // 辺 e は頂点 e の対辺。左上規則: 左の辺 (a > 0) と上の水平な辺 (a == 0 && b > 0) は境界上を含む
+        const int i = (e + 1) % 3;
+        const int j = (e + 2) % 3;
+        t.a[e] = Y[i] - Y[j];
+        t.b[e] = X[j] - X[i];
+        t.c[e] = static_cast<int64_t>(X[i]) * Y[j] - static_cast<int64_t>(Y[i]) * X[j];
+        const bool topLeft = t.a[e] > 0 || (t.a[e] == 0 && t.b[e] > 0);
+        if (!topLeft)
+            t.c[e] -= 1;
+    }
+    t.minX = minX;
+    t.minY = minY;
+    t.maxX = maxX;
+    t.maxY = maxY;
+
+    // 属性は頂点 0 を基準とする平面 value = a0 + dx * (x - x0) + dy * (y - y0) で補間する
+    t.x0 = X[0] * (1.0f / kSubPixel);
+    t.y0 = Y[0] * (1.0f / kSubPixel);
+    const float dx1 = (X[1] - X[0]) * (1.0f / kSubPixel);
+    const float dy1 = (Y[1] - Y[0]) * (1.0f / kSubPixel);
+    const float dx2 = (X[2] - X[0]) * (1.0f / kSubPixel);
+    const float dy2 = (Y[2] - Y[0]) * (1.0f / kSubPixel);
+    const float invArea = 1.0f / (dx1 * dy2 - dx2 * dy1);
+    for (int k = 0; k < 6; ++k)
+    {
+        const float a0 = v[0]->attr[k];
+        const float d1 = v[1]->attr[k] - a0;
+        const float d2 = v[2]->attr[k] - a0;
+        t.attr[k][0] = a0;
+        t.attr[k][1] = (d1 * dy2 - d2 * dy1) * invArea;
+        t.attr[k][2] = (d2 * dx1 - d1 * dx2) * invArea;
+    }
+    t.texture = m_drawTexture;
+    t.alphaBlend = m_draw->alphaBlend;
+
+    // ImGui の矩形や文字以外の図形の多くは色とテクスチャ座標 (白い画素) が一定なので、色を一度だけ求めておく
+    t.flat = true;
+    for (int k = 0; k < 6; ++k)
+        t.flat = t.flat && t.attr[k][1] == 0.0f && t.attr[k][2] == 0.0f;
+    if (t.flat)
+    {
+        for (int k = 0; k < 4; ++k)
+            t.color[k] = Saturate(t.attr[k][0]);
+        if (t.texture)
+        {
+            float texel[4];
+            SampleBilinear(t.texture->texels.data(), t.texture->width, t.texture->height, t.attr[4][0],
+                           t.attr[5][0], texel);
+            for (int k = 0; k < 4; ++k)
+                t.color[k] *= texel[k];
+        }
+    }
+
+    const uint32_t index = static_cast<uint32_t>(m_triangles.size());
+    m_triangles.push_back(t);
+    ++m_stats.triangles;
+    const uint32_t tx0 = static_cast<uint32_t>(minX) / kTileSize;
+    const uint32_t tx1 = static_cast<uint32_t>(maxX) / kTileSize;
+    const uint32_t ty0 = static_cast<uint32_t>(minY) / kTileSize;
+    const uint32_t ty1 = static_cast<uint32_t>(maxY) / kTileSize;
+    for (uint32_t ty = ty0; ty <= ty1; ++ty)
+    {
+        for (uint32_t tx = tx0; tx <= tx1; ++tx)
+            m_bins[ty * m_tilesX + tx].push_back(index);
+    }
+    m_stats.binEntries += static_cast<uint64_t>(tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+}
+
+/**
+ * @brief 連続する頂点を 3 つずつ三角形にして振り分ける。
+ * @param vertexCount 頂点数。
+ * @param firstVertex 最初の頂点。
+ */
+void SoftwareRenderDevice::Draw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    if (!PrepareDraw())
+        return;
+    Vertex v[3];
+    for (uint32_t i = 0; i + 3 <= vertexCount; i += 3)
+    {
+        bool ok = true;
+        for (uint32_t k = 0; k < 3; ++k)
+            ok = ok && FetchVertex(static_cast<int64_t>(firstVertex) + i + k, v[k]);
+        if (ok)
+            SetupTriangle(v[0], v[1], v[2]);
+        else
+            ++m_stats.culled;
+    }
+}
+
+/**
+ * @brief インデックスが指す頂点を 3 つずつ三角形にして振り分ける。
+ * @param indexCount インデックス数。
+ * @param firstIndex 最初のインデックス。
+ * @param baseVertex 各インデックスへ足す値。
+ */
+void SoftwareRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+    if (!PrepareDraw())
+        return;
+    const Resource* indices = Find(m_indexBuffer, Type::Buffer);
+    if (!indices)
+        return;
+    const size_t indexBytes = m_indexFormat == IndexFormat::U16 ? 2 : 4;
+    if ((static_cast<uint64_t>(firstIndex) + indexCount) * indexBytes > indices->data.size())
+    {
+        ++m_stats.invalid;
+        return;
+    }
+    const uint8_t* src = indices->data.data() + static_cast<size_t>(firstIndex) * indexBytes;
+    Vertex v[3];
+    for (uint32_t i = 0; i + 3 <= indexCount; i += 3)
+    {
+        bool ok = true;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t index = 0;
+            if (indexBytes == 2)
+            {
+                uint16_t u16;
+                std::memcpy(&u16, src + (i + k) * 2, 2);
+                index = u16;
+            }
+            else
+            {
+                std::memcpy(&index, src + (i + k) * 4, 4);
+            }
+            ok = ok && FetchVertex(static_cast<int64_t>(index) + baseVertex, v[k]);
+        }
+        if (ok)
+            SetupTriangle(v[0], v[1], v[2]);
+        else
+            ++m_stats.culled;
+    }
+}
+
+/**
+ * @brief タイル 1 つをクリアし、振り分けられた三角形を順に塗る。
+ * @details 三角形とタイルが重なる矩形の四隅でエッジ関数を評価し、全体が外側の辺があれば飛ばし、全体が内側の辺は
+ *          画素ごとの判定を省く。残った辺は矩形の中で符号が変わるため、値は 32 ビットに収まる。
+ * @param tile タイル番号。
+ */
+void SoftwareRenderDevice::RasterizeTile(uint32_t tile)
+{
+    const int32_t tileX = static_cast<int32_t>(tile % m_tilesX * kTileSize);
+    const int32_t tileY = static_cast<int32_t>(tile / m_tilesX * kTileSize);
+    const int32_t tileRight = (std::min)(tileX + static_cast<int32_t>(kTileSize), static_cast<int32_t>(m_width)) - 1;
+    const int32_t tileBottom = (std::min)(tileY + static_cast<int32_t>(kTileSize), static_cast<int32_t>(m_height)) - 1;
+    const size_t pitch = static_cast<size_t>(m_width) * 4;
+
+    // 1 行目をクリアカラーで埋め、残りの行へ複製する
+    uint8_t* first = m_color.data() + tileY * pitch + tileX * 4;
+    const size_t rowBytes = static_cast<size_t>(tileRight - tileX + 1) * 4;
+    for (size_t x = 0; x < rowBytes; x += 4)
+        std::memcpy(first + x, m_clear, 4);
+    for (int32_t y = tileY + 1; y <= tileBottom; ++y)
+        std::memcpy(m_color.data() + y * pitch + tileX * 4, first, rowBytes);
+
+    for (uint32_t index : m_bins[tile])
+    {
+        const Triangle& t = m_triangles[index];
+        const int32_t x0 = (std::max)(t.minX, tileX);
+        const int32_t y0 = (std::max)(t.minY, tileY);
+        const int32_t x1 = (std::min)(t.maxX, tileRight);
+        const int32_t y1 = (std::min)(t.maxY, tileBottom);
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        // 矩形の左上の画素の中心での値と、1 画素あたりの増分
+        int32_t start[3];
+        int32_t stepX[3];
+        int32_t stepY[3];
+        bool outside = false;
+        for (int e = 0; e < 3 && !outside; ++e)
+        {
+            const int64_t px = static_cast<int64_t>(x0) * kSubPixel + kSubPixel / 2;
+            const int64_t py = static_cast<int64_t>(y0) * kSubPixel + kSubPixel / 2;
+            const int64_t dx = static_cast<int64_t>(t.a[e]) * kSubPixel;
+            const int64_t dy = static_cast<int64_t>(t.b[e]) * kSubPixel;
+            const int64_t e00 = t.a[e] * px + t.b[e] * py + t.c[e];
+            const int64_t spanX = dx * (x1 - x0);
+            const int64_t spanY = dy * (y1 - y0);
+            const int64_t lo = e00 + (std::min)(spanX, int64_t(0)) + (std::min)(spanY, int64_t(0));
+            const int64_t hi = e00 + (std::max)(spanX, int64_t(0)) + (std::max)(spanY, int64_t(0));
+            if (hi < 0)
+                outside = true;
+            else if (lo >= 0)
+                start[e] = stepX[e] = stepY[e] = 0; // 矩形全体が内側
+            else
+            {
+                start[e] = static_cast<int32_t>(e00);
+                stepX[e] = static_cast<int32_t>(dx);
+                stepY[e] = static_cast<int32_t>(dy);
+            }
+        }
+        if (outside)
+            continue;
+
+        int32_t lanes[3][4];
+        for (int e = 0; e < 3; ++e)
+        {
+            for (int i = 0; i < 4; ++i)
+                lanes[e][i] = stepX[e] * i;
+        }
+
+        const uint8_t* texels = t.texture ? t.texture->texels.data() : nullptr;
+        const uint32_t texWidth = t.texture ? t.texture->width : 0;
+        const uint32_t texHeight = t.texture ? t.texture->height : 0;
+        int32_t rowStart[3] = {start[0], start[1], start[2]};
+        for (int32_t y = y0; y <= y1; ++y)
+        {
+            int32_t e[3] = {rowStart[0], rowStart[1], rowStart[2]};
+            uint8_t* row = m_color.data() + y * pitch;
+            const float fy = static_cast<float>(y) + 0.5f - t.y0;
+            for (int32_t x = x0; x <= x1; x += 4)
+            {
+                uint32_t mask = Coverage4(e, lanes);
+                const int32_t remaining = x1 - x + 1;
+                if (remaining < 4)
+                    mask &= (1u << remaining) - 1;
+                for (int32_t i = 0; mask; ++i, mask >>= 1)
+                {
+                    if (!(mask & 1))
+                        continue;
+                    uint8_t* dst = row + (x + i) * 4;
+                    if (t.flat)
+                    {
+                        WritePixel(dst, t.color, t.alphaBlend);
+                        continue;
+                    }
+                    const float fx = static_cast<float>(x + i) + 0.5f - t.x0;
+                    float a[6];
+                    for (int k = 0; k < 6; ++k)
+                        a[k] = t.attr[k][0] + t.attr[k][1] * fx + t.attr[k][2] * fy;
+                    float src[4] = {Saturate(a[0]), Saturate(a[1]), Saturate(a[2]), Saturate(a[3])};
+                    if (texels)
+                    {
+                        float texel[4];
+                        SampleBilinear(texels, texWidth, texHeight, a[4], a[5], texel);
+                        for (int k = 0; k < 4; ++k)
+                            src[k] *= texel[k];
+                    }
+                    WritePixel(dst, src, t.alphaBlend);
+                }
+                for (int k = 0; k < 3; ++k)
+                    e[k] += stepX[k] * 4;
+            }
+            for (int k = 0; k < 3; ++k)
+                rowStart[k] += stepY[k];
+        }
+    }
+}
+
+/**
+ * @brief 未処理のタイルが無くなるまで取り出して塗る。描画スレッドとワーカーが並行して呼ぶ。
+ */
+void SoftwareRenderDevice::RasterizeTiles()
+{
+    const uint32_t count = m_tilesX * m_tilesY;
+    for (uint32_t tile = m_nextTile.fetch_add(1, std::memory_order_relaxed); tile < count;
+         tile = m_nextTile.fetch_add(1, std::memory_order_relaxed))
+        RasterizeTile(tile);
+}
+
+/**
+ * @brief ワーカースレッドの本体。Present の合図ごとに RasterizeTiles を呼ぶ。
+ */
+void SoftwareRenderDevice::WorkerMain()
+{
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop)
+                return;
+            seen = m_generation;
+        }
+        RasterizeTiles();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_busy == 0)
+                m_done.notify_one();
+        }
+    }
+}
+
+/**
+ * @brief 振り分けた三角形を全タイルで塗り、フレームを確定する。待機はしない。
+ * @param vsync 垂直同期を待つ場合は true (使わない)。
+ * @return 常に PresentResult::Ok。
+ */
+PresentResult SoftwareRenderDevice::Present(bool vsync)
+{
+    (void)vsync;
+    const auto start = std::chrono::steady_clock::now();
+    m_nextTile.store(0, std::memory_order_relaxed);
+    if (!m_workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy = static_cast<uint32_t>(m_workers.size());
+            ++m_generation;
+        }
+        m_wake.notify_all();
+    }
+    RasterizeTiles();
+    if (!m_workers.empty())
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [&] { return m_busy == 0; });
+    }
+    m_stats.rasterMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    ++m_stats.frames;
+    m_retired.clear();
+    return PresentResult::Ok;
+}
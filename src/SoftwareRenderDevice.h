@@ -0,0 +1,296 @@
+#pragma once
+#include "RenderDevice.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @file SoftwareRenderDevice.h
+ * @brief CPU で画素を塗るソフトウェアラスタライザーのレンダーデバイスの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief ソフトウェアラスタライザーの集計。
+ */
+struct SoftwareStats
+{
+    uint64_t frames = 0;     // Present した回数
+    uint64_t invalid = 0;    // 無効なハンドルや範囲外の頂点を参照した回数 (累計)
+    uint32_t threads = 0;    // ラスタライズに使うスレッド数 (描画スレッドを含む)
+    uint64_t triangles = 0;  // 直近のフレームでビンに振り分けた三角形数
+    uint64_t culled = 0;     // 直近のフレームで捨てた三角形数 (面積 0・w <= 0・ガードバンド外・画面外)
+    uint64_t binEntries = 0; // 直近のフレームのタイルへの振り分け数の合計
+    double rasterMs = 0.0;   // 直近のフレームのラスタライズの所要時間 (ミリ秒)
+};
+
+/**
+ * @brief 三角形をタイルへ振り分け、タイルごとに複数スレッドで塗るソフトウェアラスタライザー。
+ * @details GPU なしで DxApp と UiRenderer の描画を画素単位で再現し、オフスクリーンの RGBA8 バッファへ描く。
+ *          シェーダーは実行せず、PipelineDesc のフラグから「位置を Mvp で変換し、頂点色に Tint とテクスチャ
+ *          (バイリニア・クランプ) を掛け、必要ならアルファブレンドする」処理を再現する。属性の補間は画面空間の線形補間
+ *          (2D 用の MVP を前提とし、遠近補正はしない)。
+ *
+ *          描画呼び出しの時点で頂点を変換して三角形を組み立て、64x64 のタイルへ振り分けるだけにしておき、
+ *          Present でタイルを並列に塗る。1 つのタイルは 1 つのスレッドが振り分け順に塗るため、結果はスレッド数に
+ *          よらず同じになる。被覆判定は 1/16 ピクセル精度の整数のエッジ関数 (左上規則) で行い、4 画素ずつ SIMD で
+ *          評価する (SSE2 が無い環境ではスカラー)。
+ */
+class SoftwareRenderDevice : public RenderDevice
+{
+public:
+    static constexpr uint32_t kTileSize = 64; // タイルの一辺 (ピクセル)
+
+    /**
+     * @brief ワーカースレッドを起動する。
+     * @param threads ラスタライズに使うスレッド数 (描画スレッドを含む)。0 ならハードウェアのスレッド数。
+     */
+    explicit SoftwareRenderDevice(uint32_t threads = 0);
+
+    /**
+     * @brief ワーカースレッドを停止する。
+     */
+    ~SoftwareRenderDevice() override;
+
+    SoftwareRenderDevice(const SoftwareRenderDevice&) = delete;
+    SoftwareRenderDevice& operator=(const SoftwareRenderDevice&) = delete;
+
+    const char* Name() const override
+    {
+        return "Software";
+    }
+
+    Handle CreateBuffer(BufferKind kind, uint32_t bytes, const void* initial) override;
+    Handle CreateTexture(uint32_t width, uint32_t height, const void* rgba) override;
+    Handle CreatePipeline(const PipelineDesc& desc) override;
+    void Destroy(Handle handle) override;
+    void* MapBuffer(Handle buffer) override;
+    void UnmapBuffer(Handle buffer) override;
+    bool Resize(uint32_t width, uint32_t height) override;
+    void BeginPass(const float clear[4]) override;
+    void SetPipeline(Handle pipeline) override;
+    void SetVertexBuffer(Handle buffer, uint32_t stride) override;
+    void SetIndexBuffer(Handle buffer, IndexFormat format) override;
+    void SetConstantBuffer(Handle buffer) override;
+    void SetTexture(Handle texture) override;
+    void SetScissor(const ScissorRect& rect) override;
+    void Draw(uint32_t vertexCount, uint32_t firstVertex) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+    PresentResult Present(bool vsync) override;
+
+    /**
+     * @brief 直近に Present したフレームの画素を取得する。描画スレッドか、描画スレッドを止めた後に読む。
+     * @return 上の行から並んだ RGBA8 (Width() * Height() * 4 バイト)。
+     */
+    const uint8_t* Pixels() const
+    {
+        return m_color.data();
+    }
+
+    /**
+     * @brief 描画先の幅を取得する。
+     * @return 幅 (ピクセル)。
+     */
+    uint32_t Width() const
+    {
+        return m_width;
+    }
+
+    /**
+     * @brief 描画先の高さを取得する。
+     * @return 高さ (ピクセル)。
+     */
+    uint32_t Height() const
+    {
+        return m_height;
+    }
+
+    /**
+     * @brief 集計を取得する。描画スレッドか、描画スレッドを止めた後に読む。
+     * @return 集計。
+     */
+    const SoftwareStats& Stats() const
+    {
+        return m_stats;
+    }
+
+private:
+    /**
+     * @brief リソースの種類。
+     */
+    enum class Type : uint8_t
+    {
+        None,     // 空き
+        Buffer,   // バッファ
+        Texture,  // テクスチャ
+        Pipeline, // パイプライン
+    };
+
+    /**
+     * @brief RGBA8 のテクスチャ。
+     */
+    struct Texture
+    {
+        uint32_t width = 0;          // 幅
+        uint32_t height = 0;         // 高さ
+        std::vector<uint8_t> texels; // 画素 (RGBA8)
+    };
+
+    /**
+     * @brief 頂点レイアウトと固定機能の状態を解釈したパイプライン。
+     */
+    struct Pipeline
+    {
+        uint32_t positionOffset = 0;                        // 位置のバイト位置
+        VertexFormat positionFormat = VertexFormat::Float3; // 位置の型
+        bool hasColor = false;                              // 頂点色がある
+        uint32_t colorOffset = 0;                           // 頂点色のバイト位置
+        VertexFormat colorFormat = VertexFormat::Float3;    // 頂点色の型
+        bool hasTexCoord = false;                           // テクスチャ座標がある
+        uint32_t texCoordOffset = 0;                        // テクスチャ座標のバイト位置
+        bool tinted = false;                                // 頂点色に Tint を掛ける
+        bool textured = false;                              // テクスチャを掛ける
+        bool alphaBlend = false;                            // アルファブレンドする
+        bool scissor = false;                               // シザー矩形で切り抜く
+    };
+
+    /**
+     * @brief ハンドルが指すリソース。種類に応じて一部のメンバーだけを使う。
+     */
+    struct Resource
+    {
+        Type type = Type::None;           // 種類
+        bool dynamic = false;             // 動的バッファ
+        bool mapped = false;              // Map 中
+        std::vector<uint8_t> data;        // バッファの内容
+        std::unique_ptr<Texture> texture; // テクスチャ
+        Pipeline pipeline;                // パイプライン
+    };
+
+    /**
+     * @brief 変換済みの頂点 (画面座標と属性)。
+     */
+    struct Vertex
+    {
+        float x = 0.0f;                     // 画面座標 x (ピクセル)
+        float y = 0.0f;                     // 画面座標 y (ピクセル)
+        float attr[6] = {1, 1, 1, 1, 0, 0}; // r, g, b, a, u, v
+    };
+
+    /**
+     * @brief 振り分け済みの三角形。エッジ関数と属性の平面の式を持つ。
+     * @details エッジ関数 E(X, Y) = a * X + b * Y + c は 1/16 ピクセル単位の座標で評価し、内側で 0 以上になる。
+     *          c には左上規則のための -1 を含める。
+     */
+    struct Triangle
+    {
+        int32_t a[3];           // エッジ関数の X の係数
+        int32_t b[3];           // エッジ関数の Y の係数
+        int64_t c[3];           // エッジ関数の定数項
+        int32_t minX, minY;     // 塗る範囲の左上 (ピクセル、シザー適用済み)
+        int32_t maxX, maxY;     // 塗る範囲の右下 (ピクセル、含む)
+        float x0, y0;           // 属性の平面の基準点 (頂点 0 の画面座標)
+        float attr[6][3];       // 属性ごとの (頂点 0 での値, x 方向の傾き, y 方向の傾き)
+        const Texture* texture; // 掛けるテクスチャ (無ければ nullptr)
+        bool alphaBlend;        // アルファブレンドする
+        bool flat;              // 属性が一定 (画素ごとの補間とサンプリングを省く)
+        float color[4];         // flat のときの色 (テクスチャを掛けた後)
+    };
+
+    /**
+     * @brief リソースの枠を確保する。空きがあれば使い回す。
+     * @param type 種類。
+     * @return ハンドル。
+     */
+    Handle Allocate(Type type);
+
+    /**
+     * @brief ハンドルが指定の種類のリソースを指しているか確かめる。違えば invalid を数える。
+     * @param handle ハンドル。
+     * @param type 期待する種類。
+     * @return リソース。無効なら nullptr。
+     */
+    Resource* Find(Handle handle, Type type);
+
+    /**
+     * @brief 頂点を読み出して変換する。
+     * @param index 頂点番号。
+     * @param out 変換結果。
+     * @return 頂点バッファの範囲内なら true。
+     */
+    bool FetchVertex(int64_t index, Vertex& out) const;
+
+    /**
+     * @brief 三角形を組み立て、重なるタイルへ振り分ける。
+     * @param v0 頂点 0。
+     * @param v1 頂点 1。
+     * @param v2 頂点 2。
+     */
+    void SetupTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2);
+
+    /**
+     * @brief 描画の前に、設定中の状態から三角形に共通する値を用意する。
+     * @return 描ける状態なら true。
+     */
+    bool PrepareDraw();
+
+    /**
+     * @brief 未処理のタイルが無くなるまで取り出して塗る。描画スレッドとワーカーが並行して呼ぶ。
+     */
+    void RasterizeTiles();
+
+    /**
+     * @brief タイル 1 つをクリアし、振り分けられた三角形を順に塗る。
+     * @param tile タイル番号。
+     */
+    void RasterizeTile(uint32_t tile);
+
+    /**
+     * @brief ワーカースレッドの本体。Present の合図ごとに RasterizeTiles を呼ぶ。
+     */
+    void WorkerMain();
+
+    std::vector<Resource> m_resources;               // ハンドル - 1 で引くリソース
+    std::vector<Handle> m_freeList;                  // 破棄されたハンドル
+    std::vector<std::unique_ptr<Texture>> m_retired; // 描画中のフレームが参照し得るため Present まで残すテクスチャ
+    uint32_t m_width = 0;                            // 描画先の幅
+    uint32_t m_height = 0;                           // 描画先の高さ
+    uint32_t m_tilesX = 0;                           // 横方向のタイル数
+    uint32_t m_tilesY = 0;                           // 縦方向のタイル数
+    std::vector<uint8_t> m_color;                    // 描画先 (RGBA8)
+    uint8_t m_clear[4] = {};                         // クリアカラー (RGBA8)
+    std::vector<Triangle> m_triangles;               // 記録中のフレームの三角形
+    std::vector<std::vector<uint32_t>> m_bins;       // タイルごとの三角形番号 (振り分け順)
+    SoftwareStats m_stats;                           // 集計
+
+    Handle m_pipeline = kNoHandle;                // 設定中のパイプライン
+    Handle m_vertexBuffer = kNoHandle;            // 設定中の頂点バッファ
+    uint32_t m_stride = 0;                        // 頂点 1 つのバイト数
+    Handle m_indexBuffer = kNoHandle;             // 設定中のインデックスバッファ
+    IndexFormat m_indexFormat = IndexFormat::U16; // インデックスの型
+    Handle m_constantBuffer = kNoHandle;          // 設定中の定数バッファ
+    Handle m_texture = kNoHandle;                 // 設定中のテクスチャ
+    ScissorRect m_scissor;                        // 設定中のシザー矩形
+
+    // PrepareDraw が用意する描画ごとの値
+    const Pipeline* m_draw = nullptr;                 // パイプライン
+    const std::vector<uint8_t>* m_vertices = nullptr; // 頂点バッファの内容
+    FrameConstants m_constants{};                     // 定数バッファの内容
+    const Texture* m_drawTexture = nullptr;           // テクスチャ
+    ScissorRect m_clip;                               // 描画先とシザーを重ねた範囲
+
+    std::vector<std::thread> m_workers;  // ワーカースレッド
+    std::mutex m_mutex;                  // 以下の合図を保護
+    std::condition_variable m_wake;      // ラスタライズの開始・停止をワーカーへ知らせる
+    std::condition_variable m_done;      // ワーカーの完了を描画スレッドへ知らせる
+    uint64_t m_generation = 0;           // ラスタライズを始めるたびに増やす
+    uint32_t m_busy = 0;                 // ラスタライズ中のワーカー数
+    bool m_stop = false;                 // 停止要求
+    std::atomic<uint32_t> m_nextTile{0}; // 次に取り出すタイル番号
+};
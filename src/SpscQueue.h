@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @file SpscQueue.h
+ * @brief 1 対 1 のスレッド間で値を受け渡す固定容量のロックフリーキューの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 単一生産者・単一消費者の有界リングバッファ。
+ * @details 生産者だけが末尾を、消費者だけが先頭を進めるため、操作は添字の読み書きと要素の移動だけで済み、
+ *          ロックも CAS も使わない。先頭と末尾は別のキャッシュラインに置き、互いの書き込みで
+ *          キャッシュラインを奪い合わないようにする。添字は折り返さずに数え続け、容量の剰余で位置を求める。
+ *          TryPush は生産者スレッドから、TryPop は消費者スレッドからだけ呼ぶこと。
+ * @tparam T 受け渡す値の型 (ムーブ可能であること)。
+ * @tparam Capacity 容量 (2 の冪)。
+ */
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity は 2 の冪である必要がある");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief 末尾へ値を追加する (生産者スレッド専用)。
+     * @param item 追加する値。満杯で追加できなかった場合は変更しない。
+     * @return 追加できた場合は true、満杯なら false。
+     */
+    bool TryPush(T&& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache == Capacity)
+        {
+            // 手元の先頭の写しが古い場合だけ、消費者の添字を読み直す
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache == Capacity)
+                return false;
+        }
+        m_items[tail & (Capacity - 1)] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 先頭の値を取り出す (消費者スレッド専用)。
+     * @param out 取り出した値の格納先。
+     * @return 取り出せた場合は true、空なら false。
+     */
+    bool TryPop(T& out)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache)
+                return false;
+        }
+        out = std::move(m_items[head & (Capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 要素数の概算を取得する。他方のスレッドが操作中なら直後に変わりうる。
+     * @return 要素数。
+     */
+    size_t SizeApprox() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> m_head{0}; // 次に取り出す位置 (消費者が進める)
+    size_t m_tailCache = 0;                    // 消費者が最後に読んだ末尾 (消費者専用)
+    alignas(64) std::atomic<size_t> m_tail{0}; // 次に追加する位置 (生産者が進める)
+    size_t m_headCache = 0;                    // 生産者が最後に読んだ先頭 (生産者専用)
+    alignas(64) T m_items[Capacity]{};         // 要素
+};
@@ -0,0 +1,234 @@
+/**
+ * @file UiRenderer.cpp
+ * @brief ImGui の描画データをレンダーデバイスで描くレンダラーの実装。
+ * @author 山内陽
+ */
+
+#include "UiRenderer.h"
+
+#include <cstddef>
+#include <cstring>
+
+/**
+ * @brief UI 用のシェーダー。定数バッファは Shader.hlsl と同じ FrameConstants のレイアウトを使う。
+ */
+static const char kUiShader[] = R"(
+cbuffer Globals : register(b0)
+{
+    float4 Tint;
+    float2 Screen;
+    float2 Pad0;
+    float4x4 Mvp;
+};
+
+Texture2D Texture0 : register(t0);
+SamplerState Sampler0 : register(s0);
+
+struct VSInput
+{
+    float2 pos : POSITION;
+    float4 col : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+struct VSOutput
+{
+    float4 pos : SV_POSITION;
+    float4 col : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+VSOutput VSMain(VSInput input)
+{
+    VSOutput o;
+    o.pos = mul(float4(input.pos, 0.0f, 1.0f), Mvp);
+    o.col = input.col;
+    o.uv = input.uv;
+    return o;
+}
+
+float4 PSMain(VSOutput input) : SV_TARGET
+{
+    return input.col * Texture0.Sample(Sampler0, input.uv);
+}
+)";
+
+/**
+ * @brief フォントテクスチャ・パイプライン・定数バッファを作り、ImGui コンテキストへレンダラーとして登録する。
+ * @param device 描画に使うデバイス。
+ * @return すべてのリソースを作成できた場合は true。
+ */
+bool UiRenderer::Init(RenderDevice& device)
+{
+    m_device = &device;
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "UiRenderer";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset; // DrawIndexed の baseVertex で 64K 頂点を超えられる
+
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    m_font = device.CreateTexture(static_cast<uint32_t>(width), static_cast<uint32_t>(height), pixels);
+    io.Fonts->SetTexID(reinterpret_cast<ImTextureID>(static_cast<intptr_t>(m_font)));
+
+    PipelineDesc desc;
+    desc.name = "ImGui";
+    desc.shaderSource = kUiShader;
+    desc.layout = {
+        {VertexSemantic::Position, VertexFormat::Float2, static_cast<uint32_t>(offsetof(ImDrawVert, pos))},
+        {VertexSemantic::TexCoord, VertexFormat::Float2, static_cast<uint32_t>(offsetof(ImDrawVert, uv))},
+        {VertexSemantic::Color, VertexFormat::Unorm8x4, static_cast<uint32_t>(offsetof(ImDrawVert, col))},
+    };
+    desc.textured = true;
+    desc.alphaBlend = true;
+    desc.scissor = true;
+    m_pipeline = device.CreatePipeline(desc);
+    m_constants = device.CreateBuffer(BufferKind::Constant, sizeof(FrameConstants), nullptr);
+    return m_font != RenderDevice::kNoHandle && m_pipeline != RenderDevice::kNoHandle &&
+           m_constants != RenderDevice::kNoHandle;
+}
+
+/**
+ * @brief リソースを破棄し、ImGui コンテキストへの登録を解除する。
+ */
+void UiRenderer::Shutdown()
+{
+    if (!m_device)
+        return;
+    for (RenderDevice::Handle* h : {&m_pipeline, &m_font, &m_constants, &m_vertices, &m_indices})
+    {
+        m_device->Destroy(*h);
+        *h = RenderDevice::kNoHandle;
+    }
+    m_vertexCapacity = m_indexCapacity = 0;
+    m_device = nullptr;
+
+    if (ImGui::GetCurrentContext())
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        io.Fonts->SetTexID(nullptr);
+        io.BackendRendererName = nullptr;
+        io.BackendFlags &= ~ImGuiBackendFlags_RendererHasVtxOffset;
+    }
+}
+
+/**
+ * @brief バッファが足りなければ、上乗せ分の余裕を持たせて作り直す。
+ * @param kind 用途。
+ * @param buffer バッファのハンドル。
+ * @param capacity 現在の容量 (要素数)。
+ * @param required 必要な要素数。
+ * @param extra 作り直す際に上乗せする要素数。
+ * @param stride 要素 1 つのバイト数。
+ * @return バッファを用意できた場合は true。
+ */
+bool UiRenderer::Reserve(BufferKind kind, RenderDevice::Handle& buffer, int& capacity, int required, int extra,
+                         uint32_t stride)
+{
+    if (buffer != RenderDevice::kNoHandle && capacity >= required)
+        return true;
+    m_device->Destroy(buffer);
+    capacity = required + extra;
+    buffer = m_device->CreateBuffer(kind, static_cast<uint32_t>(capacity) * stride, nullptr);
+    if (buffer == RenderDevice::kNoHandle)
+        capacity = 0;
+    return buffer != RenderDevice::kNoHandle;
+}
+
+/**
+ * @brief パイプラインとバッファを設定し、表示領域を -1..1 へ写す投影行列を定数バッファへ書き込む。
+ * @param data 描く描画データ。
+ */
+void UiRenderer::SetupRenderState(const ImDrawData* data)
+{
+    const float l = data->DisplayPos.x;
+    const float r = data->DisplayPos.x + data->DisplaySize.x;
+    const float t = data->DisplayPos.y;
+    const float b = data->DisplayPos.y + data->DisplaySize.y;
+    FrameConstants cb{};
+    cb.Tint[0] = cb.Tint[1] = cb.Tint[2] = cb.Tint[3] = 1.0f;
+    cb.Screen[0] = data->DisplaySize.x;
+    cb.Screen[1] = data->DisplaySize.y;
+    const float mvp[16] = {
+        2.0f / (r - l), 0.0f, 0.0f, (r + l) / (l - r), //
+        0.0f, 2.0f / (t - b), 0.0f, (t + b) / (b - t), //
+        0.0f, 0.0f, 0.5f, 0.5f,                        //
+        0.0f, 0.0f, 0.0f, 1.0f,                        //
+    };
+    std::memcpy(cb.Mvp, mvp, sizeof(mvp));
+    m_device->UpdateBuffer(m_constants, &cb, sizeof(cb));
+
+    m_device->SetPipeline(m_pipeline);
+    m_device->SetVertexBuffer(m_vertices, sizeof(ImDrawVert));
+    m_device->SetIndexBuffer(m_indices, sizeof(ImDrawIdx) == 2 ? IndexFormat::U16 : IndexFormat::U32);
+    m_device->SetConstantBuffer(m_constants);
+}
+
+/**
+ * @brief 全描画リストの頂点・インデックスを 1 本ずつのバッファへまとめて書き込み、コマンドごとにシザーを設定して描く。
+ * @param data ImGui::GetDrawData() またはその複製。
+ */
+void UiRenderer::Render(const ImDrawData* data)
+{
+    if (!m_device || !data || data->CmdListsCount == 0 || data->DisplaySize.x <= 0.0f || data->DisplaySize.y <= 0.0f)
+        return;
+    if (!Reserve(BufferKind::Vertex, m_vertices, m_vertexCapacity, data->TotalVtxCount, 5000, sizeof(ImDrawVert)) ||
+        !Reserve(BufferKind::Index, m_indices, m_indexCapacity, data->TotalIdxCount, 10000, sizeof(ImDrawIdx)))
+        return;
+
+    auto* vtx = static_cast<ImDrawVert*>(m_device->MapBuffer(m_vertices));
+    if (!vtx)
+        return;
+    auto* idx = static_cast<ImDrawIdx*>(m_device->MapBuffer(m_indices));
+    if (!idx)
+    {
+        m_device->UnmapBuffer(m_vertices);
+        return;
+    }
+    for (const ImDrawList* list : data->CmdLists)
+    {
+        std::memcpy(vtx, list->VtxBuffer.Data, static_cast<size_t>(list->VtxBuffer.Size) * sizeof(ImDrawVert));
+        std::memcpy(idx, list->IdxBuffer.Data, static_cast<size_t>(list->IdxBuffer.Size) * sizeof(ImDrawIdx));
+        vtx += list->VtxBuffer.Size;
+        idx += list->IdxBuffer.Size;
+    }
+    m_device->UnmapBuffer(m_vertices);
+    m_device->UnmapBuffer(m_indices);
+
+    SetupRenderState(data);
+
+    // クリップ矩形は表示領域の座標なので、描画先の原点からの座標へ直してシザーにする
+    const ImVec2 origin = data->DisplayPos;
+    int vtxOffset = 0;
+    int idxOffset = 0;
+    for (const ImDrawList* list : data->CmdLists)
+    {
+        for (const ImDrawCmd& cmd : list->CmdBuffer)
+        {
+            if (cmd.UserCallback)
+            {
+                if (cmd.UserCallback == ImDrawCallback_ResetRenderState)
+                    SetupRenderState(data);
+                else
+                    cmd.UserCallback(list, &cmd);
+                continue;
+            }
+            const ImVec2 clipMin(cmd.ClipRect.x - origin.x, cmd.ClipRect.y - origin.y);
+            const ImVec2 clipMax(cmd.ClipRect.z - origin.x, cmd.ClipRect.w - origin.y);
+            if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y)
+                continue;
+
+            ScissorRect rect;
+            rect.left = static_cast<int32_t>(clipMin.x);
+            rect.top = static_cast<int32_t>(clipMin.y);
+            rect.right = static_cast<int32_t>(clipMax.x);
+            rect.bottom = static_cast<int32_t>(clipMax.y);
+            m_device->SetScissor(rect);
+            m_device->SetTexture(static_cast<RenderDevice::Handle>(reinterpret_cast<intptr_t>(cmd.GetTexID())));
+            m_device->DrawIndexed(cmd.ElemCount, cmd.IdxOffset + static_cast<uint32_t>(idxOffset),
+                                  static_cast<int32_t>(cmd.VtxOffset) + vtxOffset);
+        }
+        vtxOffset += list->VtxBuffer.Size;
+        idxOffset += list->IdxBuffer.Size;
+    }
+}
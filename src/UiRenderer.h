@@ -0,0 +1,69 @@
+#pragma once
+#include "RenderDevice.h"
+#include "imgui.h"
+
+#include <cstdint>
+
+/**
+ * @file UiRenderer.h
+ * @brief ImGui の描画データをレンダーデバイスで描くレンダラーの宣言。
+ * @author 山内陽
+ */
+
+/**
+ * @brief ImGui のレンダラーバックエンド。描画 API には RenderDevice を通じてだけ触れる。
+ * @details フォントテクスチャ・パイプライン・定数バッファを Init で作り、頂点・インデックスバッファは
+ *          描画データが収まらなくなったときだけ余裕を持たせて作り直す。
+ *          Init と Shutdown は ImGui のコンテキストがあるスレッドから、Render は描画スレッドから呼ぶ。
+ *          Render は渡された描画データだけを読み、ImGui のコンテキストには触れない。
+ */
+class UiRenderer
+{
+public:
+    /**
+     * @brief フォントテクスチャなどのリソースを作り、現在の ImGui コンテキストへレンダラーとして登録する。
+     * @param device 描画に使うデバイス (Shutdown まで生存すること)。
+     * @return すべてのリソースを作成できた場合は true。
+     */
+    bool Init(RenderDevice& device);
+
+    /**
+     * @brief リソースを破棄し、ImGui コンテキストへの登録を解除する。
+     */
+    void Shutdown();
+
+    /**
+     * @brief 描画データを描く (描画スレッド専用)。
+     * @param data ImGui::GetDrawData() またはその複製。
+     */
+    void Render(const ImDrawData* data);
+
+private:
+    /**
+     * @brief パイプラインとバッファ・投影行列を設定する。
+     * @param data 描く描画データ。
+     */
+    void SetupRenderState(const ImDrawData* data);
+
+    /**
+     * @brief バッファが足りなければ作り直す。
+     * @param kind 用途。
+     * @param buffer バッファのハンドル。
+     * @param capacity 現在の容量 (要素数)。
+     * @param required 必要な要素数。
+     * @param extra 作り直す際に上乗せする要素数。
+     * @param stride 要素 1 つのバイト数。
+     * @return バッファを用意できた場合は true。
+     */
+    bool Reserve(BufferKind kind, RenderDevice::Handle& buffer, int& capacity, int required, int extra,
+                 uint32_t stride);
+
+    RenderDevice* m_device = nullptr;                           // 描画に使うデバイス
+    RenderDevice::Handle m_pipeline = RenderDevice::kNoHandle;  // UI 用パイプライン
+    RenderDevice::Handle m_font = RenderDevice::kNoHandle;      // フォントテクスチャ
+    RenderDevice::Handle m_constants = RenderDevice::kNoHandle; // 投影行列の定数バッファ
+    RenderDevice::Handle m_vertices = RenderDevice::kNoHandle;  // 頂点バッファ
+    RenderDevice::Handle m_indices = RenderDevice::kNoHandle;   // インデックスバッファ
+    int m_vertexCapacity = 0;                                   // 頂点バッファの容量 (頂点数)
+    int m_indexCapacity = 0;                                    // インデックスバッファの容量 (インデックス数)
+};
@@ -4,12 +4,18 @@
  * @author 山内陽
  */
 
+#include "D3D11RenderDevice.h"
 #include "DxApp.h"
-#include "imgui_impl_dx11.h"
+#include "IniParser.h"
 #include "imgui_impl_win32.h" // ハンドラ宣言用
 
+#include <memory>
+#include <string>
+#include <string_view>
 #include <windows.h>
 
+#include <shellapi.h>
+
 extern LRESULT ImGui_ImplWin32_WndProcHandler(HWND, UINT, WPARAM, LPARAM);
 
 /**
@@ -31,13 +37,24 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     switch (msg)
     {
     case WM_SIZE:
-        if (app && wParam != SIZE_MINIMIZED)
+        if (app)
         {
-            UINT width = LOWORD(lParam);
-            UINT height = HIWORD(lParam);
-            app->OnResize(width, height);
+            // 最小化中は描画を止めずにフレームレートだけを絞る (設定の再読み込みなどは続ける)
+            app->Scheduler().SetMinimized(wParam == SIZE_MINIMIZED);
+            app->Invalidate();
+            if (wParam != SIZE_MINIMIZED)
+            {
+                UINT width = LOWORD(lParam);
+                UINT height = HIWORD(lParam);
+                app->OnResize(width, height);
+            }
         }
         break;
+    case WM_PAINT:
+        // 隠れていた部分が見えた場合など、OS から再描画を求められたら次のフレームを描く (検証は DefWindowProc が行う)
+        if (app)
+            app->Invalidate(1);
+        break;
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
@@ -47,11 +64,61 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
+/**
+ * @brief キーボード・マウスの入力メッセージか判定する。
+ * @param message メッセージ ID。
+ * @return 入力メッセージなら true。
+ */
+static bool IsInputMessage(UINT message)
+{
+    return (message >= WM_KEYFIRST && message <= WM_KEYLAST) || (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST) ||
+           message == WM_MOUSELEAVE;
+}
+
+/**
+ * @brief コマンドライン引数のうち "--Category.Key=value" 形式のものを上書き設定の INI テキストへまとめる。
+ * @param replay "--replay=<path>" で指定された編集ログのパスを受け取る (指定が無ければ空)。
+ * @return 上書き設定 (指定が無ければ空)。
+ */
+static std::string ParseCommandLineOverrides(std::wstring& replay)
+{
+    std::string ini;
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv)
+        return ini;
+
+    std::string arg;
+    const std::wstring_view kReplay = L"--replay=";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::wstring_view(argv[i]).substr(0, kReplay.size()) == kReplay)
+        {
+            replay.assign(argv[i] + kReplay.size());
+            continue;
+        }
+        const int len = WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0, nullptr, nullptr);
+        if (len <= 1)
+            continue;
+        arg.resize(static_cast<size_t>(len));
+        WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, &arg[0], len, nullptr, nullptr);
+        arg.pop_back(); // 終端の '\0'
+        if (!AppendCommandLineOverride(arg, ini))
+        {
+            std::wstring msg = L"[Settings] Ignored command-line argument: ";
+            msg.append(argv[i]).append(L"\n");
+            OutputDebugStringW(msg.c_str());
+        }
+    }
+    LocalFree(argv);
+    return ini;
+}
+
 /**
  * @brief Win32 アプリケーションのエントリーポイント。
  * @param hInst インスタンスハンドル。
  * @param unusedPrevInst 未使用。
- * @param unusedCmdLine 未使用のコマンドライン文字列。
+ * @param unusedCmdLine 未使用のコマンドライン文字列 (引数は CommandLineToArgvW で分割し直す)。
  * @param nCmdShow 表示コマンド。
  * @return プロセスの終了コード。
  */
@@ -79,34 +146,51 @@ int APIENTRY wWinMain(HINSTANCE hInst, HINSTANCE unusedPrevInst, LPWSTR unusedCm
         return -1;
 
     DxApp app;
-    if (!app.Init(hWnd, 1280, 720))
+    std::wstring replay;
+    auto device = std::make_unique<D3D11RenderDevice>();
+    if (!device->Init(hWnd, 1280, 720) ||
+        !app.Init(hWnd, std::move(device), 1280, 720, ParseCommandLineOverrides(replay)))
     {
         MessageBox(hWnd, L"Direct3D の初期化に失敗しました。", L"Error", MB_ICONERROR);
         return -1;
     }
+    if (!replay.empty() && !app.StartReplay(replay))
+    {
+        std::wstring msg = L"[Settings] Failed to open replay log: ";
+        msg.append(replay).append(L"\n");
+        OutputDebugStringW(msg.c_str());
+    }
     SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(&app));
 
     ShowWindow(hWnd, nCmdShow);
     UpdateWindow(hWnd);
 
+    // 溜まったメッセージを処理してから、スケジューラーが決めた時刻まで (メッセージが届けばそれまで) 待って描く。
+    // 描かない間もスレッドを眠らせるため、VSync を切っても CPU を使い切らない。
+    // Render.OnDemand では入力と設定の再読み込みがあったときだけ描き、入力の後は ImGui が落ち着くまで数フレーム描く
+    FrameScheduler& scheduler = app.Scheduler();
     MSG msg{};
     while (msg.message != WM_QUIT)
     {
         if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
         {
+            if (IsInputMessage(msg.message))
+                app.Invalidate();
             TranslateMessage(&msg);
             DispatchMessage(&msg);
+            continue;
         }
-        else
-        {
-            app.Render();
-        }
+        if (app.PollSettings())
+            app.Invalidate();
+        if (!scheduler.WaitForFrame())
+            continue;
+        scheduler.BeginFrame();
+        app.Render();
+        scheduler.EndFrame();
     }
 
-    // 終了処理は DxApp のデストラクタで十分
-    ImGui_ImplDX11_Shutdown();
-    ImGui_ImplWin32_Shutdown();
-    ImGui::DestroyContext();
+    // 提出待ちのフレームを描き切って描画スレッドを止めてから ImGui を破棄する。残りは DxApp のデストラクタで十分
+    app.Shutdown();
 
     return static_cast<int>(msg.wParam);
 }
@@ -0,0 +1,317 @@
+/**
+ * @file FrameSchedulerTest.cpp
+ * @brief 偽の時計で FrameScheduler のペーシング精度と描く契機を決定的に検証する単体試験。
+ * @author 山内陽
+ */
+
+#include "FrameScheduler.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+using namespace std::chrono_literals;
+
+/**
+ * @brief 待機すると時刻をその場で進める偽の時計。
+ * @details 待機の誤差 (タイマーの寝過ごし) と、待機中に届くイベントを再現できる。
+ */
+class FakeFrameClock : public FrameClock
+{
+public:
+    /**
+     * @brief 現在時刻を取得する。
+     * @return 偽の現在時刻。
+     */
+    TimePoint Now() override
+    {
+        return m_now;
+    }
+
+    /**
+     * @brief 期限まで時刻を進める。期限より前にイベントが予定されていればその時刻で止まる。
+     * @param deadline 待機の期限。
+     * @return 期限に達した場合は true、イベントで起こされた場合は false。
+     */
+    bool WaitUntil(TimePoint deadline) override
+    {
+        ++waits;
+        if (m_event != TimePoint{} && m_event < deadline)
+        {
+            m_now = (std::max)(m_now, m_event);
+            m_event = TimePoint{};
+            return false;
+        }
+        if (m_now < deadline)
+            m_now = deadline + oversleep;
+        return true;
+    }
+
+    /**
+     * @brief 処理に時間がかかったものとして時刻を進める。
+     * @param d 進める時間。
+     */
+    void Advance(Duration d)
+    {
+        m_now += d;
+    }
+
+    /**
+     * @brief 指定時間後にイベントが届くようにする。
+     * @param after 現在時刻からの時間。
+     */
+    void PostEvent(Duration after)
+    {
+        m_event = m_now + after;
+    }
+
+    Duration oversleep{0}; // 待機が期限を過ぎて戻る量 (タイマーの誤差)
+    uint64_t waits = 0;    // WaitUntil の呼び出し回数
+
+private:
+    TimePoint m_now{std::chrono::seconds(1)}; // 偽の現在時刻 (0 は未設定の予定時刻と区別できないため避ける)
+    TimePoint m_event{};                      // 次にイベントが届く時刻 (無ければ既定値)
+};
+
+/**
+ * @brief WaitForFrame が true を返すまで呼び、1 フレーム描いたものとして時刻を進める。
+ * @param scheduler 対象スケジューラー。
+ * @param clock 偽の時計。
+ * @param work フレームの処理時間。
+ * @return フレームの開始時刻。
+ */
+static FrameClock::TimePoint RunFrame(FrameScheduler& scheduler, FakeFrameClock& clock, FrameClock::Duration work)
+{
+    while (!scheduler.WaitForFrame())
+    {
+    }
+    const FrameClock::TimePoint start = clock.Now();
+    scheduler.BeginFrame();
+    clock.Advance(work);
+    scheduler.EndFrame();
+    return start;
+}
+
+/**
+ * @brief 周期 (ns) を求める。FrameScheduler と同じく四捨五入する。
+ * @param fps 1 秒あたりのフレーム数。
+ * @return 周期。
+ */
+static FrameClock::Duration PeriodOf(double fps)
+{
+    return FrameClock::Duration{static_cast<FrameClock::Duration::rep>(std::llround(1e9 / fps))};
+}
+
+/**
+ * @brief 目標フレームレートでは、各フレームが予定時刻ちょうどに始まり、長時間回しても誤差が蓄積しないことを確かめる。
+ */
+static void TestFixedRateHasNoDrift()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(60.0);
+    const FrameClock::Duration period = PeriodOf(60.0);
+
+    const FrameClock::TimePoint first = RunFrame(scheduler, clock, 5ms);
+    constexpr int kFrames = 3600;
+    FrameClock::TimePoint last = first;
+    for (int i = 1; i <= kFrames; ++i)
+    {
+        last = RunFrame(scheduler, clock, 5ms);
+        CHECK(last - first == period * i);
+    }
+    const FrameStats stats = scheduler.Stats();
+    CHECK(std::fabs(stats.fps - 60.0f) < 0.01f);
+    CHECK(stats.maxJitterMs == 0.0f);
+    CHECK(std::fabs(stats.cpuMs - 5.0f) < 1e-3f);
+    CHECK(std::fabs(stats.waitMs - (1000.0f / 60.0f - 5.0f)) < 1e-3f);
+}
+
+/**
+ * @brief 待機が毎回寝過ごしても、次の予定は前の予定時刻から数えるため、ずれが蓄積しないことを確かめる。
+ */
+static void TestOversleepDoesNotAccumulate()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(144.0);
+    const FrameClock::Duration period = PeriodOf(144.0);
+
+    const FrameClock::TimePoint first = RunFrame(scheduler, clock, 1ms);
+    clock.oversleep = 300us;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        const FrameClock::TimePoint start = RunFrame(scheduler, clock, 1ms);
+        // 各フレームは予定時刻から寝過ごした分だけ遅れるが、遅れはフレームをまたいで増えない
+        CHECK(start - first == period * i + clock.oversleep);
+    }
+    const FrameStats stats = scheduler.Stats();
+    CHECK(std::fabs(stats.jitterMs - 0.3f) < 1e-3f);
+    CHECK(std::fabs(stats.fps - 144.0f) < 0.01f);
+}
+
+/**
+ * @brief 1 周期以上遅れたフレームの後は遅れを取り戻そうと連続で描かず、現在時刻から数え直すことを確かめる。
+ */
+static void TestLongFrameResetsSchedule()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(60.0);
+    const FrameClock::Duration period = PeriodOf(60.0);
+
+    RunFrame(scheduler, clock, 2ms);
+    const FrameClock::TimePoint hitch = RunFrame(scheduler, clock, 50ms);
+    const FrameClock::TimePoint after = RunFrame(scheduler, clock, 2ms);
+    CHECK(after == hitch + 50ms);
+    const FrameClock::TimePoint next = RunFrame(scheduler, clock, 2ms);
+    CHECK(next - after == period);
+}
+
+/**
+ * @brief 目標フレームレートが無ければ待機しないことを確かめる。
+ */
+static void TestUncappedNeverWaits()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(0.0);
+    for (int i = 0; i < 100; ++i)
+        RunFrame(scheduler, clock, 3ms);
+    CHECK(clock.waits == 0);
+    CHECK(std::fabs(scheduler.Stats().fps - 1000.0f / 3.0f) < 0.1f);
+}
+
+/**
+ * @brief 最小化中・隠れている間はバックグラウンドのフレームレートへ落ち、戻れば目標フレームレートに戻ることを確かめる。
+ */
+static void TestThrottledUsesBackgroundRate()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(240.0);
+    scheduler.SetBackgroundFps(10.0);
+
+    RunFrame(scheduler, clock, 1ms);
+    scheduler.SetMinimized(true);
+    CHECK(scheduler.Throttled());
+    FrameClock::TimePoint prev = RunFrame(scheduler, clock, 1ms);
+    for (int i = 0; i < 5; ++i)
+    {
+        const FrameClock::TimePoint start = RunFrame(scheduler, clock, 1ms);
+        CHECK(start - prev == PeriodOf(10.0));
+        prev = start;
+    }
+
+    scheduler.SetMinimized(false);
+    scheduler.SetOccluded(true);
+    CHECK(scheduler.Throttled());
+    scheduler.SetOccluded(false);
+    CHECK(!scheduler.Throttled());
+    RunFrame(scheduler, clock, 1ms);
+    prev = RunFrame(scheduler, clock, 1ms);
+    const FrameClock::TimePoint start = RunFrame(scheduler, clock, 1ms);
+    CHECK(start - prev == PeriodOf(240.0));
+
+    // バックグラウンドの方が速い設定なら目標フレームレートを超えない
+    scheduler.SetBackgroundFps(1000.0);
+    scheduler.SetMinimized(true);
+    prev = RunFrame(scheduler, clock, 1ms);
+    CHECK(RunFrame(scheduler, clock, 1ms) - prev == PeriodOf(240.0));
+}
+
+/**
+ * @brief OnDemand では要求されたフレームだけ描き、それ以外は起床間隔ごとに描かずに戻ることを確かめる。
+ */
+static void TestOnDemand()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(60.0);
+    scheduler.SetIdleWakeInterval(50ms);
+    scheduler.SetMode(FrameMode::OnDemand);
+
+    // 切り替え直後の 1 フレーム
+    CHECK(scheduler.WaitForFrame());
+    scheduler.BeginFrame();
+    scheduler.EndFrame();
+
+    const FrameClock::TimePoint idleStart = clock.Now();
+    for (int i = 0; i < 4; ++i)
+        CHECK(!scheduler.WaitForFrame());
+    CHECK(clock.Now() - idleStart == 200ms);
+    CHECK(scheduler.Stats().idleWakes == 4);
+    CHECK(scheduler.Stats().frames == 1);
+
+    scheduler.Invalidate(2);
+    scheduler.Invalidate(1);
+    RunFrame(scheduler, clock, 1ms);
+    RunFrame(scheduler, clock, 1ms);
+    CHECK(scheduler.Stats().frames == 3);
+    CHECK(!scheduler.WaitForFrame());
+    CHECK(scheduler.Stats().frames == 3);
+
+    // Continuous では Invalidate は何もしない
+    scheduler.SetMode(FrameMode::Continuous);
+    scheduler.Invalidate(5);
+    RunFrame(scheduler, clock, 1ms);
+    CHECK(scheduler.WaitForFrame());
+}
+
+/**
+ * @brief 待機中にイベントが届けば描かずに戻り、次の呼び出しで元の予定時刻まで待ち直すことを確かめる。
+ */
+static void TestEventInterruptsWait()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(60.0);
+    const FrameClock::TimePoint first = RunFrame(scheduler, clock, 1ms);
+
+    clock.PostEvent(5ms);
+    CHECK(!scheduler.WaitForFrame());
+    CHECK(clock.Now() == first + 6ms);
+    CHECK(scheduler.WaitForFrame());
+    CHECK(clock.Now() == first + PeriodOf(60.0));
+
+    // OnDemand の待機も同様に中断され、起床回数には数えない
+    scheduler.SetMode(FrameMode::OnDemand);
+    RunFrame(scheduler, clock, 1ms);
+    clock.PostEvent(10ms);
+    CHECK(!scheduler.WaitForFrame());
+    CHECK(scheduler.Stats().idleWakes == 0);
+}
+
+/**
+ * @brief 計測値の履歴が保持数を超えても最新のものから引けることを確かめる。
+ */
+static void TestTimingHistory()
+{
+    FakeFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.SetTargetFps(0.0);
+    for (size_t i = 0; i < FrameScheduler::kHistory + 10; ++i)
+        RunFrame(scheduler, clock, std::chrono::milliseconds(1 + i % 4));
+    CHECK(scheduler.TimingCount() == FrameScheduler::kHistory);
+    CHECK(std::fabs(scheduler.Timing(0).cpuMs - static_cast<float>(1 + (FrameScheduler::kHistory + 9) % 4)) < 1e-3f);
+    CHECK(std::fabs(scheduler.Timing(1).cpuMs - static_cast<float>(1 + (FrameScheduler::kHistory + 8) % 4)) < 1e-3f);
+}
+
+/**
+ * @brief エントリーポイント。
+ * @return いずれかの検査に失敗すれば 1。
+ */
+int main()
+{
+    TestFixedRateHasNoDrift();
+    TestOversleepDoesNotAccumulate();
+    TestLongFrameResetsSchedule();
+    TestUncappedNeverWaits();
+    TestThrottledUsesBackgroundRate();
+    TestOnDemand();
+    TestEventInterruptsWait();
+    TestTimingHistory();
+    return TestExitCode();
+}
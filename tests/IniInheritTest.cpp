@@ -0,0 +1,103 @@
+/**
+ * @file IniInheritTest.cpp
+ * @brief "[Section : Base]" の継承が、継承元で参照時に勝つ値 (同じキーの最後の値) を引き継ぐことを確かめる回帰試験。
+ * @author 山内陽
+ */
+
+#include "AsyncFileWriter.h"
+#include "Settings.h"
+#include "TestUtil.h"
+
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+/**
+ * @brief 作業ディレクトリにファイルを書き出す。
+ * @param path 書き出し先。
+ * @param text ファイル内容。
+ */
+static void WriteFile(const std::filesystem::path& path, std::string_view text)
+{
+    CHECK(AsyncFileWriter::WriteAtomically(path, text));
+}
+
+/**
+ * @brief 同じファイル内で継承元に同じキーが 2 回現れる場合、継承先も後の値を引き継ぐことを確かめる。
+ * @param dir 作業ディレクトリ。
+ */
+static void TestDuplicateKeyInSameFile(const std::filesystem::path& dir)
+{
+    const std::filesystem::path path = dir / "duplicate.ini";
+    WriteFile(path, "[A]\n"
+                    "x=1\n"
+                    "x=2\n"
+                    "y=3\n"
+                    "[B : A]\n"
+                    "y=4\n");
+    Settings settings;
+    CHECK(settings.Load(path.wstring()));
+    CHECK(settings.GetInt("A", "x", 0) == 2);
+    CHECK(settings.GetInt("B", "x", 0) == 2);
+    // 継承先自身の値は継承元の値より優先する
+    CHECK(settings.GetInt("B", "y", 0) == 4);
+}
+
+/**
+ * @brief 取り込んだファイルの値をファイル自身が上書きした場合、継承先も上書き後の値を引き継ぐことを確かめる。
+ * @param dir 作業ディレクトリ。
+ */
+static void TestIncludeOverriddenThenInherited(const std::filesystem::path& dir)
+{
+    WriteFile(dir / "common.ini", "[Render]\n"
+                                  "MaxFps=60\n"
+                                  "VSync=1\n");
+    const std::filesystem::path path = dir / "main.ini";
+    WriteFile(path, "@include common.ini\n"
+                    "[Render]\n"
+                    "MaxFps=120\n"
+                    "[Boss : Render]\n");
+    Settings settings;
+    CHECK(settings.Load(path.wstring()));
+    CHECK(settings.GetInt("Render", "MaxFps", 0) == 120);
+    CHECK(settings.GetInt("Boss", "MaxFps", 0) == 120);
+    CHECK(settings.GetInt("Boss", "VSync", 0) == 1);
+}
+
+/**
+ * @brief 多段の継承でも、中間のセクションで勝つ値が末端まで引き継がれることを確かめる。
+ * @param dir 作業ディレクトリ。
+ */
+static void TestChainedInherit(const std::filesystem::path& dir)
+{
+    const std::filesystem::path path = dir / "chain.ini";
+    WriteFile(path, "[C : B]\n"
+                    "[A]\n"
+                    "x=1\n"
+                    "[B : A]\n"
+                    "[A]\n"
+                    "x=5\n");
+    Settings settings;
+    CHECK(settings.Load(path.wstring()));
+    CHECK(settings.GetInt("B", "x", 0) == 5);
+    CHECK(settings.GetInt("C", "x", 0) == 5);
+}
+
+/**
+ * @brief エントリーポイント。
+ * @return いずれかの検査に失敗すれば 1。
+ */
+int main()
+{
+    std::error_code ec;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "IniInheritTest";
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+
+    TestDuplicateKeyInSameFile(dir);
+    TestIncludeOverriddenThenInherited(dir);
+    TestChainedInherit(dir);
+
+    std::filesystem::remove_all(dir, ec);
+    return TestExitCode();
+}
@@ -0,0 +1,126 @@
+/**
+ * @file IniTableTest.cpp
+ * @brief IniTable がセクションの見出しとキー行を ParseIni と同じ規則で引くことを確かめる単体試験。
+ * @author 山内陽
+ */
+
+#include "AsyncFileWriter.h"
+#include "IniTable.h"
+#include "TestUtil.h"
+
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+/**
+ * @brief 作業ディレクトリにファイルを書き出して開く。
+ * @param table 開く表。
+ * @param path 書き出し先。
+ * @param text ファイル内容。
+ */
+static void OpenText(IniTable& table, const std::filesystem::path& path, std::string_view text)
+{
+    CHECK(AsyncFileWriter::WriteAtomically(path, text));
+    CHECK(table.Open(path));
+}
+
+/**
+ * @brief "[Section : Base]" の見出しが Section として登録され、継承元のキーは補われないことを確かめる。
+ * @param dir 作業ディレクトリ。
+ */
+static void TestInheritHeader(const std::filesystem::path& dir)
+{
+    IniTable table;
+    OpenText(table, dir / "inherit.ini",
+             "[A]\n"
+             "x=1\n"
+             "[E : A]\n"
+             "y=2\n"
+             "[ F:A ] ; comment\n"
+             "z=3\n");
+    CHECK(table.SectionCount() == 3);
+    CHECK(table.FindSection("E : A") == IniTable::kNoSection);
+    CHECK(table.Get("E", "y") == std::string_view("2"));
+    CHECK(!table.Get("E", "x"));
+    CHECK(table.Get("F", "z") == std::string_view("3"));
+    table.Close();
+}
+
+/**
+ * @brief 同名のセクションを 1 つにまとめ、同じキーは後勝ちとすることを確かめる。
+ * @param dir 作業ディレクトリ。
+ */
+static void TestMergedSections(const std::filesystem::path& dir)
+{
+    IniTable table;
+    OpenText(table, dir / "merged.ini",
+             "[A]\n"
+             "x=1\n"
+             "[B]\n"
+             "x=2\n"
+             "[A : B]\n"
+             "x=3\n"
+             "y=4\n");
+    CHECK(table.SectionCount() == 2);
+    CHECK(table.Get("A", "x") == std::string_view("3"));
+    const uint32_t a = table.FindSection("A");
+    CHECK(table.KeyCount(a) == 2);
+    CHECK(table.KeyAt(a, 0) == "x" && table.ValueAt(a, 1) == "4");
+    table.Close();
+}
+
+/**
+ * @brief 最初の見出しより前にキー行がある場合だけ "Default" セクションを作ることを確かめる。
+ * @param dir 作業ディレクトリ。
+ */
+static void TestDefaultSection(const std::filesystem::path& dir)
+{
+    IniTable table;
+    // コメントや "@" 指令の '=' ではキー行にならない
+    OpenText(table, dir / "comment.ini",
+             "; a = b\n"
+             "# c=d\n"
+             "@include x=y.ini\n"
+             "[A]\n"
+             "x=1\n");
+    CHECK(table.SectionCount() == 1);
+    CHECK(table.FindSection("Default") == IniTable::kNoSection);
+    table.Close();
+
+    OpenText(table, dir / "commentonly.ini", "; a = b\n");
+    CHECK(table.SectionCount() == 0);
+    table.Close();
+
+    OpenText(table, dir / "preamble.ini",
+             "; header comment\n"
+             "  key = value ; trailing\n"
+             "[A]\n"
+             "x=1\n");
+    CHECK(table.SectionCount() == 2);
+    CHECK(table.Get("Default", "key") == std::string_view("value"));
+    table.Close();
+
+    OpenText(table, dir / "noheader.ini", "key=value\n");
+    CHECK(table.SectionCount() == 1);
+    CHECK(table.Get("Default", "key") == std::string_view("value"));
+    table.Close();
+}
+
+/**
+ * @brief エントリーポイント。
+ * @return いずれかの検査に失敗すれば 1。
+ */
+int main()
+{
+    std::error_code ec;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "IniTableTest";
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+
+    TestInheritHeader(dir);
+    TestMergedSections(dir);
+    TestDefaultSection(dir);
+
+    std::filesystem::remove_all(dir, ec);
+    return TestExitCode();
+}
@@ -0,0 +1,141 @@
+/**
+ * @file NumberConversionBenchmark.cpp
+ * @brief 設定値の数値変換の毎秒変換数を、以前の std::stod / std::to_string による変換と比べて計測するベンチマーク。
+ * @author 山内陽
+ */
+
+#include "IniArray.h"
+#include "IniParser.h"
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 以前の Settings::GetDouble と同じく std::stod を例外捕捉で包んで解釈する。
+ * @param s 値文字列。
+ * @param def 解釈できない場合の既定値。
+ * @return 解釈した値、または既定値。
+ */
+static double LegacyGetDouble(const std::string& s, double def)
+{
+    try
+    {
+        return std::stod(s);
+    }
+    catch (...)
+    {
+        return def;
+    }
+}
+
+/**
+ * @brief 計測結果を 1 行で表示する。
+ * @param name 計測対象の名前。
+ * @param count 変換回数。
+ * @param seconds 所要時間 (秒)。
+ */
+static void Report(const char* name, size_t count, double seconds)
+{
+    std::printf("%-28s %10.1f M/s\n", name, count / seconds / 1e6);
+}
+
+/**
+ * @brief エントリーポイント。設定ファイルに現れる程度の値 (0〜1 の係数、ミリ秒、角度など) で変換を計測する。
+ * @param argc 引数の数。
+ * @param argv 引数 (argv[1] は 1 回の計測で変換する値の数。既定は 200000)。
+ * @return 常に 0 (計測のみ)。
+ */
+int main(int argc, char** argv)
+{
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<int> ms(0, 2000);
+    std::vector<double> values(count);
+    for (size_t i = 0; i < count; ++i)
+        values[i] = (i % 3 == 0) ? unit(rng) : (i % 3 == 1) ? ms(rng) : unit(rng) * 360.0 - 180.0;
+
+    // 解析の入力は現在の書式で作る (以前の書式では精度が落ちて公平でない)
+    std::vector<std::string> texts(count);
+    for (size_t i = 0; i < count; ++i)
+        texts[i] = std::string(FormatIniNumber(values[i]).View());
+
+    const double legacyParse = MeasureBest(3, [&] {
+        double sum = 0.0;
+        for (const std::string& s : texts)
+            sum += LegacyGetDouble(s, 0.0);
+        Consume(static_cast<uint64_t>(sum));
+    });
+    const double parse = MeasureBest(3, [&] {
+        double sum = 0.0;
+        for (const std::string& s : texts)
+        {
+            double v = 0.0;
+            ParseIniNumber(s, v);
+            sum += v;
+        }
+        Consume(static_cast<uint64_t>(sum));
+    });
+    const double legacyFormat = MeasureBest(3, [&] {
+        size_t chars = 0;
+        for (double v : values)
+            chars += std::to_string(v).size();
+        Consume(chars);
+    });
+    const double format = MeasureBest(3, [&] {
+        size_t chars = 0;
+        for (double v : values)
+            chars += FormatIniNumber(v).size;
+        Consume(chars);
+    });
+
+    // 配列値 (RGBA など 4 要素) の変換
+    std::vector<float> floats(count);
+    for (size_t i = 0; i < count; ++i)
+        floats[i] = static_cast<float>(values[i]);
+    std::string joined;
+    const size_t arrays = count / 4;
+    std::vector<std::string> arrayTexts(arrays);
+    for (size_t i = 0; i < arrays; ++i)
+        AppendIniFloats(&floats[i * 4], 4, arrayTexts[i]);
+    const double arrayParse = MeasureBest(3, [&] {
+        float out[4];
+        float sum = 0.0f;
+        for (const std::string& s : arrayTexts)
+        {
+            ParseIniFloats(s, out, 4);
+            sum += out[0] + out[3];
+        }
+        Consume(static_cast<uint64_t>(sum));
+    });
+    const double arrayFormat = MeasureBest(3, [&] {
+        size_t chars = 0;
+        for (size_t i = 0; i < arrays; ++i)
+        {
+            joined.clear();
+            AppendIniFloats(&floats[i * 4], 4, joined);
+            chars += joined.size();
+        }
+        Consume(chars);
+    });
+
+    // 以前の書式は小数点以下 6 桁に丸めるため、読み戻すと値が変わる
+    size_t lossy = 0;
+    for (double v : values)
+        lossy += LegacyGetDouble(std::to_string(v), 0.0) != v;
+
+    std::printf("values: %zu\n", count);
+    Report("parse  std::stod", count, legacyParse);
+    Report("parse  ParseIniNumber", count, parse);
+    Report("format std::to_string", count, legacyFormat);
+    Report("format FormatIniNumber", count, format);
+    Report("parse  ParseIniFloats x4", arrays * 4, arrayParse);
+    Report("format AppendIniFloats x4", arrays * 4, arrayFormat);
+    std::printf("std::to_string round trip lost precision on %zu of %zu values\n", lossy, count);
+    return 0;
+}
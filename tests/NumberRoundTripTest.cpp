@@ -0,0 +1,230 @@
+/**
+ * @file NumberRoundTripTest.cpp
+ * @brief 設定値の数値変換 (ParseIniNumber / FormatIniNumber と配列版) が値を失わずに往復することを確かめる性質試験。
+ * @author 山内陽
+ */
+
+#include "IniArray.h"
+#include "IniParser.h"
+#include "TestUtil.h"
+
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <system_error>
+
+/**
+ * @brief ビット表現が同じか判定する (NaN 同士や 0 と -0 の区別も含めて比べる)。
+ * @param a 比較する値。
+ * @param b 比較する値。
+ * @return ビット表現が同じなら true。NaN は符号だけを比べる。
+ */
+template <typename T>
+static bool SameValue(T a, T b)
+{
+    if (std::isnan(a) || std::isnan(b))
+        return std::isnan(a) && std::isnan(b) && std::signbit(a) == std::signbit(b);
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+/**
+ * @brief 任意のビット列から作った double (非正規化数・無限大・NaN を含む) が書式化・解析で元に戻ることを確かめる。
+ * @param rng 乱数生成器。
+ * @param iterations 試行回数。
+ */
+static void TestDoubleRoundTrip(std::mt19937_64& rng, int iterations)
+{
+    int failures = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        const uint64_t bits = rng();
+        double v = 0.0;
+        std::memcpy(&v, &bits, sizeof(v));
+        const IniNumberText t = FormatIniNumber(v);
+        double back = 0.0;
+        if (t.size == 0 || ParseIniNumber(t.View(), back) != std::errc{} || !SameValue(v, back))
+        {
+            if (++failures <= 5)
+                std::fprintf(stderr, "double round trip failed: %.17g -> '%.*s'\n", v, static_cast<int>(t.size),
+                             t.data);
+        }
+    }
+    CHECK(failures == 0);
+}
+
+/**
+ * @brief 任意のビット列から作った有限の float が、float 用の書式化と解析で元に戻ることを確かめる。
+ * @details float の設定値の読み込みと同じく、ParseIniNumber で double として読んでから float へ丸める。
+ * @param rng 乱数生成器。
+ * @param iterations 試行回数。
+ */
+static void TestFloatRoundTrip(std::mt19937_64& rng, int iterations)
+{
+    int failures = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        const uint32_t bits = static_cast<uint32_t>(rng());
+        float v = 0.0f;
+        std::memcpy(&v, &bits, sizeof(v));
+        if (!std::isfinite(v))
+            continue;
+        const IniNumberText t = FormatIniNumber(v);
+        double back = 0.0;
+        if (t.size == 0 || ParseIniNumber(t.View(), back) != std::errc{} || !SameValue(v, static_cast<float>(back)))
+        {
+            if (++failures <= 5)
+                std::fprintf(stderr, "float round trip failed: %.9g -> '%.*s'\n", v, static_cast<int>(t.size), t.data);
+        }
+    }
+    CHECK(failures == 0);
+}
+
+/**
+ * @brief 任意の長さ・値の float 配列と int 配列が、追記と解析で元に戻ることを確かめる。
+ * @details 長さは SIMD で一括変換する幅をまたぐよう 0〜40 要素とし、値は単純な十進表記になるものと
+ *          任意のビット列から作るもの (指数表記になるもの) を混ぜる。
+ * @param rng 乱数生成器。
+ * @param iterations 試行回数。
+ */
+static void TestArrayRoundTrip(std::mt19937_64& rng, int iterations)
+{
+    std::uniform_int_distribution<int> length(0, 40);
+    std::uniform_int_distribution<int> digits(0, 1000000);
+    std::uniform_int_distribution<int> anyInt(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    int failures = 0;
+    std::string text;
+    float floats[40];
+    float floatsBack[40];
+    int ints[40];
+    int intsBack[40];
+    for (int i = 0; i < iterations; ++i)
+    {
+        const size_t n = static_cast<size_t>(length(rng));
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (rng() & 1)
+            {
+                floats[k] = static_cast<float>(digits(rng)) / 1000.0f * ((rng() & 1) ? 1.0f : -1.0f);
+            }
+            else
+            {
+                const uint32_t bits = static_cast<uint32_t>(rng());
+                std::memcpy(&floats[k], &bits, sizeof(float));
+                if (!std::isfinite(floats[k]))
+                    floats[k] = 0.0f;
+            }
+            ints[k] = anyInt(rng);
+        }
+
+        text.clear();
+        AppendIniFloats(floats, n, text);
+        bool ok = CountIniValues(text) == n || (n == 0 && text.empty());
+        if (n > 0)
+        {
+            ok = ok && ParseIniFloats(text, floatsBack, n) == std::errc{};
+            for (size_t k = 0; ok && k < n; ++k)
+                ok = SameValue(floats[k], floatsBack[k]);
+        }
+
+        text.clear();
+        AppendIniInts(ints, n, text);
+        if (n > 0)
+        {
+            ok = ok && ParseIniInts(text, intsBack, n) == std::errc{};
+            ok = ok && std::memcmp(ints, intsBack, n * sizeof(int)) == 0;
+        }
+        if (!ok && ++failures <= 5)
+            std::fprintf(stderr, "array round trip failed: '%s'\n", text.c_str());
+    }
+    CHECK(failures == 0);
+}
+
+/**
+ * @brief 代表的な値の表記と、不正な入力がエラーコードで報告されることを確かめる。
+ */
+static void TestEdgeCases()
+{
+    CHECK(FormatIniNumber(0.1).View() == "0.1");
+    CHECK(FormatIniNumber(2.0).View() == "2");
+    CHECK(FormatIniNumber(0.1f).View() == "0.1");
+    CHECK(FormatIniNumber(-0.0).View() == "-0");
+    CHECK(FormatIniNumber(std::numeric_limits<int>::min()).View() == "-2147483648");
+
+    double v = 42.0;
+    CHECK(ParseIniNumber("+1.5", v) == std::errc{} && v == 1.5);
+    CHECK(ParseIniNumber("-1e-3", v) == std::errc{} && v == -1e-3);
+    v = 42.0;
+    CHECK(ParseIniNumber("", v) == std::errc::invalid_argument);
+    CHECK(ParseIniNumber("+", v) == std::errc::invalid_argument);
+    CHECK(ParseIniNumber("+-1", v) == std::errc::invalid_argument);
+    CHECK(ParseIniNumber("1.5abc", v) == std::errc::invalid_argument);
+    CHECK(ParseIniNumber("abc", v) == std::errc::invalid_argument);
+    CHECK(ParseIniNumber("1,5", v) == std::errc::invalid_argument);
+    CHECK(ParseIniNumber("1e400", v) == std::errc::result_out_of_range);
+    // 失敗時は格納先を変更しない
+    CHECK(v == 42.0);
+
+    float f[3] = {};
+    CHECK(ParseIniFloats(" 1 , 0.5,0.25 ", f, 3) == std::errc{} && f[0] == 1.0f && f[1] == 0.5f && f[2] == 0.25f);
+    CHECK(ParseIniFloats("1,0.5", f, 3) != std::errc{});
+    CHECK(ParseIniFloats("1,x,0.25", f, 3) == std::errc::invalid_argument);
+    CHECK(ParseIniFloats("1,1e39,0.25", f, 3) == std::errc::result_out_of_range);
+}
+
+/**
+ * @brief 小数点にカンマを使うロケールでも表記と解析が変わらないことを確かめる。
+ * @details 該当ロケールが導入されていない環境では何もしない。
+ */
+static void TestLocaleIndependence()
+{
+    const char* locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "German_Germany.1252"};
+    const char* applied = nullptr;
+    for (const char* name : locales)
+    {
+        if (std::setlocale(LC_ALL, name))
+        {
+            applied = name;
+            break;
+        }
+    }
+    if (!applied)
+    {
+        std::printf("locale test skipped (no decimal-comma locale installed)\n");
+        return;
+    }
+
+    double v = 0.0;
+    CHECK(FormatIniNumber(0.5).View() == "0.5");
+    CHECK(ParseIniNumber("0.5", v) == std::errc{} && v == 0.5);
+    std::string text;
+    const float f[2] = {0.5f, 1.25f};
+    AppendIniFloats(f, 2, text);
+    CHECK(text == "0.5,1.25");
+    std::setlocale(LC_ALL, "C");
+}
+
+/**
+ * @brief エントリーポイント。
+ * @param argc 引数の数。
+ * @param argv 引数 (argv[1] は乱数の種。既定は固定値)。
+ * @return いずれかの検査に失敗すれば 1。
+ */
+int main(int argc, char** argv)
+{
+    const uint64_t seed = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20240601u;
+    std::printf("seed: %llu\n", static_cast<unsigned long long>(seed));
+    std::mt19937_64 rng(seed);
+
+    TestEdgeCases();
+    TestDoubleRoundTrip(rng, 200000);
+    TestFloatRoundTrip(rng, 200000);
+    TestArrayRoundTrip(rng, 20000);
+    TestLocaleIndependence();
+    return TestExitCode();
+}
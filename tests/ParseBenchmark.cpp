@@ -0,0 +1,169 @@
+/**
+ * @file ParseBenchmark.cpp
+ * @brief INI 解析のスループット (MB/s) を、以前の行コピー方式の解析と比べて計測するベンチマーク。
+ * @author 山内陽
+ */
+
+#include "IniParser.h"
+#include "Settings.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 以前の Settings::Parse が構築していたカテゴリ別のキー・値テーブル。
+ */
+using LegacyTable = std::unordered_map<std::string, std::unordered_map<std::string, std::string>>;
+
+/**
+ * @brief 文字列の前後空白を取り除く (以前の実装と同じ処理)。
+ * @param s 処理対象の文字列。
+ */
+static void LegacyTrim(std::string& s)
+{
+    auto issp = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [&](char c) { return !issp(c); }));
+    s.erase(std::find_if(s.rbegin(), s.rend(), [&](char c) { return !issp(c); }).base(), s.end());
+}
+
+/**
+ * @brief 以前の実装と同じく istringstream と getline で 1 行ずつコピーしながら解析する。
+ * @param text 解析対象のテキスト。
+ * @param data 解析結果 (事前にクリアされる)。
+ */
+static void LegacyParse(const std::string& text, LegacyTable& data)
+{
+    data.clear();
+    std::istringstream iss(text);
+    std::string line;
+    std::string currentCat = "Default";
+    while (std::getline(iss, line))
+    {
+        auto semi = line.find(';');
+        if (semi != std::string::npos)
+            line.erase(semi);
+        auto hash = line.find('#');
+        if (hash != std::string::npos)
+            line.erase(hash);
+
+        LegacyTrim(line);
+        if (line.empty())
+            continue;
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            currentCat = line.substr(1, line.size() - 2);
+            LegacyTrim(currentCat);
+            continue;
+        }
+
+        auto eq = line.find('=');
+        if (eq == std::string::npos)
+            continue;
+
+        std::string key = line.substr(0, eq);
+        std::string val = line.substr(eq + 1);
+        LegacyTrim(key);
+        LegacyTrim(val);
+        data[currentCat][key] = val;
+    }
+}
+
+/**
+ * @brief 実際の settings.ini に近い構成 (見出し・コメント・空行・数値や配列の値) のテキストを生成する。
+ * @param bytes 目安のサイズ。
+ * @param keys 生成したキーの数。
+ * @return 生成したテキスト。
+ */
+static std::string MakeIniText(size_t bytes, size_t& keys)
+{
+    std::string text;
+    text.reserve(bytes + 256);
+    keys = 0;
+    char line[128];
+    for (int section = 0; text.size() < bytes; ++section)
+    {
+        std::snprintf(line, sizeof(line), "; section %d\n[Section%d]\n", section, section);
+        text += line;
+        for (int i = 0; i < 32; ++i, ++keys)
+        {
+            if (i % 3 == 0)
+                std::snprintf(line, sizeof(line), "Color%d = 0.%d, 0.25, 1, 1 ; RGBA\n", i, section % 10);
+            else if (i % 3 == 1)
+                std::snprintf(line, sizeof(line), "  IntervalMs%d=%d\n", i, section * 7 + i);
+            else
+                std::snprintf(line, sizeof(line), "Name%d = value_%d_%d\n", i, section, i);
+            text += line;
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+/**
+ * @brief 計測結果を 1 行で表示する。
+ * @param name 計測対象の名前。
+ * @param bytes 解析したバイト数。
+ * @param seconds 所要時間 (秒)。
+ */
+static void Report(const char* name, size_t bytes, double seconds)
+{
+    std::printf("%-24s %8.2f ms %10.1f MB/s\n", name, seconds * 1000.0, bytes / seconds / (1024.0 * 1024.0));
+}
+
+/**
+ * @brief エントリーポイント。生成したテキストで解析結果を照合してから各方式を計測する。
+ * @param argc 引数の数。
+ * @param argv 引数 (argv[1] は生成するテキストの目安サイズ (MB)。既定は 8)。
+ * @return 解析結果が以前の方式と食い違えば 1。
+ */
+int main(int argc, char** argv)
+{
+    const double megabytes = argc > 1 ? std::atof(argv[1]) : 8.0;
+    size_t keys = 0;
+    const std::string text = MakeIniText(static_cast<size_t>((std::max)(megabytes, 0.01) * 1024 * 1024), keys);
+    std::printf("input: %zu bytes, %zu keys\n", text.size(), keys);
+
+    // 解析結果が一致することを確かめてから計測する
+    std::vector<IniEntry> entries;
+    ParseIni(text, entries);
+    LegacyTable legacy;
+    LegacyParse(text, legacy);
+    CHECK(entries.size() == keys);
+    for (const IniEntry& e : entries)
+    {
+        const auto cat = legacy.find(std::string(SpanView(text, e.section)));
+        CHECK(cat != legacy.end());
+        if (cat == legacy.end())
+            break;
+        const auto kv = cat->second.find(std::string(SpanView(text, e.key)));
+        CHECK(kv != cat->second.end() && kv->second == SpanView(text, e.value));
+    }
+
+    const double legacySeconds = MeasureBest(3, [&] {
+        LegacyParse(text, legacy);
+        Consume(legacy.size());
+    });
+    const double scanSeconds = MeasureBest(5, [&] {
+        ParseIni(text, entries);
+        Consume(entries.size());
+    });
+    Settings settings;
+    const double loadSeconds = MeasureBest(3, [&] {
+        settings.SetLayerText(0, text);
+        Consume(settings.ChangedKeys().size());
+    });
+
+    Report("legacy getline", text.size(), legacySeconds);
+    Report("ParseIni", text.size(), scanSeconds);
+    Report("Settings::SetLayerText", text.size(), loadSeconds);
+    std::printf("ParseIni speedup: %.1fx\n", legacySeconds / scanSeconds);
+    return TestExitCode();
+}
@@ -0,0 +1,156 @@
+/**
+ * @file PipelineBenchmark.cpp
+ * @brief SpscQueue と FramePipeline の受け渡し性能を、描画を伴わない提出処理で計測するベンチマーク。
+ * @author 山内陽
+ */
+
+#include "FramePipeline.h"
+#include "SpscQueue.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief 指定時間だけ CPU を使って回る (更新・提出の処理時間の代わり)。
+ * @param d 回る時間。
+ */
+static void Spin(std::chrono::microseconds d)
+{
+    const auto end = Clock::now() + d;
+    while (Clock::now() < end)
+    {
+    }
+}
+
+/**
+ * @brief 生産者と消費者のスレッドで値を受け渡し、1 秒あたりの受け渡し数を求める。
+ * @param count 受け渡す値の数。
+ * @return 1 秒あたりの受け渡し数。
+ */
+static double MeasureQueue(uint64_t count)
+{
+    SpscQueue<uint64_t, 1024> queue;
+    uint64_t sum = 0;
+    const auto t0 = Clock::now();
+    std::thread consumer([&] {
+        uint64_t v = 0;
+        for (uint64_t received = 0; received < count;)
+        {
+            if (queue.TryPop(v))
+            {
+                sum += v;
+                ++received;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (uint64_t i = 0; i < count;)
+    {
+        uint64_t v = i;
+        if (queue.TryPush(std::move(v)))
+            ++i;
+        else
+            std::this_thread::yield();
+    }
+    consumer.join();
+    const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    CHECK(sum == count * (count - 1) / 2);
+    return count / seconds;
+}
+
+/**
+ * @brief 更新段と提出段にそれぞれ処理時間を与えてパイプラインを回し、1 秒あたりのフレーム数を求める。
+ * @param frames フレーム数。
+ * @param update 更新段の 1 フレームの処理時間。
+ * @param submit 提出段の 1 フレームの処理時間。
+ * @param stats 終了時の統計。
+ * @return 1 秒あたりのフレーム数。
+ */
+static double MeasurePipeline(uint64_t frames, std::chrono::microseconds update, std::chrono::microseconds submit,
+                              FramePipelineStats& stats)
+{
+    FramePipeline pipeline;
+    uint64_t expected = 0;
+    uint64_t outOfOrder = 0;
+    pipeline.Start([&](FramePacket& packet) {
+        outOfOrder += packet.index != expected++;
+        Spin(submit);
+    });
+
+    const auto t0 = Clock::now();
+    for (uint64_t i = 0; i < frames;)
+    {
+        FramePacket* packet = pipeline.Acquire(std::chrono::milliseconds(100));
+        if (!packet)
+            continue;
+        Spin(update);
+        packet->index = i++;
+        packet->published = Clock::now();
+        pipeline.Publish(packet);
+    }
+    pipeline.Stop();
+    const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    stats = pipeline.Stats();
+    CHECK(outOfOrder == 0);
+    CHECK(stats.published == frames);
+    CHECK(stats.submitted == frames);
+    return frames / seconds;
+}
+
+/**
+ * @brief 同じ処理を 1 スレッドで順に行った場合の 1 秒あたりのフレーム数を求める (パイプライン化前の比較用)。
+ * @param frames フレーム数。
+ * @param update 更新の処理時間。
+ * @param submit 提出の処理時間。
+ * @return 1 秒あたりのフレーム数。
+ */
+static double MeasureSerial(uint64_t frames, std::chrono::microseconds update, std::chrono::microseconds submit)
+{
+    const auto t0 = Clock::now();
+    for (uint64_t i = 0; i < frames; ++i)
+    {
+        Spin(update);
+        Spin(submit);
+    }
+    return frames / std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+/**
+ * @brief エントリーポイント。
+ * @param argc 引数の数。
+ * @param argv 引数 (argv[1] は各計測のフレーム数。既定は 2000)。
+ * @return 受け渡しの順序や数が食い違えば 1。
+ */
+int main(int argc, char** argv)
+{
+    const uint64_t frames = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+
+    std::printf("SpscQueue                     %10.1f M items/s\n", MeasureQueue(10000000) / 1e6);
+
+    // 提出が何もしない場合: パケットの受け渡しと起床だけの費用
+    FramePipelineStats stats;
+    const std::chrono::microseconds none(0);
+    const double empty = MeasurePipeline(frames * 10, none, none, stats);
+    std::printf("FramePipeline (empty)         %10.0f frames/s %8.2f us/frame  stalls %llu\n", empty, 1e6 / empty,
+                static_cast<unsigned long long>(stats.stalls));
+
+    // 更新と提出が同程度の場合: 2 段が重なるぶん、順に行うより速くなる (コアが 2 つ以上あれば最大 2 倍)
+    const std::chrono::microseconds work(250);
+    const double serial = MeasureSerial(frames, work, work);
+    const double pipelined = MeasurePipeline(frames, work, work, stats);
+    std::printf("serial  (250us + 250us)       %10.0f frames/s\n", serial);
+    std::printf("pipeline (250us + 250us)      %10.0f frames/s  %.2fx  latency %.3f ms  stalls %llu\n", pipelined,
+                pipelined / serial, stats.latencyMs, static_cast<unsigned long long>(stats.stalls));
+    return TestExitCode();
+}
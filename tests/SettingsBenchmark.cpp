@@ -0,0 +1,207 @@
+/**
+ * @file SettingsBenchmark.cpp
+ * @brief 設定キー数ごとの Settings の読み込み・再読み込み・取得・設定・確定・保存の所要時間を計測するマイクロベンチマーク。
+ * @author 山内陽
+ */
+
+#include "AsyncFileWriter.h"
+#include "Hash.h"
+#include "IniParser.h"
+#include "Settings.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 1 カテゴリあたり 10 キーの設定ファイルを書き出す (エンティティごとの調整値を並べた生成設定を想定)。
+ * @param path 書き出し先。
+ * @param keys キー数。
+ * @param cats 各キーのカテゴリ名。
+ * @param names 各キーのキー名。
+ * @return 書き出した内容。
+ */
+static std::string WriteSettingsFile(const std::filesystem::path& path, size_t keys, std::vector<std::string>& cats,
+                                     std::vector<std::string>& names)
+{
+    cats.resize(keys);
+    names.resize(keys);
+    std::string text;
+    text.reserve(keys * 24);
+    char line[64];
+    for (size_t i = 0; i < keys; ++i)
+    {
+        if (i % 10 == 0)
+        {
+            std::snprintf(line, sizeof(line), "[Entity%zu]\n", i / 10);
+            text += line;
+        }
+        cats[i] = "Entity" + std::to_string(i / 10);
+        names[i] = "Param" + std::to_string(i % 10);
+        std::snprintf(line, sizeof(line), "%s=%zu.5\n", names[i].c_str(), i);
+        text += line;
+    }
+    CHECK(AsyncFileWriter::WriteAtomically(path, text));
+    return text;
+}
+
+/**
+ * @brief 監視スレッドと同じく、ファイル内容を解析して直前の内容との差分を作る。
+ * @param settings 取り込み先。
+ * @param base 直前に受け渡した内容。
+ * @param text ファイル内容。
+ * @param doc 書き込み先。
+ */
+static void PrepareReload(const Settings& settings, Settings::DiffBase& base, const std::string& text,
+                          IniDocument& doc)
+{
+    doc = IniDocument{};
+    doc.text = text;
+    doc.hash = Hash64(doc.text);
+    ParseIni(doc.text, doc.entries);
+    settings.Diff(doc, base);
+}
+
+/**
+ * @brief 1 回分の所要時間を計る。
+ * @param fn 計測する処理。
+ * @return 所要時間 (秒)。
+ */
+template <typename Fn>
+static double MeasureOnce(Fn&& fn)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/**
+ * @brief 指定キー数で各操作を計測して 1 行で表示する。
+ * @param dir 作業ディレクトリ。
+ * @param keys キー数。
+ */
+static void RunSize(const std::filesystem::path& dir, size_t keys)
+{
+    const std::filesystem::path path = dir / ("settings_" + std::to_string(keys) + ".ini");
+    std::filesystem::path cache = path;
+    cache += ".cache";
+    std::vector<std::string> cats;
+    std::vector<std::string> names;
+    std::string text = WriteSettingsFile(path, keys, cats, names);
+
+    // 読み込み: キャッシュの無い状態での解析と、2 回目以降のキャッシュからの復元
+    std::unique_ptr<Settings> settings;
+    const double loadSeconds = MeasureOnce([&] {
+        settings = std::make_unique<Settings>();
+        CHECK(settings->Load(path.wstring()));
+    });
+    const int loadRepeats = keys >= 1000000 ? 1 : 3;
+    const double cachedSeconds = MeasureBest(loadRepeats, [&] {
+        settings = std::make_unique<Settings>();
+        CHECK(settings->Load(path.wstring()));
+    });
+
+    // 再読み込み: 先頭のキーの値だけを変えた内容を監視スレッドの分担 (解析と差分) まで済ませ、取り込みだけを計る
+    Settings::DiffBase base;
+    IniDocument doc;
+    PrepareReload(*settings, base, text, doc);
+    CHECK(settings->Apply(doc));
+    const int reloads = 20;
+    const size_t edited = text.find('=') + 1;
+    double reloadSeconds = 0.0;
+    for (int r = 0; r < reloads; ++r)
+    {
+        text[edited] = static_cast<char>('1' + r % 9);
+        PrepareReload(*settings, base, text, doc);
+        reloadSeconds += MeasureOnce([&] { CHECK(settings->Apply(doc)); });
+    }
+    CHECK(settings->Stats().incremental == static_cast<uint64_t>(reloads));
+    CHECK(settings->GetDouble(cats[0], names[0], 0.0) == (reloads - 1) % 9 + 1.5);
+
+    // 取得・設定: カテゴリ名とキー名で無作為な順に引く
+    const size_t ops = (std::max)(keys, static_cast<size_t>(100000));
+    std::vector<uint32_t> order(ops);
+    std::mt19937 rng(static_cast<uint32_t>(keys));
+    for (uint32_t& i : order)
+        i = static_cast<uint32_t>(rng() % keys);
+    const double getSeconds = MeasureBest(3, [&] {
+        double sum = 0.0;
+        for (uint32_t i : order)
+            sum += settings->GetDouble(cats[i], names[i], 0.0);
+        Consume(static_cast<uint64_t>(sum));
+    });
+    CHECK(settings->GetDouble(cats[keys - 1], names[keys - 1], 0.0) == static_cast<double>(keys - 1) + 0.5);
+
+    // 確定: 1 キーだけのトランザクション。スナップショットの公開と未保存の編集の記録を含む
+    const int commits = keys >= 1000000 ? 20 : 200;
+    std::vector<Settings::Handle> handles(commits);
+    for (int r = 0; r < commits; ++r)
+        handles[r] = settings->Resolve(cats[order[r % ops]], names[order[r % ops]]);
+    const double commitSeconds = MeasureOnce([&] {
+        for (int r = 0; r < commits; ++r)
+        {
+            Settings::Transaction tx = settings->Begin();
+            tx.SetDouble(handles[r], static_cast<double>(r) + 0.75);
+            CHECK(tx.Commit());
+        }
+    });
+    CHECK(settings->GetDouble(handles[commits - 1], 0.0) == static_cast<double>(commits - 1) + 0.75);
+    const double setSeconds = MeasureBest(3, [&] {
+        for (uint32_t i : order)
+            settings->SetDouble(cats[i], names[i], static_cast<double>(i) + 0.25);
+    });
+
+    // 保存: 書き出しの完了 (fsync と置き換え) までを含める
+    const double saveSeconds = MeasureOnce([&] {
+        CHECK(settings->Save());
+        settings->FlushSave();
+    });
+    settings.reset();
+
+    Settings reloaded;
+    std::filesystem::remove(cache);
+    CHECK(reloaded.Load(path.wstring()));
+    CHECK(reloaded.GetDouble(cats[order[0]], names[order[0]], 0.0) == static_cast<double>(order[0]) + 0.25);
+
+    std::printf("%9zu %12.2f %12.2f %12.2f %10.1f %10.1f %12.2f %12.2f\n", keys, loadSeconds * 1e3, cachedSeconds * 1e3,
+                reloadSeconds / reloads * 1e6, getSeconds / ops * 1e9, setSeconds / ops * 1e9,
+                commitSeconds / commits * 1e6, saveSeconds * 1e3);
+    std::filesystem::remove(path);
+    std::filesystem::remove(cache);
+}
+
+/**
+ * @brief エントリーポイント。
+ * @param argc 引数の数。
+ * @param argv 計測するキー数の並び (既定は 10 1000 100000 1000000)。
+ * @return 読み書きした値が食い違えば 1。
+ */
+int main(int argc, char** argv)
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    if (sizes.empty())
+        sizes = {10, 1000, 100000, 1000000};
+
+    std::error_code ec;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "SettingsBenchmark";
+    std::filesystem::create_directories(dir, ec);
+
+    std::printf("%9s %12s %12s %12s %10s %10s %12s %12s\n", "keys", "load ms", "cached ms", "reload us", "get ns",
+                "set ns", "commit us", "save ms");
+    for (size_t keys : sizes)
+    {
+        if (keys > 0)
+            RunSize(dir, keys);
+    }
+    std::filesystem::remove_all(dir, ec);
+    return TestExitCode();
+}
@@ -0,0 +1,144 @@
+/**
+ * @file SettingsDiffTest.cpp
+ * @brief Settings::Diff で作った差分を Apply が取り込み、値が変わったキーだけを統合し直すことを確かめる単体試験。
+ * @author 山内陽
+ */
+
+#include "AsyncFileWriter.h"
+#include "IniParser.h"
+#include "Settings.h"
+#include "TestUtil.h"
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+/**
+ * @brief 監視スレッドと同じく、テキストを解析して差分を作った内容を用意する。
+ * @param settings 差分の基準となるキー名表を持つ設定。
+ * @param base 直前に受け渡した内容。
+ * @param text ファイル内容。
+ * @param doc 書き込み先。
+ */
+static void Prepare(const Settings& settings, Settings::DiffBase& base, std::string_view text, IniDocument& doc)
+{
+    doc = IniDocument{};
+    doc.text.assign(text.data(), text.size());
+    ParseIni(doc.text, doc.entries);
+    settings.Diff(doc, base);
+}
+
+/**
+ * @brief 値を 1 つ変えた内容は差分だけで取り込まれ、位置のずれた他のキーも正しく引けることを確かめる。
+ * @param path 設定ファイル。
+ */
+static void TestSingleChange(const std::filesystem::path& path)
+{
+    const std::string original = "[A]\nx=1\ny=2\n[B]\nz=3\n";
+    CHECK(AsyncFileWriter::WriteAtomically(path, original));
+    Settings settings;
+    CHECK(settings.Load(path.wstring()));
+    const Settings::Handle x = settings.Resolve("A", "x");
+    const Settings::Handle z = settings.Resolve("B", "z");
+
+    // 最初の受け渡しは基準を覚えるだけ (内容が同じなので取り込みも省かれる)
+    Settings::DiffBase base;
+    IniDocument doc;
+    Prepare(settings, base, original, doc);
+    CHECK(!doc.incremental);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().skipped == 1);
+
+    Prepare(settings, base, "[A]\nx=100\ny=2\n[B]\nz=3\n", doc);
+    CHECK(doc.incremental);
+    CHECK(doc.changes.size() == 1 && doc.changes[0].id == x.id && !doc.changes[0].removed);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().incremental == 1);
+    CHECK(settings.ChangedKeys().size() == 1 && settings.ChangedKeys()[0].id == x.id);
+    CHECK(settings.GetInt(x, 0) == 100);
+    CHECK(settings.GetView(z) == std::string_view("3"));
+    CHECK(settings.Read()->GetInt(x, 0) == 100);
+    CHECK(settings.Read()->GetView(z) == std::string_view("3"));
+
+    // キーの削除と、上位レイヤーに覆われたキーの変更
+    const uint32_t top = settings.AddLayer("override");
+    CHECK(settings.SetLayerText(top, "[B]\nz=30\n"));
+    Prepare(settings, base, "[A]\nx=100\n[B]\nz=4\n", doc);
+    CHECK(doc.incremental && doc.changes.size() == 2);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().incremental == 2);
+    CHECK(!settings.Has(settings.Resolve("A", "y")));
+    CHECK(settings.ChangedKeys().size() == 1);
+    CHECK(settings.GetInt(z, 0) == 30);
+    CHECK(settings.SetLayerText(top, ""));
+    CHECK(settings.GetInt(z, 0) == 4);
+}
+
+/**
+ * @brief 差分を使えない場合 (新しいキー・編集済み・受け渡しの取りこぼし) は全体を統合し直すことを確かめる。
+ * @param path 設定ファイル。
+ */
+static void TestFallback(const std::filesystem::path& path)
+{
+    const std::string original = "[A]\nx=1\n";
+    CHECK(AsyncFileWriter::WriteAtomically(path, original));
+    Settings settings;
+    CHECK(settings.Load(path.wstring()));
+    Settings::DiffBase base;
+    IniDocument doc;
+    Prepare(settings, base, original, doc);
+    CHECK(settings.Apply(doc));
+
+    // キー名表に無いキーが現れた: 差分を作らず基準を捨てる
+    Prepare(settings, base, "[A]\nx=1\nw=5\n", doc);
+    CHECK(!doc.incremental && !base.valid);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().incremental == 0);
+    CHECK(settings.GetInt("A", "w", 0) == 5);
+    Prepare(settings, base, "[A]\nx=2\nw=5\n", doc);
+    CHECK(!doc.incremental && base.valid);
+    CHECK(settings.Apply(doc));
+    Prepare(settings, base, "[A]\nx=3\nw=5\n", doc);
+    CHECK(doc.incremental);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().incremental == 1);
+    CHECK(settings.GetInt("A", "x", 0) == 3);
+
+    // 基本レイヤーを編集した後は、差分の基準と内容が一致しない
+    settings.SetInt("A", "w", 6);
+    Prepare(settings, base, "[A]\nx=4\nw=5\n", doc);
+    CHECK(doc.incremental);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().incremental == 1);
+    CHECK(settings.GetInt("A", "x", 0) == 4);
+    CHECK(settings.GetInt("A", "w", 0) == 5);
+
+    // 間の内容を取り込まなかった (メールボックスで上書きされた)
+    IniDocument skipped;
+    Prepare(settings, base, "[A]\nx=5\nw=5\n", skipped);
+    Prepare(settings, base, "[A]\nx=6\nw=7\n", doc);
+    CHECK(doc.incremental && doc.changes.size() == 2);
+    CHECK(settings.Apply(doc));
+    CHECK(settings.Stats().incremental == 1);
+    CHECK(settings.GetInt("A", "x", 0) == 6);
+    CHECK(settings.GetInt("A", "w", 0) == 7);
+}
+
+/**
+ * @brief エントリーポイント。
+ * @return いずれかの検査に失敗すれば 1。
+ */
+int main()
+{
+    std::error_code ec;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "SettingsDiffTest";
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+
+    TestSingleChange(dir / "single.ini");
+    TestFallback(dir / "fallback.ini");
+
+    std::filesystem::remove_all(dir, ec);
+    return TestExitCode();
+}
@@ -0,0 +1,132 @@
+/**
+ * @file SnapshotReadBenchmark.cpp
+ * @brief 設定スナップショットの読み出しが読者スレッド数に対してどう伸びるかを計測するベンチマーク。
+ * @author 山内陽
+ */
+
+#include "Settings.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 読者スレッドを並べて一定時間読み続けさせ、全体の読み出し回数を数える。
+ * @details 計測中は書き手が 1ms ごとに新しい版を公開し続ける (ホットリロードや UI 編集より十分に頻繁)。
+ * @param threads 読者スレッド数。
+ * @param duration 計測時間。
+ * @param read 1 回の読み出し (読んだ値の要約を返す)。
+ * @param publish 1 回の公開。
+ * @return 全読者の読み出し回数。
+ */
+template <typename Read, typename Publish>
+static uint64_t RunReaders(unsigned threads, std::chrono::milliseconds duration, Read&& read, Publish&& publish)
+{
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> readers;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        readers.emplace_back([&] {
+            while (!start.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            uint64_t n = 0;
+            uint64_t sum = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                sum += read();
+                ++n;
+            }
+            Consume(sum);
+            total.fetch_add(n, std::memory_order_relaxed);
+        });
+    }
+
+    const auto end = std::chrono::steady_clock::now() + duration;
+    start.store(true, std::memory_order_release);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        publish();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop.store(true, std::memory_order_relaxed);
+    for (std::thread& t : readers)
+        t.join();
+    return total.load();
+}
+
+/**
+ * @brief エントリーポイント。1 スレッドからコア数まで倍々に読者を増やし、SnapshotCell 経由の読み出しと
+ *        mutex で守った共有ポインタの読み出しを比べる。
+ * @param argc 引数の数。
+ * @param argv 引数 (argv[1] は 1 段あたりの計測時間 (ミリ秒)。既定は 200)。
+ * @return 常に 0 (計測のみ)。
+ */
+int main(int argc, char** argv)
+{
+    const std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1]) : 200);
+    const unsigned maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+
+    Settings settings;
+    settings.SetLayerText(0, "[Render]\nMaxFps=240\n[Triangle]\nScale=1.5\nRotationSpeed=1\n");
+    const Settings::Handle maxFps = settings.Resolve("Render", "MaxFps");
+    const Settings::Handle scale = settings.Resolve("Triangle", "Scale");
+    const Settings::Handle speed = settings.Resolve("Triangle", "RotationSpeed");
+    int edits = 0;
+    auto publishSettings = [&] {
+        settings.SetInt(maxFps, 240 + (++edits & 1));
+        settings.Publish();
+    };
+    auto readSettings = [&] {
+        auto snap = settings.Read();
+        return static_cast<uint64_t>(snap->GetInt(maxFps, 0) + snap->GetDouble(scale, 0.0) +
+                                     snap->GetDouble(speed, 0.0));
+    };
+
+    // 比較用: 読むたびに mutex を取り、公開中の版の共有ポインタを複製する
+    std::mutex mutex;
+    auto shared = std::make_shared<const std::array<double, 3>>();
+    auto publishShared = [&] {
+        auto next = std::make_shared<std::array<double, 3>>();
+        (*next)[0] = 240 + (++edits & 1);
+        std::lock_guard<std::mutex> lock(mutex);
+        shared = std::move(next);
+    };
+    auto readShared = [&] {
+        std::shared_ptr<const std::array<double, 3>> snap;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            snap = shared;
+        }
+        return static_cast<uint64_t>((*snap)[0] + (*snap)[1] + (*snap)[2]);
+    };
+
+    std::printf("%8s %18s %10s %18s %10s\n", "readers", "snapshot Mreads/s", "scaling", "mutex Mreads/s", "scaling");
+    double snapshotBase = 0.0;
+    double mutexBase = 0.0;
+    for (unsigned threads = 1;; threads = (std::min)(threads * 2, maxThreads))
+    {
+        const double seconds = std::chrono::duration<double>(duration).count();
+        const double snapshotRate = RunReaders(threads, duration, readSettings, publishSettings) / seconds / 1e6;
+        const double mutexRate = RunReaders(threads, duration, readShared, publishShared) / seconds / 1e6;
+        if (threads == 1)
+        {
+            snapshotBase = snapshotRate;
+            mutexBase = mutexRate;
+        }
+        std::printf("%8u %18.1f %9.2fx %18.1f %9.2fx\n", threads, snapshotRate, snapshotRate / snapshotBase, mutexRate,
+                    mutexRate / mutexBase);
+        if (threads == maxThreads)
+            break;
+    }
+    return 0;
+}
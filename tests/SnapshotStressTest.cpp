@@ -0,0 +1,207 @@
+/**
+ * @file SnapshotStressTest.cpp
+ * @brief SnapshotCell と Settings のスナップショット公開を、複数の書き手・読者スレッドで同時に動かす負荷試験。
+ * @author 山内陽
+ */
+
+#include "Settings.h"
+#include "SnapshotCell.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 公開するオブジェクト。全要素が同じ値なら一貫した状態で読めている。
+ */
+struct Payload
+{
+    static constexpr uint64_t kAlive = 0x5AFE5AFE5AFE5AFEull; // 生存中を表す印
+    static inline std::atomic<int64_t> s_live{0};             // 生存中のオブジェクト数
+
+    /**
+     * @brief 全要素を seq で埋めて構築する。
+     * @param seq 公開番号。
+     */
+    explicit Payload(uint64_t seq)
+    {
+        std::fill(std::begin(values), std::end(values), seq);
+        s_live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 印を消して破棄する。回収済みのオブジェクトを読んだ読者は印の食い違いで検出できる。
+     */
+    ~Payload()
+    {
+        alive = 0;
+        std::fill(std::begin(values), std::end(values), ~0ull);
+        s_live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    uint64_t alive = kAlive; // 生存中の印
+    uint64_t values[16];     // 公開番号 (すべて同じ値)
+};
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief 読者スレッドの数。コア数が少なくても書き手と競合するよう最低 4 とする。
+ * @return スレッド数。
+ */
+static unsigned ReaderCount()
+{
+    return (std::max)(4u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief 複数の書き手が公開を繰り返す間、読者が破棄済みや書きかけのオブジェクトを見ないことを確かめる。
+ * @param duration 書き手が公開を繰り返す時間。
+ */
+static void TestSnapshotCell(std::chrono::milliseconds duration)
+{
+    constexpr int kWriters = 2;
+
+    {
+        SnapshotCell<Payload> cell;
+        cell.Publish(std::make_unique<Payload>(0));
+
+        std::atomic<bool> done{false};
+        std::atomic<uint64_t> nextSeq{1};
+        std::atomic<int> torn{0};
+        std::atomic<uint64_t> reads{0};
+
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < ReaderCount(); ++r)
+        {
+            threads.emplace_back([&] {
+                uint64_t n = 0;
+                while (!done.load(std::memory_order_acquire))
+                {
+                    auto guard = cell.Read();
+                    const Payload& p = *guard;
+                    bool ok = p.alive == Payload::kAlive;
+                    for (uint64_t v : p.values)
+                        ok = ok && v == p.values[0];
+                    if (!ok)
+                        torn.fetch_add(1, std::memory_order_relaxed);
+                    ++n;
+                }
+                reads.fetch_add(n, std::memory_order_relaxed);
+            });
+        }
+
+        // 公開は読者が抜けるのを待つため、コア数が少ないと回数が伸びない。回数ではなく時間で区切る
+        const auto deadline = Clock::now() + duration;
+        std::vector<std::thread> writers;
+        for (int w = 0; w < kWriters; ++w)
+        {
+            writers.emplace_back([&] {
+                while (Clock::now() < deadline)
+                    cell.Publish(std::make_unique<Payload>(nextSeq.fetch_add(1, std::memory_order_relaxed)));
+            });
+        }
+        for (std::thread& t : writers)
+            t.join();
+        done.store(true, std::memory_order_release);
+        for (std::thread& t : threads)
+            t.join();
+
+        const uint64_t publishes = nextSeq.load() - 1;
+        std::printf("SnapshotCell: %llu publishes, %llu reads, %u readers\n",
+                    static_cast<unsigned long long>(publishes), static_cast<unsigned long long>(reads.load()),
+                    ReaderCount());
+        CHECK(torn.load() == 0);
+        CHECK(publishes > 0);
+        CHECK(reads.load() > 0);
+        // 公開中の 1 つ以外はすべて回収されている
+        CHECK(Payload::s_live.load() == 1);
+        CHECK(cell.Read()->values[0] <= publishes);
+    }
+    CHECK(Payload::s_live.load() == 0);
+}
+
+/**
+ * @brief Settings の所有スレッドが値を編集・公開する間、他スレッドから読むスナップショットが一貫していることを確かめる。
+ * @details 書き手は 2 つのキーへ常に同じ値を書いてから公開する。読者が別々の値を見たら、公開途中の状態が見えている。
+ * @param duration 書き手が公開を繰り返す時間。
+ */
+static void TestSettingsSnapshot(std::chrono::milliseconds duration)
+{
+    Settings settings;
+    settings.SetLayerText(0, "[Stress]\nA=0\nB=0\nName=v0\n");
+    const Settings::Handle a = settings.Resolve("Stress", "A");
+    const Settings::Handle b = settings.Resolve("Stress", "B");
+    const Settings::Handle name = settings.Resolve("Stress", "Name");
+
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::atomic<int> backwards{0};
+    std::vector<std::thread> threads;
+    for (unsigned r = 0; r < ReaderCount(); ++r)
+    {
+        threads.emplace_back([&] {
+            uint64_t lastVersion = 0;
+            int lastValue = 0;
+            while (!done.load(std::memory_order_acquire))
+            {
+                auto snap = settings.Read();
+                const int va = snap->GetInt(a, -1);
+                const int vb = snap->GetInt(b, -2);
+                const auto text = snap->GetView(name);
+                const bool nameOk = text && *text == "v" + std::to_string(va);
+                if (va != vb || !nameOk)
+                    torn.fetch_add(1, std::memory_order_relaxed);
+                // 版番号と値は公開順にしか進まない
+                if (snap->Version() < lastVersion || va < lastValue)
+                    backwards.fetch_add(1, std::memory_order_relaxed);
+                lastVersion = snap->Version();
+                lastValue = va;
+            }
+        });
+    }
+
+    std::string text;
+    const auto deadline = Clock::now() + duration;
+    int publishes = 0;
+    while (Clock::now() < deadline)
+    {
+        ++publishes;
+        text = "v" + std::to_string(publishes);
+        settings.SetInt(a, publishes);
+        settings.SetString(name, text);
+        settings.SetInt(b, publishes);
+        settings.Publish();
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread& t : threads)
+        t.join();
+
+    std::printf("Settings: %d publishes, %u readers\n", publishes, ReaderCount());
+    CHECK(torn.load() == 0);
+    CHECK(backwards.load() == 0);
+    CHECK(publishes > 0);
+    CHECK(settings.Read()->GetInt(b, 0) == publishes);
+}
+
+/**
+ * @brief エントリーポイント。
+ * @param argc 引数の数。
+ * @param argv 引数 (argv[1] は各試験で公開を繰り返す時間 (ミリ秒)。既定は 1000)。
+ * @return いずれかの検査に失敗すれば 1。
+ */
+int main(int argc, char** argv)
+{
+    const std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1]) : 1000);
+    TestSnapshotCell(duration);
+    TestSettingsSnapshot(duration);
+    return TestExitCode();
+}
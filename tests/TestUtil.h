@@ -0,0 +1,79 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * @file TestUtil.h
+ * @brief テスト・ベンチマーク実行ファイルで共有する検査マクロと計時ヘルパー。
+ * @author 山内陽
+ */
+
+/**
+ * @brief 失敗した検査の数。CHECK が加算し、TestExitCode が終了コードへ変換する。
+ */
+inline int g_testFailures = 0;
+
+/**
+ * @brief 条件が偽なら位置と式を表示して失敗を記録する。以降の検査は続ける。
+ */
+#define CHECK(cond)                                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);                              \
+            ++g_testFailures;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+/**
+ * @brief 失敗の有無を表示し、main の戻り値にする終了コードを返す。
+ * @return 失敗が無ければ EXIT_SUCCESS。
+ */
+inline int TestExitCode()
+{
+    if (g_testFailures == 0)
+        return EXIT_SUCCESS;
+    std::fprintf(stderr, "%d check(s) failed\n", g_testFailures);
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief 処理を複数回実行し、最も速かった 1 回の所要時間を返す。
+ * @details 初回はキャッシュやヒープを温めるだけで計測に含めない。
+ * @param repeats 計測する回数。
+ * @param fn 計測する処理。
+ * @return 最短の所要時間 (秒)。
+ */
+template <typename Fn>
+double MeasureBest(int repeats, Fn&& fn)
+{
+    using Clock = std::chrono::steady_clock;
+    fn();
+    double best = 1e30;
+    for (int i = 0; i < repeats; ++i)
+    {
+        const auto t0 = Clock::now();
+        fn();
+        const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (s < best)
+            best = s;
+    }
+    return best;
+}
+
+/**
+ * @brief 計測結果を溜める変数。ベンチマークの処理が最適化で消されないよう結果を書き込む。
+ */
+inline volatile uint64_t g_benchmarkSink = 0;
+
+/**
+ * @brief 計測した処理の結果を観測可能にする。
+ * @param v 処理結果から作った値 (件数・合計など)。
+ */
+inline void Consume(uint64_t v)
+{
+    g_benchmarkSink = g_benchmarkSink ^ v;
+}